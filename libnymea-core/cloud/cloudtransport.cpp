@@ -33,10 +33,16 @@
 
 #include "nymeacore.h"
 
+#include <QTimer>
+#include <QAbstractSocket>
+
 using namespace remoteproxyclient;
 
 namespace nymeaserver {
 
+// Data queued for a tunnel and not yet sent to the proxy server before the client gets disconnected
+static const qint64 maxPendingBytes = 4 * 1024 * 1024;
+
 CloudTransport::CloudTransport(const ServerConfiguration &config, QObject *parent):
     TransportInterface(config, parent)
 {
@@ -46,32 +52,137 @@ CloudTransport::CloudTransport(const ServerConfiguration &config, QObject *paren
 void CloudTransport::sendData(const QUuid &clientId, const QByteArray &data)
 {
     qCDebug(dcCloudTraffic()) << "Sending data" << clientId << data;
-    foreach (const ConnectionContext &ctx, m_connections) {
-        if (ctx.clientId == clientId) {
-            ctx.proxyConnection->sendData(data);
-            return;
-        }
+    RemoteProxyConnection *proxyConnection = m_clientConnections.value(clientId);
+    if (!proxyConnection) {
+        qCWarning(dcCloud()) << "Error sending data. No such clientId";
+        return;
     }
-    qCWarning(dcCloud()) << "Error sending data. No such clientId";
+    queueData(m_connections[proxyConnection], data);
 }
 
 void CloudTransport::sendData(const QList<QUuid> &clientIds, const QByteArray &data)
 {
+    qCDebug(dcCloudTraffic()) << "Sending data to" << clientIds.count() << "clients" << data;
     foreach (const QUuid &clientId, clientIds) {
-        sendData(clientId, data);
+        RemoteProxyConnection *proxyConnection = m_clientConnections.value(clientId);
+        if (proxyConnection) {
+            queueData(m_connections[proxyConnection], data);
+        }
     }
 }
 
 void CloudTransport::terminateClientConnection(const QUuid &clientId)
 {
-    foreach (const ConnectionContext &ctx, m_connections) {
-        if (ctx.clientId == clientId) {
-            ctx.proxyConnection->disconnectServer();
-            return;
+    RemoteProxyConnection *proxyConnection = m_clientConnections.value(clientId);
+    if (proxyConnection) {
+        closeTunnel(proxyConnection);
+    }
+}
+
+void CloudTransport::queueData(ConnectionContext &context, const QByteArray &data)
+{
+    if (context.closing) {
+        return;
+    }
+
+    // The tunnel can't be written to before the next cycle, so its buffer only needs to be checked once per cycle
+    if (context.pendingMessages.isEmpty()) {
+        context.tunnelBytes = tunnelBytesToWrite(context.proxyConnection);
+    }
+
+    // Each message is terminated by a newline
+    if (context.tunnelBytes + context.pendingBytes + data.size() + 1 > maxPendingBytes) {
+        qCWarning(dcCloud()) << "More than" << maxPendingBytes << "bytes pending for cloud client" << context.clientId.toString() << "Disconnecting the client.";
+        context.pendingMessages.clear();
+        context.pendingBytes = 0;
+        context.closing = true;
+        closeTunnel(context.proxyConnection);
+        return;
+    }
+
+    context.pendingMessages.append(data);
+    context.pendingBytes += data.size() + 1;
+
+    if (!m_flushScheduled) {
+        m_flushScheduled = true;
+        QTimer::singleShot(0, this, &CloudTransport::flushConnections);
+    }
+}
+
+void CloudTransport::flushConnections()
+{
+    m_flushScheduled = false;
+
+    // Collect first, a connection might get disconnected while sending
+    QList<QPair<RemoteProxyConnection*, QByteArray>> writes;
+    for (QHash<RemoteProxyConnection*, ConnectionContext>::iterator it = m_connections.begin(); it != m_connections.end(); ++it) {
+        ConnectionContext &context = it.value();
+        if (context.pendingMessages.isEmpty()) {
+            continue;
+        }
+
+        // Every message is terminated by a newline like on the TCP transport
+        QByteArray data;
+        data.reserve(static_cast<int>(context.pendingBytes));
+        foreach (const QByteArray &message, context.pendingMessages) {
+            data.append(message);
+            data.append('\n');
+        }
+        context.pendingMessages.clear();
+        context.pendingBytes = 0;
+        context.sentBytes += static_cast<quint64>(data.size());
+        writes.append(qMakePair(it.key(), data));
+    }
+
+    for (int i = 0; i < writes.count(); i++) {
+        if (m_connections.contains(writes.at(i).first)) {
+            writeTunnel(writes.at(i).first, writes.at(i).second);
         }
     }
 }
 
+QUuid CloudTransport::addTunnel(RemoteProxyConnection *proxyConnection, const QString &token, const QString &nonce)
+{
+    ConnectionContext context;
+    context.clientId = QUuid::createUuid();
+    context.token = token;
+    context.nonce = nonce;
+    context.proxyConnection = proxyConnection;
+    m_connections.insert(proxyConnection, context);
+    m_clientConnections.insert(context.clientId, proxyConnection);
+    return context.clientId;
+}
+
+void CloudTransport::removeTunnel(RemoteProxyConnection *proxyConnection)
+{
+    if (!m_connections.contains(proxyConnection)) {
+        return;
+    }
+
+    ConnectionContext context = m_connections.take(proxyConnection);
+    m_clientConnections.remove(context.clientId);
+
+    qCDebug(dcCloud()) << "The remote connection disconnected." << context.clientId << "Sent" << context.sentBytes << "bytes.";
+    emit clientDisconnected(context.clientId);
+}
+
+void CloudTransport::writeTunnel(RemoteProxyConnection *proxyConnection, const QByteArray &data)
+{
+    proxyConnection->sendData(data);
+}
+
+void CloudTransport::closeTunnel(RemoteProxyConnection *proxyConnection)
+{
+    proxyConnection->disconnectServer();
+}
+
+qint64 CloudTransport::tunnelBytesToWrite(RemoteProxyConnection *proxyConnection) const
+{
+    // The proxy connection doesn't expose its write buffer, but owns the socket it writes to
+    QAbstractSocket *socket = proxyConnection->findChild<QAbstractSocket*>();
+    return socket ? socket->bytesToWrite() : 0;
+}
+
 bool CloudTransport::startServer()
 {
     qCDebug(dcCloud()) << "Started cloud transport";
@@ -89,21 +200,17 @@ void CloudTransport::connectToCloud(const QString &token, const QString &nonce,
     QString proxyUrl = serverUrl.isEmpty() ? m_defaultProxyUrl : serverUrl;
     qCDebug(dcCloud()) << "Connecting to remote proxy server" << proxyUrl;
 
-    ConnectionContext context;
-    context.clientId = QUuid::createUuid();
-    context.token = token;
-    context.nonce = nonce;
     QString identifier = QString("nymea:core (%1)").arg(NymeaCore::instance()->configuration()->serverName());
-    context.proxyConnection = new RemoteProxyConnection(NymeaCore::instance()->configuration()->serverUuid().toString(), identifier, this);
-    m_connections.insert(context.proxyConnection, context);
+    RemoteProxyConnection *proxyConnection = new RemoteProxyConnection(NymeaCore::instance()->configuration()->serverUuid().toString(), identifier, this);
+    addTunnel(proxyConnection, token, nonce);
 
-    connect(context.proxyConnection, &RemoteProxyConnection::ready, this, &CloudTransport::transportReady);
-    connect(context.proxyConnection, &RemoteProxyConnection::stateChanged, this, &CloudTransport::remoteConnectionStateChanged);
-    connect(context.proxyConnection, &RemoteProxyConnection::dataReady, this, &CloudTransport::transportDataReady);
-    connect(context.proxyConnection, &RemoteProxyConnection::remoteConnectionEstablished, this, &CloudTransport::transportConnected);
-    connect(context.proxyConnection, &RemoteProxyConnection::disconnected, this, &CloudTransport::transportDisconnected);
+    connect(proxyConnection, &RemoteProxyConnection::ready, this, &CloudTransport::transportReady);
+    connect(proxyConnection, &RemoteProxyConnection::stateChanged, this, &CloudTransport::remoteConnectionStateChanged);
+    connect(proxyConnection, &RemoteProxyConnection::dataReady, this, &CloudTransport::transportDataReady);
+    connect(proxyConnection, &RemoteProxyConnection::remoteConnectionEstablished, this, &CloudTransport::transportConnected);
+    connect(proxyConnection, &RemoteProxyConnection::disconnected, this, &CloudTransport::transportDisconnected);
 
-    context.proxyConnection->connectServer(QUrl(proxyUrl));
+    proxyConnection->connectServer(QUrl(proxyUrl));
 }
 
 void CloudTransport::remoteConnectionStateChanged(RemoteProxyConnection::State state)
@@ -123,11 +230,8 @@ void CloudTransport::transportConnected()
 void CloudTransport::transportDisconnected()
 {
     RemoteProxyConnection *proxyConnection = qobject_cast<RemoteProxyConnection*>(sender());
-    ConnectionContext context = m_connections.take(proxyConnection);
+    removeTunnel(proxyConnection);
     proxyConnection->deleteLater();
-
-    qCDebug(dcCloud()) << "The remote connection disconnected." << context.clientId;
-    emit clientDisconnected(context.clientId);
 }
 
 void CloudTransport::transportReady()
@@ -32,6 +32,7 @@
 #define CLOUDTRANSPORT_H
 
 #include <QObject>
+#include <QByteArrayList>
 #include "../transportinterface.h"
 #include "nymea-remoteproxyclient/remoteproxyconnection.h"
 
@@ -62,6 +63,18 @@ private slots:
     void transportReady();
     void transportDataReady(const QByteArray &data);
     void transportDisconnected();
+    void flushConnections();
+
+protected:
+    // Registers a tunnel and returns the id of its remote client
+    QUuid addTunnel(remoteproxyclient::RemoteProxyConnection *proxyConnection, const QString &token, const QString &nonce);
+    void removeTunnel(remoteproxyclient::RemoteProxyConnection *proxyConnection);
+
+    // Virtual so the transport can be used without a proxy server
+    virtual void writeTunnel(remoteproxyclient::RemoteProxyConnection *proxyConnection, const QByteArray &data);
+    virtual void closeTunnel(remoteproxyclient::RemoteProxyConnection *proxyConnection);
+    // Bytes written to the tunnel which are not sent to the proxy server yet
+    virtual qint64 tunnelBytesToWrite(remoteproxyclient::RemoteProxyConnection *proxyConnection) const;
 
 private:
     QString m_defaultProxyUrl;
@@ -72,8 +85,20 @@ private:
         QString token;
         QString nonce;
         remoteproxyclient::RemoteProxyConnection* proxyConnection;
+        // Messages sent within the current event loop cycle, written as one tunnel message
+        QByteArrayList pendingMessages;
+        qint64 pendingBytes = 0;
+        // Bytes still buffered in the tunnel when the current cycle started
+        qint64 tunnelBytes = 0;
+        quint64 sentBytes = 0;
+        // Set once the tunnel is being closed, no more data is queued
+        bool closing = false;
     };
     QHash<remoteproxyclient::RemoteProxyConnection*, ConnectionContext> m_connections;
+    QHash<QUuid, remoteproxyclient::RemoteProxyConnection*> m_clientConnections;
+    bool m_flushScheduled = false;
+
+    void queueData(ConnectionContext &context, const QByteArray &data);
 
 };
 
@@ -33,6 +33,7 @@
 #include "nymeasettings.h"
 #include "nymeacore.h"
 #include "nymeaconfiguration.h"
+#include "ruleengine/ruleengine.h"
 #include "version.h"
 
 #include <QDir>
@@ -209,6 +210,7 @@ void DebugReportGenerator::saveConfigs()
     copyFileToReportDirectory(NymeaSettings(NymeaSettings::SettingsRoleThings).fileName(), "config");
     copyFileToReportDirectory(NymeaSettings(NymeaSettings::SettingsRoleThingStates).fileName(), "config");
     copyFileToReportDirectory(NymeaSettings(NymeaSettings::SettingsRoleRules).fileName(), "config");
+    copyFileToReportDirectory(NymeaCore::instance()->ruleEngine()->databaseName(), "config");
     copyFileToReportDirectory(NymeaSettings(NymeaSettings::SettingsRolePlugins).fileName(), "config");
     copyFileToReportDirectory(NymeaSettings(NymeaSettings::SettingsRoleTags).fileName(), "config");
     copyFileToReportDirectory(NymeaCore::instance()->configuration()->logDBName(), "config");
@@ -35,6 +35,7 @@
 #include "loggingcategories.h"
 #include "debugserverhandler.h"
 #include "nymeaconfiguration.h"
+#include "performancemonitor.h"
 #include "stdio.h"
 #include "version.h"
 
@@ -48,15 +49,30 @@
 #include <QWebSocket>
 #include <QPair>
 #include <QHostInfo>
+#include <QMetaEnum>
+
+#include <algorithm>
 
 
 namespace nymeaserver {
 
-QList<QWebSocket*> DebugServerHandler::s_websocketClients;
+// Number of log lines kept for new websocket clients
+static const int logHistoryLimit = 5000;
+// Live log lines are not sent to a client which has more than this amount of data queued
+static const qint64 maxPendingBytes = 1024 * 1024;
+
+QMutex DebugServerHandler::s_logMutex;
+QStringList DebugServerHandler::s_logHistory;
+QStringList DebugServerHandler::s_pendingLogLines;
+bool DebugServerHandler::s_forwardLogLines = false;
 
 DebugServerHandler::DebugServerHandler(QObject *parent) :
     QObject(parent)
 {
+    m_logFlushTimer = new QTimer(this);
+    m_logFlushTimer->setInterval(200);
+    connect(m_logFlushTimer, &QTimer::timeout, this, &DebugServerHandler::flushLogLines);
+
     connect(NymeaCore::instance()->configuration(), &NymeaConfiguration::debugServerEnabledChanged, this, &DebugServerHandler::onDebugServerEnabledChanged);
     onDebugServerEnabledChanged(NymeaCore::instance()->configuration()->debugServerEnabled());
 }
@@ -471,6 +487,57 @@ HttpReply *DebugServerHandler::processDebugRequest(const QString &requestPath, c
         }
     }
 
+    if (requestPath.startsWith("/debug/performance")) {
+        PerformanceMonitor *performanceMonitor = NymeaCore::instance()->performanceMonitor();
+
+        // Allow to enable the monitor temporarily, the configuration is not touched
+        if (requestQuery.hasQueryItem("enabled")) {
+            bool enabled = QVariant(requestQuery.queryItemValue("enabled")).toBool();
+            qCDebug(dcDebugServer()) << "Performance monitoring" << (enabled ? "enabled" : "disabled");
+            performanceMonitor->setEnabled(enabled);
+        }
+
+        qCDebug(dcDebugServer()) << "Request performance statistics";
+        QVariantList entries;
+        foreach (const PerformanceEntry &entry, performanceMonitor->entries()) {
+            QVariantMap entryMap;
+            entryMap.insert("category", QMetaEnum::fromType<PerformanceEntry::PerformanceCategory>().valueToKey(entry.category()));
+            entryMap.insert("name", entry.name());
+            if (!entry.label().isEmpty()) {
+                entryMap.insert("label", entry.label());
+            }
+            entryMap.insert("samples", entry.samples());
+            entryMap.insert("totalTime", entry.totalTime());
+            entryMap.insert("averageTime", entry.averageTime());
+            entryMap.insert("maxTime", entry.maxTime());
+            QVariantList histogram;
+            foreach (int count, entry.histogram()) {
+                histogram.append(count);
+            }
+            entryMap.insert("histogram", histogram);
+            entries.append(entryMap);
+        }
+
+        QVariantList histogramBounds;
+        foreach (double bound, PerformanceMonitor::histogramBounds()) {
+            histogramBounds.append(bound);
+        }
+
+        QVariantMap dataMap;
+        dataMap.insert("enabled", PerformanceMonitor::enabled());
+        dataMap.insert("histogramBounds", histogramBounds);
+        dataMap.insert("entries", entries);
+
+        if (QVariant(requestQuery.queryItemValue("reset")).toBool()) {
+            performanceMonitor->reset();
+        }
+
+        HttpReply *reply = HttpReply::createSuccessReply();
+        reply->setHeader(HttpReply::ContentTypeHeader, "application/json; charset=\"utf-8\";");
+        reply->setPayload(QJsonDocument::fromVariant(dataMap).toJson(QJsonDocument::Indented));
+        return reply;
+    }
+
     if (requestPath.startsWith("/debug/report")) {
 
         // The client can poll this url in order to get information about the current report generating process.
@@ -572,8 +639,15 @@ void DebugServerHandler::logMessageHandler(QtMsgType type, const QMessageLogCont
         break;
     }
 
-    foreach (QWebSocket *client, s_websocketClients) {
-        client->sendTextMessage(finalMessage);
+    // Never send from here, this may be called from any thread. The lines are
+    // sent to the clients in batches by flushLogLines() in the main thread.
+    QMutexLocker locker(&s_logMutex);
+    s_logHistory.append(finalMessage);
+    if (s_logHistory.count() > logHistoryLimit) {
+        s_logHistory.removeFirst();
+    }
+    if (s_forwardLogLines) {
+        s_pendingLogLines.append(finalMessage);
     }
 }
 
@@ -636,8 +710,26 @@ void DebugServerHandler::onDebugServerEnabledChanged(bool enabled)
         }
 
         qCDebug(dcDebugServer()) << "The debug server websocket interface has been started on" << m_websocketServer->serverUrl().toString();
+
+        // Collect the log history for clients connecting later
+        nymeaInstallMessageHandler(&logMessageHandler);
     } else {
         if (m_websocketServer) {
+            nymeaUninstallMessageHandler(&logMessageHandler);
+            m_logFlushTimer->stop();
+            foreach (QWebSocket *client, m_websocketClients.keys()) {
+                client->disconnect(this);
+                client->close();
+                client->deleteLater();
+            }
+            m_websocketClients.clear();
+
+            QMutexLocker locker(&s_logMutex);
+            s_forwardLogLines = false;
+            s_pendingLogLines.clear();
+            s_logHistory.clear();
+            locker.unlock();
+
             m_websocketServer->close();
             qCDebug(dcDebugServer()) << "The debug server websocket interface has been closed" << m_websocketServer->serverUrl().toString();
             m_websocketServer->deleteLater();
@@ -650,29 +742,45 @@ void DebugServerHandler::onWebsocketClientConnected()
 {
     QWebSocket *client = m_websocketServer->nextPendingConnection();
 
-    if (s_websocketClients.isEmpty()) {
-        qCDebug(dcDebugServer()) << "Install debug message handler for live logs.";
-        //QLoggingCategory::setFilterRules("*.debug=true");
-        nymeaInstallMessageHandler(&logMessageHandler);
+    // Send the history first, everything logged from now on follows with the next flush. The pending
+    // lines are part of the history already, they are taken together so the new client doesn't get them twice.
+    QMutexLocker locker(&s_logMutex);
+    QString history = s_logHistory.join(QString());
+    QStringList pendingLines;
+    pendingLines.swap(s_pendingLogLines);
+    if (m_websocketClients.isEmpty()) {
+        s_forwardLogLines = true;
+        m_logFlushTimer->start();
     }
+    locker.unlock();
+
+    sendLogLines(pendingLines);
 
-    s_websocketClients.append(client);
+    WebsocketClient clientState;
+    if (!history.isEmpty()) {
+        clientState.pendingBytes = client->sendTextMessage(history);
+    }
+    m_websocketClients.insert(client, clientState);
     qCDebug(dcDebugServer()) << "New websocket client connected:" << client->peerAddress().toString();
 
     connect(client, SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(onWebsocketClientError(QAbstractSocket::SocketError)));
     connect(client, &QWebSocket::disconnected, this, &DebugServerHandler::onWebsocketClientDisconnected);
+    connect(client, &QWebSocket::bytesWritten, this, &DebugServerHandler::onWebsocketClientBytesWritten);
 }
 
 void DebugServerHandler::onWebsocketClientDisconnected()
 {
     QWebSocket *client = static_cast<QWebSocket *>(sender());
     qCDebug(dcDebugServer()) << "Websocket client disconnected" << client->peerAddress().toString();
-    s_websocketClients.removeAll(client);
+    m_websocketClients.remove(client);
     client->deleteLater();
 
-    if (s_websocketClients.isEmpty()) {
-        qCDebug(dcDebugServer()) << "Uninstalling debug message handler for live logs.";
-        nymeaUninstallMessageHandler(&logMessageHandler);
+    if (m_websocketClients.isEmpty()) {
+        qCDebug(dcDebugServer()) << "Stop forwarding live logs.";
+        m_logFlushTimer->stop();
+        QMutexLocker locker(&s_logMutex);
+        s_forwardLogLines = false;
+        s_pendingLogLines.clear();
     }
 }
 
@@ -682,6 +790,49 @@ void DebugServerHandler::onWebsocketClientError(QAbstractSocket::SocketError err
     qCWarning(dcDebugServer()) << "Websocket client error" << client->peerAddress().toString() << error << client->errorString();
 }
 
+void DebugServerHandler::onWebsocketClientBytesWritten(qint64 bytes)
+{
+    QWebSocket *client = static_cast<QWebSocket *>(sender());
+    if (!m_websocketClients.contains(client))
+        return;
+
+    WebsocketClient &clientState = m_websocketClients[client];
+    clientState.pendingBytes = qMax(clientState.pendingBytes - bytes, Q_INT64_C(0));
+}
+
+void DebugServerHandler::flushLogLines()
+{
+    QMutexLocker locker(&s_logMutex);
+    QStringList lines;
+    lines.swap(s_pendingLogLines);
+    locker.unlock();
+
+    sendLogLines(lines);
+}
+
+void DebugServerHandler::sendLogLines(const QStringList &lines)
+{
+    if (lines.isEmpty())
+        return;
+
+    QString batch = lines.join(QString());
+    foreach (QWebSocket *client, m_websocketClients.keys()) {
+        WebsocketClient &clientState = m_websocketClients[client];
+
+        // Don't queue up data for clients which can't keep up
+        if (clientState.pendingBytes > maxPendingBytes) {
+            clientState.droppedLines += lines.count();
+            continue;
+        }
+
+        if (clientState.droppedLines > 0) {
+            clientState.pendingBytes += client->sendTextMessage(QString(" W | DebugServer: %1 log lines dropped because the connection is too slow.\n").arg(clientState.droppedLines));
+            clientState.droppedLines = 0;
+        }
+        clientState.pendingBytes += client->sendTextMessage(batch);
+    }
+}
+
 void DebugServerHandler::onPingProcessFinished(int exitCode, QProcess::ExitStatus exitStatus)
 {
     qCDebug(dcDebugServer()) << "Ping process finished" << exitCode << exitStatus;
@@ -930,6 +1081,14 @@ QByteArray DebugServerHandler::createDebugXmlDocument()
     writer.writeCharacters(tr("Logs"));
     writer.writeEndElement(); // button
 
+    writer.writeStartElement("button");
+    writer.writeAttribute("class", "tablinks");
+    writer.writeAttribute("id", "performanceTabButton");
+    writer.writeAttribute("onclick", "selectSection(event, 'performance-section')");
+    //: The name of the section tab in the debug server interface
+    writer.writeCharacters(tr("Performance"));
+    writer.writeEndElement(); // button
+
     writer.writeEndElement(); // tab
 
     // Body
@@ -1921,6 +2080,57 @@ QByteArray DebugServerHandler::createDebugXmlDocument()
 
     writer.writeEndElement(); // logs-section
 
+
+    // ---------------------------------------------------------------------------
+    writer.writeStartElement("div");
+    writer.writeAttribute("class", "tabcontent");
+    writer.writeAttribute("id", "performance-section");
+
+    writer.writeEmptyElement("hr");
+    //: The performance section of the debug interface
+    writer.writeTextElement("h2", tr("Performance"));
+    writer.writeEmptyElement("hr");
+
+    if (PerformanceMonitor::enabled()) {
+        writer.writeTextElement("p", tr("This section shows where the nymea server spent its time since the performance monitor has been enabled. All times are given in milliseconds. The raw data including histograms can be fetched from /debug/performance."));
+    } else {
+        writer.writeTextElement("p", tr("The performance monitor is disabled. It can be enabled with the performanceMonitoringEnabled setting in the nymead configuration, or temporarily using /debug/performance?enabled=true."));
+    }
+
+    // Show the most expensive code paths first
+    PerformanceEntries performanceEntries = NymeaCore::instance()->performanceMonitor()->entries();
+    std::sort(performanceEntries.begin(), performanceEntries.end(), [](const PerformanceEntry &a, const PerformanceEntry &b) {
+        return a.totalTime() > b.totalTime();
+    });
+
+    writer.writeStartElement("table");
+
+    writer.writeStartElement("tr");
+    //: The performance table header of the debug interface
+    writer.writeTextElement("th", tr("Category"));
+    writer.writeTextElement("th", tr("Name"));
+    writer.writeTextElement("th", tr("Samples"));
+    writer.writeTextElement("th", tr("Average"));
+    writer.writeTextElement("th", tr("Maximum"));
+    writer.writeTextElement("th", tr("Total"));
+    writer.writeEndElement(); // tr
+
+    QMetaEnum performanceCategoryEnum = QMetaEnum::fromType<PerformanceEntry::PerformanceCategory>();
+    foreach (const PerformanceEntry &entry, performanceEntries) {
+        writer.writeStartElement("tr");
+        writer.writeTextElement("td", QString(performanceCategoryEnum.valueToKey(entry.category())).remove("PerformanceCategory"));
+        writer.writeTextElement("td", entry.label().isEmpty() ? entry.name() : entry.label() + " (" + entry.name() + ")");
+        writer.writeTextElement("td", QString::number(entry.samples()));
+        writer.writeTextElement("td", QString::number(entry.averageTime(), 'f', 3));
+        writer.writeTextElement("td", QString::number(entry.maxTime(), 'f', 3));
+        writer.writeTextElement("td", QString::number(entry.totalTime(), 'f', 3));
+        writer.writeEndElement(); // tr
+    }
+
+    writer.writeEndElement(); // table
+
+    writer.writeEndElement(); // performance-section
+
     writer.writeEndElement(); // div body
 
     // Footer
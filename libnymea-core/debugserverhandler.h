@@ -31,6 +31,8 @@
 #ifndef DEBUGSERVERHANDLER_H
 #define DEBUGSERVERHANDLER_H
 
+#include <QHash>
+#include <QMutex>
 #include <QTimer>
 #include <QObject>
 #include <QProcess>
@@ -51,10 +53,23 @@ public:
     HttpReply *processDebugRequest(const QString &requestPath, const QUrlQuery &requestQuery);
 
 private:
-    static QList<QWebSocket*> s_websocketClients;
+    class WebsocketClient
+    {
+    public:
+        qint64 pendingBytes = 0;
+        int droppedLines = 0;
+    };
+
+    // Filled by the log message handler from any thread, consumed in the main thread
+    static QMutex s_logMutex;
+    static QStringList s_logHistory;
+    static QStringList s_pendingLogLines;
+    static bool s_forwardLogLines;
     static void logMessageHandler(QtMsgType type, const QMessageLogContext &context, const QString &message);
 
     QWebSocketServer *m_websocketServer = nullptr;
+    QHash<QWebSocket*, WebsocketClient> m_websocketClients;
+    QTimer *m_logFlushTimer = nullptr;
 
     QProcess *m_pingProcess = nullptr;
     HttpReply *m_pingReply = nullptr;
@@ -76,12 +91,16 @@ private:
     QByteArray createDebugXmlDocument();
     QByteArray createErrorXmlDocument(HttpReply::HttpStatusCode statusCode, const QString &errorMessage);
 
+    void sendLogLines(const QStringList &lines);
+
 private slots:
     void onDebugServerEnabledChanged(bool enabled);
 
     void onWebsocketClientConnected();
     void onWebsocketClientDisconnected();
     void onWebsocketClientError(QAbstractSocket::SocketError error);
+    void onWebsocketClientBytesWritten(qint64 bytes);
+    void flushLogLines();
 
     void onPingProcessFinished(int exitCode, QProcess::ExitStatus exitStatus);
     void onDigProcessFinished(int exitCode, QProcess::ExitStatus exitStatus);
@@ -30,6 +30,9 @@
 
 #include "bluetoothlowenergymanagerimplementation.h"
 #include "loggingcategories.h"
+#include "hardware/threadcall.h"
+
+#include <QDateTime>
 
 namespace nymeaserver {
 
@@ -71,6 +74,10 @@ BluetoothLowEnergyManagerImplementation::BluetoothLowEnergyManagerImplementation
 
 BluetoothDiscoveryReply *BluetoothLowEnergyManagerImplementation::discoverDevices(int interval)
 {
+    // Called by a plugin running in its own thread. Replies and devices stay in this thread.
+    if (QThread::currentThread() != thread())
+        return callInThread<BluetoothDiscoveryReply*>(this, [=]() { return discoverDevices(interval); });
+
     // Create the reply for this discovery request
     QPointer<BluetoothDiscoveryReplyImplementation> reply = new BluetoothDiscoveryReplyImplementation(this);
     if (!available()) {
@@ -87,22 +94,6 @@ BluetoothDiscoveryReply *BluetoothLowEnergyManagerImplementation::discoverDevice
         return reply.data();
     }
 
-    if (!m_currentReply.isNull()) {
-        qCWarning(dcBluetooth()) << "resource busy. There is already a discovery running.";
-        reply->setError(BluetoothDiscoveryReplyImplementation::BluetoothDiscoveryReplyErrorBusy);
-        reply->setFinished();
-        return reply.data();
-    }
-
-    m_currentReply = reply;
-    m_discoveredDevices.clear();
-
-    // Start discovery on all adapters
-    qCDebug(dcBluetooth()) << "Start bluetooth discovery";
-    foreach (QBluetoothDeviceDiscoveryAgent *discoveryAgent, m_bluetoothDiscoveryAgents) {
-        discoveryAgent->start();
-    }
-
     // Prevent blocking the hardware resource from plugins
     int finalInterval = interval;
     if (finalInterval > 30000) {
@@ -115,12 +106,33 @@ BluetoothDiscoveryReply *BluetoothLowEnergyManagerImplementation::discoverDevice
         finalInterval = 5000;
     }
 
-    m_timer->start(finalInterval);
+    // Concurrent discoveries share the running scan and finish with the devices found until their own interval elapsed
+    if (m_runningDiscoveries.isEmpty()) {
+        m_discoveredDevices.clear();
+
+        // Start discovery on all adapters
+        qCDebug(dcBluetooth()) << "Start bluetooth discovery";
+        foreach (QBluetoothDeviceDiscoveryAgent *discoveryAgent, m_bluetoothDiscoveryAgents) {
+            discoveryAgent->start();
+        }
+    } else {
+        qCDebug(dcBluetooth()) << "Joining running bluetooth discovery." << m_runningDiscoveries.count() << "discoveries already running.";
+    }
+
+    RunningDiscovery runningDiscovery;
+    runningDiscovery.reply = reply;
+    runningDiscovery.deadline = QDateTime::currentMSecsSinceEpoch() + finalInterval;
+    m_runningDiscoveries.append(runningDiscovery);
+
+    scheduleDiscoveryTimeout();
     return reply.data();
 }
 
 BluetoothLowEnergyDevice *BluetoothLowEnergyManagerImplementation::registerDevice(const QBluetoothDeviceInfo &deviceInfo, const QLowEnergyController::RemoteAddressType &addressType)
 {
+    if (QThread::currentThread() != thread())
+        return callInThread<BluetoothLowEnergyDevice*>(this, [=]() { return registerDevice(deviceInfo, addressType); });
+
     QPointer<BluetoothLowEnergyDeviceImplementation> bluetoothDevice = new BluetoothLowEnergyDeviceImplementation(deviceInfo, addressType, this);
     qCDebug(dcBluetooth()) << "Register device" << bluetoothDevice->name() << bluetoothDevice->address().toString();
     m_devices.append(bluetoothDevice);
@@ -129,6 +141,11 @@ BluetoothLowEnergyDevice *BluetoothLowEnergyManagerImplementation::registerDevic
 
 void BluetoothLowEnergyManagerImplementation::unregisterDevice(BluetoothLowEnergyDevice *bluetoothDevice)
 {
+    if (QThread::currentThread() != thread()) {
+        callInThread(this, [=]() { unregisterDevice(bluetoothDevice); });
+        return;
+    }
+
     QPointer<BluetoothLowEnergyDevice> devicePointer(bluetoothDevice);
     if (devicePointer.isNull()) {
         qCWarning(dcBluetooth()) << "Cannot unregister bluetooth device. Looks like the device is already unregistered.";
@@ -189,27 +206,51 @@ void BluetoothLowEnergyManagerImplementation::onReconnectTimeout()
     }
 }
 
-void BluetoothLowEnergyManagerImplementation::onDiscoveryTimeout()
+void BluetoothLowEnergyManagerImplementation::scheduleDiscoveryTimeout()
 {
-    // Stop discovery on all adapters
-    qCDebug(dcBluetooth()) << "Stop bluetooth discovery";
-    foreach (QBluetoothDeviceDiscoveryAgent *discoveryAgent, m_bluetoothDiscoveryAgents) {
-        discoveryAgent->stop();
+    if (m_runningDiscoveries.isEmpty())
+        return;
+
+    qint64 nextDeadline = m_runningDiscoveries.first().deadline;
+    foreach (const RunningDiscovery &runningDiscovery, m_runningDiscoveries) {
+        nextDeadline = qMin(nextDeadline, runningDiscovery.deadline);
     }
 
-    qCDebug(dcBluetooth()) << "Discovery finished. Found" << m_discoveredDevices.count() << "bluetooth devices.";
+    m_timer->start(static_cast<int>(qMax(0LL, nextDeadline - QDateTime::currentMSecsSinceEpoch())));
+}
 
-    if (m_currentReply.isNull()) {
-        qCWarning(dcBluetooth()) << "Reply does not exist any more. Please don't delete the reply before it has finished.";
-        m_currentReply.clear();
-        return;
+void BluetoothLowEnergyManagerImplementation::onDiscoveryTimeout()
+{
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    QList<QPointer<BluetoothDiscoveryReplyImplementation>> finishedReplies;
+    for (int i = m_runningDiscoveries.count() - 1; i >= 0; i--) {
+        if (m_runningDiscoveries.at(i).deadline <= now) {
+            finishedReplies.prepend(m_runningDiscoveries.takeAt(i).reply);
+        }
     }
 
-    m_currentReply->setError(BluetoothDiscoveryReply::BluetoothDiscoveryReplyErrorNoError);
-    m_currentReply->setDiscoveredDevices(m_discoveredDevices);
-    m_currentReply->setFinished();
+    if (m_runningDiscoveries.isEmpty()) {
+        // Stop discovery on all adapters
+        qCDebug(dcBluetooth()) << "Stop bluetooth discovery";
+        foreach (QBluetoothDeviceDiscoveryAgent *discoveryAgent, m_bluetoothDiscoveryAgents) {
+            discoveryAgent->stop();
+        }
+    } else {
+        scheduleDiscoveryTimeout();
+    }
+
+    qCDebug(dcBluetooth()) << "Discovery finished. Found" << m_discoveredDevices.count() << "bluetooth devices.";
 
-    m_currentReply.clear();
+    foreach (QPointer<BluetoothDiscoveryReplyImplementation> reply, finishedReplies) {
+        if (reply.isNull()) {
+            qCWarning(dcBluetooth()) << "Reply does not exist any more. Please don't delete the reply before it has finished.";
+            continue;
+        }
+
+        reply->setError(BluetoothDiscoveryReply::BluetoothDiscoveryReplyErrorNoError);
+        reply->setDiscoveredDevices(m_discoveredDevices);
+        reply->setFinished();
+    }
 }
 
 void BluetoothLowEnergyManagerImplementation::onDeviceDiscovered(const QBluetoothDeviceInfo &deviceInfo)
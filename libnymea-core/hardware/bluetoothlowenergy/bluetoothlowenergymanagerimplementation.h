@@ -68,6 +68,12 @@ protected:
     void setEnabled(bool enabled) override;
 
 private:
+    class RunningDiscovery {
+    public:
+        QPointer<BluetoothDiscoveryReplyImplementation> reply;
+        qint64 deadline = 0;
+    };
+
     PluginTimer *m_reconnectTimer = nullptr;
     QTimer *m_timer = nullptr;
     QList<QPointer<BluetoothLowEnergyDeviceImplementation>> m_devices;
@@ -77,7 +83,9 @@ private:
 
     QList<QBluetoothDeviceDiscoveryAgent *> m_bluetoothDiscoveryAgents;
     QList<QBluetoothDeviceInfo> m_discoveredDevices;
-    QPointer<BluetoothDiscoveryReplyImplementation> m_currentReply;
+    QList<RunningDiscovery> m_runningDiscoveries;
+
+    void scheduleDiscoveryTimeout();
 
 private slots:
     void onReconnectTimeout();
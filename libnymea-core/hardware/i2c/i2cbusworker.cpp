@@ -0,0 +1,242 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "i2cbusworker.h"
+
+#include "hardware/i2c/i2cdevice.h"
+#include "loggingcategories.h"
+
+#include <sys/ioctl.h>
+#include <linux/i2c-dev.h>
+
+namespace nymeaserver {
+
+double I2CDeviceStatistics::averageReadLatency() const
+{
+    return readCount > 0 ? (double)totalReadLatency / readCount : 0;
+}
+
+double I2CDeviceStatistics::averageJitter() const
+{
+    return readCount > 0 ? (double)totalJitter / readCount : 0;
+}
+
+double I2CDeviceStatistics::averageWriteLatency() const
+{
+    return writeCount > 0 ? (double)totalWriteLatency / writeCount : 0;
+}
+
+I2CBusWorker::I2CBusWorker(const QString &portName, int fileDescriptor, QObject *parent) :
+    QThread(parent),
+    m_portName(portName),
+    m_fileDescriptor(fileDescriptor)
+{
+    m_clock.start();
+}
+
+I2CBusWorker::~I2CBusWorker()
+{
+    stop();
+}
+
+QString I2CBusWorker::portName() const
+{
+    return m_portName;
+}
+
+void I2CBusWorker::addReader(I2CDevice *i2cDevice, int interval)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_readers.contains(i2cDevice))
+        m_schedule.remove(m_readers.value(i2cDevice).nextReading, i2cDevice);
+
+    // First reading as soon as possible
+    ReadingInfo readingInfo;
+    readingInfo.interval = qMax(1, interval);
+    readingInfo.nextReading = now();
+    m_readers.insert(i2cDevice, readingInfo);
+    m_schedule.insert(readingInfo.nextReading, i2cDevice);
+    m_statistics[i2cDevice];
+    m_wakeUp.wakeAll();
+}
+
+void I2CBusWorker::removeReader(I2CDevice *i2cDevice)
+{
+    QMutexLocker locker(&m_mutex);
+    if (!m_readers.contains(i2cDevice))
+        return;
+
+    m_schedule.remove(m_readers.take(i2cDevice).nextReading, i2cDevice);
+    m_wakeUp.wakeAll();
+}
+
+void I2CBusWorker::enqueueWrite(I2CDevice *i2cDevice, const QByteArray &data)
+{
+    QMutexLocker locker(&m_mutex);
+    WritingInfo writingInfo;
+    writingInfo.device = i2cDevice;
+    writingInfo.data = data;
+    writingInfo.queued = now();
+    m_writeQueue.enqueue(writingInfo);
+    m_statistics[i2cDevice];
+    m_wakeUp.wakeAll();
+}
+
+void I2CBusWorker::removeDevice(I2CDevice *i2cDevice)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_readers.contains(i2cDevice))
+        m_schedule.remove(m_readers.take(i2cDevice).nextReading, i2cDevice);
+
+    for (int i = m_writeQueue.count() - 1; i >= 0; i--) {
+        if (m_writeQueue.at(i).device == i2cDevice) {
+            m_writeQueue.removeAt(i);
+        }
+    }
+    m_statistics.remove(i2cDevice);
+
+    // The device may be deleted once we return, make sure the worker is done with it
+    while (m_activeDevice == i2cDevice && isRunning())
+        m_transferFinished.wait(&m_mutex);
+}
+
+I2CDeviceStatistics I2CBusWorker::statistics(I2CDevice *i2cDevice) const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_statistics.value(i2cDevice);
+}
+
+void I2CBusWorker::stop()
+{
+    m_mutex.lock();
+    m_stopping = true;
+    m_wakeUp.wakeAll();
+    m_mutex.unlock();
+    wait();
+}
+
+void I2CBusWorker::run()
+{
+    QMutexLocker locker(&m_mutex);
+    while (!m_stopping) {
+        // Writes always have priority over pending readings
+        if (!m_writeQueue.isEmpty()) {
+            WritingInfo writingInfo = m_writeQueue.dequeue();
+            I2CDevice *i2cDevice = writingInfo.device;
+            m_activeDevice = i2cDevice;
+            locker.unlock();
+
+            bool success = false;
+            if (selectAddress(i2cDevice->address())) {
+                qCDebug(dcI2C()) << "Writing to I2C device" << i2cDevice;
+                success = i2cDevice->writeData(m_fileDescriptor, writingInfo.data);
+            } else {
+                qCWarning(dcI2C()) << "Cannot select I2C slave address for I2C device" << i2cDevice;
+            }
+            QMetaObject::invokeMethod(i2cDevice, "dataWritten", Qt::QueuedConnection, Q_ARG(bool, success));
+            qint64 finished = now();
+
+            locker.relock();
+            m_activeDevice = nullptr;
+            m_transferFinished.wakeAll();
+            if (m_statistics.contains(i2cDevice)) {
+                I2CDeviceStatistics &statistics = m_statistics[i2cDevice];
+                qint64 latency = finished - writingInfo.queued;
+                statistics.writeCount++;
+                statistics.failedCount += success ? 0 : 1;
+                statistics.totalWriteLatency += latency;
+                statistics.maxWriteLatency = qMax(statistics.maxWriteLatency, latency);
+            }
+            continue;
+        }
+
+        if (m_schedule.isEmpty()) {
+            m_wakeUp.wait(&m_mutex);
+            continue;
+        }
+
+        qint64 deadline = m_schedule.firstKey();
+        qint64 started = now();
+        if (deadline > started) {
+            m_wakeUp.wait(&m_mutex, (deadline - started + 999) / 1000);
+            continue;
+        }
+
+        I2CDevice *i2cDevice = m_schedule.take(deadline);
+        m_activeDevice = i2cDevice;
+        locker.unlock();
+
+        bool success = false;
+        if (selectAddress(i2cDevice->address())) {
+            qCDebug(dcI2C()) << "Reading I2C device" << i2cDevice;
+            QByteArray data = i2cDevice->readData(m_fileDescriptor);
+            QMetaObject::invokeMethod(i2cDevice, "readingAvailable", Qt::QueuedConnection, Q_ARG(QByteArray, data));
+            success = true;
+        } else {
+            qCWarning(dcI2C()) << "Cannot select I2C slave address for I2C device" << i2cDevice;
+        }
+        qint64 finished = now();
+
+        locker.relock();
+        m_activeDevice = nullptr;
+        m_transferFinished.wakeAll();
+
+        // Removed while reading
+        if (!m_readers.contains(i2cDevice))
+            continue;
+
+        // Keep the cadence of the device, but never schedule into the past after an overrun
+        ReadingInfo &readingInfo = m_readers[i2cDevice];
+        readingInfo.nextReading = qMax(deadline + readingInfo.interval * 1000, finished);
+        m_schedule.insert(readingInfo.nextReading, i2cDevice);
+
+        I2CDeviceStatistics &statistics = m_statistics[i2cDevice];
+        qint64 latency = finished - started;
+        qint64 jitter = started - deadline;
+        statistics.readCount++;
+        statistics.failedCount += success ? 0 : 1;
+        statistics.totalReadLatency += latency;
+        statistics.maxReadLatency = qMax(statistics.maxReadLatency, latency);
+        statistics.totalJitter += jitter;
+        statistics.maxJitter = qMax(statistics.maxJitter, jitter);
+    }
+}
+
+bool I2CBusWorker::selectAddress(int address)
+{
+    return ioctl(m_fileDescriptor, I2C_SLAVE, address) >= 0;
+}
+
+qint64 I2CBusWorker::now() const
+{
+    return m_clock.nsecsElapsed() / 1000;
+}
+
+}
@@ -0,0 +1,121 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef I2CBUSWORKER_H
+#define I2CBUSWORKER_H
+
+#include <QHash>
+#include <QMap>
+#include <QMutex>
+#include <QQueue>
+#include <QThread>
+#include <QElapsedTimer>
+#include <QWaitCondition>
+
+class I2CDevice;
+
+namespace nymeaserver {
+
+class I2CDeviceStatistics
+{
+public:
+    int readCount = 0;
+    int writeCount = 0;
+    int failedCount = 0;
+
+    // All times in micro seconds
+    qint64 totalReadLatency = 0;
+    qint64 maxReadLatency = 0;
+    qint64 totalJitter = 0;
+    qint64 maxJitter = 0;
+    qint64 totalWriteLatency = 0;
+    qint64 maxWriteLatency = 0;
+
+    double averageReadLatency() const;
+    double averageJitter() const;
+    double averageWriteLatency() const;
+};
+
+class I2CBusWorker : public QThread
+{
+    Q_OBJECT
+public:
+    explicit I2CBusWorker(const QString &portName, int fileDescriptor, QObject *parent = nullptr);
+    ~I2CBusWorker() override;
+
+    QString portName() const;
+
+    void addReader(I2CDevice *i2cDevice, int interval);
+    void removeReader(I2CDevice *i2cDevice);
+    void enqueueWrite(I2CDevice *i2cDevice, const QByteArray &data);
+    void removeDevice(I2CDevice *i2cDevice);
+
+    I2CDeviceStatistics statistics(I2CDevice *i2cDevice) const;
+
+    void stop();
+
+protected:
+    void run() override;
+    virtual bool selectAddress(int address);
+
+private:
+    class ReadingInfo {
+    public:
+        int interval;
+        qint64 nextReading;
+    };
+    class WritingInfo {
+    public:
+        I2CDevice *device;
+        QByteArray data;
+        qint64 queued;
+    };
+
+    QString m_portName;
+    int m_fileDescriptor;
+    QElapsedTimer m_clock;
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_wakeUp;
+    QWaitCondition m_transferFinished;
+    bool m_stopping = false;
+    I2CDevice *m_activeDevice = nullptr;
+
+    QHash<I2CDevice *, ReadingInfo> m_readers;
+    QMultiMap<qint64, I2CDevice *> m_schedule;  // next reading | device
+    QQueue<WritingInfo> m_writeQueue;
+    QHash<I2CDevice *, I2CDeviceStatistics> m_statistics;
+
+    qint64 now() const;
+};
+
+}
+
+#endif // I2CBUSWORKER_H
@@ -32,9 +32,10 @@
 
 #include "hardware/i2c/i2cdevice.h"
 #include "loggingcategories.h"
+#include "hardware/threadcall.h"
 
 #include <QDir>
-#include <QtConcurrent/QtConcurrentRun>
+#include <QFile>
 
 #include <sys/ioctl.h>
 #include <unistd.h>
@@ -44,14 +45,14 @@ namespace nymeaserver {
 
 I2CManagerImplementation::I2CManagerImplementation(QObject *parent) : I2CManager(parent)
 {
-    m_pollTimer.setInterval(200);
-    m_pollTimer.setSingleShot(true);
-    connect(&m_pollTimer, &QTimer::timeout, this, &I2CManagerImplementation::nextCycle);
 }
 
 I2CManagerImplementation::~I2CManagerImplementation()
 {
-    m_watcher.waitForFinished();
+    foreach (I2CBusWorker *worker, m_workers) {
+        worker->stop();
+        delete worker;
+    }
 }
 
 QStringList nymeaserver::I2CManagerImplementation::availablePorts() const
@@ -106,6 +107,10 @@ QList<I2CScanResult> nymeaserver::I2CManagerImplementation::scanRegisters(const
 
 bool I2CManagerImplementation::open(I2CDevice *i2cDevice)
 {
+    // Called by a plugin running in its own thread, the workers are managed in this thread
+    if (QThread::currentThread() != thread())
+        return callInThread<bool>(this, [=]() { return open(i2cDevice); });
+
     if (m_openFiles.contains(i2cDevice)) {
         qCWarning(dcI2C()) << "I2C device" << i2cDevice << "already opened.";
         return false;
@@ -138,63 +143,74 @@ bool I2CManagerImplementation::open(I2CDevice *i2cDevice)
     m_mutex.lock();
     m_openFiles.insert(i2cDevice, file);
     m_mutex.unlock();
+
+    // Each bus gets its own worker so slow devices on one bus don't delay the others
+    I2CBusWorker *worker = new I2CBusWorker(i2cDevice->portName(), file->handle());
+    m_workers.insert(i2cDevice->portName(), worker);
+    worker->start();
     return true;
 }
 
 bool I2CManagerImplementation::startReading(I2CDevice *i2cDevice, int interval)
 {
-    QMutexLocker locker(&m_mutex);
+    if (QThread::currentThread() != thread())
+        return callInThread<bool>(this, [=]() { return startReading(i2cDevice, interval); });
 
     if (!m_openFiles.contains(i2cDevice)) {
         qCWarning(dcI2C()) << "I2CDevice not open. Cannot start reading.";
         return false;
     }
-    qCDebug(dcI2C()) << "Starting to poll I2C device" << i2cDevice;
-    ReadingInfo readingInfo;
-    readingInfo.interval = interval;
-    m_readers.insert(i2cDevice, readingInfo);
-
-    if (!m_pollTimer.isActive()) {
-        m_pollTimer.start();
-    }
+    qCDebug(dcI2C()) << "Starting to poll I2C device" << i2cDevice << "every" << interval << "ms";
+    m_workers.value(i2cDevice->portName())->addReader(i2cDevice, interval);
     return true;
 }
 
 
 void I2CManagerImplementation::stopReading(I2CDevice *i2cDevice)
 {
-    QMutexLocker locker(&m_mutex);
-    m_readers.remove(i2cDevice);
+    if (QThread::currentThread() != thread()) {
+        callInThread(this, [=]() { stopReading(i2cDevice); });
+        return;
+    }
 
-    if (m_readers.count() == 0) {
-        m_pollTimer.stop();
+    I2CBusWorker *worker = m_workers.value(i2cDevice->portName());
+    if (worker && m_openFiles.contains(i2cDevice)) {
+        worker->removeReader(i2cDevice);
     }
 }
 
 bool I2CManagerImplementation::writeData(I2CDevice *i2cDevice, const QByteArray &data)
 {
-    m_writeQueueMutex.lock();
-    WritingInfo info;
-    info.device = i2cDevice;
-    info.data = data;
-    m_writeQueue.append(info);
-    m_writeQueueMutex.unlock();
+    if (QThread::currentThread() != thread())
+        return callInThread<bool>(this, [=]() { return writeData(i2cDevice, data); });
+
+    if (!m_openFiles.contains(i2cDevice)) {
+        qCWarning(dcI2C()) << "I2CDevice not open. Cannot write data.";
+        return false;
+    }
+    m_workers.value(i2cDevice->portName())->enqueueWrite(i2cDevice, data);
     return true;
 }
 
 void I2CManagerImplementation::close(I2CDevice *i2cDevice)
 {
-    bool isInUse = false;
-    m_mutex.lock();
-    if (m_readers.contains(i2cDevice)) {
-        isInUse = true;
+    if (QThread::currentThread() != thread()) {
+        callInThread(this, [=]() { close(i2cDevice); });
+        return;
     }
-    m_mutex.unlock();
 
-    if (isInUse) {
-        stopReading(i2cDevice);
+    if (!m_openFiles.contains(i2cDevice)) {
+        return;
     }
 
+    // Drops pending readings and writes and waits for a running transfer of this device
+    I2CBusWorker *worker = m_workers.value(i2cDevice->portName());
+    worker->removeDevice(i2cDevice);
+
+    m_mutex.lock();
+    QFile *f = m_openFiles.take(i2cDevice);
+    m_mutex.unlock();
+
     int refCount = 0;
     foreach (I2CDevice* d, m_openFiles.keys()) {
         if (d->portName() == i2cDevice->portName()) {
@@ -202,77 +218,23 @@ void I2CManagerImplementation::close(I2CDevice *i2cDevice)
         }
     }
     if (refCount == 0) {
-
-        m_mutex.lock();
-        QFile *f = m_openFiles.take(i2cDevice);
-        m_mutex.unlock();
+        m_workers.remove(i2cDevice->portName());
+        worker->stop();
+        delete worker;
 
         f->close();
         f->deleteLater();
     }
 }
 
-void I2CManagerImplementation::nextCycle()
+/*! Returns the reading and writing statistics of the given \a i2cDevice. Times are given in micro seconds. */
+I2CDeviceStatistics I2CManagerImplementation::statistics(I2CDevice *i2cDevice) const
 {
-    QFuture<void> future = QtConcurrent::run([this](){
-        // Copy the write queue to open it up as fast as possible for others to append new entries
-        m_writeQueueMutex.lock();
-        QList<WritingInfo> writeQueue = m_writeQueue;
-        m_writeQueue.clear();
-        m_writeQueueMutex.unlock();
-
-        m_mutex.lock();
-
-        foreach (const WritingInfo &info, writeQueue) {
-            I2CDevice *i2cDevice = info.device;
-
-            int fd = m_openFiles.value(i2cDevice)->handle();
-            if (fd == -1) {
-                qCWarning(dcI2C()) << "I2C device" << i2cDevice << "not opened. Cannot write to it.";
-                continue;
-            }
-
-            if (ioctl(fd, I2C_SLAVE, i2cDevice->address()) < 0) {
-                qCWarning(dcI2C()) << "Cannot select I2C slave address for I2C device" << i2cDevice;
-                continue;
-            }
-
-            qCDebug(dcI2C()) << "Writing to I2C device" << i2cDevice;
-            bool success = i2cDevice->writeData(fd, info.data);
-
-            QMetaObject::invokeMethod(i2cDevice, "dataWritten", Qt::QueuedConnection, Q_ARG(bool, success));
-
-        }
-
-        foreach (I2CDevice *i2cDevice, m_readers.keys()) {
-            ReadingInfo readingInfo = m_readers.value(i2cDevice);
-            if (readingInfo.lastReading.addMSecs(readingInfo.interval) > QDateTime::currentDateTime()) {
-                continue;
-            }
-            int fd = m_openFiles.value(i2cDevice)->handle();
-            if (fd == -1) {
-                qCWarning(dcI2C()) << "I2C device" << i2cDevice << "not opened. Cannot read.";
-                continue;
-            }
-
-            if (ioctl(fd, I2C_SLAVE, i2cDevice->address()) < 0) {
-                qCWarning(dcI2C()) << "Cannot select I2C slave address for I2C device" << i2cDevice;
-                continue;
-            }
-
-            qCDebug(dcI2C()) << "Reading I2C device" << i2cDevice;
-            QByteArray data = i2cDevice->readData(fd);
-
-            m_readers[i2cDevice].lastReading = QDateTime::currentDateTime();
-
-            QMetaObject::invokeMethod(i2cDevice, "readingAvailable", Qt::QueuedConnection, Q_ARG(QByteArray, data));
-        }
-
-        m_mutex.unlock();
-    });
-
-    m_watcher.setFuture(future);
-    connect(&m_watcher, SIGNAL(finished()), &m_pollTimer, SLOT(start()));
+    I2CBusWorker *worker = m_workers.value(i2cDevice->portName());
+    if (!worker) {
+        return I2CDeviceStatistics();
+    }
+    return worker->statistics(i2cDevice);
 }
 
 }
@@ -32,14 +32,11 @@
 #define I2CMANAGERIMPLEMENTATION_H
 
 #include "hardware/i2c/i2cmanager.h"
+#include "hardware/i2c/i2cbusworker.h"
 
 #include <QObject>
 #include <QMutex>
-#include <QTimer>
 #include <QHash>
-#include <QFuture>
-#include <QFutureWatcher>
-#include <QDateTime>
 
 class QFile;
 
@@ -62,31 +59,14 @@ public:
     bool writeData(I2CDevice *i2cDevice, const QByteArray &data) override;
     void close(I2CDevice *i2cDevice) override;
 
-private slots:
-    void nextCycle();
+    I2CDeviceStatistics statistics(I2CDevice *i2cDevice) const;
 
 private:
-    class ReadingInfo {
-    public:
-        int interval;
-        QDateTime lastReading;
-    };
-    class WritingInfo {
-    public:
-        QByteArray data;
-        I2CDevice *device;
-    };
-
     QMutex m_mutex;
-    QHash<I2CDevice*, ReadingInfo> m_readers;
     QHash<I2CDevice*, QFile*> m_openFiles;
 
-    QMutex m_writeQueueMutex;
-    QList<WritingInfo> m_writeQueue;
-
-    QFutureWatcher<void> m_watcher;
-
-    QTimer m_pollTimer;
+    // One worker thread per bus port
+    QHash<QString, I2CBusWorker*> m_workers;
 
 };
 
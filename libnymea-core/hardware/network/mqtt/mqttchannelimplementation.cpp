@@ -67,6 +67,20 @@ QStringList MqttChannelImplementation::topicPrefixList() const
     return m_topicPrefixList;
 }
 
+bool MqttChannelImplementation::isOnline() const
+{
+    return m_online;
+}
+
+void MqttChannelImplementation::setOnline(bool online)
+{
+    if (m_online == online)
+        return;
+
+    m_online = online;
+    emit onlineChanged(this, online);
+}
+
 void MqttChannelImplementation::publish(const QString &topic, const QByteArray &payload)
 {
     emit pluginPublished(topic, payload);
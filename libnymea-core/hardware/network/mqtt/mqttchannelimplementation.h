@@ -48,6 +48,8 @@ public:
     quint16 serverPort() const override;
     QStringList topicPrefixList() const override;
 
+    bool isOnline() const override;
+
     void publish(const QString &topic, const QByteArray &payload) override;
 
 signals:
@@ -60,6 +62,10 @@ private:
     QHostAddress m_serverAddress;
     quint16 m_serverPort;
     QStringList m_topicPrefixList;
+    bool m_online = false;
+    bool m_hasAvailability = false;
+
+    void setOnline(bool online);
 
     friend class MqttProviderImplementation;
 };
@@ -31,13 +31,32 @@
 #include "mqttproviderimplementation.h"
 #include "mqttchannelimplementation.h"
 #include "loggingcategories.h"
+#include "hardware/threadcall.h"
 
 #include <QtDebug>
 #include <QUuid>
+#include <QSharedPointer>
 #include <QNetworkInterface>
 
 namespace nymeaserver {
 
+// Devices announce their presence on an availability topic and set the offline message as their
+// last will, e.g. Tasmota "tele/<id>/LWT" Online/Offline or Shelly "shellies/<id>/online" true/false.
+// Returns 1 for online, 0 for offline and -1 if the message is no availability message.
+static int availabilityFromMessage(const QString &topic, const QByteArray &payload)
+{
+    QString level = topic.section('/', -1).toLower();
+    if (level != "lwt" && level != "online" && level != "availability")
+        return -1;
+
+    QByteArray value = payload.trimmed().toLower();
+    if (value == "online" || value == "true" || value == "1" || value == "connected")
+        return 1;
+    if (value == "offline" || value == "false" || value == "0" || value == "disconnected")
+        return 0;
+    return -1;
+}
+
 MqttProviderImplementation::MqttProviderImplementation(MqttBroker *broker, QObject *parent):
     MqttProvider(parent),
     m_broker(broker)
@@ -49,6 +68,10 @@ MqttProviderImplementation::MqttProviderImplementation(MqttBroker *broker, QObje
 
 MqttChannel *MqttProviderImplementation::createChannel(const QString &clientId, const QHostAddress &clientAddress, const QStringList &topicPrefixList)
 {
+    // Called by a plugin running in its own thread. The channel stays in this thread, its signals are queued to the plugin.
+    if (QThread::currentThread() != thread())
+        return callInThread<MqttChannel*>(this, [=]() { return createChannel(clientId, clientAddress, topicPrefixList); });
+
     if (m_broker->configurations().isEmpty()) {
         qCWarning(dcMqtt) << "MQTT broker not running. Cannot create a channel for thing" << clientId;
         return nullptr;
@@ -98,19 +121,36 @@ MqttChannel *MqttProviderImplementation::createChannel(const QString &clientId,
     foreach (const QString &topicPrefix, channel->m_topicPrefixList) {
         policy.allowedPublishTopicFilters.append(QString("%1/#").arg(topicPrefix));
         policy.allowedSubscribeTopicFilters.append(QString("%1/#").arg(topicPrefix));
+        m_channelTopics.insert(QString("%1/#").arg(topicPrefix), channel);
     }
     m_broker->updatePolicy(policy);
 
+    channel->m_online = m_broker->isClientConnected(channel->clientId());
+    subscribeChannel(channel);
+
     return channel;
 }
 
 void MqttProviderImplementation::releaseChannel(MqttChannel *channel)
 {
+    if (QThread::currentThread() != thread()) {
+        callInThread(this, [=]() { releaseChannel(channel); });
+        return;
+    }
+
     if (!m_createdChannels.contains(channel->clientId())) {
         qCWarning(dcMqtt) << "ReleaseChannel called for a channel we don't manage. Potential memory leak!";
         return;
     }
     m_createdChannels.take(channel->clientId());
+    MqttClient *replayClient = m_replayClients.take(channel);
+    if (replayClient) {
+        replayClient->deleteLater();
+    }
+    foreach (const QString &topicPrefix, channel->topicPrefixList()) {
+        m_channelTopics.remove(QString("%1/#").arg(topicPrefix), channel);
+    }
+    unsubscribeChannel(static_cast<MqttChannelImplementation*>(channel));
     m_broker->removePolicy(channel->clientId());
     qCDebug(dcMqtt) << "Released MQTT channel for client ID" << channel->clientId();
     delete channel;
@@ -118,6 +158,22 @@ void MqttProviderImplementation::releaseChannel(MqttChannel *channel)
 
 MqttClient *MqttProviderImplementation::createInternalClient(const QString &clientId)
 {
+    // Called by a plugin running in its own thread. The plugin uses the client directly, so it is handed over to that
+    // thread and deleted with it unless the plugin deletes it before.
+    if (QThread::currentThread() != thread()) {
+        QThread *pluginThread = QThread::currentThread();
+        return callInThread<MqttClient*>(this, [=]() -> MqttClient* {
+            MqttClient *client = createInternalClient(clientId);
+            if (client) {
+                client->setParent(nullptr);
+                client->moveToThread(pluginThread);
+                connect(pluginThread, &QThread::finished, client, [client](){
+                    delete client;
+                }, Qt::DirectConnection);
+            }
+            return client;
+        });
+    }
 
     ServerConfiguration preferredConfig;
     foreach (const ServerConfiguration &config, m_broker->configurations()) {
@@ -181,23 +237,33 @@ void MqttProviderImplementation::setEnabled(bool enabled)
 void MqttProviderImplementation::onClientConnected(const QString &clientId)
 {
     if (m_createdChannels.contains(clientId)) {
-        MqttChannel* channel = m_createdChannels.value(clientId);
+        MqttChannelImplementation* channel = static_cast<MqttChannelImplementation*>(m_createdChannels.value(clientId));
         emit channel->clientConnected(channel);
+        // Devices with an availability topic announce themselves
+        if (!channel->m_hasAvailability) {
+            channel->setOnline(true);
+        }
     }
 }
 
 void MqttProviderImplementation::onClientDisconnected(const QString &clientId)
 {
     if (m_createdChannels.contains(clientId)) {
-        MqttChannel *channel = m_createdChannels.value(clientId);
+        MqttChannelImplementation *channel = static_cast<MqttChannelImplementation*>(m_createdChannels.value(clientId));
         emit channel->clientDisconnected(channel);
+        channel->setOnline(false);
     }
 }
 
 void MqttProviderImplementation::onPublishReceived(const QString &clientId, const QString &topic, const QByteArray &payload)
 {
-    if (m_createdChannels.contains(clientId)) {
-        MqttChannel* channel = m_createdChannels.value(clientId);
+    // Deliver to the channels owning the topic and to the channel of the publishing client
+    QSet<MqttChannel*> channels = m_channelTopics.values(topic);
+    MqttChannel *clientChannel = m_createdChannels.value(clientId);
+    if (clientChannel) {
+        channels.insert(clientChannel);
+    }
+    foreach (MqttChannel *channel, channels) {
         emit channel->publishReceived(channel, topic, payload);
     }
 }
@@ -205,18 +271,152 @@ void MqttProviderImplementation::onPublishReceived(const QString &clientId, cons
 void MqttProviderImplementation::onPluginPublished(const QString &topic, const QByteArray &payload)
 {
     MqttChannelImplementation *channel = static_cast<MqttChannelImplementation*>(sender());
-    bool found = false;
-    foreach (const QString &topicPrefix, channel->topicPrefixList()) {
-        if (topicPrefix.startsWith(topicPrefix)) {
-            found = true;
-            break;
+    if (!m_channelTopics.matches(topic, channel)) {
+        qCWarning(dcMqtt) << "Attempt to publish to MQTT channel for client" << channel->clientId() << "but topic is not within allowed topic prefix. Discarding message.";
+        return;
+    }
+    m_broker->publish(topic, payload);
+}
+
+
+void MqttProviderImplementation::onStateClientConnected(Mqtt::ConnectReturnCode returnCode)
+{
+    if (returnCode != Mqtt::ConnectReturnCodeAccepted) {
+        qCWarning(dcMqtt) << "Internal MQTT state client rejected:" << returnCode;
+        return;
+    }
+
+    // Subscribe again after a reconnect, the retained availability messages bring the presence up to date
+    m_stateClientConnected = true;
+    foreach (const QString &topicFilter, m_stateSubscriptions.keys()) {
+        m_stateClient->subscribe(topicFilter);
+    }
+}
+
+void MqttProviderImplementation::onStateClientDisconnected()
+{
+    m_stateClientConnected = false;
+}
+
+void MqttProviderImplementation::onStatePublishReceived(const QString &topic, const QByteArray &payload, bool retained)
+{
+    Q_UNUSED(retained)
+
+    // Messages reach the channels through the broker and retained ones are replayed to new
+    // channels by replayRetainedMessages(). Only the presence is taken from here.
+    if (availabilityFromMessage(topic, payload) < 0) {
+        return;
+    }
+    foreach (MqttChannel *channel, m_channelTopics.values(topic)) {
+        updateAvailability(static_cast<MqttChannelImplementation*>(channel), topic, payload);
+    }
+}
+
+void MqttProviderImplementation::subscribeChannel(MqttChannelImplementation *channel)
+{
+    if (!m_stateClient) {
+        m_stateClient = createInternalClient("nymea-mqtt-state");
+        if (!m_stateClient) {
+            qCWarning(dcMqtt) << "Unable to create the internal MQTT state client. Retained messages and device presence are not available.";
+            return;
         }
+        m_stateClient->setAutoReconnect(true);
+        connect(m_stateClient, &MqttClient::connected, this, &MqttProviderImplementation::onStateClientConnected);
+        connect(m_stateClient, &MqttClient::disconnected, this, &MqttProviderImplementation::onStateClientDisconnected);
+        connect(m_stateClient, &MqttClient::publishReceived, this, &MqttProviderImplementation::onStatePublishReceived);
+    }
 
+    foreach (const QString &topicPrefix, channel->m_topicPrefixList) {
+        QString topicFilter = QString("%1/#").arg(topicPrefix);
+        int channelCount = m_stateSubscriptions.value(topicFilter);
+        m_stateSubscriptions.insert(topicFilter, channelCount + 1);
+        if (channelCount == 0 && m_stateClientConnected) {
+            m_stateClient->subscribe(topicFilter);
+        }
     }
-    if (!found) {
-        qCWarning(dcMqtt) << "Attempt to publish to MQTT channel for client" << channel->clientId() << "but topic is not within allowed topic prefix. Discarding message.";
+
+    replayRetainedMessages(channel);
+}
+
+void MqttProviderImplementation::unsubscribeChannel(MqttChannelImplementation *channel)
+{
+    foreach (const QString &topicPrefix, channel->m_topicPrefixList) {
+        QString topicFilter = QString("%1/#").arg(topicPrefix);
+        int channelCount = m_stateSubscriptions.value(topicFilter) - 1;
+        if (channelCount > 0) {
+            m_stateSubscriptions.insert(topicFilter, channelCount);
+            continue;
+        }
+
+        m_stateSubscriptions.remove(topicFilter);
+        if (m_stateClient && m_stateClientConnected) {
+            m_stateClient->unsubscribe(topicFilter);
+        }
     }
-    m_broker->publish(topic, payload);
+}
+
+void MqttProviderImplementation::replayRetainedMessages(MqttChannelImplementation *channel)
+{
+    // The broker sends its retained messages, flagged as retained, to every new subscription. A client of
+    // its own gets exactly what the broker holds right now and hands it to this channel only. The broker
+    // handles the packets of a client in order, so once the unsubscribe is acknowledged, all of them arrived.
+    QString clientId = QString("nymea-mqtt-replay-%1").arg(QUuid::createUuid().toString().remove(QRegExp("[{}-]")));
+    MqttClient *client = createInternalClient(clientId);
+    if (!client) {
+        qCWarning(dcMqtt) << "Unable to create an internal MQTT client. Retained messages are not replayed for" << channel->clientId();
+        return;
+    }
+    m_replayClients.insert(channel, client);
+
+    QSharedPointer<QSet<QString>> receivedTopics(new QSet<QString>());
+    QSharedPointer<QSet<quint16>> pendingUnsubscribes(new QSet<quint16>());
+
+    auto finish = [this, channel, client]() {
+        if (m_replayClients.value(channel) == client) {
+            m_replayClients.remove(channel);
+            client->deleteLater();
+        }
+    };
+
+    connect(client, &MqttClient::connected, channel, [client, channel, pendingUnsubscribes, finish](Mqtt::ConnectReturnCode returnCode) {
+        if (returnCode != Mqtt::ConnectReturnCodeAccepted) {
+            qCWarning(dcMqtt) << "Internal MQTT client for replaying retained messages rejected:" << returnCode;
+            finish();
+            return;
+        }
+        foreach (const QString &topicPrefix, channel->topicPrefixList()) {
+            client->subscribe(QString("%1/#").arg(topicPrefix));
+        }
+        foreach (const QString &topicPrefix, channel->topicPrefixList()) {
+            pendingUnsubscribes->insert(client->unsubscribe(QString("%1/#").arg(topicPrefix)));
+        }
+    });
+    connect(client, &MqttClient::publishReceived, channel, [this, channel, receivedTopics](const QString &topic, const QByteArray &payload, bool retained) {
+        // Live messages reach the channel through the broker. Overlapping prefixes get the same retained message twice.
+        if (!retained || receivedTopics->contains(topic)) {
+            return;
+        }
+        receivedTopics->insert(topic);
+        updateAvailability(channel, topic, payload);
+        emit channel->publishReceived(channel, topic, payload);
+    });
+    connect(client, &MqttClient::unsubscribed, channel, [pendingUnsubscribes, finish](quint16 packetId) {
+        pendingUnsubscribes->remove(packetId);
+        if (pendingUnsubscribes->isEmpty()) {
+            finish();
+        }
+    });
+    connect(client, &MqttClient::disconnected, channel, finish);
+}
+
+void MqttProviderImplementation::updateAvailability(MqttChannelImplementation *channel, const QString &topic, const QByteArray &payload)
+{
+    int availability = availabilityFromMessage(topic, payload);
+    if (availability < 0) {
+        return;
+    }
+    channel->m_hasAvailability = true;
+    channel->setOnline(availability == 1);
 }
 
 }
@@ -34,10 +34,13 @@
 #include <QObject>
 
 #include "servers/mqttbroker.h"
+#include "servers/mqtttopictrie.h"
 
 #include "network/mqtt/mqttprovider.h"
 namespace nymeaserver {
 
+class MqttChannelImplementation;
+
 class MqttProviderImplementation : public MqttProvider
 {
     Q_OBJECT
@@ -58,11 +61,30 @@ private slots:
     void onClientDisconnected(const QString &clientId);
     void onPublishReceived(const QString &clientId, const QString &topic, const QByteArray &payload);
     void onPluginPublished(const QString &topic, const QByteArray &payload);
+    void onStateClientConnected(Mqtt::ConnectReturnCode returnCode);
+    void onStateClientDisconnected();
+    void onStatePublishReceived(const QString &topic, const QByteArray &payload, bool retained);
 
 private:
     MqttBroker* m_broker = nullptr;
 
     QHash<QString, MqttChannel*> m_createdChannels;
+    // Topic prefixes of all channels, used to route publishes to channels
+    MqttTopicTrie<MqttChannel*> m_channelTopics;
+
+    // Internal client subscribed to the topics of all channels. It receives the availability
+    // messages of the devices, including the last will published for devices dropping off.
+    MqttClient *m_stateClient = nullptr;
+    bool m_stateClientConnected = false;
+    // Number of channels per subscribed "prefix/#" filter
+    QHash<QString, int> m_stateSubscriptions;
+    // Short lived clients fetching the retained messages of the broker for a new channel
+    QHash<MqttChannel*, MqttClient*> m_replayClients;
+
+    void subscribeChannel(MqttChannelImplementation *channel);
+    void unsubscribeChannel(MqttChannelImplementation *channel);
+    void replayRetainedMessages(MqttChannelImplementation *channel);
+    void updateAvailability(MqttChannelImplementation *channel, const QString &topic, const QByteArray &payload);
 };
 
 }
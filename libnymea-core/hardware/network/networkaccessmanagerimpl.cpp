@@ -57,6 +57,9 @@ NetworkAccessManagerImpl::NetworkAccessManagerImpl(QNetworkAccessManager *networ
 
 QNetworkReply *NetworkAccessManagerImpl::get(const QNetworkRequest &request)
 {
+    if (QThread::currentThread() != thread())
+        return threadManager()->get(request);
+
     QNetworkReply *reply = m_manager->get(request);
     hookupTimeoutTimer(reply);
     return reply;
@@ -64,6 +67,9 @@ QNetworkReply *NetworkAccessManagerImpl::get(const QNetworkRequest &request)
 
 QNetworkReply *NetworkAccessManagerImpl::deleteResource(const QNetworkRequest &request)
 {
+    if (QThread::currentThread() != thread())
+        return threadManager()->deleteResource(request);
+
     QNetworkReply *reply = m_manager->deleteResource(request);
     hookupTimeoutTimer(reply);
     return reply;
@@ -71,6 +77,9 @@ QNetworkReply *NetworkAccessManagerImpl::deleteResource(const QNetworkRequest &r
 
 QNetworkReply *NetworkAccessManagerImpl::head(const QNetworkRequest &request)
 {
+    if (QThread::currentThread() != thread())
+        return threadManager()->head(request);
+
     QNetworkReply *reply = m_manager->head(request);
     hookupTimeoutTimer(reply);
     return reply;
@@ -78,6 +87,9 @@ QNetworkReply *NetworkAccessManagerImpl::head(const QNetworkRequest &request)
 
 QNetworkReply *NetworkAccessManagerImpl::post(const QNetworkRequest &request, QIODevice *data)
 {
+    if (QThread::currentThread() != thread())
+        return threadManager()->post(request, data);
+
     QNetworkReply *reply = m_manager->post(request, data);
     hookupTimeoutTimer(reply);
     return reply;
@@ -85,6 +97,9 @@ QNetworkReply *NetworkAccessManagerImpl::post(const QNetworkRequest &request, QI
 
 QNetworkReply *NetworkAccessManagerImpl::post(const QNetworkRequest &request, const QByteArray &data)
 {
+    if (QThread::currentThread() != thread())
+        return threadManager()->post(request, data);
+
     QNetworkReply *reply = m_manager->post(request, data);
     hookupTimeoutTimer(reply);
     return reply;
@@ -92,6 +107,9 @@ QNetworkReply *NetworkAccessManagerImpl::post(const QNetworkRequest &request, co
 
 QNetworkReply *NetworkAccessManagerImpl::post(const QNetworkRequest &request, QHttpMultiPart *multiPart)
 {
+    if (QThread::currentThread() != thread())
+        return threadManager()->post(request, multiPart);
+
     QNetworkReply *reply = m_manager->post(request, multiPart);
     hookupTimeoutTimer(reply);
     return reply;
@@ -99,6 +117,9 @@ QNetworkReply *NetworkAccessManagerImpl::post(const QNetworkRequest &request, QH
 
 QNetworkReply *NetworkAccessManagerImpl::put(const QNetworkRequest &request, QIODevice *data)
 {
+    if (QThread::currentThread() != thread())
+        return threadManager()->put(request, data);
+
     QNetworkReply  *reply = m_manager->put(request, data);
     hookupTimeoutTimer(reply);
     return reply;
@@ -106,6 +127,9 @@ QNetworkReply *NetworkAccessManagerImpl::put(const QNetworkRequest &request, QIO
 
 QNetworkReply *NetworkAccessManagerImpl::put(const QNetworkRequest &request, const QByteArray &data)
 {
+    if (QThread::currentThread() != thread())
+        return threadManager()->put(request, data);
+
     QNetworkReply *reply = m_manager->put(request, data);
     hookupTimeoutTimer(reply);
     return reply;
@@ -113,6 +137,9 @@ QNetworkReply *NetworkAccessManagerImpl::put(const QNetworkRequest &request, con
 
 QNetworkReply *NetworkAccessManagerImpl::put(const QNetworkRequest &request, QHttpMultiPart *multiPart)
 {
+    if (QThread::currentThread() != thread())
+        return threadManager()->put(request, multiPart);
+
     QNetworkReply *reply = m_manager->put(request, multiPart);
     hookupTimeoutTimer(reply);
     return reply;
@@ -120,6 +147,9 @@ QNetworkReply *NetworkAccessManagerImpl::put(const QNetworkRequest &request, QHt
 
 QNetworkReply *NetworkAccessManagerImpl::sendCustomRequest(const QNetworkRequest &request, const QByteArray &verb, QIODevice *data)
 {
+    if (QThread::currentThread() != thread())
+        return threadManager()->sendCustomRequest(request, verb, data);
+
     QNetworkReply* reply = m_manager->sendCustomRequest(request, verb, data);
     hookupTimeoutTimer(reply);
     return reply;
@@ -145,6 +175,37 @@ void NetworkAccessManagerImpl::setEnabled(bool enabled)
         qCDebug(dcNetworkManager()) << "Network Manager disabled";
     }
     m_enabled = enabled;
+
+    QMutexLocker locker(&m_threadManagersMutex);
+    foreach (NetworkAccessManagerImpl *threadManager, m_threadManagers) {
+        QTimer::singleShot(0, threadManager, [threadManager, enabled](){
+            threadManager->setEnabled(enabled);
+        });
+    }
+}
+
+NetworkAccessManagerImpl *NetworkAccessManagerImpl::threadManager()
+{
+    // A QNetworkAccessManager and its replies can only be used in the thread they live in. Plugins running in
+    // their own thread get a network manager living in that thread, it goes away together with the thread.
+    QThread *currentThread = QThread::currentThread();
+    QMutexLocker locker(&m_threadManagersMutex);
+    NetworkAccessManagerImpl *threadManager = m_threadManagers.value(currentThread);
+    if (threadManager)
+        return threadManager;
+
+    QNetworkAccessManager *networkManager = new QNetworkAccessManager();
+    threadManager = new NetworkAccessManagerImpl(networkManager);
+    networkManager->setParent(threadManager);
+    threadManager->setEnabled(m_enabled);
+    m_threadManagers.insert(currentThread, threadManager);
+    connect(currentThread, &QThread::finished, threadManager, [this, currentThread, threadManager](){
+        QMutexLocker locker(&m_threadManagersMutex);
+        m_threadManagers.remove(currentThread);
+        locker.unlock();
+        delete threadManager;
+    }, Qt::DirectConnection);
+    return threadManager;
 }
 
 void NetworkAccessManagerImpl::hookupTimeoutTimer(QNetworkReply *reply)
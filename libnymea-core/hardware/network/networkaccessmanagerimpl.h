@@ -42,6 +42,8 @@
 #include <QDebug>
 #include <QUrl>
 #include <QTimer>
+#include <QMutex>
+#include <QThread>
 
 namespace nymeaserver {
 
@@ -81,6 +83,11 @@ private:
 
     void hookupTimeoutTimer(QNetworkReply* reply);
 
+    // Used by plugins running in their own thread
+    NetworkAccessManagerImpl *threadManager();
+    QMutex m_threadManagersMutex;
+    QHash<QThread*, NetworkAccessManagerImpl*> m_threadManagers;
+
 private slots:
     void networkReplyFinished();
     void networkTimeout();
@@ -40,6 +40,12 @@
 
   The communication was implementet using following documentation: \l{http://upnp.org/specs/arch/UPnP-arch-DeviceArchitecture-v1.1.pdf}
 
+  Devices usually answer every M-SEARCH message once per advertised service, so a single discovery receives the same
+  response many times. Each response location will only be evaluated once per discovery and the device description
+  behind it will be fetched only once, even if several discoveries are running at the same time. Parsed device
+  descriptions are cached for the \c max-age advertised in the \c CACHE-CONTROL header of the response and dropped
+  as soon as the device announces \c ssdp:byebye.
+
   \sa UpnpDevice, UpnpDeviceDescriptor
 */
 
@@ -50,6 +56,7 @@
 
 #include "upnpdiscoveryimplementation.h"
 #include "upnpdiscoveryreplyimplementation.h"
+#include "hardware/threadcall.h"
 
 #include <QMetaObject>
 #include <QNetworkInterface>
@@ -92,6 +99,10 @@ UpnpDiscoveryImplementation::~UpnpDiscoveryImplementation()
 
 UpnpDiscoveryReply *UpnpDiscoveryImplementation::discoverDevices(const QString &searchTarget, const QString &userAgent, const int &timeout)
 {
+    // Called by a plugin running in its own thread. The reply stays in this thread, its signals are queued to the plugin.
+    if (QThread::currentThread() != thread())
+        return callInThread<UpnpDiscoveryReply*>(this, [=]() { return discoverDevices(searchTarget, userAgent, timeout); });
+
     // Create the reply for this discovery request
     QPointer<UpnpDiscoveryReplyImplementation> reply = new UpnpDiscoveryReplyImplementation(searchTarget, userAgent, this);
 
@@ -111,20 +122,40 @@ UpnpDiscoveryReply *UpnpDiscoveryImplementation::discoverDevices(const QString &
 
     qCDebug(dcUpnp) << "Starging discovery for" << searchTarget << "(User agent:" << userAgent << ")";
 
+    // Concurrent discoveries for the same target share the search messages and the results
+    foreach (UpnpDiscoveryRequest *request, m_discoverRequests) {
+        if (request->searchTarget() == searchTarget && request->userAgent() == userAgent) {
+            qCDebug(dcUpnp()) << "Joining running discovery for" << searchTarget;
+            request->addReply(reply, timeout);
+            return reply.data();
+        }
+    }
+
     // Looks good so far, lets start a request
-    UpnpDiscoveryRequest *request = new UpnpDiscoveryRequest(this, reply.data());
+    UpnpDiscoveryRequest *request = new UpnpDiscoveryRequest(this, searchTarget, userAgent);
     connect(request, &UpnpDiscoveryRequest::discoveryTimeout, this, &UpnpDiscoveryImplementation::discoverTimeout);
-    request->discover(timeout);
+    request->addReply(reply, timeout);
+    request->discover();
     m_discoverRequests.append(request);
     return reply.data();
 }
 
-void UpnpDiscoveryImplementation::requestDeviceInformation(const QNetworkRequest &networkRequest, const UpnpDeviceDescriptor &upnpDeviceDescriptor)
+/*! Sets the SSDP multicast \a host and \a port used by this resource. This has to be set before the resource gets
+    enabled. If \a host is not a multicast address (i.e. an SSDP responder on the loopback interface) the socket will
+    be bound to a random port instead of joining a multicast group. */
+void UpnpDiscoveryImplementation::setMulticastAddress(const QHostAddress &host, quint16 port)
+{
+    m_host = host;
+    m_port = port;
+}
+
+void UpnpDiscoveryImplementation::requestDeviceInformation(const QNetworkRequest &networkRequest, const DescriptorCacheEntry &cacheEntry)
 {
     qCDebug(dcUpnp()) << "Requesting device information for" << networkRequest.url();
     QNetworkReply *replay = m_networkAccessManager->get(networkRequest);
     connect(replay, &QNetworkReply::finished, this, &UpnpDiscoveryImplementation::replyFinished);
-    m_informationRequestList.insert(replay, upnpDeviceDescriptor);
+    m_informationRequestList.insert(replay, cacheEntry);
+    m_pendingLocations.insert(cacheEntry.descriptor.location(), replay);
 }
 
 void UpnpDiscoveryImplementation::respondToSearchRequest(QHostAddress host, int port)
@@ -203,6 +234,11 @@ void UpnpDiscoveryImplementation::respondToSearchRequest(QHostAddress host, int
 /*! This method will be called to send the SSDP message \a data to the UPnP multicast.*/
 void UpnpDiscoveryImplementation::sendToMulticast(const QByteArray &data)
 {
+    if (QThread::currentThread() != thread()) {
+        callInThread(this, [=]() { sendToMulticast(data); });
+        return;
+    }
+
     if (!m_socket)
         return;
 
@@ -246,49 +282,141 @@ void UpnpDiscoveryImplementation::readData()
     QByteArray data;
     quint16 port;
     QHostAddress hostAddress;
-    QUrl location;
 
-    // read the answere from the multicast
-    while (m_socket->hasPendingDatagrams()) {
-        data.resize(m_socket->pendingDatagramSize());
+    // read the answers from the multicast
+    while (m_socket && m_socket->hasPendingDatagrams()) {
+        data.resize(static_cast<int>(m_socket->pendingDatagramSize()));
         m_socket->readDatagram(data.data(), data.size(), &hostAddress, &port);
+        processDatagram(data, hostAddress, port);
     }
+}
 
+void UpnpDiscoveryImplementation::processDatagram(const QByteArray &data, const QHostAddress &hostAddress, quint16 port)
+{
     if (data.contains("M-SEARCH") && !QNetworkInterface::allAddresses().contains(hostAddress)) {
         qCDebug(dcUpnp()) << "UPnP discovery request received. Responding...";
         respondToSearchRequest(hostAddress, port);
         return;
     }
 
-    if (data.contains("NOTIFY") && !QNetworkInterface::allAddresses().contains(hostAddress)) {
-        emit upnpNotify(data);
+    if (data.contains("NOTIFY")) {
+        // Devices leaving the network invalidate their cached description
+        QHash<QString, QString> headers = parseHeaders(data);
+        if (headers.value("NTS") == "ssdp:byebye" && !parseUuid(headers.value("USN")).isEmpty()) {
+            removeExpiredDescriptors(parseUuid(headers.value("USN")));
+        }
+
+        if (!QNetworkInterface::allAddresses().contains(hostAddress)) {
+            emit upnpNotify(data);
+        }
         return;
     }
 
     // if the data contains the HTTP OK header...
     if (data.contains("HTTP/1.1 200 OK")) {
-        const QStringList lines = QString(data).split("\r\n");
-        foreach (const QString& line, lines) {
-            int separatorIndex = line.indexOf(':');
-            QString key = line.left(separatorIndex).toUpper();
-            QString value = line.mid(separatorIndex+1).trimmed();
-
-            // get location
-            if (key.contains("LOCATION") || key.contains("location") || key.contains("Location")) {
-                location = QUrl(value);
-            }
+        processSearchResponse(data, hostAddress);
+    }
+}
+
+void UpnpDiscoveryImplementation::processSearchResponse(const QByteArray &data, const QHostAddress &hostAddress)
+{
+    QHash<QString, QString> headers = parseHeaders(data);
+    QUrl location = QUrl(headers.value("LOCATION"));
+    if (!location.isValid() || location.isEmpty()) {
+        qCDebug(dcUpnp()) << "Ignoring search response without valid location from" << hostAddress.toString();
+        return;
+    }
+
+    // Only the running discoveries searching for this target which did not see this location yet are interested in this response
+    QList<UpnpDiscoveryRequest *> interestedRequests;
+    foreach (UpnpDiscoveryRequest *upnpDiscoveryRequest, m_discoverRequests) {
+        if (upnpDiscoveryRequest->matchesSearchTarget(headers.value("ST")) && upnpDiscoveryRequest->registerLocation(location)) {
+            interestedRequests.append(upnpDiscoveryRequest);
+        }
+    }
+
+    if (interestedRequests.isEmpty())
+        return;
+
+    if (m_descriptorCache.contains(location)) {
+        DescriptorCacheEntry cacheEntry = m_descriptorCache.value(location);
+        if (cacheEntry.expiry > QDateTime::currentMSecsSinceEpoch()) {
+            qCDebug(dcUpnp()) << "Using cached device information for" << location.toString();
+            deliverDeviceDescriptor(cacheEntry.descriptor);
+            return;
+        }
+        m_descriptorCache.remove(location);
+    }
+
+    // The result of a running request will be delivered to all discoveries which have seen this location
+    if (m_pendingLocations.contains(location))
+        return;
+
+    DescriptorCacheEntry cacheEntry;
+    cacheEntry.descriptor.setLocation(location);
+    cacheEntry.descriptor.setHostAddress(hostAddress);
+    cacheEntry.descriptor.setPort(location.port());
+    cacheEntry.uuid = parseUuid(headers.value("USN"));
+    cacheEntry.maxAge = parseMaxAge(headers.value("CACHE-CONTROL"));
+
+    QNetworkRequest networkRequest = interestedRequests.first()->createNetworkRequest(cacheEntry.descriptor);
+    requestDeviceInformation(networkRequest, cacheEntry);
+}
+
+void UpnpDiscoveryImplementation::deliverDeviceDescriptor(const UpnpDeviceDescriptor &deviceDescriptor)
+{
+    foreach (UpnpDiscoveryRequest *upnpDiscoveryRequest, m_discoverRequests) {
+        if (upnpDiscoveryRequest->hasLocation(deviceDescriptor.location())) {
+            upnpDiscoveryRequest->addDeviceDescriptor(deviceDescriptor);
+        }
+    }
+}
+
+void UpnpDiscoveryImplementation::removeExpiredDescriptors(const QString &uuid)
+{
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    QHash<QUrl, DescriptorCacheEntry>::iterator it = m_descriptorCache.begin();
+    while (it != m_descriptorCache.end()) {
+        if (it.value().expiry <= now || (!uuid.isEmpty() && it.value().uuid == uuid)) {
+            qCDebug(dcUpnp()) << "Removing cached device information for" << it.key().toString();
+            it = m_descriptorCache.erase(it);
+        } else {
+            ++it;
         }
+    }
+}
 
-        UpnpDeviceDescriptor upnpDeviceDescriptor;
-        upnpDeviceDescriptor.setLocation(location);
-        upnpDeviceDescriptor.setHostAddress(hostAddress);
-        upnpDeviceDescriptor.setPort(location.port());
+QHash<QString, QString> UpnpDiscoveryImplementation::parseHeaders(const QByteArray &data)
+{
+    QHash<QString, QString> headers;
+    const QStringList lines = QString(data).split("\r\n");
+    foreach (const QString &line, lines) {
+        int separatorIndex = line.indexOf(':');
+        if (separatorIndex <= 0)
+            continue;
 
-        foreach (UpnpDiscoveryRequest *upnpDiscoveryRequest, m_discoverRequests) {
-            QNetworkRequest networkRequest = upnpDiscoveryRequest->createNetworkRequest(upnpDeviceDescriptor);
-            requestDeviceInformation(networkRequest, upnpDeviceDescriptor);
+        QString key = line.left(separatorIndex).trimmed().toUpper();
+        if (!headers.contains(key)) {
+            headers.insert(key, line.mid(separatorIndex + 1).trimmed());
         }
     }
+    return headers;
+}
+
+QString UpnpDiscoveryImplementation::parseUuid(const QString &usn)
+{
+    // A device announces itself with one USN per service (uuid:<uuid>::<type>), all of them sharing the uuid part
+    return usn.section("::", 0, 0);
+}
+
+int UpnpDiscoveryImplementation::parseMaxAge(const QString &cacheControl)
+{
+    // The UPnP device architecture requires a max-age of at least 1800 seconds if none is given
+    QRegExp maxAgeExpression("max-age\\s*=\\s*(\\d+)", Qt::CaseInsensitive);
+    if (maxAgeExpression.indexIn(cacheControl) < 0)
+        return 1800;
+
+    return maxAgeExpression.cap(1).toInt();
 }
 
 void UpnpDiscoveryImplementation::replyFinished()
@@ -296,10 +424,13 @@ void UpnpDiscoveryImplementation::replyFinished()
     QNetworkReply *reply = static_cast<QNetworkReply *>(sender());
     int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
 
+    DescriptorCacheEntry cacheEntry = m_informationRequestList.take(reply);
+    m_pendingLocations.remove(cacheEntry.descriptor.location());
+
     switch (status) {
     case(200):{
         QByteArray data = reply->readAll();
-        UpnpDeviceDescriptor upnpDeviceDescriptor = m_informationRequestList.take(reply);
+        UpnpDeviceDescriptor &upnpDeviceDescriptor = cacheEntry.descriptor;
 
         // parse XML data
         QXmlStreamReader xml(data);
@@ -354,16 +485,18 @@ void UpnpDiscoveryImplementation::replyFinished()
             }
         }
 
+        if (cacheEntry.maxAge > 0) {
+            cacheEntry.expiry = QDateTime::currentMSecsSinceEpoch() + cacheEntry.maxAge * 1000LL;
+            m_descriptorCache.insert(upnpDeviceDescriptor.location(), cacheEntry);
+        }
+
         qCDebug(dcUpnp()) << "Discovery result:" << upnpDeviceDescriptor.hostAddress().toString();
         qCDebug(dcUpnp()) << "Have" << m_discoverRequests.count() << "running discoveries";
-        foreach (UpnpDiscoveryRequest *upnpDiscoveryRequest, m_discoverRequests) {
-            upnpDiscoveryRequest->addDeviceDescriptor(upnpDeviceDescriptor);
-        }
+        deliverDeviceDescriptor(upnpDeviceDescriptor);
         break;
     }
     default:
         qCWarning(dcUpnp()) << name() << "HTTP request error" << reply->request().url().toString() << status;
-        m_informationRequestList.remove(reply);
     }
 
     reply->deleteLater();
@@ -371,6 +504,7 @@ void UpnpDiscoveryImplementation::replyFinished()
 
 void UpnpDiscoveryImplementation::notificationTimeout()
 {
+    removeExpiredDescriptors();
     sendAliveMessage();
 }
 
@@ -469,11 +603,13 @@ void UpnpDiscoveryImplementation::sendAliveMessage()
 void UpnpDiscoveryImplementation::discoverTimeout()
 {
     UpnpDiscoveryRequest *discoveryRequest = static_cast<UpnpDiscoveryRequest*>(sender());
-    QPointer<UpnpDiscoveryReplyImplementation> reply = discoveryRequest->reply();
 
-    if (reply.isNull()) {
-        qCWarning(dcUpnp()) << name() << "Reply does not exist any more. Please don't delete the reply before it has finished.";
-    }  else {
+    foreach (QPointer<UpnpDiscoveryReplyImplementation> reply, discoveryRequest->takeFinishedReplies()) {
+        if (reply.isNull()) {
+            qCWarning(dcUpnp()) << name() << "Reply does not exist any more. Please don't delete the reply before it has finished.";
+            continue;
+        }
+
         qCDebug(dcUpnp()) << "Descovery finished. Found devices:";
         qCDebug(dcUpnp()) << discoveryRequest->deviceList();
         reply->setDeviceDescriptors(discoveryRequest->deviceList());
@@ -481,8 +617,10 @@ void UpnpDiscoveryImplementation::discoverTimeout()
         reply->setFinished();
     }
 
-    m_discoverRequests.removeOne(discoveryRequest);
-    delete discoveryRequest;
+    if (!discoveryRequest->hasReplies()) {
+        m_discoverRequests.removeOne(discoveryRequest);
+        discoveryRequest->deleteLater();
+    }
 }
 
 void UpnpDiscoveryImplementation::networkConfigurationChanged(const QNetworkConfiguration &config)
@@ -504,13 +642,13 @@ bool UpnpDiscoveryImplementation::enable()
 
     // Bind udp socket and join multicast group
     m_socket = new QUdpSocket(this);
-    m_port = 1900;
-    m_host = QHostAddress("239.255.255.250");
 
     m_socket->setSocketOption(QAbstractSocket::MulticastTtlOption,QVariant(1));
     m_socket->setSocketOption(QAbstractSocket::MulticastLoopbackOption,QVariant(1));
 
-    if(!m_socket->bind(QHostAddress::AnyIPv4, m_port, QUdpSocket::ShareAddress)){
+    // A unicast target (i.e. a local SSDP responder) sends the responses to the port we are sending from
+    quint16 bindPort = m_host.isMulticast() ? m_port : 0;
+    if(!m_socket->bind(QHostAddress::AnyIPv4, bindPort, QUdpSocket::ShareAddress)){
         qCWarning(dcUpnp()) << name() << "could not bind to port" << m_port;
         m_available = false;
         emit availableChanged(false);
@@ -519,7 +657,7 @@ bool UpnpDiscoveryImplementation::enable()
         return false;
     }
 
-    if(!m_socket->joinMulticastGroup(m_host)){
+    if(m_host.isMulticast() && !m_socket->joinMulticastGroup(m_host)){
         qCWarning(dcUpnp()) << name() << "could not join multicast group" << m_host;
         m_available = false;
         emit availableChanged(false);
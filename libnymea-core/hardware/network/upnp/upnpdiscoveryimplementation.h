@@ -64,23 +64,43 @@ public:
     bool available() const override;
     bool enabled() const override;
 
+    void setMulticastAddress(const QHostAddress &host, quint16 port);
+
 private:
+    class DescriptorCacheEntry {
+    public:
+        UpnpDeviceDescriptor descriptor;
+        QString uuid;
+        int maxAge = 1800;
+        qint64 expiry = 0;
+    };
+
     QUdpSocket *m_socket = nullptr;
-    QHostAddress m_host;
-    qint16 m_port;
+    QHostAddress m_host = QHostAddress("239.255.255.250");
+    quint16 m_port = 1900;
 
     QTimer *m_notificationTimer = nullptr;
 
     QNetworkAccessManager *m_networkAccessManager = nullptr;
 
     QList<UpnpDiscoveryRequest *> m_discoverRequests;
-    QHash<QNetworkReply*, UpnpDeviceDescriptor> m_informationRequestList;
+    QHash<QNetworkReply*, DescriptorCacheEntry> m_informationRequestList;
+    QHash<QUrl, QNetworkReply*> m_pendingLocations;
+    QHash<QUrl, DescriptorCacheEntry> m_descriptorCache;
 
     bool m_available = false;
     bool m_enabled = false;
 
-    void requestDeviceInformation(const QNetworkRequest &networkRequest, const UpnpDeviceDescriptor &upnpDeviceDescriptor);
+    void processDatagram(const QByteArray &data, const QHostAddress &hostAddress, quint16 port);
+    void processSearchResponse(const QByteArray &data, const QHostAddress &hostAddress);
+    void requestDeviceInformation(const QNetworkRequest &networkRequest, const DescriptorCacheEntry &cacheEntry);
+    void deliverDeviceDescriptor(const UpnpDeviceDescriptor &deviceDescriptor);
     void respondToSearchRequest(QHostAddress host, int port);
+    void removeExpiredDescriptors(const QString &uuid = QString());
+
+    static QHash<QString, QString> parseHeaders(const QByteArray &data);
+    static QString parseUuid(const QString &usn);
+    static int parseMaxAge(const QString &cacheControl);
 
 protected:
     void setEnabled(bool enabled) override;
@@ -33,38 +33,93 @@
 
 namespace nymeaserver {
 
-UpnpDiscoveryRequest::UpnpDiscoveryRequest(UpnpDiscovery *upnpDiscovery, QPointer<UpnpDiscoveryReplyImplementation> reply):
+UpnpDiscoveryRequest::UpnpDiscoveryRequest(UpnpDiscovery *upnpDiscovery, const QString &searchTarget, const QString &userAgent):
     QObject(upnpDiscovery),
     m_upnpDiscovery(upnpDiscovery),
-    m_reply(reply)
+    m_searchTarget(searchTarget),
+    m_userAgent(userAgent)
 {
     m_timer = new QTimer(this);
     m_timer->setSingleShot(false);
     connect(m_timer, &QTimer::timeout, this, &UpnpDiscoveryRequest::onTimeout);
 }
 
-void UpnpDiscoveryRequest::discover(int timeout)
+QString UpnpDiscoveryRequest::searchTarget() const
+{
+    return m_searchTarget;
+}
+
+QString UpnpDiscoveryRequest::userAgent() const
+{
+    return m_userAgent;
+}
+
+void UpnpDiscoveryRequest::discover()
 {
     m_ssdpSearchMessage = QByteArray("M-SEARCH * HTTP/1.1\r\n"
                                               "HOST:239.255.255.250:1900\r\n"
                                               "MAN:\"ssdp:discover\"\r\n"
                                               "MX:4\r\n"
-                                              "ST: " + reply()->searchTarget().toUtf8() + "\r\n");
-    if (!reply()->userAgent().isEmpty()) {
-        m_ssdpSearchMessage.append("USR-AGENT: " + reply()->userAgent().toUtf8() + "\r\n");
+                                              "ST: " + m_searchTarget.toUtf8() + "\r\n");
+    if (!m_userAgent.isEmpty()) {
+        m_ssdpSearchMessage.append("USR-AGENT: " + m_userAgent.toUtf8() + "\r\n");
     }
     m_ssdpSearchMessage.append("\r\n");
 
     m_upnpDiscovery->sendToMulticast(m_ssdpSearchMessage);
 
-    // All 500 ms the message will be broadcasterd. So the message will be sent timeout[s] * 2
-    m_totalTriggers = timeout / 500;
-    m_triggerCounter = 0;
-
     qCDebug(dcUpnp()) << "--> Discovery called.";
     m_timer->start(500);
 }
 
+void UpnpDiscoveryRequest::addReply(QPointer<UpnpDiscoveryReplyImplementation> reply, int timeout)
+{
+    // All 500 ms the message will be broadcasterd. So the message will be sent timeout[s] * 2
+    PendingReply pendingReply;
+    pendingReply.reply = reply;
+    pendingReply.remainingTriggers = timeout / 500;
+    m_pendingReplies.append(pendingReply);
+}
+
+QList<QPointer<UpnpDiscoveryReplyImplementation>> UpnpDiscoveryRequest::takeFinishedReplies()
+{
+    QList<QPointer<UpnpDiscoveryReplyImplementation>> finishedReplies;
+    for (int i = m_pendingReplies.count() - 1; i >= 0; i--) {
+        if (m_pendingReplies.at(i).remainingTriggers < 0) {
+            finishedReplies.prepend(m_pendingReplies.takeAt(i).reply);
+        }
+    }
+    return finishedReplies;
+}
+
+bool UpnpDiscoveryRequest::hasReplies() const
+{
+    return !m_pendingReplies.isEmpty();
+}
+
+bool UpnpDiscoveryRequest::matchesSearchTarget(const QString &searchTarget) const
+{
+    // Devices echo the search target in their response. Responses to other discoveries sharing the socket are not
+    // meant for this one, unless it is searching for everything.
+    return m_searchTarget == "ssdp:all" || searchTarget.isEmpty() || searchTarget == m_searchTarget;
+}
+
+bool UpnpDiscoveryRequest::registerLocation(const QUrl &location)
+{
+    // Devices answer every search message, often once for each service they offer.
+    // Within one discovery window only the first response for a location is of interest.
+    if (m_locations.contains(location))
+        return false;
+
+    m_locations.insert(location);
+    return true;
+}
+
+bool UpnpDiscoveryRequest::hasLocation(const QUrl &location) const
+{
+    return m_locations.contains(location);
+}
+
 void UpnpDiscoveryRequest::addDeviceDescriptor(const UpnpDeviceDescriptor &deviceDescriptor)
 {
     // check if we already have the device in the list
@@ -85,7 +140,7 @@ QNetworkRequest UpnpDiscoveryRequest::createNetworkRequest(UpnpDeviceDescriptor
     QNetworkRequest deviceRequest;
     deviceRequest.setUrl(deviveDescriptor.location());
     deviceRequest.setHeader(QNetworkRequest::ContentTypeHeader,QVariant("text/xml"));
-    deviceRequest.setHeader(QNetworkRequest::UserAgentHeader,QVariant(reply()->userAgent()));
+    deviceRequest.setHeader(QNetworkRequest::UserAgentHeader,QVariant(m_userAgent));
 
     return deviceRequest;
 }
@@ -95,21 +150,21 @@ QList<UpnpDeviceDescriptor> UpnpDiscoveryRequest::deviceList() const
     return m_deviceList;
 }
 
-QPointer<UpnpDiscoveryReplyImplementation> UpnpDiscoveryRequest::reply()
-{
-    return m_reply;
-}
-
 void UpnpDiscoveryRequest::onTimeout()
 {
-    qCDebug(dcUpnp()) << "Send SSDP search message" << m_triggerCounter << "/" << m_totalTriggers;
+    qCDebug(dcUpnp()) << "Send SSDP search message for" << m_searchTarget << "(" << m_pendingReplies.count() << "replies waiting )";
     m_upnpDiscovery->sendToMulticast(m_ssdpSearchMessage);
 
-    if (m_triggerCounter >= m_totalTriggers) {
-        m_timer->stop();
+    bool replyFinished = false;
+    for (int i = 0; i < m_pendingReplies.count(); i++) {
+        m_pendingReplies[i].remainingTriggers--;
+        if (m_pendingReplies.at(i).remainingTriggers < 0) {
+            replyFinished = true;
+        }
+    }
+
+    if (replyFinished) {
         emit discoveryTimeout();
-    } else {
-        m_triggerCounter++;
     }
 }
 
@@ -36,6 +36,8 @@
 #include <QTimer>
 #include <QMetaObject>
 #include <QPointer>
+#include <QSet>
+#include <QUrl>
 
 #include "upnpdiscoveryreplyimplementation.h"
 #include "network/upnp/upnpdiscovery.h"
@@ -51,24 +53,39 @@ class UpnpDiscoveryRequest : public QObject
 {
     Q_OBJECT
 public:
-    explicit UpnpDiscoveryRequest(UpnpDiscovery *upnpDiscovery, QPointer<UpnpDiscoveryReplyImplementation> reply);
+    explicit UpnpDiscoveryRequest(UpnpDiscovery *upnpDiscovery, const QString &searchTarget, const QString &userAgent);
 
-    void discover(int timeout);
+    QString searchTarget() const;
+    QString userAgent() const;
+
+    void discover();
+    void addReply(QPointer<UpnpDiscoveryReplyImplementation> reply, int timeout);
+    QList<QPointer<UpnpDiscoveryReplyImplementation>> takeFinishedReplies();
+    bool hasReplies() const;
+
+    bool matchesSearchTarget(const QString &searchTarget) const;
+    bool registerLocation(const QUrl &location);
+    bool hasLocation(const QUrl &location) const;
     void addDeviceDescriptor(const UpnpDeviceDescriptor &deviceDescriptor);
     QNetworkRequest createNetworkRequest(UpnpDeviceDescriptor deviveDescriptor);
     QList<UpnpDeviceDescriptor> deviceList() const;
 
-    QPointer<UpnpDiscoveryReplyImplementation> reply();
-
 private:
+    class PendingReply {
+    public:
+        QPointer<UpnpDiscoveryReplyImplementation> reply;
+        int remainingTriggers = 0;
+    };
+
     UpnpDiscovery *m_upnpDiscovery;
+    QString m_searchTarget;
+    QString m_userAgent;
     QByteArray m_ssdpSearchMessage;
-    QPointer<UpnpDiscoveryReplyImplementation> m_reply;
-    int m_totalTriggers = 0;
-    int m_triggerCounter = 0;
+    QList<PendingReply> m_pendingReplies;
 
     QTimer *m_timer = nullptr;
     QList<UpnpDeviceDescriptor> m_deviceList;
+    QSet<QUrl> m_locations;
 
 signals:
     void discoveryTimeout();
@@ -30,25 +30,39 @@
 
 #include "plugintimermanagerimplementation.h"
 #include "loggingcategories.h"
-#include "nymeacore.h"
+#include "performancemonitor.h"
+#include "hardware/threadcall.h"
+
+#include <cmath>
+#include <limits>
 
 namespace nymeaserver {
 
-PluginTimerImplementation::PluginTimerImplementation(int interval, QObject *parent) :
+// Resolution of the timer wheel in milliseconds
+static const int wheelResolution = 100;
+
+PluginTimerImplementation::PluginTimerImplementation(int id, int intervalMSecs, PluginTimerManagerImplementation *parent) :
     PluginTimer(parent),
-    m_interval(interval)
+    m_manager(parent),
+    m_id(id),
+    m_intervalMSecs(intervalMSecs)
 {
-    connect(NymeaCore::instance()->timeManager(), &TimeManager::tick, this, &PluginTimerImplementation::tick);
+    m_periodStart = m_manager->currentTime();
 }
 
 int PluginTimerImplementation::interval() const
 {
-    return m_interval;
+    return m_intervalMSecs / 1000;
+}
+
+int PluginTimerImplementation::intervalMSecs() const
+{
+    return m_intervalMSecs;
 }
 
 int PluginTimerImplementation::currentTick() const
 {
-    return m_currentTick;
+    return static_cast<int>(elapsed() / 1000);
 }
 
 bool PluginTimerImplementation::running() const
@@ -72,94 +86,160 @@ void PluginTimerImplementation::setPaused(bool paused)
     }
 }
 
-void PluginTimerImplementation::setCurrentTick(int tick)
+qint64 PluginTimerImplementation::elapsed() const
+{
+    if (!m_running || m_paused)
+        return m_pausedElapsed;
+
+    return m_manager->currentTime() - m_periodStart;
+}
+
+qint64 PluginTimerImplementation::expiry() const
 {
-    if (m_currentTick != tick) {
-        m_currentTick = tick;
-        emit currentTickChanged(m_currentTick);
+    return m_periodStart + m_intervalMSecs;
+}
+
+void PluginTimerImplementation::schedule()
+{
+    if (m_running && !m_paused) {
+        m_manager->scheduleTimer(this);
+    } else {
+        m_manager->unscheduleTimer(this);
     }
 }
 
-void PluginTimerImplementation::tick()
+void PluginTimerImplementation::expire()
 {
-    if (m_paused)
+    if (!m_running || m_paused)
         return;
 
-    if (!m_running)
+    qint64 now = m_manager->currentTime();
+    if (expiry() > now) {
+        schedule();
         return;
+    }
 
-    setCurrentTick(m_currentTick += 1);
+    // Keep the phase unless we are late by more than one interval (i.e. the system was suspended)
+    m_periodStart += m_intervalMSecs;
+    if (expiry() <= now)
+        m_periodStart = now;
 
-    if (m_currentTick >= m_interval) {
-        emit timeout();
-        reset();
-    }
+    schedule();
+
+    PerformanceMeasurement measurement(PerformanceEntry::PerformanceCategoryPlugin, m_owner.isEmpty() ? QStringLiteral("PluginTimer") : m_owner, QStringLiteral("timer"));
+    emit timeout();
+    emit currentTickChanged(currentTick());
 }
 
 void PluginTimerImplementation::reset()
 {
-    setCurrentTick(0);
+    // Called by a plugin running in its own thread for a timer registered in the main thread
+    if (QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, "reset", Qt::QueuedConnection);
+        return;
+    }
+
+    m_periodStart = m_manager->currentTime();
+    m_pausedElapsed = 0;
+    schedule();
+    emit currentTickChanged(0);
 }
 
 void PluginTimerImplementation::start()
 {
+    if (QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, "start", Qt::QueuedConnection);
+        return;
+    }
+
+    if (!m_running || m_paused)
+        m_periodStart = m_manager->currentTime() - m_pausedElapsed;
+
     setPaused(false);
     setRunning(true);
+    schedule();
 }
 
 void PluginTimerImplementation::stop()
 {
+    if (QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, "stop", Qt::QueuedConnection);
+        return;
+    }
+
+    m_pausedElapsed = elapsed();
     setPaused(false);
     setRunning(false);
+    schedule();
 }
 
 void PluginTimerImplementation::pause()
 {
+    if (QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, "pause", Qt::QueuedConnection);
+        return;
+    }
+
+    if (m_paused)
+        return;
+
+    m_pausedElapsed = elapsed();
     m_paused = true;
+    schedule();
 }
 
 void PluginTimerImplementation::resume()
 {
+    if (QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, "resume", Qt::QueuedConnection);
+        return;
+    }
+
+    if (!m_paused)
+        return;
+
     m_paused = false;
+    m_periodStart = m_manager->currentTime() - m_pausedElapsed;
+    schedule();
 }
 
 
 PluginTimerManagerImplementation::PluginTimerManagerImplementation(QObject *parent) :
     PluginTimerManager(parent)
 {
+    m_clock.start();
+
+    m_wheelTimer = new QTimer(this);
+    m_wheelTimer->setSingleShot(true);
+    connect(m_wheelTimer, &QTimer::timeout, this, &PluginTimerManagerImplementation::onWheelTimeout);
+
     m_available = true;
     qCDebug(dcHardware()) << "-->" << name() << "created successfully.";
 }
 
 PluginTimer *PluginTimerManagerImplementation::registerTimer(int seconds)
 {
-    QPointer<PluginTimerImplementation> pluginTimer = new PluginTimerImplementation(seconds, this);
-    qCDebug(dcHardware()) << "Register timer" << pluginTimer->interval();
-
-    // TODO: schedule timer for load balancing
-
-    //    // Get min/max timer interval
-    //    PluginTimer *shortestTimer = nullptr;
-    //    PluginTimer *longestTimer = nullptr;
-    //    foreach (PluginTimer *timer, m_timers) {
-    //        if (!shortestTimer && !longestTimer) {
-    //            shortestTimer = timer;
-    //            longestTimer = timer;
-    //            continue;
-    //        }
-
-    //        if (timer->interval() < shortestTimer->interval()) {
-    //            shortestTimer = timer;
-    //            continue;
-    //        }
-
-    //        if (timer->interval() > longestTimer->interval()) {
-    //            longestTimer = timer;
-    //            continue;
-    //        }
-    //    }
-
-    m_timers.append(pluginTimer);
+    return registerTimerMSecs(seconds * 1000);
+}
+
+PluginTimer *PluginTimerManagerImplementation::registerTimerMSecs(int msecs)
+{
+    if (QThread::currentThread() != thread())
+        return threadManager()->registerTimerMSecs(msecs);
+
+    int interval = qMax(msecs, wheelResolution);
+    QPointer<PluginTimerImplementation> pluginTimer = new PluginTimerImplementation(m_nextTimerId++, interval, this);
+    pluginTimer->m_owner = PerformanceMonitor::currentOwner();
+    qCDebug(dcHardware()) << "Register timer" << interval << "ms";
+
+    // Spread timers with the same interval over the second half of the first period (golden ratio
+    // sequence) so things polled with the same interval don't all poll at the same moment.
+    int index = m_intervalTimerCounts[interval]++;
+    double phase = std::fmod(index * 0.6180339887, 1.0);
+    pluginTimer->m_periodStart -= static_cast<qint64>(phase * interval / 2);
+
+    m_timers.insert(pluginTimer->m_id, pluginTimer);
+    pluginTimer->schedule();
     return pluginTimer.data();
 }
 
@@ -171,11 +251,23 @@ void PluginTimerManagerImplementation::unregisterTimer(PluginTimer *timer)
         return;
     }
 
+    // Timers registered by plugins running in their own thread are managed by the manager of that thread
+    PluginTimerImplementation *timerImplementation = static_cast<PluginTimerImplementation*>(timer);
+    if (timerImplementation->m_manager != this) {
+        timerImplementation->m_manager->unregisterTimer(timer);
+        return;
+    }
+    if (QThread::currentThread() != thread()) {
+        callInThread(this, [=]() { unregisterTimer(timer); });
+        return;
+    }
+
     qCDebug(dcHardware()) << "Unregister timer" << timer->interval();
 
     foreach (QPointer<PluginTimerImplementation> tPointer, m_timers) {
         if (timerPointer.data() == tPointer.data()) {
-            m_timers.removeAll(tPointer);
+            m_timers.remove(tPointer->m_id);
+            unscheduleTimer(tPointer);
             tPointer->deleteLater();
         }
     }
@@ -191,16 +283,53 @@ bool PluginTimerManagerImplementation::enabled() const
     return m_enabled;
 }
 
-void PluginTimerManagerImplementation::timeTick()
+qint64 PluginTimerManagerImplementation::currentTime() const
+{
+    return m_clock.elapsed();
+}
+
+void PluginTimerManagerImplementation::scheduleTimer(PluginTimerImplementation *timer)
+{
+    // Round up, a timer must never expire early
+    m_wheel.insert(timer->m_id, (timer->expiry() + wheelResolution - 1) / wheelResolution);
+    armWheelTimer();
+}
+
+void PluginTimerManagerImplementation::unscheduleTimer(PluginTimerImplementation *timer)
+{
+    m_wheel.remove(timer->m_id);
+    armWheelTimer();
+}
+
+void PluginTimerManagerImplementation::armWheelTimer()
 {
-    // If timer resource is not enabled do nothing
-    if (!enabled()) {
+    // Rearmed once all expired timers are handled
+    if (m_expiring)
+        return;
+
+    qint64 nextTick = m_wheel.nextTick();
+    if (!m_enabled || nextTick < 0) {
+        m_wheelTimer->stop();
         return;
     }
 
-    foreach (PluginTimerImplementation *timer, m_timers) {
-        timer->tick();
+    qint64 interval = qMax<qint64>(0, nextTick * wheelResolution - currentTime());
+    m_wheelTimer->start(static_cast<int>(qMin<qint64>(interval, std::numeric_limits<int>::max())));
+}
+
+void PluginTimerManagerImplementation::onWheelTimeout()
+{
+    m_expiring = true;
+    QList<int> expiredTimers = m_wheel.advance(currentTime() / wheelResolution);
+    foreach (int timerId, expiredTimers) {
+        QPointer<PluginTimerImplementation> timer = m_timers.value(timerId);
+        if (!timer.isNull()) {
+            timer->expire();
+        }
     }
+    m_expiring = false;
+
+    armWheelTimer();
 }
 
 void PluginTimerManagerImplementation::setEnabled(bool enabled)
@@ -213,11 +342,42 @@ void PluginTimerManagerImplementation::setEnabled(bool enabled)
     m_enabled = enabled;
     emit enabledChanged(enabled);
 
-    foreach (QPointer<PluginTimerImplementation> timer, m_timers) {
-        timer->setPaused(enabled);
+    // Timers don't expire while the resource is disabled, late ones expire once enabled again
+    armWheelTimer();
+
+    QMutexLocker locker(&m_threadManagersMutex);
+    foreach (PluginTimerManagerImplementation *threadManager, m_threadManagers) {
+        QTimer::singleShot(0, threadManager, [threadManager, enabled](){
+            threadManager->setEnabled(enabled);
+        });
     }
 }
 
+PluginTimerManagerImplementation *PluginTimerManagerImplementation::threadManager()
+{
+    // Timers expire in the thread of their manager. Plugins running in their own thread get a manager
+    // living in that thread. Once the thread finished, the plugin continues in the main thread and so do its timers.
+    QThread *currentThread = QThread::currentThread();
+    QMutexLocker locker(&m_threadManagersMutex);
+    foreach (PluginTimerManagerImplementation *threadManager, m_threadManagers) {
+        if (threadManager->thread() == currentThread) {
+            return threadManager;
+        }
+    }
+
+    PluginTimerManagerImplementation *threadManager = new PluginTimerManagerImplementation();
+    threadManager->setEnabled(m_enabled);
+    m_threadManagers.append(threadManager);
+    connect(currentThread, &QThread::finished, threadManager, [this, threadManager](){
+        QMutexLocker locker(&m_threadManagersMutex);
+        threadManager->moveToThread(thread());
+        QTimer::singleShot(0, this, [this, threadManager](){
+            threadManager->setParent(this);
+        });
+    }, Qt::DirectConnection);
+    return threadManager;
+}
+
 bool PluginTimerManagerImplementation::enable()
 {
     if (!available())
@@ -237,5 +397,3 @@ bool PluginTimerManagerImplementation::disable()
 }
 
 }
-
-
@@ -34,11 +34,18 @@
 #include <QTimer>
 #include <QObject>
 #include <QPointer>
+#include <QElapsedTimer>
+#include <QMutex>
+
+#include <atomic>
 
 #include "plugintimer.h"
+#include "timerwheel.h"
 
 namespace nymeaserver {
 
+class PluginTimerManagerImplementation;
+
 class PluginTimerImplementation : public PluginTimer
 {
     Q_OBJECT
@@ -46,24 +53,34 @@ class PluginTimerImplementation : public PluginTimer
     friend class PluginTimerManagerImplementation;
 
 public:
-    explicit PluginTimerImplementation(int interval, QObject *parent = nullptr);
+    explicit PluginTimerImplementation(int id, int intervalMSecs, PluginTimerManagerImplementation *parent);
 
     int interval() const override;
+    int intervalMSecs() const override;
     int currentTick() const override;
     bool running() const override;
 
 private:
-    int m_interval;
-    int m_currentTick = 0;
+    PluginTimerManagerImplementation *m_manager = nullptr;
+    int m_id;
+    int m_intervalMSecs;
+    // The plugin which registered this timer, if known
+    QString m_owner;
+
+    // Start of the current period in manager time, the elapsed time is kept while not running
+    qint64 m_periodStart = 0;
+    qint64 m_pausedElapsed = 0;
 
     bool m_paused = false;
     bool m_running = true;
 
     void setRunning(bool running);
     void setPaused(bool paused);
-    void setCurrentTick(int tick);
 
-    void tick();
+    qint64 elapsed() const;
+    qint64 expiry() const;
+    void schedule();
+    void expire();
 
 public slots:
     void reset() override;
@@ -79,19 +96,41 @@ class PluginTimerManagerImplementation : public PluginTimerManager
     Q_OBJECT
 
     friend class HardwareManagerImplementation;
+    friend class PluginTimerImplementation;
 
 public:
     explicit PluginTimerManagerImplementation(QObject *parent = nullptr);
 
     PluginTimer *registerTimer(int seconds = 60) override;
+    PluginTimer *registerTimerMSecs(int msecs) override;
     void unregisterTimer(PluginTimer *timer = nullptr) override;
 
     bool available() const override;
     bool enabled() const override;
 
 private:
-    QList<QPointer<PluginTimerImplementation> > m_timers;
-    void timeTick();
+    QHash<int, QPointer<PluginTimerImplementation> > m_timers;
+    int m_nextTimerId = 0;
+    // Number of timers registered per interval, used to spread their phases
+    QHash<int, int> m_intervalTimerCounts;
+
+    QElapsedTimer m_clock;
+    TimerWheel m_wheel;
+    QTimer *m_wheelTimer = nullptr;
+    bool m_expiring = false;
+
+    qint64 currentTime() const;
+    void scheduleTimer(PluginTimerImplementation *timer);
+    void unscheduleTimer(PluginTimerImplementation *timer);
+    void armWheelTimer();
+
+    // Used by plugins running in their own thread
+    PluginTimerManagerImplementation *threadManager();
+    QMutex m_threadManagersMutex;
+    QList<PluginTimerManagerImplementation*> m_threadManagers;
+
+private slots:
+    void onWheelTimeout();
 
 protected:
     void setEnabled(bool enabled) override;
@@ -102,7 +141,8 @@ public slots:
 
 private:
     bool m_available = false;
-    bool m_enabled = false;
+    // Read by plugin threads through the main manager
+    std::atomic<bool> m_enabled{false};
 
 };
 
@@ -58,6 +58,7 @@
 #include "radio433brennenstuhl.h"
 #include "loggingcategories.h"
 #include "hardware/gpio.h"
+#include "hardware/threadcall.h"
 
 #include <QFileInfo>
 
@@ -98,6 +99,10 @@ void Radio433Brennenstuhl::brennenstuhlAvailableChanged(bool available)
 /*! Returns true, if the \a rawData with a certain \a delay (pulse length) could be sent \a repetitions times. */
 bool Radio433Brennenstuhl::sendData(int delay, QList<int> rawData, int repetitions)
 {
+    // Called by a plugin running in its own thread
+    if (QThread::currentThread() != thread())
+        return callInThread<bool>(this, [=]() { return sendData(delay, rawData, repetitions); });
+
     if (!available()) {
         qCWarning(dcHardware()) << name() << "Brennenstuhl gateway not available";
         return false;
@@ -0,0 +1,78 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef THREADCALL_H
+#define THREADCALL_H
+
+#include <QObject>
+#include <QThread>
+#include <QTimer>
+#include <QSemaphore>
+
+#include <functional>
+
+namespace nymeaserver {
+
+// Hardware resources live in the main thread. Plugins running in their own thread call into them
+// through this, it runs the call in the thread of the context object and waits for it to finish.
+template <typename T>
+T callInThread(QObject *context, std::function<T()> call)
+{
+    if (QThread::currentThread() == context->thread())
+        return call();
+
+    T result = T();
+    QSemaphore done;
+    QTimer::singleShot(0, context, [&result, &done, call](){
+        result = call();
+        done.release();
+    });
+    done.acquire();
+    return result;
+}
+
+inline void callInThread(QObject *context, std::function<void()> call)
+{
+    if (QThread::currentThread() == context->thread()) {
+        call();
+        return;
+    }
+
+    QSemaphore done;
+    QTimer::singleShot(0, context, [&done, call](){
+        call();
+        done.release();
+    });
+    done.acquire();
+}
+
+}
+
+#endif // THREADCALL_H
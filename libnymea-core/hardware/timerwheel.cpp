@@ -0,0 +1,162 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "timerwheel.h"
+
+namespace nymeaserver {
+
+TimerWheel::TimerWheel():
+    m_slots(levelCount * levelSize)
+{
+
+}
+
+qint64 TimerWheel::currentTick() const
+{
+    return m_currentTick;
+}
+
+bool TimerWheel::isEmpty() const
+{
+    return m_entries.isEmpty();
+}
+
+bool TimerWheel::contains(int id) const
+{
+    return m_entries.contains(id);
+}
+
+void TimerWheel::insert(int id, qint64 expiry)
+{
+    remove(id);
+
+    // Already due timers expire with the next tick
+    place(id, qMax(expiry, m_currentTick + 1));
+}
+
+void TimerWheel::remove(int id)
+{
+    if (!m_entries.contains(id))
+        return;
+
+    m_slots[m_entries.take(id).slot].remove(id);
+}
+
+QList<int> TimerWheel::advance(qint64 tick)
+{
+    QList<int> expired;
+
+    while (m_currentTick < tick) {
+        m_currentTick++;
+
+        // Move the timers of the next block down whenever a level wraps around
+        for (int level = 1; level < levelCount; level++) {
+            if ((m_currentTick & ((Q_INT64_C(1) << (levelBits * level)) - 1)) != 0)
+                break;
+
+            cascade(level);
+        }
+
+        QSet<int> &slot = m_slots[m_currentTick & levelMask];
+        if (slot.isEmpty())
+            continue;
+
+        QSet<int> ids;
+        ids.swap(slot);
+        foreach (int id, ids) {
+            Entry entry = m_entries.take(id);
+            if (entry.expiry <= m_currentTick) {
+                expired.append(id);
+            } else {
+                place(id, entry.expiry);
+            }
+        }
+    }
+
+    return expired;
+}
+
+qint64 TimerWheel::nextTick() const
+{
+    if (m_entries.isEmpty())
+        return -1;
+
+    // The first non empty slot of each level, the lowest level has to be expired,
+    // the higher levels need to be cascaded at the beginning of their block.
+    qint64 next = -1;
+    for (int level = 0; level < levelCount; level++) {
+        qint64 block = m_currentTick >> (levelBits * level);
+        for (int i = 1; i <= levelSize; i++) {
+            if (m_slots.at(level * levelSize + ((block + i) & levelMask)).isEmpty())
+                continue;
+
+            qint64 tick = (block + i) << (levelBits * level);
+            if (next < 0 || tick < next)
+                next = tick;
+
+            break;
+        }
+    }
+
+    return next;
+}
+
+void TimerWheel::cascade(int level)
+{
+    int index = (m_currentTick >> (levelBits * level)) & levelMask;
+
+    QSet<int> ids;
+    ids.swap(m_slots[level * levelSize + index]);
+    foreach (int id, ids) {
+        place(id, m_entries.take(id).expiry);
+    }
+}
+
+void TimerWheel::place(int id, qint64 expiry)
+{
+    // Timers beyond the range of the wheel are parked on the last level and placed again on cascade
+    qint64 maxDelta = (Q_INT64_C(1) << (levelBits * levelCount)) - 1;
+    qint64 delta = qBound<qint64>(0, expiry - m_currentTick, maxDelta);
+
+    int level = 0;
+    while (level < levelCount - 1 && delta >= (Q_INT64_C(1) << (levelBits * (level + 1)))) {
+        level++;
+    }
+
+    int slot = level * levelSize + (((m_currentTick + delta) >> (levelBits * level)) & levelMask);
+    m_slots[slot].insert(id);
+
+    Entry entry;
+    entry.expiry = expiry;
+    entry.slot = slot;
+    m_entries.insert(id, entry);
+}
+
+}
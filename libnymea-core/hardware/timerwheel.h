@@ -0,0 +1,81 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <QVector>
+#include <QHash>
+#include <QSet>
+#include <QList>
+
+namespace nymeaserver {
+
+// A hierarchical timer wheel with 4 levels of 64 slots. Times are given in ticks, inserting,
+// removing and expiring a timer is O(1). Timers on the higher levels get moved down
+// (cascaded) whenever the lower level wraps around. Advancing over empty slots is cheap, so
+// the wheel can be advanced lazily up to the next tick returned by nextTick().
+class TimerWheel
+{
+public:
+    TimerWheel();
+
+    qint64 currentTick() const;
+    bool isEmpty() const;
+    bool contains(int id) const;
+
+    void insert(int id, qint64 expiry);
+    void remove(int id);
+
+    QList<int> advance(qint64 tick);
+    qint64 nextTick() const;
+
+private:
+    struct Entry {
+        qint64 expiry;
+        int slot;
+    };
+
+    static const int levelBits = 6;
+    static const int levelSize = 1 << levelBits;
+    static const int levelMask = levelSize - 1;
+    static const int levelCount = 4;
+
+    qint64 m_currentTick = 0;
+    QHash<int, Entry> m_entries;
+    QVector<QSet<int> > m_slots;
+
+    void cascade(int level);
+    void place(int id, qint64 expiry);
+};
+
+}
+
+#endif // TIMERWHEEL_H
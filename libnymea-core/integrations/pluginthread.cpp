@@ -0,0 +1,124 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "pluginthread.h"
+#include "integrations/integrationplugin.h"
+
+#include <QCoreApplication>
+#include <QEvent>
+
+class PluginCallEvent : public QEvent
+{
+public:
+    PluginCallEvent(std::function<void()> call):
+        QEvent(QEvent::User),
+        m_call(call)
+    {
+    }
+
+    void run() const
+    {
+        m_call();
+    }
+
+private:
+    std::function<void()> m_call;
+};
+
+class PluginCallDispatcher : public QObject
+{
+public:
+    bool event(QEvent *event) override
+    {
+        if (event->type() != QEvent::User)
+            return QObject::event(event);
+
+        static_cast<PluginCallEvent *>(event)->run();
+        return true;
+    }
+};
+
+PluginThread::PluginThread(IntegrationPlugin *plugin, QObject *parent):
+    QThread(parent),
+    m_plugin(plugin)
+{
+    setObjectName(plugin->pluginName());
+
+    // Posted events are delivered in order, unlike timers, so all calls go through this object
+    m_dispatcher = new PluginCallDispatcher();
+    m_dispatcher->moveToThread(this);
+
+    // Only objects without parent can be moved to another thread. Children of the plugin will follow.
+    plugin->setParent(nullptr);
+    plugin->moveToThread(this);
+}
+
+PluginThread::~PluginThread()
+{
+    // The thread isn't running any more at this point
+    delete m_dispatcher;
+}
+
+IntegrationPlugin *PluginThread::plugin() const
+{
+    return m_plugin;
+}
+
+void PluginThread::post(std::function<void()> call)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_stopped) {
+        locker.unlock();
+        call();
+        return;
+    }
+
+    QCoreApplication::postEvent(m_dispatcher, new PluginCallEvent(call));
+}
+
+void PluginThread::stop()
+{
+    // An object can only be pushed to another thread from its own thread
+    QThread *ownerThread = thread();
+    post([this, ownerThread](){
+        m_plugin->moveToThread(ownerThread);
+        QMutexLocker locker(&m_mutex);
+        m_stopped = true;
+        quit();
+    });
+}
+
+void PluginThread::run()
+{
+    exec();
+
+    // Calls posted before the thread stopped, but after it was told to quit, are still pending
+    QCoreApplication::sendPostedEvents(m_dispatcher, QEvent::User);
+}
@@ -0,0 +1,69 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef PLUGINTHREAD_H
+#define PLUGINTHREAD_H
+
+#include <QThread>
+#include <QMutex>
+
+#include <functional>
+
+class IntegrationPlugin;
+
+// Runs a plugin with the "threaded" metadata flag. Calls posted to the thread are executed in order.
+class PluginThread : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit PluginThread(IntegrationPlugin *plugin, QObject *parent = nullptr);
+    ~PluginThread() override;
+
+    IntegrationPlugin *plugin() const;
+
+    // Runs call in the plugin thread after everything posted before. Once the thread has stopped, call is run right away.
+    void post(std::function<void()> call);
+
+    // Moves the plugin back to the thread of this object and quits the thread. The thread emits finished() once done.
+    void stop();
+
+protected:
+    void run() override;
+
+private:
+    IntegrationPlugin *m_plugin = nullptr;
+    QObject *m_dispatcher = nullptr;
+
+    QMutex m_mutex;
+    bool m_stopped = false;
+};
+
+#endif // PLUGINTHREAD_H
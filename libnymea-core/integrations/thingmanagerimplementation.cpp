@@ -39,6 +39,8 @@
 #include "nymeasettings.h"
 #include "version.h"
 #include "plugininfocache.h"
+#include "settingssnapshot.h"
+#include "performancemonitor.h"
 
 #include "integrations/thingdiscoveryinfo.h"
 #include "integrations/thingpairinginfo.h"
@@ -63,6 +65,33 @@
 #include <QCoreApplication>
 #include <QStandardPaths>
 #include <QDir>
+#include <QDataStream>
+#include <QDateTime>
+
+// Identical discoveries within this time share the result of the previous discovery
+static const int discoveryCacheTimeout = 30000;
+
+static void writeParams(QDataStream &stream, const ParamList &params)
+{
+    stream << static_cast<quint32>(params.count());
+    foreach (const Param &param, params) {
+        stream << param.paramTypeId() << param.value();
+    }
+}
+
+static ParamList readParams(QDataStream &stream)
+{
+    ParamList params;
+    quint32 count;
+    stream >> count;
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; i++) {
+        QUuid paramTypeId;
+        QVariant value;
+        stream >> paramTypeId >> value;
+        params.append(Param(paramTypeId, value));
+    }
+    return params;
+}
 
 ThingManagerImplementation::ThingManagerImplementation(HardwareManager *hardwareManager, const QLocale &locale, QObject *parent) :
     ThingManager(parent),
@@ -87,6 +116,17 @@ ThingManagerImplementation::ThingManagerImplementation(HardwareManager *hardware
         oldStateFile.copy(settingsPath + "/thingstates.conf");
     }
 
+    // Cached discovery results may list things which have been added or removed meanwhile
+    connect(this, &ThingManager::thingAdded, this, [this](Thing *thing){
+        invalidateDiscoveryCache(thing->pluginId());
+    });
+    connect(this, &ThingManager::thingChanged, this, [this](Thing *thing){
+        invalidateDiscoveryCache(thing->pluginId());
+    });
+    connect(this, &ThingManager::thingRemoved, this, [this](){
+        invalidateDiscoveryCache();
+    });
+
     // Give hardware a chance to start up before loading plugins etc.
     QMetaObject::invokeMethod(this, "loadPlugins", Qt::QueuedConnection);
     QMetaObject::invokeMethod(this, "loadConfiguredThings", Qt::QueuedConnection);
@@ -100,9 +140,32 @@ ThingManagerImplementation::~ThingManagerImplementation()
 {
     delete m_translator;
 
+    // Plugin threads may still be working with things, stop them before deleting anything
+    foreach (PluginThread *pluginThread, m_pluginThreads) {
+        pluginThread->stop();
+    }
+    QList<PluginId> runningPlugins;
+    foreach (PluginThread *pluginThread, m_pluginThreads) {
+        if (!pluginThread->wait(5000)) {
+            qCWarning(dcThingManager()) << "Thread of plugin" << pluginThread->plugin()->pluginName() << "did not stop. Not deleting the plugin and its things.";
+            runningPlugins.append(pluginThread->plugin()->pluginId());
+            continue;
+        }
+        pluginThread->plugin()->setParent(this);
+        delete pluginThread;
+    }
+    m_pluginThreads.clear();
+
     foreach (Thing *thing, m_configuredThings) {
         storeThingStates(thing);
-        delete thing;
+    }
+    if (SettingsSnapshot::enabled()) {
+        saveThingStatesSnapshot();
+    }
+    foreach (Thing *thing, m_configuredThings) {
+        if (!runningPlugins.contains(thing->pluginId())) {
+            delete thing;
+        }
     }
 
     foreach (IntegrationPlugin *plugin, m_integrationPlugins) {
@@ -167,6 +230,24 @@ void ThingManagerImplementation::registerStaticPlugin(IntegrationPlugin *plugin,
     loadPlugin(plugin, metaData);
 }
 
+void ThingManagerImplementation::setLazyPluginLoading(bool enabled, int idleTimeout)
+{
+    m_lazyPluginLoading = enabled;
+    m_pluginIdleTimeout = static_cast<qint64>(idleTimeout) * 1000;
+    if (!m_lazyPluginLoading) {
+        return;
+    }
+
+    qCDebug(dcThingManager()) << "Lazy plugin loading enabled. Unloading idle plugins after" << idleTimeout << "seconds";
+    if (!m_pluginIdleTimer) {
+        m_pluginIdleTimer = new QTimer(this);
+        connect(m_pluginIdleTimer, &QTimer::timeout, this, &ThingManagerImplementation::unloadIdlePlugins);
+    }
+    // Check often enough to unload plugins no later than 10% after their idle timeout
+    m_pluginIdleTimer->setInterval(static_cast<int>(qBound<qint64>(1000, m_pluginIdleTimeout / 10, 60000)));
+    m_pluginIdleTimer->start();
+}
+
 IntegrationPlugins ThingManagerImplementation::plugins() const
 {
     return m_integrationPlugins.values();
@@ -190,25 +271,34 @@ Thing::ThingError ThingManagerImplementation::setPluginConfig(const PluginId &pl
     if (verify != Thing::ThingErrorNoError)
         return verify;
 
-    Thing::ThingError result = plugin->setConfiguration(params);
-    if (result != Thing::ThingErrorNoError)
-        return result;
+    // Plugins running in their own thread apply the configuration asynchronously. It has been verified against
+    // the configuration description already, which is all the plugin checks, so this returns success for them.
+    QSharedPointer<Thing::ThingError> result(new Thing::ThingError(Thing::ThingErrorNoError));
+    callPlugin(plugin, "setConfiguration", [plugin, params, result](){
+        *result = plugin->setConfiguration(params);
+    }, [this, plugin, pluginConfig, result](){
+        if (*result != Thing::ThingErrorNoError) {
+            qCWarning(dcThingManager()) << "Plugin" << plugin->pluginName() << "rejected the configuration:" << *result;
+            return;
+        }
 
-    NymeaSettings settings(NymeaSettings::SettingsRolePlugins);
-    settings.beginGroup("PluginConfig");
-    settings.beginGroup(plugin->pluginId().toString());
+        NymeaSettings settings(NymeaSettings::SettingsRolePlugins);
+        settings.beginGroup("PluginConfig");
+        settings.beginGroup(plugin->pluginId().toString());
+
+        foreach (const Param &param, pluginConfig) {
+            settings.beginGroup(param.paramTypeId().toString());
+            settings.setValue("type", static_cast<int>(param.value().type()));
+            settings.setValue("value", param.value());
+            settings.endGroup();
+        }
 
-    foreach (const Param &param, pluginConfig) {
-        settings.beginGroup(param.paramTypeId().toString());
-        settings.setValue("type", static_cast<int>(param.value().type()));
-        settings.setValue("value", param.value());
         settings.endGroup();
-    }
+        settings.endGroup();
+        emit pluginConfigChanged(plugin->pluginId(), pluginConfig);
+    });
 
-    settings.endGroup();
-    settings.endGroup();
-    emit pluginConfigChanged(plugin->pluginId(), pluginConfig);
-    return result;
+    return m_pluginThreads.contains(plugin) ? Thing::ThingErrorNoError : *result;
 }
 
 Vendors ThingManagerImplementation::supportedVendors() const
@@ -251,7 +341,7 @@ ThingDiscoveryInfo* ThingManagerImplementation::discoverThings(const ThingClassI
         discoveryInfo->finish(Thing::ThingErrorCreationMethodNotSupported);
         return discoveryInfo;
     }
-    IntegrationPlugin *plugin = m_integrationPlugins.value(thingClass.pluginId());
+    IntegrationPlugin *plugin = activatePlugin(thingClass.pluginId());
     if (!plugin) {
         qCWarning(dcThingManager) << "Thing discovery failed. Plugin not found for thing class" << thingClass.name();
         ThingDiscoveryInfo *discoveryInfo = new ThingDiscoveryInfo(thingClassId, params, this);
@@ -268,24 +358,78 @@ ThingDiscoveryInfo* ThingManagerImplementation::discoverThings(const ThingClassI
         return discoveryInfo;
     }
 
+    // Identical discoveries share a recent result or the running discovery instead of scanning again
+    QByteArray cacheKey = discoveryCacheKey(thingClassId, effectiveParams);
+    if (m_discoveryCache.contains(cacheKey)) {
+        DiscoveryCacheEntry cacheEntry = m_discoveryCache.value(cacheKey);
+        if (cacheEntry.expiry > QDateTime::currentMSecsSinceEpoch()) {
+            qCDebug(dcThingManager) << "Using cached discovery results for" << thingClass.name();
+            ThingDiscoveryInfo *discoveryInfo = new ThingDiscoveryInfo(thingClassId, effectiveParams, this);
+            discoveryInfo->addThingDescriptors(cacheEntry.thingDescriptors);
+            discoveryInfo->finish(Thing::ThingErrorNoError);
+            return discoveryInfo;
+        }
+        m_discoveryCache.remove(cacheKey);
+    }
+
+    if (m_runningDiscoveries.contains(cacheKey)) {
+        qCDebug(dcThingManager) << "Joining running thing discovery for" << thingClass.name();
+        ThingDiscoveryInfo *runningInfo = m_runningDiscoveries.value(cacheKey);
+        // The joined info times out on its own, in case the running discovery never finishes
+        ThingDiscoveryInfo *discoveryInfo = new ThingDiscoveryInfo(thingClassId, effectiveParams, this, 30000);
+        connect(runningInfo, &ThingDiscoveryInfo::finished, discoveryInfo, [runningInfo, discoveryInfo](){
+            if (discoveryInfo->isFinished())
+                return;
+
+            discoveryInfo->addThingDescriptors(runningInfo->thingDescriptors());
+            discoveryInfo->finish(runningInfo->status(), runningInfo->displayMessage());
+        });
+        connect(runningInfo, &ThingDiscoveryInfo::destroyed, discoveryInfo, [discoveryInfo](){
+            if (!discoveryInfo->isFinished()) {
+                discoveryInfo->finish(Thing::ThingErrorHardwareFailure);
+            }
+        });
+        return discoveryInfo;
+    }
+
     ThingDiscoveryInfo *discoveryInfo = new ThingDiscoveryInfo(thingClassId, effectiveParams, this, 30000);
-    connect(discoveryInfo, &ThingDiscoveryInfo::finished, this, [this, discoveryInfo](){
+    m_runningDiscoveries.insert(cacheKey, discoveryInfo);
+    connect(discoveryInfo, &ThingDiscoveryInfo::destroyed, this, [this, discoveryInfo, cacheKey](){
+        if (m_runningDiscoveries.value(cacheKey) == discoveryInfo) {
+            m_runningDiscoveries.remove(cacheKey);
+        }
+    });
+    connect(discoveryInfo, &ThingDiscoveryInfo::finished, this, [this, discoveryInfo, cacheKey, thingClass](){
+        m_runningDiscoveries.remove(cacheKey);
         if (discoveryInfo->status() != Thing::ThingErrorNoError) {
             qCWarning(dcThingManager()) << "Discovery failed:" << discoveryInfo->status() << discoveryInfo->displayMessage();
             return;
         }
         qCDebug(dcThingManager()) << "Discovery finished. Found things:" << discoveryInfo->thingDescriptors().count();
+        ThingDescriptors validDescriptors;
         foreach (const ThingDescriptor &descriptor, discoveryInfo->thingDescriptors()) {
             if (!descriptor.isValid()) {
                 qCWarning(dcThingManager()) << "Descriptor is invalid. Not adding to results";
                 continue;
             }
             m_discoveredThings.insert(descriptor.id(), descriptor);
+            validDescriptors.append(descriptor);
+        }
+
+        // Empty results are not cached, retrying a discovery which found nothing should scan again
+        if (!validDescriptors.isEmpty()) {
+            DiscoveryCacheEntry cacheEntry;
+            cacheEntry.pluginId = thingClass.pluginId();
+            cacheEntry.thingDescriptors = validDescriptors;
+            cacheEntry.expiry = QDateTime::currentMSecsSinceEpoch() + discoveryCacheTimeout;
+            m_discoveryCache.insert(cacheKey, cacheEntry);
         }
     });
 
     qCDebug(dcThingManager) << "Thing discovery for" << thingClass.name() << "started...";
-    plugin->discoverThings(discoveryInfo);
+    callPlugin(plugin, "discoverThings", discoveryInfo, [plugin, discoveryInfo](){
+        plugin->discoverThings(discoveryInfo);
+    });
     return discoveryInfo;
 }
 
@@ -388,7 +532,7 @@ ThingSetupInfo *ThingManagerImplementation::reconfigureThing(const ThingDescript
 
 ThingSetupInfo *ThingManagerImplementation::reconfigureThingInternal(Thing *thing, const ParamList &params, const QString &name)
 {
-    IntegrationPlugin *plugin = m_integrationPlugins.value(thing->thingClass().pluginId());
+    IntegrationPlugin *plugin = activatePlugin(thing->thingClass().pluginId());
     if (!plugin) {
         qCWarning(dcThingManager()) << "Cannot reconfigure thing. Plugin for ThingClass" << thing->thingClassId().toString() << "not found.";
         ThingSetupInfo *info = new ThingSetupInfo(nullptr, this);
@@ -405,24 +549,26 @@ ThingSetupInfo *ThingManagerImplementation::reconfigureThingInternal(Thing *thin
         return info;
     }
 
-    // first remove the thing in the plugin
-    plugin->thingRemoved(thing);
-
     // mark setup as incomplete
     thing->setSetupStatus(Thing::ThingSetupStatusInProgress, Thing::ThingErrorNoError);
 
-    // set new params
-    foreach (const Param &param, params) {
-        thing->setParamValue(param.paramTypeId(), param.value());
-    }
+    // first remove the thing in the plugin, then try to setup the thing with the new params
+    ThingSetupInfo *info = new ThingSetupInfo(thing, this, 30000);
+    callPlugin(plugin, "thingRemoved", [plugin, thing](){
+        plugin->thingRemoved(thing);
+    }, [this, plugin, thing, info, params, name](){
+        foreach (const Param &param, params) {
+            thing->setParamValue(param.paramTypeId(), param.value());
+        }
 
-    if (!name.isEmpty()) {
-        thing->setName(name);
-    }
+        if (!name.isEmpty()) {
+            thing->setName(name);
+        }
 
-    // try to setup the thing with the new params
-    ThingSetupInfo *info = new ThingSetupInfo(thing, this, 30000);
-    plugin->setupThing(info);
+        callPlugin(plugin, "setupThing", info, [plugin, info](){
+            plugin->setupThing(info);
+        });
+    });
     connect(info, &ThingSetupInfo::finished, this, [this, info](){
 
         if (info->status() != Thing::ThingErrorNoError) {
@@ -563,7 +709,7 @@ ThingPairingInfo *ThingManagerImplementation::confirmPairing(const PairingTransa
     ThingClassId thingClassId = context.thingClassId;
 
     ThingClass thingClass = m_supportedThings.value(thingClassId);
-    IntegrationPlugin *plugin = m_integrationPlugins.value(thingClass.pluginId());
+    IntegrationPlugin *plugin = activatePlugin(thingClass.pluginId());
     if (!plugin) {
         qCWarning(dcThingManager) << "Can't find a plugin for this thing class:" << thingClass;
         ThingPairingInfo *info = new ThingPairingInfo(pairingTransactionId, thingClassId, context.thingId, context.thingName, context.params, context.parentId, this);
@@ -580,7 +726,9 @@ ThingPairingInfo *ThingManagerImplementation::confirmPairing(const PairingTransa
     // both, the internal pairing and the setup have completed.
     ThingPairingInfo *internalInfo = new ThingPairingInfo(pairingTransactionId, thingClassId, thingId, context.thingName, context.params, context.parentId, this);
     ThingPairingInfo *externalInfo = new ThingPairingInfo(pairingTransactionId, thingClassId, thingId, context.thingName, context.params, context.parentId, this);
-    plugin->confirmPairing(internalInfo, username, secret);
+    callPlugin(plugin, "confirmPairing", internalInfo, [plugin, internalInfo, username, secret](){
+        plugin->confirmPairing(internalInfo, username, secret);
+    });
 
     connect(internalInfo, &ThingPairingInfo::finished, this, [this, internalInfo, externalInfo, plugin, addNewThing](){
 
@@ -628,7 +776,7 @@ ThingPairingInfo *ThingManagerImplementation::confirmPairing(const PairingTransa
                     qCWarning(dcThingManager()) << "Failed to set up thing" << info->thing()->name()
                                                  << "Not adding thing to the system. Error:"
                                                   << info->status() << info->displayMessage();
-                    info->thing()->deleteLater();
+                    deleteAfterPlugin(m_integrationPlugins.value(info->thing()->pluginId()), info->thing());
 
                 } else {
                     qCWarning(dcThingManager()) << "Failed to reconfigure thing" << info->thing()->name() <<
@@ -684,7 +832,7 @@ ThingSetupInfo* ThingManagerImplementation::addConfiguredThingInternal(const Thi
         thingId = ThingId::createThingId();
     }
 
-    IntegrationPlugin *plugin = m_integrationPlugins.value(thingClass.pluginId());
+    IntegrationPlugin *plugin = activatePlugin(thingClass.pluginId());
     if (!plugin) {
         qCWarning(dcThingManager()) << "Cannot add thing. Plugin for thing class" << thingClass.name() << "not found.";
         ThingSetupInfo *info = new ThingSetupInfo(nullptr, this);
@@ -720,7 +868,7 @@ ThingSetupInfo* ThingManagerImplementation::addConfiguredThingInternal(const Thi
     connect(info, &ThingSetupInfo::finished, this, [this, info](){
         if (info->status() != Thing::ThingErrorNoError) {
             qCWarning(dcThingManager) << "Thing setup failed. Not adding thing to system.";
-            info->thing()->deleteLater();
+            deleteAfterPlugin(m_integrationPlugins.value(info->thing()->pluginId()), info->thing());
             return;
         }
 
@@ -748,19 +896,26 @@ Thing::ThingError ThingManagerImplementation::removeConfiguredThing(const ThingI
     if (!plugin) {
         qCWarning(dcThingManager()).nospace() << "Plugin not loaded for thing " << thing->name() << ". Not calling thingRemoved on plugin.";
     } else {
-        plugin->thingRemoved(thing);
+        callPlugin(plugin, "thingRemoved", [plugin, thing](){
+            plugin->thingRemoved(thing);
+        });
     }
 
-    thing->deleteLater();
+    deleteAfterPlugin(plugin, thing);
 
-    NymeaSettings settings(NymeaSettings::SettingsRoleThings);
-    settings.beginGroup("ThingConfig");
-    settings.beginGroup(thingId.toString());
-    settings.remove("");
-    settings.endGroup();
+    {
+        NymeaSettings settings(NymeaSettings::SettingsRoleThings);
+        settings.beginGroup("ThingConfig");
+        settings.beginGroup(thingId.toString());
+        settings.remove("");
+        settings.endGroup();
 
-    NymeaSettings stateCache(NymeaSettings::SettingsRoleThingStates);
-    stateCache.remove(thingId.toString());
+        NymeaSettings stateCache(NymeaSettings::SettingsRoleThingStates);
+        stateCache.remove(thingId.toString());
+    }
+    if (SettingsSnapshot::enabled()) {
+        saveConfiguredThingsSnapshot();
+    }
 
     foreach (const IOConnectionId &ioConnectionId, m_ioConnections.keys()) {
         IOConnection ioConnection = m_ioConnections.value(ioConnectionId);
@@ -803,7 +958,9 @@ BrowseResult *ThingManagerImplementation::browseThing(const ThingId &thingId, co
         return result;
     }
 
-    plugin->browseThing(result);
+    callPlugin(plugin, "browseThing", result, [plugin, result](){
+        plugin->browseThing(result);
+    });
     connect(result, &BrowseResult::finished, this, [result](){
         if (result->status() != Thing::ThingErrorNoError) {
             qCWarning(dcThingManager()) << "Browse thing failed:" << result->status();
@@ -841,7 +998,9 @@ BrowserItemResult *ThingManagerImplementation::browserItemDetails(const ThingId
         return result;
     }
 
-    plugin->browserItem(result);
+    callPlugin(plugin, "browserItem", result, [plugin, result](){
+        plugin->browserItem(result);
+    });
     connect(result, &BrowserItemResult::finished, this, [result](){
         if (result->status() != Thing::ThingErrorNoError) {
             qCWarning(dcThingManager()) << "Browsing thing failed:" << result->status();
@@ -878,7 +1037,9 @@ BrowserActionInfo* ThingManagerImplementation::executeBrowserItem(const BrowserA
         info->finish(Thing::ThingErrorUnsupportedFeature);
         return info;
     }
-    plugin->executeBrowserItem(info);
+    callPlugin(plugin, "executeBrowserItem", info, [plugin, info](){
+        plugin->executeBrowserItem(info);
+    });
     return info;
 }
 
@@ -912,7 +1073,9 @@ BrowserItemActionInfo* ThingManagerImplementation::executeBrowserItemAction(cons
     }
     // TODO: check browserItemAction.params with ThingClass
 
-    plugin->executeBrowserItemAction(info);
+    callPlugin(plugin, "executeBrowserItemAction", info, [plugin, info](){
+        plugin->executeBrowserItemAction(info);
+    });
     return info;
 }
 
@@ -1025,10 +1188,15 @@ Thing::ThingError ThingManagerImplementation::disconnectIO(const IOConnectionId
     }
     m_ioConnections.remove(ioConnectionId);
 
-    NymeaSettings settings(NymeaSettings::SettingsRoleIOConnections);
-    settings.beginGroup("IOConnections");
-    settings.remove(ioConnectionId.toString());
-    settings.endGroup();
+    {
+        NymeaSettings settings(NymeaSettings::SettingsRoleIOConnections);
+        settings.beginGroup("IOConnections");
+        settings.remove(ioConnectionId.toString());
+        settings.endGroup();
+    }
+    if (SettingsSnapshot::enabled()) {
+        saveIOConnectionsSnapshot();
+    }
 
     qCDebug(dcThingManager()) << "IO connection disconnected:" << ioConnectionId;
 
@@ -1230,7 +1398,9 @@ ThingActionInfo *ThingManagerImplementation::executeAction(const Action &action)
         return info;
     }
 
-    plugin->executeAction(info);
+    callPlugin(plugin, "executeAction", info, [plugin, info](){
+        plugin->executeAction(info);
+    });
 
     return info;
 }
@@ -1251,54 +1421,16 @@ void ThingManagerImplementation::loadPlugins()
             if (!fi.exists())
                 continue;
 
-            // Check plugin API version compatibility
-            QLibrary lib(fi.absoluteFilePath());
-            if (!lib.load()) {
-                qCWarning(dcThingManager()).nospace() << "Error loading plugin " << fi.absoluteFilePath() << ": " << lib.errorString();
-                continue;
-            }
-
-            QFunctionPointer versionFunc = lib.resolve("libnymea_api_version");
-            if (!versionFunc) {
-                qCWarning(dcThingManager()).nospace() << "Unable to resolve version in plugin " << fi.absoluteFilePath() << ". Not loading plugin.";
-                lib.unload();
-                continue;
-            }
-
-            QString version = reinterpret_cast<QString(*)()>(versionFunc)();
-            lib.unload();
-            QStringList parts = version.split('.');
-            QStringList coreParts = QString(LIBNYMEA_API_VERSION).split('.');
-            if (parts.length() != 3 || parts.at(0).toInt() != coreParts.at(0).toInt() || parts.at(1).toInt() > coreParts.at(1).toInt()) {
-                qCWarning(dcThingManager()).nospace() << "Libnymea API mismatch for " << fi.absoluteFilePath() << ". Core API: " << LIBNYMEA_API_VERSION << ", Plugin API: " << version;
+            if (m_lazyPluginLoading && registerDormantPlugin(fi.absoluteFilePath())) {
                 continue;
             }
 
-            // Version is ok. Now load the plugin
             QPluginLoader loader;
             loader.setFileName(fi.absoluteFilePath());
-            loader.setLoadHints(QLibrary::ResolveAllSymbolsHint);
 
-            qCDebug(dcThingManager()) << "Loading plugin from:" << fi.absoluteFilePath();
-            if (!loader.load()) {
-                qCWarning(dcThingManager) << "Could not load plugin data of" << entry << "\n" << loader.errorString();
-                continue;
-            }
-
-            QJsonObject pluginInfo = loader.metaData().value("MetaData").toObject();
-            PluginMetadata metaData(pluginInfo, false, false);
-            if (!metaData.isValid()) {
-                foreach (const QString &error, metaData.validationErrors()) {
-                    qCWarning(dcThingManager()) << error;
-                }
-                loader.unload();
-                continue;
-            }
-
-            IntegrationPlugin *pluginIface = qobject_cast<IntegrationPlugin *>(loader.instance());
+            PluginMetadata metaData;
+            IntegrationPlugin *pluginIface = instantiatePlugin(&loader, &metaData);
             if (!pluginIface) {
-                qCWarning(dcThingManager) << "Could not get plugin instance of" << entry;
-                loader.unload();
                 continue;
             }
             if (m_integrationPlugins.contains(pluginIface->pluginId())) {
@@ -1306,7 +1438,8 @@ void ThingManagerImplementation::loadPlugins()
                 continue;
             }
             loadPlugin(pluginIface, metaData);
-            PluginInfoCache::cachePluginInfo(pluginInfo);
+            startPluginThread(pluginIface);
+            PluginInfoCache::cachePluginInfo(loader.metaData().value("MetaData").toObject());
         }
     }
 
@@ -1348,10 +1481,224 @@ void ThingManagerImplementation::loadPlugins()
 #endif
 }
 
+IntegrationPlugin *ThingManagerImplementation::instantiatePlugin(QPluginLoader *loader, PluginMetadata *metaData)
+{
+    QString fileName = loader->fileName();
+
+    // Check plugin API version compatibility
+    QLibrary lib(fileName);
+    if (!lib.load()) {
+        qCWarning(dcThingManager()).nospace() << "Error loading plugin " << fileName << ": " << lib.errorString();
+        return nullptr;
+    }
+
+    QFunctionPointer versionFunc = lib.resolve("libnymea_api_version");
+    if (!versionFunc) {
+        qCWarning(dcThingManager()).nospace() << "Unable to resolve version in plugin " << fileName << ". Not loading plugin.";
+        lib.unload();
+        return nullptr;
+    }
+
+    QString version = reinterpret_cast<QString(*)()>(versionFunc)();
+    lib.unload();
+    QStringList parts = version.split('.');
+    QStringList coreParts = QString(LIBNYMEA_API_VERSION).split('.');
+    if (parts.length() != 3 || parts.at(0).toInt() != coreParts.at(0).toInt() || parts.at(1).toInt() > coreParts.at(1).toInt()) {
+        qCWarning(dcThingManager()).nospace() << "Libnymea API mismatch for " << fileName << ". Core API: " << LIBNYMEA_API_VERSION << ", Plugin API: " << version;
+        return nullptr;
+    }
+
+    // Version is ok. Now load the plugin
+    loader->setLoadHints(QLibrary::ResolveAllSymbolsHint);
+
+    qCDebug(dcThingManager()) << "Loading plugin from:" << fileName;
+    if (!loader->load()) {
+        qCWarning(dcThingManager) << "Could not load plugin data of" << fileName << "\n" << loader->errorString();
+        return nullptr;
+    }
+
+    QJsonObject pluginInfo = loader->metaData().value("MetaData").toObject();
+    *metaData = PluginMetadata(pluginInfo, false, false);
+    if (!metaData->isValid()) {
+        foreach (const QString &error, metaData->validationErrors()) {
+            qCWarning(dcThingManager()) << error;
+        }
+        loader->unload();
+        return nullptr;
+    }
+
+    IntegrationPlugin *pluginIface = qobject_cast<IntegrationPlugin *>(loader->instance());
+    if (!pluginIface) {
+        qCWarning(dcThingManager) << "Could not get plugin instance of" << fileName;
+        loader->unload();
+        return nullptr;
+    }
+    return pluginIface;
+}
+
+bool ThingManagerImplementation::registerDormantPlugin(const QString &fileName)
+{
+    // Reading the metadata does not dlopen() the library
+    QPluginLoader loader(fileName);
+    QJsonObject pluginInfo = loader.metaData().value("MetaData").toObject();
+    PluginMetadata metaData(pluginInfo, false, false);
+    if (!metaData.isValid() || m_integrationPlugins.contains(metaData.pluginId())) {
+        // Let the regular loading code deal with reporting errors
+        return false;
+    }
+
+    // Plugins creating things on their own need to be running all the time
+    foreach (const ThingClass &thingClass, metaData.thingClasses()) {
+        if (thingClass.createMethods().testFlag(ThingClass::CreateMethodAuto)) {
+            qCDebug(dcThingManager()) << "Plugin" << metaData.pluginName() << "creates things automatically. Not deferring plugin loading.";
+            return false;
+        }
+    }
+
+    // Register a placeholder which serves the metadata and plugin configuration until the plugin is needed
+    IntegrationPlugin *placeholder = new IntegrationPlugin(this);
+    loadPlugin(placeholder, metaData);
+    m_dormantPlugins.insert(metaData.pluginId(), fileName);
+    PluginInfoCache::cachePluginInfo(pluginInfo);
+    qCDebug(dcThingManager()) << "Deferred loading of plugin" << metaData.pluginName() << "from" << fileName;
+    return true;
+}
+
+IntegrationPlugin *ThingManagerImplementation::activatePlugin(const PluginId &pluginId)
+{
+    if (m_pluginLoaders.contains(pluginId)) {
+        m_pluginActivity[pluginId].start();
+    }
+
+    if (!m_dormantPlugins.contains(pluginId)) {
+        return m_integrationPlugins.value(pluginId);
+    }
+
+    QPluginLoader *loader = new QPluginLoader(m_dormantPlugins.value(pluginId), this);
+    PluginMetadata metaData;
+    IntegrationPlugin *pluginIface = instantiatePlugin(loader, &metaData);
+    if (!pluginIface || pluginIface->pluginId() != pluginId) {
+        qCWarning(dcThingManager()) << "Failed to activate plugin" << pluginId.toString() << "from" << loader->fileName();
+        delete loader;
+        return nullptr;
+    }
+
+    IntegrationPlugin *placeholder = m_integrationPlugins.take(pluginId);
+    placeholder->deleteLater();
+    m_dormantPlugins.remove(pluginId);
+
+    qCDebug(dcThingManager()) << "Activating plugin" << metaData.pluginName();
+    loadPlugin(pluginIface, metaData);
+    startPluginThread(pluginIface);
+    m_pluginLoaders.insert(pluginId, loader);
+    m_pluginActivity[pluginId].start();
+    return pluginIface;
+}
+
+void ThingManagerImplementation::startPluginThread(IntegrationPlugin *plugin)
+{
+    if (!plugin->m_metaData.isThreaded())
+        return;
+
+    qCDebug(dcThingManager()) << "Starting thread for plugin" << plugin->pluginName();
+    PluginThread *pluginThread = new PluginThread(plugin, this);
+    pluginThread->start();
+    m_pluginThreads.insert(plugin, pluginThread);
+}
+
+void ThingManagerImplementation::stopPluginThread(IntegrationPlugin *plugin, std::function<void()> stopped)
+{
+    PluginThread *pluginThread = m_pluginThreads.value(plugin);
+    if (!pluginThread) {
+        stopped();
+        return;
+    }
+
+    qCDebug(dcThingManager()) << "Stopping thread of plugin" << plugin->pluginName();
+    connect(pluginThread, &PluginThread::finished, this, [this, plugin, pluginThread, stopped](){
+        m_pluginThreads.remove(plugin);
+        plugin->setParent(this);
+        pluginThread->deleteLater();
+        stopped();
+    });
+    pluginThread->stop();
+}
+
+void ThingManagerImplementation::callPlugin(IntegrationPlugin *plugin, const char *entryPoint, std::function<void()> call, std::function<void()> done)
+{
+    // Always wrapped, the measurement tracks the plugin owning resources registered in the call even while disabled
+    if (entryPoint) {
+        std::function<void()> unmeasuredCall = call;
+        QString pluginName = plugin->pluginName();
+        call = [unmeasuredCall, pluginName, entryPoint](){
+            PerformanceMeasurement measurement(PerformanceEntry::PerformanceCategoryPlugin, pluginName, QString::fromLatin1(entryPoint));
+            unmeasuredCall();
+        };
+    }
+
+    PluginThread *pluginThread = m_pluginThreads.value(plugin);
+    if (!pluginThread) {
+        call();
+        if (done) {
+            done();
+        }
+        return;
+    }
+
+    if (!done) {
+        pluginThread->post(call);
+        return;
+    }
+
+    pluginThread->post([this, call, done](){
+        call();
+        QTimer::singleShot(0, this, done);
+    });
+}
+
+template <typename Info>
+void ThingManagerImplementation::callPlugin(IntegrationPlugin *plugin, const char *entryPoint, Info *info, std::function<void()> call)
+{
+    if (m_pluginThreads.contains(plugin)) {
+        // The plugin thread may still use the info after it finished, i.e. when it timed out. The info
+        // lives in this thread, plugins finishing it are marshalled in here, and it is deleted once the
+        // plugin thread has processed everything it got up to then.
+        disconnect(info, &Info::finished, info, &Info::deleteLater);
+        QSharedPointer<bool> released(new bool(false));
+        connect(info, &Info::finished, this, [this, plugin, info, released](){
+            if (*released)
+                return;
+
+            *released = true;
+            deleteAfterPlugin(plugin, info);
+        }, Qt::QueuedConnection);
+    }
+
+    callPlugin(plugin, entryPoint, call);
+}
+
+void ThingManagerImplementation::deleteAfterPlugin(IntegrationPlugin *plugin, QObject *object)
+{
+    PluginThread *pluginThread = m_pluginThreads.value(plugin);
+    if (!pluginThread) {
+        object->deleteLater();
+        return;
+    }
+
+    // Calls and signals queued to the plugin thread until now may still use the object
+    pluginThread->post([object](){
+        object->deleteLater();
+    });
+}
+
 void ThingManagerImplementation::loadPlugin(IntegrationPlugin *pluginIface, const PluginMetadata &metaData)
 {
     pluginIface->setParent(this);
-    pluginIface->initPlugin(metaData, this, m_hardwareManager);
+    {
+        // Plugins usually register their timers in init(), this attributes them to the plugin
+        PerformanceMeasurement measurement(PerformanceEntry::PerformanceCategoryPlugin, metaData.pluginName(), QStringLiteral("init"));
+        pluginIface->initPlugin(metaData, this, m_hardwareManager);
+    }
 
     qCDebug(dcThingManager) << "**** Loaded plugin" << pluginIface->pluginName();
     foreach (const Vendor &vendor, pluginIface->supportedVendors()) {
@@ -1367,7 +1714,9 @@ void ThingManagerImplementation::loadPlugin(IntegrationPlugin *pluginIface, cons
             qCWarning(dcThingManager) << "Vendor not found. Ignoring thing. VendorId:" << thingClass.vendorId() << "ThingClass:" << thingClass.name() << thingClass.id();
             continue;
         }
-        m_vendorThingMap[thingClass.vendorId()].append(thingClass.id());
+        if (!m_vendorThingMap[thingClass.vendorId()].contains(thingClass.id())) {
+            m_vendorThingMap[thingClass.vendorId()].append(thingClass.id());
+        }
         m_supportedThings.insert(thingClass.id(), thingClass);
         qCDebug(dcThingManager) << "* Loaded thing class:" << thingClass.name();
     }
@@ -1430,6 +1779,55 @@ void ThingManagerImplementation::loadPlugin(IntegrationPlugin *pluginIface, cons
 }
 
 void ThingManagerImplementation::loadConfiguredThings()
+{
+    if (SettingsSnapshot::enabled()) {
+        loadThingStatesSnapshot();
+    }
+
+    if (!SettingsSnapshot::enabled() || !loadConfiguredThingsSnapshot()) {
+        loadConfiguredThingsSettings();
+        if (SettingsSnapshot::enabled()) {
+            saveConfiguredThingsSnapshot();
+        }
+    }
+
+    QHash<ThingId, Thing*> setupList = m_configuredThings;
+    while (!setupList.isEmpty()) {
+        Thing *thing = nullptr;
+        foreach (Thing *d, setupList) {
+            if (d->parentId().isNull() || !setupList.contains(d->parentId())) {
+                thing = d;
+                setupList.take(d->id());
+                break;
+            }
+        }
+        Q_ASSERT(thing != nullptr);
+
+        thing->setSetupStatus(Thing::ThingSetupStatusInProgress, Thing::ThingErrorNoError);
+        ThingSetupInfo *info = setupThing(thing);
+        // Set receiving object to "thing" because at startup we load it in any case, knowing that it worked at
+        // some point. However, it'll be marked as non-working until the setup succeeds so the user might delete
+        // it in the meantime... In that case we don't want to call postsetup on it.
+        connect(info, &ThingSetupInfo::finished, thing, [this, info](){
+
+            if (info->status() != Thing::ThingErrorNoError) {
+                qCWarning(dcThingManager()) << "Error setting up thing" << info->thing()->name() << info->thing()->id().toString() << info->status() << info->displayMessage();
+                info->thing()->setSetupStatus(Thing::ThingSetupStatusFailed, info->status(), info->displayMessage());
+                emit thingChanged(info->thing());
+                return;
+            }
+
+            qCDebug(dcThingManager()) << "Setup complete for thing" << info->thing();
+            info->thing()->setSetupStatus(Thing::ThingSetupStatusComplete, Thing::ThingErrorNoError);
+            emit thingChanged(info->thing());
+            postSetupThing(info->thing());
+        });
+    }
+
+    loadIOConnections();
+}
+
+void ThingManagerImplementation::loadConfiguredThingsSettings()
 {
     bool needsMigration = false;
     NymeaSettings settings(NymeaSettings::SettingsRoleThings);
@@ -1447,40 +1845,14 @@ void ThingManagerImplementation::loadConfiguredThings()
             thingName = settings.value("devicename").toString();
         }
         PluginId pluginId = PluginId(settings.value("pluginid").toString());
-        IntegrationPlugin *plugin = m_integrationPlugins.value(pluginId);
-        if (!plugin) {
-            qCWarning(dcThingManager()) << "Plugin for thing" << thingName << idString << "not found. This thing will not be functional until the plugin can be loaded.";
-        }
         ThingClassId thingClassId = ThingClassId(settings.value("thingClassId").toString());
         // If ThingClassId isn't found in the config, retry with ThingClassId (nymea < 0.20)
         if (thingClassId.isNull()) {
             thingClassId = ThingClassId(settings.value("deviceClassId").toString());
         }
-        ThingClass thingClass = findThingClass(thingClassId);
+        ThingClass thingClass = loadStoredThingClass(pluginId, thingClassId, thingName, idString);
         if (!thingClass.isValid()) {
-            // Try to load the device class from the cache
-            QJsonObject pluginInfo = PluginInfoCache::loadPluginInfo(pluginId);
-            if (!pluginInfo.empty()) {
-                PluginMetadata pluginMetadata(pluginInfo, false, false);
-                thingClass = pluginMetadata.thingClasses().findById(thingClassId);
-                if (thingClass.isValid()) {
-                    m_supportedThings.insert(thingClassId, thingClass);
-                    if (!m_supportedVendors.contains(thingClass.vendorId())) {
-                        Vendor vendor = pluginMetadata.vendors().findById(thingClass.vendorId());
-                        m_supportedVendors.insert(vendor.id(), vendor);
-                    }
-                }
-            }
-        }
-        if (!thingClass.isValid()) {
-            qCWarning(dcThingManager()) << "Not loading thing" << thingName << idString << "because the thing class for this thing could not be found.";
-            settings.endGroup(); // ThingId
-            continue;
-        }
-
-        // Cross-check if this plugin still implements this thing class
-        if (plugin && !plugin->supportedThings().contains(thingClass)) {
-            qCWarning(dcThingManager()) << "Not loading thing" << thingName << idString << "because plugin" << plugin->pluginName() << "has removed support for it.";
+            m_skippedStoredThings = true;
             settings.endGroup(); // ThingId
             continue;
         }
@@ -1556,14 +1928,7 @@ void ThingManagerImplementation::loadConfiguredThings()
         settings.endGroup(); // Settings
         settings.endGroup(); // ThingId
 
-        // We always add the thing to the list in this case. If it's in the stored things
-        // it means that it was working at some point so lets still add it as there might
-        // be rules associated with this thing.
-        m_configuredThings.insert(thing->id(), thing);
-
-        emit thingAdded(thing);
-
-        connect(thing, &Thing::eventTriggered, this, &ThingManagerImplementation::onEventTriggered);
+        registerStoredThing(thing);
     }
     settings.endGroup();
 
@@ -1571,87 +1936,274 @@ void ThingManagerImplementation::loadConfiguredThings()
         storeConfiguredThings();
         settings.remove("DeviceConfig");
     }
+}
 
-
-    QHash<ThingId, Thing*> setupList = m_configuredThings;
-    while (!setupList.isEmpty()) {
-        Thing *thing = nullptr;
-        foreach (Thing *d, setupList) {
-            if (d->parentId().isNull() || !setupList.contains(d->parentId())) {
-                thing = d;
-                setupList.take(d->id());
-                break;
+ThingClass ThingManagerImplementation::loadStoredThingClass(const PluginId &pluginId, const ThingClassId &thingClassId, const QString &thingName, const QString &idString)
+{
+    IntegrationPlugin *plugin = m_integrationPlugins.value(pluginId);
+    if (!plugin) {
+        qCWarning(dcThingManager()) << "Plugin for thing" << thingName << idString << "not found. This thing will not be functional until the plugin can be loaded.";
+    }
+    ThingClass thingClass = findThingClass(thingClassId);
+    if (!thingClass.isValid()) {
+        // Try to load the device class from the cache
+        QJsonObject pluginInfo = PluginInfoCache::loadPluginInfo(pluginId);
+        if (!pluginInfo.empty()) {
+            PluginMetadata pluginMetadata(pluginInfo, false, false);
+            thingClass = pluginMetadata.thingClasses().findById(thingClassId);
+            if (thingClass.isValid()) {
+                m_supportedThings.insert(thingClassId, thingClass);
+                if (!m_supportedVendors.contains(thingClass.vendorId())) {
+                    Vendor vendor = pluginMetadata.vendors().findById(thingClass.vendorId());
+                    m_supportedVendors.insert(vendor.id(), vendor);
+                }
             }
         }
-        Q_ASSERT(thing != nullptr);
+    }
+    if (!thingClass.isValid()) {
+        qCWarning(dcThingManager()) << "Not loading thing" << thingName << idString << "because the thing class for this thing could not be found.";
+        return ThingClass();
+    }
 
-        thing->setSetupStatus(Thing::ThingSetupStatusInProgress, Thing::ThingErrorNoError);
-        ThingSetupInfo *info = setupThing(thing);
-        // Set receiving object to "thing" because at startup we load it in any case, knowing that it worked at
-        // some point. However, it'll be marked as non-working until the setup succeeds so the user might delete
-        // it in the meantime... In that case we don't want to call postsetup on it.
-        connect(info, &ThingSetupInfo::finished, thing, [this, info](){
+    // Cross-check if this plugin still implements this thing class
+    if (plugin && !plugin->supportedThings().contains(thingClass)) {
+        qCWarning(dcThingManager()) << "Not loading thing" << thingName << idString << "because plugin" << plugin->pluginName() << "has removed support for it.";
+        return ThingClass();
+    }
+    return thingClass;
+}
 
-            if (info->status() != Thing::ThingErrorNoError) {
-                qCWarning(dcThingManager()) << "Error setting up thing" << info->thing()->name() << info->thing()->id().toString() << info->status() << info->displayMessage();
-                info->thing()->setSetupStatus(Thing::ThingSetupStatusFailed, info->status(), info->displayMessage());
-                emit thingChanged(info->thing());
-                return;
+void ThingManagerImplementation::registerStoredThing(Thing *thing)
+{
+    // We always add the thing to the list in this case. If it's in the stored things
+    // it means that it was working at some point so lets still add it as there might
+    // be rules associated with this thing.
+    m_configuredThings.insert(thing->id(), thing);
+
+    emit thingAdded(thing);
+
+    connect(thing, &Thing::eventTriggered, this, &ThingManagerImplementation::onEventTriggered);
+}
+
+bool ThingManagerImplementation::loadConfiguredThingsSnapshot()
+{
+    SettingsSnapshot snapshot(NymeaSettings::SettingsRoleThings, 1);
+    if (!snapshot.load()) {
+        return false;
+    }
+    qCDebug(dcThingManager()) << "Loading things from snapshot";
+
+    QDataStream stream(snapshot.data());
+    quint32 count;
+    stream >> count;
+    QList<Thing*> things;
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; i++) {
+        QUuid id, pluginId, thingClassId, parentId;
+        QString thingName;
+        bool autoCreated;
+        stream >> id >> pluginId >> thingClassId >> parentId >> thingName >> autoCreated;
+        ParamList params = readParams(stream);
+        ParamList thingSettings = readParams(stream);
+
+        // The snapshot only holds loadable things. If one can't be resolved any more, the settings
+        // file has to be loaded so the skipped thing is kept there.
+        ThingClass thingClass = loadStoredThingClass(pluginId, thingClassId, thingName, id.toString());
+        if (!thingClass.isValid()) {
+            qCWarning(dcThingManager()) << "Things snapshot contains a thing which can't be loaded. Falling back to settings.";
+            qDeleteAll(things);
+            return false;
+        }
+
+        Thing *thing = new Thing(pluginId, thingClass, id, this);
+        thing->m_autoCreated = autoCreated;
+        thing->setName(thingName);
+        thing->setParentId(parentId);
+
+        // Make sure all params are around. if they aren't initialize with default values
+        foreach (const ParamType &paramType, thingClass.paramTypes()) {
+            if (!params.hasParam(paramType.id())) {
+                params.append(Param(paramType.id(), paramType.defaultValue()));
             }
+        }
+        thing->setParams(params);
+        thing->setSettings(buildParams(thingClass.settingsTypes(), thingSettings));
+        things.append(thing);
+    }
 
-            qCDebug(dcThingManager()) << "Setup complete for thing" << info->thing();
-            info->thing()->setSetupStatus(Thing::ThingSetupStatusComplete, Thing::ThingErrorNoError);
-            emit thingChanged(info->thing());
-            postSetupThing(info->thing());
-        });
+    if (stream.status() != QDataStream::Ok) {
+        qCWarning(dcThingManager()) << "Error reading things snapshot. Falling back to settings.";
+        qDeleteAll(things);
+        return false;
     }
 
-    loadIOConnections();
+    foreach (Thing *thing, things) {
+        registerStoredThing(thing);
+    }
+    return true;
 }
 
-void ThingManagerImplementation::storeConfiguredThings()
+void ThingManagerImplementation::saveConfiguredThingsSnapshot()
 {
-    NymeaSettings settings(NymeaSettings::SettingsRoleThings);
-    settings.beginGroup("ThingConfig");
+    if (m_skippedStoredThings) {
+        // The snapshot would hold less than the settings file. Make sure a stale one is never used.
+        SettingsSnapshot(NymeaSettings::SettingsRoleThings, 1).remove();
+        return;
+    }
+
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream << static_cast<quint32>(m_configuredThings.count());
     foreach (Thing *thing, m_configuredThings) {
-        settings.beginGroup(thing->id().toString());
-        // Note: clean thing settings before storing it for clean up
-        settings.remove("");
-        settings.setValue("autoCreated", thing->autoCreated());
-        settings.setValue("thingName", thing->name());
-        settings.setValue("thingClassId", thing->thingClassId().toString());
-        settings.setValue("pluginid", thing->pluginId().toString());
-        if (!thing->parentId().isNull())
-            settings.setValue("parentid", thing->parentId().toString());
+        stream << thing->id() << thing->pluginId() << thing->thingClassId() << thing->parentId() << thing->name() << thing->autoCreated();
+        writeParams(stream, thing->params());
+        writeParams(stream, thing->settings());
+    }
+    SettingsSnapshot(NymeaSettings::SettingsRoleThings, 1).save(data);
+}
 
-        settings.beginGroup("Params");
-        foreach (const Param &param, thing->params()) {
-            settings.beginGroup(param.paramTypeId().toString());
-            settings.setValue("type", static_cast<int>(param.value().type()));
-            settings.setValue("value", param.value());
-            settings.endGroup(); // ParamTypeId
+void ThingManagerImplementation::loadThingStatesSnapshot()
+{
+    SettingsSnapshot snapshot(NymeaSettings::SettingsRoleThingStates, 1);
+    if (!snapshot.load()) {
+        return;
+    }
+
+    QDataStream stream(snapshot.data());
+    quint32 count;
+    stream >> count;
+    QHash<ThingId, QHash<StateTypeId, QVariant> > states;
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; i++) {
+        QUuid thingId;
+        quint32 stateCount;
+        stream >> thingId >> stateCount;
+        QHash<StateTypeId, QVariant> thingStates;
+        for (quint32 j = 0; j < stateCount && stream.status() == QDataStream::Ok; j++) {
+            QUuid stateTypeId;
+            QVariant value;
+            stream >> stateTypeId >> value;
+            thingStates.insert(stateTypeId, value);
         }
-        settings.endGroup(); // Params
+        states.insert(thingId, thingStates);
+    }
 
-        settings.beginGroup("Settings");
-        foreach (const Param &param, thing->settings()) {
-            settings.beginGroup(param.paramTypeId().toString());
-            settings.setValue("type", static_cast<int>(param.value().type()));
-            settings.setValue("value", param.value());
-            settings.endGroup(); // ParamTypeId
+    if (stream.status() != QDataStream::Ok) {
+        qCWarning(dcThingManager()) << "Error reading thing states snapshot. Falling back to settings.";
+        return;
+    }
+    m_thingStatesSnapshot = states;
+}
+
+void ThingManagerImplementation::saveThingStatesSnapshot()
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream << static_cast<quint32>(m_configuredThings.count());
+    foreach (Thing *thing, m_configuredThings) {
+        QList<State> cachedStates;
+        foreach (const StateType &stateType, m_supportedThings.value(thing->thingClassId()).stateTypes()) {
+            if (stateType.cached()) {
+                cachedStates.append(thing->state(stateType.id()));
+            }
         }
-        settings.endGroup(); // Settings
+        stream << thing->id() << static_cast<quint32>(cachedStates.count());
+        foreach (const State &state, cachedStates) {
+            stream << state.stateTypeId() << state.value();
+        }
+    }
+    SettingsSnapshot(NymeaSettings::SettingsRoleThingStates, 1).save(data);
+}
+
+bool ThingManagerImplementation::loadIOConnectionsSnapshot()
+{
+    SettingsSnapshot snapshot(NymeaSettings::SettingsRoleIOConnections, 1);
+    if (!snapshot.load()) {
+        return false;
+    }
 
+    QDataStream stream(snapshot.data());
+    quint32 count;
+    stream >> count;
+    QList<IOConnection> ioConnections;
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; i++) {
+        QUuid id, inputThingId, inputStateTypeId, outputThingId, outputStateTypeId;
+        bool inverted;
+        stream >> id >> inputThingId >> inputStateTypeId >> outputThingId >> outputStateTypeId >> inverted;
+        ioConnections.append(IOConnection(id, inputThingId, inputStateTypeId, outputThingId, outputStateTypeId, inverted));
+    }
 
-        settings.endGroup(); // ThingId
+    if (stream.status() != QDataStream::Ok) {
+        qCWarning(dcThingManager()) << "Error reading IO connections snapshot. Falling back to settings.";
+        return false;
+    }
+
+    foreach (const IOConnection &ioConnection, ioConnections) {
+        m_ioConnections.insert(ioConnection.id(), ioConnection);
+    }
+    return true;
+}
+
+void ThingManagerImplementation::saveIOConnectionsSnapshot()
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream << static_cast<quint32>(m_ioConnections.count());
+    foreach (const IOConnection &ioConnection, m_ioConnections) {
+        stream << ioConnection.id() << ioConnection.inputThingId() << ioConnection.inputStateTypeId();
+        stream << ioConnection.outputThingId() << ioConnection.outputStateTypeId() << ioConnection.inverted();
+    }
+    SettingsSnapshot(NymeaSettings::SettingsRoleIOConnections, 1).save(data);
+}
+
+void ThingManagerImplementation::storeConfiguredThings()
+{
+    {
+        NymeaSettings settings(NymeaSettings::SettingsRoleThings);
+        settings.beginGroup("ThingConfig");
+        foreach (Thing *thing, m_configuredThings) {
+            settings.beginGroup(thing->id().toString());
+            // Note: clean thing settings before storing it for clean up
+            settings.remove("");
+            settings.setValue("autoCreated", thing->autoCreated());
+            settings.setValue("thingName", thing->name());
+            settings.setValue("thingClassId", thing->thingClassId().toString());
+            settings.setValue("pluginid", thing->pluginId().toString());
+            if (!thing->parentId().isNull())
+                settings.setValue("parentid", thing->parentId().toString());
+
+            settings.beginGroup("Params");
+            foreach (const Param &param, thing->params()) {
+                settings.beginGroup(param.paramTypeId().toString());
+                settings.setValue("type", static_cast<int>(param.value().type()));
+                settings.setValue("value", param.value());
+                settings.endGroup(); // ParamTypeId
+            }
+            settings.endGroup(); // Params
+
+            settings.beginGroup("Settings");
+            foreach (const Param &param, thing->settings()) {
+                settings.beginGroup(param.paramTypeId().toString());
+                settings.setValue("type", static_cast<int>(param.value().type()));
+                settings.setValue("value", param.value());
+                settings.endGroup(); // ParamTypeId
+            }
+            settings.endGroup(); // Settings
+
+
+            settings.endGroup(); // ThingId
+        }
+        settings.endGroup(); // ThingConfig
+    }
+    if (SettingsSnapshot::enabled()) {
+        saveConfiguredThingsSnapshot();
     }
-    settings.endGroup(); // ThingConfig
 }
 
 void ThingManagerImplementation::startMonitoringAutoThings()
 {
     foreach (IntegrationPlugin *plugin, m_integrationPlugins) {
-        plugin->startMonitoringAutoThings();
+        callPlugin(plugin, "startMonitoringAutoThings", [plugin](){
+            plugin->startMonitoringAutoThings();
+        });
     }
 }
 
@@ -1705,7 +2257,7 @@ void ThingManagerImplementation::onAutoThingsAppeared(const ThingDescriptors &th
 
             if (info->status() != Thing::ThingErrorNoError) {
                 qCWarning(dcThingManager) << "Thing setup failed. Not adding auto thing to system.";
-                info->thing()->deleteLater();
+                deleteAfterPlugin(m_integrationPlugins.value(info->thing()->pluginId()), info->thing());
                 return;
             }
 
@@ -1783,6 +2335,72 @@ void ThingManagerImplementation::onEventTriggered(const Event &event)
     emit eventTriggered(event);
 }
 
+void ThingManagerImplementation::unloadIdlePlugins()
+{
+    // Unload lazily activated plugins which have no things and weren't used for a while
+    foreach (const PluginId &pluginId, m_pluginLoaders.keys()) {
+        if (m_pluginActivity.value(pluginId).elapsed() < m_pluginIdleTimeout) {
+            continue;
+        }
+
+        bool inUse = false;
+        foreach (Thing *thing, m_configuredThings) {
+            if (thing->pluginId() == pluginId) {
+                inUse = true;
+                break;
+            }
+        }
+        foreach (const PairingContext &context, m_pendingPairings) {
+            if (m_supportedThings.value(context.thingClassId).pluginId() == pluginId) {
+                inUse = true;
+                break;
+            }
+        }
+        if (inUse) {
+            continue;
+        }
+
+        IntegrationPlugin *plugin = m_integrationPlugins.take(pluginId);
+        QPluginLoader *loader = m_pluginLoaders.take(pluginId);
+        m_pluginActivity.remove(pluginId);
+        PluginMetadata metaData = plugin->m_metaData;
+        QString fileName = loader->fileName();
+
+        qCDebug(dcThingManager()) << "Unloading idle plugin" << plugin->pluginName();
+        stopPluginThread(plugin, [plugin, loader, fileName](){
+            delete plugin;
+            if (!loader->unload()) {
+                qCWarning(dcThingManager()) << "Could not unload plugin library" << fileName << loader->errorString();
+            }
+            delete loader;
+        });
+
+        IntegrationPlugin *placeholder = new IntegrationPlugin(this);
+        loadPlugin(placeholder, metaData);
+        m_dormantPlugins.insert(pluginId, fileName);
+    }
+}
+
+void ThingManagerImplementation::writeMetrics(MetricsWriter *writer) const
+{
+    QHash<PluginId, int> thingCounts;
+    foreach (Thing *thing, m_configuredThings) {
+        thingCounts[thing->pluginId()]++;
+    }
+
+    QList<QPair<MetricsLabels, double> > things;
+    QList<QPair<MetricsLabels, quint64> > stateChanges;
+    foreach (IntegrationPlugin *plugin, m_integrationPlugins) {
+        MetricsLabels labels;
+        labels.insert("plugin", plugin->pluginName());
+        things.append(qMakePair(labels, static_cast<double>(thingCounts.value(plugin->pluginId()))));
+        QSharedPointer<MetricsCounter> stateChangeCounter = m_stateChangeCounters.value(plugin->pluginId());
+        stateChanges.append(qMakePair(labels, stateChangeCounter ? stateChangeCounter->value() : 0));
+    }
+    writer->writeGauge("nymea_things", "Number of configured things per plugin.", things);
+    writer->writeCounter("nymea_thing_state_changes_total", "Number of state changes per plugin.", stateChanges);
+}
+
 void ThingManagerImplementation::slotThingStateValueChanged(const StateTypeId &stateTypeId, const QVariant &value)
 {
     Thing *thing = qobject_cast<Thing*>(sender());
@@ -1792,6 +2410,12 @@ void ThingManagerImplementation::slotThingStateValueChanged(const StateTypeId &s
     }
     storeThingStates(thing);
 
+    QSharedPointer<MetricsCounter> &stateChangeCounter = m_stateChangeCounters[thing->pluginId()];
+    if (!stateChangeCounter) {
+        stateChangeCounter.reset(new MetricsCounter());
+    }
+    stateChangeCounter->increment();
+
     emit thingStateChanged(thing, stateTypeId, value);
 
     Param valueParam(ParamTypeId(stateTypeId.toString()), value);
@@ -1801,6 +2425,33 @@ void ThingManagerImplementation::slotThingStateValueChanged(const StateTypeId &s
     syncIOConnection(thing, stateTypeId);
 }
 
+QByteArray ThingManagerImplementation::discoveryCacheKey(const ThingClassId &thingClassId, const ParamList &params) const
+{
+    // The params are built from the discovery param types of the thing class and therefore always in the same order
+    QByteArray key;
+    QDataStream stream(&key, QIODevice::WriteOnly);
+    stream << thingClassId;
+    writeParams(stream, params);
+    return key;
+}
+
+void ThingManagerImplementation::invalidateDiscoveryCache(const PluginId &pluginId)
+{
+    if (pluginId.isNull()) {
+        m_discoveryCache.clear();
+        return;
+    }
+
+    QHash<QByteArray, DiscoveryCacheEntry>::iterator it = m_discoveryCache.begin();
+    while (it != m_discoveryCache.end()) {
+        if (it.value().pluginId == pluginId) {
+            it = m_discoveryCache.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
 void ThingManagerImplementation::syncIOConnection(Thing *thing, const StateTypeId &stateTypeId)
 {
 
@@ -1971,14 +2622,16 @@ void ThingManagerImplementation::pairThingInternal(ThingPairingInfo *info)
         return;
     }
 
-    IntegrationPlugin *plugin = m_integrationPlugins.value(thingClass.pluginId());
+    IntegrationPlugin *plugin = activatePlugin(thingClass.pluginId());
     if (!plugin) {
         qCWarning(dcThingManager) << "Cannot pair thing class" << thingClass.name() << "because no plugin for it is loaded.";
         info->finish(Thing::ThingErrorPluginNotFound);
         return;
     }
 
-    plugin->startPairing(info);
+    callPlugin(plugin, "startPairing", info, [plugin, info](){
+        plugin->startPairing(info);
+    });
 
     connect(info, &ThingPairingInfo::finished, this, [this, info, thingClass](){
         if (info->status() != Thing::ThingErrorNoError) {
@@ -2002,7 +2655,7 @@ void ThingManagerImplementation::pairThingInternal(ThingPairingInfo *info)
 ThingSetupInfo* ThingManagerImplementation::setupThing(Thing *thing)
 {
     ThingClass thingClass = findThingClass(thing->thingClassId());
-    IntegrationPlugin *plugin = m_integrationPlugins.value(thingClass.pluginId());
+    IntegrationPlugin *plugin = activatePlugin(thingClass.pluginId());
 
     if (!plugin) {
         qCWarning(dcThingManager) << "Can't find a plugin for this thing" << thing;
@@ -2025,7 +2678,9 @@ ThingSetupInfo* ThingManagerImplementation::setupThing(Thing *thing)
 
 
     ThingSetupInfo *info = new ThingSetupInfo(thing, this, 30000);
-    plugin->setupThing(info);
+    callPlugin(plugin, "setupThing", info, [plugin, info](){
+        plugin->setupThing(info);
+    });
 
     return info;
 }
@@ -2035,11 +2690,26 @@ void ThingManagerImplementation::postSetupThing(Thing *thing)
     ThingClass thingClass = findThingClass(thing->thingClassId());
     IntegrationPlugin *plugin = m_integrationPlugins.value(thingClass.pluginId());
 
-    plugin->postSetupThing(thing);
+    callPlugin(plugin, "postSetupThing", [plugin, thing](){
+        plugin->postSetupThing(thing);
+    });
 }
 
 void ThingManagerImplementation::loadThingStates(Thing *thing)
 {
+    if (m_thingStatesSnapshot.contains(thing->id())) {
+        QHash<StateTypeId, QVariant> snapshotStates = m_thingStatesSnapshot.take(thing->id());
+        ThingClass thingClass = m_supportedThings.value(thing->thingClassId());
+        foreach (const StateType &stateType, thingClass.stateTypes()) {
+            if (stateType.cached()) {
+                thing->setStateValue(stateType.id(), snapshotStates.value(stateType.id(), stateType.defaultValue()));
+            } else {
+                thing->setStateValue(stateType.id(), stateType.defaultValue());
+            }
+        }
+        return;
+    }
+
     NymeaSettings settings(NymeaSettings::SettingsRoleThingStates);
     settings.beginGroup(thing->id().toString());
     ThingClass thingClass = m_supportedThings.value(thing->thingClassId());
@@ -2065,45 +2735,65 @@ void ThingManagerImplementation::loadThingStates(Thing *thing)
 
 void ThingManagerImplementation::storeIOConnections()
 {
-    NymeaSettings connectionSettings(NymeaSettings::SettingsRoleIOConnections);
-    connectionSettings.beginGroup("IOConnections");
-    foreach (const IOConnection &ioConnection, m_ioConnections) {
-        connectionSettings.beginGroup(ioConnection.id().toString());
+    {
+        NymeaSettings connectionSettings(NymeaSettings::SettingsRoleIOConnections);
+        connectionSettings.beginGroup("IOConnections");
+        foreach (const IOConnection &ioConnection, m_ioConnections) {
+            connectionSettings.beginGroup(ioConnection.id().toString());
 
-        connectionSettings.setValue("inputThingId", ioConnection.inputThingId().toString());
-        connectionSettings.setValue("inputStateTypeId", ioConnection.inputStateTypeId().toString());
-        connectionSettings.setValue("outputThingId", ioConnection.outputThingId().toString());
-        connectionSettings.setValue("outputStateTypeId", ioConnection.outputStateTypeId().toString());
-        connectionSettings.setValue("inverted", ioConnection.inverted());
+            connectionSettings.setValue("inputThingId", ioConnection.inputThingId().toString());
+            connectionSettings.setValue("inputStateTypeId", ioConnection.inputStateTypeId().toString());
+            connectionSettings.setValue("outputThingId", ioConnection.outputThingId().toString());
+            connectionSettings.setValue("outputStateTypeId", ioConnection.outputStateTypeId().toString());
+            connectionSettings.setValue("inverted", ioConnection.inverted());
 
+            connectionSettings.endGroup();
+        }
         connectionSettings.endGroup();
     }
-    connectionSettings.endGroup();
+    if (SettingsSnapshot::enabled()) {
+        saveIOConnectionsSnapshot();
+    }
 }
 
 void ThingManagerImplementation::loadIOConnections()
 {
-    NymeaSettings connectionSettings(NymeaSettings::SettingsRoleIOConnections);
-    connectionSettings.beginGroup("IOConnections");
-    foreach (const QString &idString, connectionSettings.childGroups()) {
-        connectionSettings.beginGroup(idString);
-        IOConnectionId id(idString);
-        ThingId inputThingId = connectionSettings.value("inputThingId").toUuid();
-        StateTypeId inputStateTypeId = connectionSettings.value("inputStateTypeId").toUuid();
-        ThingId outputThingId = connectionSettings.value("outputThingId").toUuid();
-        StateTypeId outputStateTypeId = connectionSettings.value("outputStateTypeId").toUuid();
-        bool inverted = connectionSettings.value("inverted").toBool();
-        IOConnection ioConnection(id, inputThingId, inputStateTypeId, outputThingId, outputStateTypeId, inverted);
-        m_ioConnections.insert(id, ioConnection);
-        connectionSettings.endGroup();
+    if (SettingsSnapshot::enabled() && loadIOConnectionsSnapshot()) {
+        foreach (const IOConnection &ioConnection, m_ioConnections) {
+            Thing *inputThing = m_configuredThings.value(ioConnection.inputThingId());
+            if (inputThing) {
+                syncIOConnection(inputThing, ioConnection.inputStateTypeId());
+            }
+        }
+        return;
+    }
 
-        Thing *inputThing = m_configuredThings.value(inputThingId);
-        if (!inputThing) {
-            continue;
+    {
+        NymeaSettings connectionSettings(NymeaSettings::SettingsRoleIOConnections);
+        connectionSettings.beginGroup("IOConnections");
+        foreach (const QString &idString, connectionSettings.childGroups()) {
+            connectionSettings.beginGroup(idString);
+            IOConnectionId id(idString);
+            ThingId inputThingId = connectionSettings.value("inputThingId").toUuid();
+            StateTypeId inputStateTypeId = connectionSettings.value("inputStateTypeId").toUuid();
+            ThingId outputThingId = connectionSettings.value("outputThingId").toUuid();
+            StateTypeId outputStateTypeId = connectionSettings.value("outputStateTypeId").toUuid();
+            bool inverted = connectionSettings.value("inverted").toBool();
+            IOConnection ioConnection(id, inputThingId, inputStateTypeId, outputThingId, outputStateTypeId, inverted);
+            m_ioConnections.insert(id, ioConnection);
+            connectionSettings.endGroup();
+
+            Thing *inputThing = m_configuredThings.value(inputThingId);
+            if (!inputThing) {
+                continue;
+            }
+            syncIOConnection(inputThing, inputStateTypeId);
         }
-        syncIOConnection(inputThing, inputStateTypeId);
+        connectionSettings.endGroup();
+    }
+    if (SettingsSnapshot::enabled()) {
+        saveIOConnectionsSnapshot();
     }
-    connectionSettings.endGroup();
 }
 
 QVariant ThingManagerImplementation::mapValue(const QVariant &value, const StateType &fromStateType, const StateType &toStateType, bool inverted) const
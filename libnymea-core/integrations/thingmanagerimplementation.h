@@ -49,10 +49,16 @@
 #include <QLocale>
 #include <QPluginLoader>
 #include <QTranslator>
+#include <QElapsedTimer>
+#include <QSharedPointer>
+
+#include <functional>
 
 #include "hardwaremanager.h"
+#include "metrics.h"
 
 #include "integrations/thingmanager.h"
+#include "integrations/pluginthread.h"
 
 class Thing;
 class IntegrationPlugin;
@@ -74,6 +80,11 @@ public:
     static QList<QJsonObject> pluginsMetadata();
     void registerStaticPlugin(IntegrationPlugin* plugin, const PluginMetadata &metaData);
 
+    // When enabled, plugins are only registered by their metadata at startup and the
+    // shared object is loaded once a thing of that plugin is discovered, paired or set up.
+    // Activated plugins without things are unloaded again after idleTimeout seconds.
+    void setLazyPluginLoading(bool enabled, int idleTimeout = 600);
+
     IntegrationPlugins plugins() const override;
     IntegrationPlugin *plugin(const PluginId &pluginId) const override;
     Thing::ThingError setPluginConfig(const PluginId &pluginId, const ParamList &pluginConfig) override;
@@ -126,6 +137,8 @@ public:
     ThingClass translateThingClass(const ThingClass &thingClass, const QLocale &locale) override;
     Vendor translateVendor(const Vendor &vendor, const QLocale &locale) override;
 
+    void writeMetrics(MetricsWriter *writer) const;
+
 signals:
     void loaded();
 
@@ -140,6 +153,7 @@ private slots:
     void onLoaded();
     void cleanupThingStateCache();
     void onEventTriggered(const Event &event);
+    void unloadIdlePlugins();
 
     // Only connect this to Things. It will query the sender()
     void slotThingStateValueChanged(const StateTypeId &stateTypeId, const QVariant &value);
@@ -147,6 +161,19 @@ private slots:
     void slotThingNameChanged();
 
 private:
+    IntegrationPlugin *instantiatePlugin(QPluginLoader *loader, PluginMetadata *metaData);
+    bool registerDormantPlugin(const QString &fileName);
+    IntegrationPlugin *activatePlugin(const PluginId &pluginId);
+
+    // Plugins with the "threaded" metadata flag live in their own thread and are called in there.
+    // The main thread never waits for a plugin thread, except on shutdown.
+    void startPluginThread(IntegrationPlugin *plugin);
+    void stopPluginThread(IntegrationPlugin *plugin, std::function<void()> stopped);
+    void callPlugin(IntegrationPlugin *plugin, const char *entryPoint, std::function<void()> call, std::function<void()> done = nullptr);
+    template <typename Info>
+    void callPlugin(IntegrationPlugin *plugin, const char *entryPoint, Info *info, std::function<void()> call);
+    void deleteAfterPlugin(IntegrationPlugin *plugin, QObject *object);
+
     // Builds a list of params ready to create a thing.
     // Template is thingClass.paramtypes, "first" has highest priority. If a param is not found neither in first nor in second, defaults apply.
     ParamList buildParams(const ParamTypes &types, const ParamList &first, const ParamList &second = ParamList());
@@ -160,6 +187,19 @@ private:
     void storeIOConnections();
     void loadIOConnections();
 
+    void loadConfiguredThingsSettings();
+    ThingClass loadStoredThingClass(const PluginId &pluginId, const ThingClassId &thingClassId, const QString &thingName, const QString &idString);
+    void registerStoredThing(Thing *thing);
+    bool loadConfiguredThingsSnapshot();
+    void saveConfiguredThingsSnapshot();
+    void loadThingStatesSnapshot();
+    void saveThingStatesSnapshot();
+    bool loadIOConnectionsSnapshot();
+    void saveIOConnectionsSnapshot();
+
+    QByteArray discoveryCacheKey(const ThingClassId &thingClassId, const ParamList &params) const;
+    void invalidateDiscoveryCache(const PluginId &pluginId = PluginId());
+
     void syncIOConnection(Thing *inputThing, const StateTypeId &stateTypeId);
     QVariant mapValue(const QVariant &value, const StateType &fromStateType, const StateType &toStateType, bool inverted) const;
 
@@ -173,10 +213,34 @@ private:
     QHash<VendorId, QList<ThingClassId> > m_vendorThingMap;
     QHash<ThingClassId, ThingClass> m_supportedThings;
     QHash<ThingId, Thing*> m_configuredThings;
+    // Stored things which could not be loaded. They remain in the settings file, so no snapshot may be written.
+    bool m_skippedStoredThings = false;
     QHash<ThingDescriptorId, ThingDescriptor> m_discoveredThings;
 
+    // Recent discovery results and running discoveries, keyed by thing class and discovery params
+    class DiscoveryCacheEntry {
+    public:
+        PluginId pluginId;
+        ThingDescriptors thingDescriptors;
+        qint64 expiry = 0;
+    };
+    QHash<QByteArray, DiscoveryCacheEntry> m_discoveryCache;
+    QHash<QByteArray, ThingDiscoveryInfo*> m_runningDiscoveries;
+
     QHash<PluginId, IntegrationPlugin*> m_integrationPlugins;
 
+    bool m_lazyPluginLoading = false;
+    QTimer *m_pluginIdleTimer = nullptr;
+    qint64 m_pluginIdleTimeout = 600000;
+    // Plugins registered by metadata only, mapped to their library file
+    QHash<PluginId, QString> m_dormantPlugins;
+    // Lazily activated plugins which may be unloaded again when idle
+    QHash<PluginId, QPluginLoader*> m_pluginLoaders;
+    QHash<PluginId, QElapsedTimer> m_pluginActivity;
+    QHash<IntegrationPlugin*, PluginThread*> m_pluginThreads;
+
+    QHash<PluginId, QSharedPointer<MetricsCounter> > m_stateChangeCounters;
+
     class PairingContext {
     public:
         ThingId thingId;
@@ -188,6 +252,9 @@ private:
     QHash<PairingTransactionId, PairingContext> m_pendingPairings;
 
     QHash<IOConnectionId, IOConnection> m_ioConnections;
+
+    // Cached states read from the boot snapshot, consumed by loadThingStates()
+    QHash<ThingId, QHash<StateTypeId, QVariant> > m_thingStatesSnapshot;
 };
 
 #endif // THINGMANAGERIMPLEMENTATION_H
@@ -59,6 +59,7 @@
 #include "platform/platform.h"
 #include "version.h"
 #include "cloud/cloudmanager.h"
+#include "performancemonitor.h"
 
 #include "devicehandler.h"
 #include "integrationshandler.h"
@@ -485,6 +486,42 @@ bool JsonRPCServerImplementation::registerExperienceHandler(JsonHandler *handler
     return ret;
 }
 
+/*! Writes the client, method call and notification metrics of the JSON-RPC server to the given \a writer. */
+void JsonRPCServerImplementation::writeMetrics(MetricsWriter *writer) const
+{
+    QList<QPair<MetricsLabels, double> > clients;
+    foreach (TransportInterface *interface, m_interfaces.keys()) {
+        MetricsLabels labels;
+        labels.insert("transport", QString(interface->metaObject()->className()).split("::").last());
+        labels.insert("id", interface->configuration().id);
+        clients.append(qMakePair(labels, static_cast<double>(m_clientTransports.keys(interface).count())));
+    }
+    writer->writeGauge("nymea_jsonrpc_clients", "Number of clients connected to the JSON-RPC server.", clients);
+
+    QStringList methods = m_methodMetrics.keys();
+    methods.sort();
+    QList<QPair<MetricsLabels, const MetricsHistogram*> > methodHistograms;
+    foreach (const QString &method, methods) {
+        MetricsLabels labels;
+        labels.insert("method", method);
+        methodHistograms.append(qMakePair(labels, static_cast<const MetricsHistogram*>(m_methodMetrics.value(method).data())));
+    }
+    writer->writeHistograms("nymea_jsonrpc_call_duration_seconds", "Time from receiving a JSON-RPC call to sending its response.", methodHistograms);
+
+    QStringList notifications = m_notificationMetrics.keys();
+    notifications.sort();
+    QList<QPair<MetricsLabels, quint64> > emitted;
+    QList<QPair<MetricsLabels, quint64> > delivered;
+    foreach (const QString &notification, notifications) {
+        MetricsLabels labels;
+        labels.insert("notification", notification);
+        emitted.append(qMakePair(labels, m_notificationMetrics.value(notification)->emitted.value()));
+        delivered.append(qMakePair(labels, m_notificationMetrics.value(notification)->delivered.value()));
+    }
+    writer->writeCounter("nymea_jsonrpc_notifications_total", "Number of notifications emitted by the JSON-RPC server.", emitted);
+    writer->writeCounter("nymea_jsonrpc_notification_deliveries_total", "Number of notifications sent to clients.", delivered);
+}
+
 /*! Send a JSON success response to the client with the given \a clientId,
  * \a commandId and \a params to the inerted \l{TransportInterface}.
  */
@@ -705,15 +742,22 @@ void JsonRPCServerImplementation::processJsonPacket(TransportInterface *interfac
 
     qCDebug(dcJsonRpc()) << "Invoking method" << targetNamespace + '.' +  method << "from client" << clientId;
 
+    QElapsedTimer callTimer;
+    callTimer.start();
+
     JsonReply *reply;
-    if (handler->metaObject()->indexOfMethod(method.toUtf8() + "(QVariantMap,JsonContext)") >= 0) {
-        QMetaObject::invokeMethod(handler, method.toUtf8().data(), Q_RETURN_ARG(JsonReply*, reply), Q_ARG(QVariantMap, params), Q_ARG(JsonContext, callContext));
-    } else {
-        QMetaObject::invokeMethod(handler, method.toUtf8().data(), Q_RETURN_ARG(JsonReply*, reply), Q_ARG(QVariantMap, params));
+    {
+        PerformanceMeasurement measurement(PerformanceEntry::PerformanceCategoryJsonRpc, targetNamespace, method);
+        if (handler->metaObject()->indexOfMethod(method.toUtf8() + "(QVariantMap,JsonContext)") >= 0) {
+            QMetaObject::invokeMethod(handler, method.toUtf8().data(), Q_RETURN_ARG(JsonReply*, reply), Q_ARG(QVariantMap, params), Q_ARG(JsonContext, callContext));
+        } else {
+            QMetaObject::invokeMethod(handler, method.toUtf8().data(), Q_RETURN_ARG(JsonReply*, reply), Q_ARG(QVariantMap, params));
+        }
     }
 
     if (reply->type() == JsonReply::TypeAsync) {
         m_asyncReplies.insert(reply, interface);
+        m_asyncReplyTimers.insert(reply, callTimer);
         reply->setClientId(clientId);
         reply->setCommandId(commandId);
         connect(reply, &JsonReply::finished, this, &JsonRPCServerImplementation::asyncReplyFinished);
@@ -733,6 +777,11 @@ void JsonRPCServerImplementation::processJsonPacket(TransportInterface *interfac
 
         sendResponse(interface, clientId, commandId, reply->data(), deprecationWarning);
         reply->deleteLater();
+
+        QSharedPointer<MetricsHistogram> methodMetrics = m_methodMetrics.value(targetNamespace + '.' + method);
+        if (methodMetrics) {
+            methodMetrics->observe(callTimer.nsecsElapsed());
+        }
     }
 }
 
@@ -745,6 +794,11 @@ void JsonRPCServerImplementation::sendNotification(const QVariantMap &params)
     notification.insert("id", m_notificationId++);
     notification.insert("notification", handler->name() + "." + method.name());
 
+    NotificationMetrics *notificationMetrics = m_notificationMetrics.value(handler->name() + '.' + method.name()).data();
+    if (notificationMetrics) {
+        notificationMetrics->emitted.increment();
+    }
+
     foreach (const QUuid &clientId, m_clientNotifications.keys()) {
 
         // Check if this client wants to be notified
@@ -776,6 +830,10 @@ void JsonRPCServerImplementation::sendNotification(const QVariantMap &params)
         qCDebug(dcJsonRpcTraffic()) << "Notification content:" << data;
 
         m_clientTransports.value(clientId)->sendData(clientId, data);
+
+        if (notificationMetrics) {
+            notificationMetrics->delivered.increment();
+        }
     }
 }
 
@@ -810,12 +868,19 @@ void JsonRPCServerImplementation::sendClientNotification(const QUuid &clientId,
     qCDebug(dcJsonRpcTraffic()) << "Notification content:" << data;
     qCDebug(dcJsonRpc()) << "Sending notification:" << handler->name() + "." + method.name();
     m_clientTransports.value(clientId)->sendData(clientId, data);
+
+    NotificationMetrics *notificationMetrics = m_notificationMetrics.value(handler->name() + '.' + method.name()).data();
+    if (notificationMetrics) {
+        notificationMetrics->emitted.increment();
+        notificationMetrics->delivered.increment();
+    }
 }
 
 void JsonRPCServerImplementation::asyncReplyFinished()
 {
     JsonReply *reply = qobject_cast<JsonReply *>(sender());
     TransportInterface *interface = m_asyncReplies.take(reply);
+    QElapsedTimer callTimer = m_asyncReplyTimers.take(reply);
     if (!interface) {
         qCWarning(dcJsonRpc()) << "Got an async reply but the requesting connection has vanished.";
         reply->deleteLater();
@@ -836,6 +901,11 @@ void JsonRPCServerImplementation::asyncReplyFinished()
         }
 
         sendResponse(interface, reply->clientId(), reply->commandId(), reply->data(), deprecationWarning);
+
+        QSharedPointer<MetricsHistogram> methodMetrics = m_methodMetrics.value(method);
+        if (methodMetrics && callTimer.isValid()) {
+            methodMetrics->observe(callTimer.nsecsElapsed());
+        }
     } else {
         qCWarning(dcJsonRpc()) << "RPC call timed out:" << reply->handler()->name() << ":" << reply->method();
         sendErrorResponse(interface, reply->clientId(), reply->commandId(), "Command timed out");
@@ -978,6 +1048,14 @@ bool JsonRPCServerImplementation::registerHandler(JsonHandler *handler)
     qCDebug(dcJsonRpc()) << "Registering JSON RPC handler:" << handler->name();
     m_api = apiIncludingThis;
 
+    // Set up the metrics now so the hot paths only need to look them up
+    foreach (const QString &methodName, newMethods.keys()) {
+        m_methodMetrics.insert(methodName, QSharedPointer<MetricsHistogram>(new MetricsHistogram()));
+    }
+    foreach (const QString &notificationName, newNotifications.keys()) {
+        m_notificationMetrics.insert(notificationName, QSharedPointer<NotificationMetrics>(new NotificationMetrics()));
+    }
+
     m_handlers.insert(handler->name(), handler);
     for (int i = 0; i < handler->metaObject()->methodCount(); ++i) {
         QMetaMethod method = handler->metaObject()->method(i);
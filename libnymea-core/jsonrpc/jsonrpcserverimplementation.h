@@ -35,6 +35,7 @@
 #include "jsonrpc/jsonhandler.h"
 #include "transportinterface.h"
 #include "usermanager/usermanager.h"
+#include "metrics.h"
 
 #include "types/thingclass.h"
 #include "types/action.h"
@@ -44,6 +45,8 @@
 #include <QVariantMap>
 #include <QString>
 #include <QSslConfiguration>
+#include <QElapsedTimer>
+#include <QSharedPointer>
 
 class Thing;
 
@@ -84,6 +87,8 @@ public:
     bool registerHandler(JsonHandler *handler) override;
     bool registerExperienceHandler(JsonHandler *handler, int majorVersion, int minorVersion) override;
 
+    void writeMetrics(MetricsWriter *writer) const;
+
 private:
     QHash<QString, JsonHandler *> handlers() const;
 
@@ -129,6 +134,16 @@ private:
 
     int m_notificationId;
 
+    class NotificationMetrics
+    {
+    public:
+        MetricsCounter emitted;
+        MetricsCounter delivered;
+    };
+    QHash<QString, QSharedPointer<MetricsHistogram> > m_methodMetrics;
+    QHash<QString, QSharedPointer<NotificationMetrics> > m_notificationMetrics;
+    QHash<JsonReply*, QElapsedTimer> m_asyncReplyTimers;
+
     QString formatAssertion(const QString &targetNamespace, const QString &method, QMetaMethod::MethodType methodType, JsonHandler *handler, const QVariantMap &data) const;
 };
 
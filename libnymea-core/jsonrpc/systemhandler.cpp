@@ -33,6 +33,8 @@
 #include "platform/platform.h"
 #include "platform/platformupdatecontroller.h"
 #include "platform/platformsystemcontroller.h"
+#include "performancemonitor.h"
+#include "nymeacore.h"
 
 namespace nymeaserver {
 
@@ -43,6 +45,8 @@ SystemHandler::SystemHandler(Platform *platform, QObject *parent):
     // Objects
     registerObject<Package, Packages>();
     registerObject<Repository, Repositories>();
+    registerEnum<PerformanceEntry::PerformanceCategory>();
+    registerObject<PerformanceEntry, PerformanceEntries>();
 
     // Methods
     QString description; QVariantMap params; QVariantMap returns;
@@ -168,6 +172,20 @@ SystemHandler::SystemHandler(Platform *platform, QObject *parent):
     returns.insert("timeZones", enumValueName(StringList));
     registerMethod("GetTimeZones", description, params, returns);
 
+    params.clear(); returns.clear();
+    description = "Get the statistics collected by the performance monitor. \"enabled\" indicates whether the monitor "
+                  "is collecting data, it can be enabled with the performanceMonitoringEnabled setting in the nymead "
+                  "configuration. Each entry holds the wall time spent in a plugin entry point or timer, a JSON-RPC "
+                  "method or a rule evaluation, or the delay of the main event loop. All times are given in milliseconds. "
+                  "\"histogramBounds\" lists the upper bounds of the histogram buckets in each entry, the last bucket "
+                  "counts all samples exceeding the last bound. If \"reset\" is true, the statistics are cleared after "
+                  "being returned.";
+    params.insert("o:reset", enumValueName(Bool));
+    returns.insert("enabled", enumValueName(Bool));
+    returns.insert("histogramBounds", QVariantList() << enumValueName(Double));
+    returns.insert("entries", objectRef<PerformanceEntries>());
+    registerMethod("GetPerformanceStats", description, params, returns);
+
     // Notifications
     params.clear();
     description = "Emitted whenever the system capabilities change.";
@@ -446,6 +464,26 @@ JsonReply *SystemHandler::GetTimeZones(const QVariantMap &params) const
     return createReply(returns);
 }
 
+JsonReply *SystemHandler::GetPerformanceStats(const QVariantMap &params) const
+{
+    PerformanceMonitor *performanceMonitor = NymeaCore::instance()->performanceMonitor();
+
+    QVariantList histogramBounds;
+    foreach (double bound, PerformanceMonitor::histogramBounds()) {
+        histogramBounds.append(bound);
+    }
+
+    QVariantMap returns;
+    returns.insert("enabled", PerformanceMonitor::enabled());
+    returns.insert("histogramBounds", histogramBounds);
+    returns.insert("entries", pack(performanceMonitor->entries()));
+
+    if (params.value("reset", false).toBool()) {
+        performanceMonitor->reset();
+    }
+    return createReply(returns);
+}
+
 void SystemHandler::onCapabilitiesChanged()
 {
     QVariantMap caps;
@@ -39,6 +39,8 @@
 #include "platform/package.h"
 #include "platform/repository.h"
 
+#include "performanceentry.h"
+
 namespace nymeaserver {
 
 class SystemHandler : public JsonHandler
@@ -68,6 +70,8 @@ public:
     Q_INVOKABLE JsonReply *SetTime(const QVariantMap &params) const;
     Q_INVOKABLE JsonReply *GetTimeZones(const QVariantMap &params) const;
 
+    Q_INVOKABLE JsonReply *GetPerformanceStats(const QVariantMap &params) const;
+
 signals:
     void CapabilitiesChanged(const QVariantMap &params);
 
@@ -76,6 +76,22 @@ TagsHandler::TagsHandler(QObject *parent) : JsonHandler(parent)
     returns.insert("tagError", enumRef<TagsStorage::TagError>());
     registerMethod("RemoveTag", description, params, returns);
 
+    params.clear(); returns.clear();
+    description = "Add or update multiple Tags at once. "
+                  "The same rules as for AddTag apply to every tag in the list. If any of the tags is invalid, none "
+                  "of them will be added. A TagAdded or TagValueChanged notification will be emitted for each tag.";
+    params.insert("tags", objectRef("Tags"));
+    returns.insert("tagError", enumRef<TagsStorage::TagError>());
+    registerMethod("AddTags", description, params, returns);
+
+    params.clear(); returns.clear();
+    description = "Remove multiple Tags at once. "
+                  "Tag values are optional and will be disregarded. If any of the tags can't be found, none of them "
+                  "will be removed. A TagRemoved notification will be emitted for each tag.";
+    params.insert("tags", objectRef("Tags"));
+    returns.insert("tagError", enumRef<TagsStorage::TagError>());
+    registerMethod("RemoveTags", description, params, returns);
+
     // Notifications
     params.clear();
     description = "Emitted whenever a tag is added to the system. ";
@@ -103,8 +119,23 @@ QString TagsHandler::name() const
 
 JsonReply *TagsHandler::GetTags(const QVariantMap &params) const
 {
+    // Narrow down the candidates using the indexes of the storage
+    TagsStorage *tagsStorage = NymeaCore::instance()->tagsStorage();
+    QList<Tag> candidates;
+    if (params.contains("thingId")) {
+        candidates = tagsStorage->tags(ThingId(params.value("thingId").toString()));
+    } else if (params.contains("deviceId")) {
+        candidates = tagsStorage->tags(ThingId(params.value("deviceId").toString()));
+    } else if (params.contains("ruleId")) {
+        candidates = tagsStorage->tags(RuleId(params.value("ruleId").toString()));
+    } else if (params.contains("appId")) {
+        candidates = tagsStorage->appTags(params.value("appId").toString());
+    } else {
+        candidates = tagsStorage->tags();
+    }
+
     QVariantList ret;
-    foreach (const Tag &tag, NymeaCore::instance()->tagsStorage()->tags()) {
+    foreach (const Tag &tag, candidates) {
         if (params.contains("thingId") && params.value("thingId").toString() != tag.thingId().toString()) {
             continue;
         }
@@ -145,6 +176,22 @@ JsonReply *TagsHandler::RemoveTag(const QVariantMap &params) const
     return createReply(returns);
 }
 
+JsonReply *TagsHandler::AddTags(const QVariantMap &params) const
+{
+    Tags tags = unpack<Tags>(params.value("tags"));
+    TagsStorage::TagError error = NymeaCore::instance()->tagsStorage()->addTags(tags);
+    QVariantMap returns = statusToReply(error);
+    return createReply(returns);
+}
+
+JsonReply *TagsHandler::RemoveTags(const QVariantMap &params) const
+{
+    Tags tags = unpack<Tags>(params.value("tags"));
+    TagsStorage::TagError error = NymeaCore::instance()->tagsStorage()->removeTags(tags);
+    QVariantMap returns = statusToReply(error);
+    return createReply(returns);
+}
+
 void TagsHandler::onTagAdded(const Tag &tag)
 {
     qCDebug(dcJsonRpc) << "Notify \"Tags.TagAdded\"";
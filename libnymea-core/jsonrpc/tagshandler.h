@@ -48,6 +48,8 @@ public:
     Q_INVOKABLE JsonReply *GetTags(const QVariantMap &params) const;
     Q_INVOKABLE JsonReply *AddTag(const QVariantMap &params) const;
     Q_INVOKABLE JsonReply *RemoveTag(const QVariantMap &params) const;
+    Q_INVOKABLE JsonReply *AddTags(const QVariantMap &params) const;
+    Q_INVOKABLE JsonReply *RemoveTags(const QVariantMap &params) const;
 
 signals:
     void TagAdded(const QVariantMap &params);
@@ -20,12 +20,14 @@ RESOURCES += $$top_srcdir/icons.qrc \
 
 HEADERS += nymeacore.h \
     integrations/plugininfocache.h \
+    integrations/pluginthread.h \
     integrations/thingmanagerimplementation.h \
     integrations/translator.h \
     experiences/experiencemanager.h \
     ruleengine/ruleengine.h \
     ruleengine/rule.h \
     ruleengine/stateevaluator.h \
+    ruleengine/compiledstateevaluator.h \
     ruleengine/ruleaction.h \
     ruleengine/ruleactionparam.h \
     scriptengine/script.h \
@@ -36,6 +38,11 @@ HEADERS += nymeacore.h \
     scriptengine/scriptstate.h \
     transportinterface.h \
     nymeaconfiguration.h \
+    settingssnapshot.h \
+    performancemonitor.h \
+    performanceentry.h \
+    metrics.h \
+    metricshandler.h \
     servermanager.h \
     servers/tcpserver.h \
     servers/mocktcpserver.h \
@@ -45,6 +52,8 @@ HEADERS += nymeacore.h \
     servers/bluetoothserver.h \
     servers/websocketserver.h \
     servers/mqttbroker.h \
+    servers/mqtttopictrie.h \
+    servers/tlssessioncache.h \
     jsonrpc/jsonrpcserverimplementation.h \
     jsonrpc/jsonvalidator.h \
     jsonrpc/integrationshandler.h \
@@ -76,6 +85,8 @@ HEADERS += nymeacore.h \
     cloud/cloudnotifications.h \
     hardwaremanagerimplementation.h \
     hardware/plugintimermanagerimplementation.h \
+    hardware/timerwheel.h \
+    hardware/threadcall.h \
     hardware/radio433/radio433brennenstuhl.h \
     hardware/radio433/radio433transmitter.h \
     hardware/radio433/radio433brennenstuhlgateway.h \
@@ -89,6 +100,7 @@ HEADERS += nymeacore.h \
     hardware/network/mqtt/mqttproviderimplementation.h \
     hardware/network/mqtt/mqttchannelimplementation.h \
     hardware/i2c/i2cmanagerimplementation.h \
+    hardware/i2c/i2cbusworker.h \
     debugserverhandler.h \
     tagging/tagsstorage.h \
     tagging/tag.h \
@@ -99,12 +111,14 @@ HEADERS += nymeacore.h \
 
 SOURCES += nymeacore.cpp \
     integrations/plugininfocache.cpp \
+    integrations/pluginthread.cpp \
     integrations/thingmanagerimplementation.cpp \
     integrations/translator.cpp \
     experiences/experiencemanager.cpp \
     ruleengine/ruleengine.cpp \
     ruleengine/rule.cpp \
     ruleengine/stateevaluator.cpp \
+    ruleengine/compiledstateevaluator.cpp \
     ruleengine/ruleaction.cpp \
     ruleengine/ruleactionparam.cpp \
     scriptengine/script.cpp \
@@ -115,6 +129,11 @@ SOURCES += nymeacore.cpp \
     scriptengine/scriptstate.cpp \
     transportinterface.cpp \
     nymeaconfiguration.cpp \
+    settingssnapshot.cpp \
+    performancemonitor.cpp \
+    performanceentry.cpp \
+    metrics.cpp \
+    metricshandler.cpp \
     servermanager.cpp \
     servers/tcpserver.cpp \
     servers/mocktcpserver.cpp \
@@ -124,6 +143,7 @@ SOURCES += nymeacore.cpp \
     servers/websocketserver.cpp \
     servers/bluetoothserver.cpp \
     servers/mqttbroker.cpp \
+    servers/tlssessioncache.cpp \
     jsonrpc/jsonrpcserverimplementation.cpp \
     jsonrpc/jsonvalidator.cpp \
     jsonrpc/integrationshandler.cpp \
@@ -154,6 +174,7 @@ SOURCES += nymeacore.cpp \
     cloud/cloudnotifications.cpp \
     hardwaremanagerimplementation.cpp \
     hardware/plugintimermanagerimplementation.cpp \
+    hardware/timerwheel.cpp \
     hardware/radio433/radio433brennenstuhl.cpp \
     hardware/radio433/radio433transmitter.cpp \
     hardware/radio433/radio433brennenstuhlgateway.cpp \
@@ -167,6 +188,7 @@ SOURCES += nymeacore.cpp \
     hardware/network/mqtt/mqttproviderimplementation.cpp \
     hardware/network/mqtt/mqttchannelimplementation.cpp \
     hardware/i2c/i2cmanagerimplementation.cpp \
+    hardware/i2c/i2cbusworker.cpp \
     debugserverhandler.cpp \
     tagging/tagsstorage.cpp \
     tagging/tag.cpp \
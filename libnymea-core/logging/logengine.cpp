@@ -397,6 +397,7 @@ void LogEngine::appendLogEntry(const LogEntry &entry)
                 DatabaseJob *job = m_flaggedJobs[entry.typeId().toString() + entry.thingId().toString()].takeFirst();
                 int jobIdx = m_jobQueue.indexOf(job);
                 m_jobQueue.takeAt(jobIdx)->deleteLater();
+                m_discardedCounter.increment();
             }
         }
         m_flaggedJobs[entry.typeId().toString() + entry.thingId().toString()].append(job);
@@ -417,6 +418,7 @@ void LogEngine::appendLogEntry(const LogEntry &entry)
         emit logEntryAdded(entry);
 
         m_entryCount++;
+        m_writtenCounter.increment();
         trim();
     });
 
@@ -463,6 +465,14 @@ void LogEngine::trim()
     enqueJob(deleteJob, true);
 }
 
+void LogEngine::writeMetrics(MetricsWriter *writer) const
+{
+    writer->writeGauge("nymea_log_queue_length", "Number of database jobs waiting in the log engine queue.", m_jobQueue.count());
+    writer->writeGauge("nymea_log_entries", "Number of entries in the log database.", m_entryCount);
+    writer->writeCounter("nymea_log_entries_written_total", "Number of log entries written to the database.", m_writtenCounter.value());
+    writer->writeCounter("nymea_log_entries_discarded_total", "Number of log entries discarded because of log flooding.", m_discardedCounter.value());
+}
+
 void LogEngine::enqueJob(DatabaseJob *job, bool priority)
 {
     if (priority) {
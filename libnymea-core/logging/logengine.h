@@ -38,6 +38,7 @@
 #include "types/browseritemaction.h"
 #include "types/browseraction.h"
 #include "ruleengine/rule.h"
+#include "metrics.h"
 
 #include <QObject>
 #include <QSqlDatabase>
@@ -81,6 +82,8 @@ public:
     void removeThingLogs(const ThingId &thingId);
     void removeRuleLogs(const RuleId &ruleId);
 
+    void writeMetrics(MetricsWriter *writer) const;
+
 signals:
     void logEntryAdded(const LogEntry &logEntry);
     void logDatabaseUpdated();
@@ -121,6 +124,9 @@ private:
     QList<DatabaseJob*> m_jobQueue;
     DatabaseJob *m_currentJob = nullptr;
     QFutureWatcher<DatabaseJob*> m_jobWatcher;
+
+    MetricsCounter m_writtenCounter;
+    MetricsCounter m_discardedCounter;
 };
 
 class DatabaseJob: public QObject
@@ -0,0 +1,219 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class nymeaserver::MetricsCounter
+    \brief A lock free counter for the metrics exported by the \l{WebServer}.
+
+    \ingroup core
+    \inmodule core
+
+    Counters only ever increase. Rates, like calls per second, are calculated by the metrics
+    collector from the difference between two scrapes.
+*/
+
+/*!
+    \class nymeaserver::MetricsHistogram
+    \brief A lock free histogram of durations for the metrics exported by the \l{WebServer}.
+
+    \ingroup core
+    \inmodule core
+*/
+
+/*!
+    \class nymeaserver::MetricsWriter
+    \brief Formats metrics using the Prometheus text exposition format.
+
+    \ingroup core
+    \inmodule core
+
+    \sa {https://prometheus.io/docs/instrumenting/exposition_formats/}{Exposition formats}
+*/
+
+#include "metrics.h"
+
+#include <cmath>
+#include <limits>
+
+namespace nymeaserver {
+
+// Upper bounds of the histogram buckets in seconds
+static const double histogramBucketBounds[MetricsHistogram::bucketCount - 1] = { 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5 };
+
+MetricsHistogram::MetricsHistogram()
+{
+    for (int i = 0; i < bucketCount; i++) {
+        m_buckets[i].store(0);
+    }
+    m_count.store(0);
+    m_sum.store(0);
+}
+
+/*! Adds a duration of \a nsecs nanoseconds to this histogram. */
+void MetricsHistogram::observe(qint64 nsecs)
+{
+    double seconds = nsecs / 1e9;
+    int bucket = 0;
+    while (bucket < bucketCount - 1 && seconds > histogramBucketBounds[bucket]) {
+        bucket++;
+    }
+    m_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(static_cast<quint64>(qMax(nsecs, Q_INT64_C(0))), std::memory_order_relaxed);
+}
+
+/*! Returns the upper bound of the given \a bucket in seconds. */
+double MetricsHistogram::bucketBound(int bucket)
+{
+    if (bucket >= bucketCount - 1)
+        return std::numeric_limits<double>::infinity();
+
+    return histogramBucketBounds[bucket];
+}
+
+/*! Returns the number of observations in the given \a bucket. Buckets are not cumulative. */
+quint64 MetricsHistogram::bucketValue(int bucket) const
+{
+    return m_buckets[bucket].load(std::memory_order_relaxed);
+}
+
+/*! Returns the total number of observations. */
+quint64 MetricsHistogram::count() const
+{
+    return m_count.load(std::memory_order_relaxed);
+}
+
+/*! Returns the sum of all observations in seconds. */
+double MetricsHistogram::sum() const
+{
+    return m_sum.load(std::memory_order_relaxed) / 1e9;
+}
+
+/*! Writes the counter \a name with the given \a help text and one value per label set in \a samples. */
+void MetricsWriter::writeCounter(const QByteArray &name, const QByteArray &help, const QList<QPair<MetricsLabels, quint64> > &samples)
+{
+    writeHeader(name, "counter", help);
+    for (int i = 0; i < samples.count(); i++) {
+        writeSample(name, samples.at(i).first, QByteArray::number(samples.at(i).second));
+    }
+}
+
+/*! Writes the counter \a name with the given \a help text and a single \a value. */
+void MetricsWriter::writeCounter(const QByteArray &name, const QByteArray &help, quint64 value)
+{
+    writeCounter(name, help, QList<QPair<MetricsLabels, quint64> >() << qMakePair(MetricsLabels(), value));
+}
+
+/*! Writes the counter \a name with the given \a help text and a single fractional \a value, like seconds. */
+void MetricsWriter::writeCounter(const QByteArray &name, const QByteArray &help, double value)
+{
+    writeHeader(name, "counter", help);
+    writeSample(name, MetricsLabels(), formatValue(value));
+}
+
+/*! Writes the gauge \a name with the given \a help text and one value per label set in \a samples. */
+void MetricsWriter::writeGauge(const QByteArray &name, const QByteArray &help, const QList<QPair<MetricsLabels, double> > &samples)
+{
+    writeHeader(name, "gauge", help);
+    for (int i = 0; i < samples.count(); i++) {
+        writeSample(name, samples.at(i).first, formatValue(samples.at(i).second));
+    }
+}
+
+/*! Writes the gauge \a name with the given \a help text and a single \a value. */
+void MetricsWriter::writeGauge(const QByteArray &name, const QByteArray &help, double value)
+{
+    writeGauge(name, help, QList<QPair<MetricsLabels, double> >() << qMakePair(MetricsLabels(), value));
+}
+
+/*! Writes the histogram \a name with the given \a help text and one histogram per label set in \a histograms. */
+void MetricsWriter::writeHistograms(const QByteArray &name, const QByteArray &help, const QList<QPair<MetricsLabels, const MetricsHistogram *> > &histograms)
+{
+    writeHeader(name, "histogram", help);
+    for (int i = 0; i < histograms.count(); i++) {
+        const MetricsLabels &labels = histograms.at(i).first;
+        const MetricsHistogram *histogram = histograms.at(i).second;
+
+        // Buckets are cumulative in the exposition format
+        quint64 cumulative = 0;
+        for (int bucket = 0; bucket < MetricsHistogram::bucketCount; bucket++) {
+            cumulative += histogram->bucketValue(bucket);
+            MetricsLabels bucketLabels = labels;
+            bucketLabels.insert("le", QString::fromLatin1(formatValue(MetricsHistogram::bucketBound(bucket))));
+            writeSample(name + "_bucket", bucketLabels, QByteArray::number(cumulative));
+        }
+        writeSample(name + "_sum", labels, formatValue(histogram->sum()));
+        writeSample(name + "_count", labels, QByteArray::number(cumulative));
+    }
+}
+
+/*! Returns the metrics written so far. */
+QByteArray MetricsWriter::data() const
+{
+    return m_data;
+}
+
+void MetricsWriter::writeHeader(const QByteArray &name, const QByteArray &type, const QByteArray &help)
+{
+    m_data.append("# HELP " + name + ' ' + help + '\n');
+    m_data.append("# TYPE " + name + ' ' + type + '\n');
+}
+
+void MetricsWriter::writeSample(const QByteArray &name, const MetricsLabels &labels, const QByteArray &value)
+{
+    m_data.append(name + formatLabels(labels) + ' ' + value + '\n');
+}
+
+QByteArray MetricsWriter::formatLabels(const MetricsLabels &labels)
+{
+    if (labels.isEmpty())
+        return QByteArray();
+
+    QList<QByteArray> pairs;
+    foreach (const QString &key, labels.keys()) {
+        QByteArray value = labels.value(key).toUtf8();
+        value.replace('\\', "\\\\").replace('"', "\\\"").replace('\n', "\\n");
+        pairs.append(key.toUtf8() + "=\"" + value + '"');
+    }
+    return '{' + pairs.join(',') + '}';
+}
+
+QByteArray MetricsWriter::formatValue(double value)
+{
+    if (std::isinf(value))
+        return value > 0 ? "+Inf" : "-Inf";
+
+    if (std::isnan(value))
+        return "NaN";
+
+    return QByteArray::number(value, 'g', 10);
+}
+
+}
@@ -0,0 +1,110 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <QMap>
+#include <QList>
+#include <QPair>
+#include <QString>
+#include <QByteArray>
+
+#include <atomic>
+
+namespace nymeaserver {
+
+// A monotonically increasing counter which can be incremented from any thread without locking
+class MetricsCounter
+{
+public:
+    MetricsCounter() = default;
+
+    void increment(quint64 delta = 1) { m_value.fetch_add(delta, std::memory_order_relaxed); }
+    quint64 value() const { return m_value.load(std::memory_order_relaxed); }
+
+private:
+    Q_DISABLE_COPY(MetricsCounter)
+    std::atomic<quint64> m_value{0};
+};
+
+// A histogram of durations with fixed buckets which can be fed from any thread without locking
+class MetricsHistogram
+{
+public:
+    MetricsHistogram();
+
+    void observe(qint64 nsecs);
+
+    // The upper bound of each bucket in seconds, the last bucket is +Inf
+    static const int bucketCount = 13;
+    static double bucketBound(int bucket);
+
+    quint64 bucketValue(int bucket) const;
+    quint64 count() const;
+    double sum() const;
+
+private:
+    Q_DISABLE_COPY(MetricsHistogram)
+    std::atomic<quint64> m_buckets[bucketCount];
+    std::atomic<quint64> m_count;
+    std::atomic<quint64> m_sum; // nanoseconds
+};
+
+typedef QMap<QString, QString> MetricsLabels;
+
+// Writes metrics in the Prometheus text exposition format
+class MetricsWriter
+{
+public:
+    MetricsWriter() = default;
+
+    void writeCounter(const QByteArray &name, const QByteArray &help, const QList<QPair<MetricsLabels, quint64> > &samples);
+    void writeCounter(const QByteArray &name, const QByteArray &help, quint64 value);
+    void writeCounter(const QByteArray &name, const QByteArray &help, double value);
+    void writeGauge(const QByteArray &name, const QByteArray &help, const QList<QPair<MetricsLabels, double> > &samples);
+    void writeGauge(const QByteArray &name, const QByteArray &help, double value);
+    void writeHistograms(const QByteArray &name, const QByteArray &help, const QList<QPair<MetricsLabels, const MetricsHistogram*> > &histograms);
+
+    QByteArray data() const;
+
+private:
+    QByteArray m_data;
+
+    void writeHeader(const QByteArray &name, const QByteArray &type, const QByteArray &help);
+    void writeSample(const QByteArray &name, const MetricsLabels &labels, const QByteArray &value);
+
+    static QByteArray formatLabels(const MetricsLabels &labels);
+    static QByteArray formatValue(double value);
+};
+
+}
+
+#endif // METRICS_H
@@ -0,0 +1,118 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class nymeaserver::MetricsHandler
+    \brief Serves the metrics of the nymea server on the /metrics path of the \l{WebServer}.
+
+    \ingroup core
+    \inmodule core
+
+    The metrics are provided in the Prometheus text exposition format and contain the connected clients per
+    transport, the JSON-RPC calls and their latency per method, the notification fan-out, the log engine queue,
+    rule evaluations, state changes per plugin, the MQTT broker traffic and the memory usage of the process.
+    Rates, like calls per second, are calculated by the metrics collector from the counters.
+
+    The metrics are only served if \c metricsEnabled is set to true in the \c nymead section of the configuration.
+*/
+
+#include "metricshandler.h"
+#include "nymeacore.h"
+#include "loggingcategories.h"
+#include "servermanager.h"
+#include "servers/mqttbroker.h"
+#include "logging/logengine.h"
+#include "ruleengine/ruleengine.h"
+#include "jsonrpc/jsonrpcserverimplementation.h"
+#include "integrations/thingmanagerimplementation.h"
+
+#include <QFile>
+
+#include <unistd.h>
+
+namespace nymeaserver {
+
+/*! Constructs a new MetricsHandler with the given \a parent. */
+MetricsHandler::MetricsHandler(QObject *parent) :
+    QObject(parent)
+{
+
+}
+
+/*! Collects the current metrics and returns them in a HttpReply. */
+HttpReply *MetricsHandler::processMetricsRequest()
+{
+    NymeaCore *core = NymeaCore::instance();
+
+    MetricsWriter writer;
+    core->jsonRPCServer()->writeMetrics(&writer);
+    qobject_cast<ThingManagerImplementation*>(core->thingManager())->writeMetrics(&writer);
+    core->ruleEngine()->writeMetrics(&writer);
+    core->logEngine()->writeMetrics(&writer);
+    core->serverManager()->mqttBroker()->writeMetrics(&writer);
+    writer.writeCounter("nymea_log_messages_dropped_total", "Number of diagnostic log messages dropped because the log buffer was full.", droppedLogMessages());
+    writeProcessMetrics(&writer);
+
+    HttpReply *reply = HttpReply::createSuccessReply();
+    reply->setHeader(HttpReply::ContentTypeHeader, "text/plain; version=0.0.4; charset=utf-8");
+    reply->setPayload(writer.data());
+    return reply;
+}
+
+void MetricsHandler::writeProcessMetrics(MetricsWriter *writer)
+{
+    // Memory usage from /proc/self/statm, given in pages
+    QFile statmFile("/proc/self/statm");
+    if (statmFile.open(QFile::ReadOnly)) {
+        QList<QByteArray> fields = statmFile.readAll().simplified().split(' ');
+        if (fields.count() >= 2) {
+            double pageSize = sysconf(_SC_PAGESIZE);
+            writer->writeGauge("process_virtual_memory_bytes", "Virtual memory size in bytes.", fields.at(0).toDouble() * pageSize);
+            writer->writeGauge("process_resident_memory_bytes", "Resident memory size in bytes.", fields.at(1).toDouble() * pageSize);
+        }
+    } else {
+        qCWarning(dcWebServer()) << "Unable to read the memory usage of the process:" << statmFile.errorString();
+    }
+
+    // CPU time from /proc/self/stat, utime and stime are the fields 14 and 15, given in clock ticks.
+    // The process name in field 2 may contain spaces, so start counting after its closing parenthesis.
+    QFile statFile("/proc/self/stat");
+    if (statFile.open(QFile::ReadOnly)) {
+        QByteArray stat = statFile.readAll();
+        QList<QByteArray> fields = stat.mid(stat.lastIndexOf(')') + 2).split(' ');
+        if (fields.count() >= 13) {
+            double ticks = sysconf(_SC_CLK_TCK);
+            double cpuSeconds = (fields.at(11).toDouble() + fields.at(12).toDouble()) / ticks;
+            writer->writeCounter("process_cpu_seconds_total", "Total user and system CPU time spent in seconds.", cpuSeconds);
+        }
+    }
+}
+
+}
@@ -553,6 +553,41 @@ int NymeaConfiguration::logDBMaxEntries() const
     return settings.value("logDBMaxEntries", 200000).toInt();
 }
 
+bool NymeaConfiguration::lazyPluginLoading() const
+{
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("Plugins");
+    return settings.value("lazyLoading", false).toBool();
+}
+
+int NymeaConfiguration::pluginIdleTimeout() const
+{
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("Plugins");
+    return settings.value("idleTimeout", 600).toInt();
+}
+
+bool NymeaConfiguration::bootSnapshotEnabled() const
+{
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("nymead");
+    return settings.value("bootSnapshotEnabled", false).toBool();
+}
+
+bool NymeaConfiguration::performanceMonitoringEnabled() const
+{
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("nymead");
+    return settings.value("performanceMonitoringEnabled", false).toBool();
+}
+
+bool NymeaConfiguration::metricsEnabled() const
+{
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("nymead");
+    return settings.value("metricsEnabled", false).toBool();
+}
+
 QString NymeaConfiguration::sslCertificate() const
 {
     NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
@@ -181,6 +181,19 @@ public:
     QString logDBPassword() const;
     int logDBMaxEntries() const;
 
+    // Plugins
+    bool lazyPluginLoading() const;
+    int pluginIdleTimeout() const;
+
+    // Boot snapshots
+    bool bootSnapshotEnabled() const;
+
+    // Performance monitoring
+    bool performanceMonitoringEnabled() const;
+
+    // Metrics
+    bool metricsEnabled() const;
+
 private:
     QHash<QString, ServerConfiguration> m_tcpServerConfigs;
     QHash<QString, WebServerConfiguration> m_webServerConfigs;
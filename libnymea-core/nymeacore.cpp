@@ -34,6 +34,9 @@
 #include "jsonrpc/jsonrpcserverimplementation.h"
 #include "ruleengine/ruleengine.h"
 #include "nymeasettings.h"
+#include "settingssnapshot.h"
+#include "performancemonitor.h"
+#include "metricshandler.h"
 #include "tagging/tagsstorage.h"
 #include "platform/platform.h"
 #include "experiences/experiencemanager.h"
@@ -85,6 +88,10 @@ void NymeaCore::init() {
     qCDebug(dcApplication()) << "Loading nymea configurations" << NymeaSettings(NymeaSettings::SettingsRoleGlobal).fileName();
     m_configuration = new NymeaConfiguration(this);
 
+    qCDebug(dcApplication()) << "Creating Performance Monitor";
+    m_performanceMonitor = new PerformanceMonitor(this);
+    m_performanceMonitor->setEnabled(m_configuration->performanceMonitoringEnabled());
+
     qCDebug(dcApplication()) << "Creating Time Manager";
     // Migration path: nymea < 0.18 doesn't use system time zone but stores its own time zone in the config
     // For migration, let's set the system's time zone to the config now to upgrade to the system time zone based nymea >= 0.18
@@ -107,11 +114,14 @@ void NymeaCore::init() {
     qCDebug(dcApplication) << "Creating Hardware Manager";
     m_hardwareManager = new HardwareManagerImplementation(m_platform, m_serverManager->mqttBroker(), this);
 
+    SettingsSnapshot::setEnabled(m_configuration->bootSnapshotEnabled());
+
     qCDebug(dcApplication) << "Creating Thing Manager (locale:" << m_configuration->locale() << ")";
     m_thingManager = new ThingManagerImplementation(m_hardwareManager, m_configuration->locale(), this);
+    m_thingManager->setLazyPluginLoading(m_configuration->lazyPluginLoading(), m_configuration->pluginIdleTimeout());
 
     qCDebug(dcApplication) << "Creating Rule Engine";
-    m_ruleEngine = new RuleEngine(this);
+    m_ruleEngine = new RuleEngine(NymeaSettings::settingsPath() + "/rules.sqlite", this);
 
     qCDebug(dcApplication()) << "Creating Script Engine";
     m_scriptEngine = new ScriptEngine(m_thingManager, this);
@@ -127,6 +137,9 @@ void NymeaCore::init() {
     qCDebug(dcApplication) << "Creating Debug Server Handler";
     m_debugServerHandler = new DebugServerHandler(this);
 
+    qCDebug(dcApplication) << "Creating Metrics Handler";
+    m_metricsHandler = new MetricsHandler(this);
+
     qCDebug(dcApplication) << "Creating Cloud Manager";
     m_cloudManager = new CloudManager(m_configuration, m_networkManager, this);
 
@@ -156,6 +169,8 @@ void NymeaCore::init() {
     connect(m_ruleEngine, &RuleEngine::ruleRemoved, this, &NymeaCore::ruleRemoved);
     connect(m_ruleEngine, &RuleEngine::ruleConfigurationChanged, this, &NymeaCore::ruleConfigurationChanged);
 
+    connect(m_ruleEngine, &RuleEngine::nextTimeEvaluationChanged, m_timeManager, &TimeManager::scheduleWakeup);
+
     connect(m_timeManager, &TimeManager::dateTimeChanged, this, &NymeaCore::onDateTimeChanged);
 
     m_logger->logSystemEvent(m_timeManager->currentDateTime(), true);
@@ -682,6 +697,16 @@ DebugServerHandler *NymeaCore::debugServerHandler() const
     return m_debugServerHandler;
 }
 
+PerformanceMonitor *NymeaCore::performanceMonitor() const
+{
+    return m_performanceMonitor;
+}
+
+MetricsHandler *NymeaCore::metricsHandler() const
+{
+    return m_metricsHandler;
+}
+
 TagsStorage *NymeaCore::tagsStorage() const
 {
     return m_tagsStorage;
@@ -66,6 +66,8 @@ class System;
 class ExperienceManager;
 class ScriptEngine;
 class CloudManager;
+class PerformanceMonitor;
+class MetricsHandler;
 
 class NymeaCore : public QObject
 {
@@ -104,6 +106,8 @@ public:
     UserManager *userManager() const;
     CloudManager *cloudManager() const;
     DebugServerHandler *debugServerHandler() const;
+    PerformanceMonitor *performanceMonitor() const;
+    MetricsHandler *metricsHandler() const;
     TagsStorage *tagsStorage() const;
     Platform *platform() const;
 
@@ -143,6 +147,8 @@ private:
     CloudManager *m_cloudManager;
     HardwareManagerImplementation *m_hardwareManager;
     DebugServerHandler *m_debugServerHandler;
+    PerformanceMonitor *m_performanceMonitor = nullptr;
+    MetricsHandler *m_metricsHandler = nullptr;
     TagsStorage *m_tagsStorage;
 
     NetworkManager *m_networkManager;
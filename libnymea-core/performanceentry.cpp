@@ -0,0 +1,163 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class nymeaserver::PerformanceEntry
+    \brief Holds the timing statistics of one measured code path.
+
+    \ingroup core
+    \inmodule core
+
+    A PerformanceEntry describes how often a code path, like an entry point of an integration plugin, a JSON-RPC
+    method or the evaluation of a rule, has been executed and how long those executions took. All times are
+    given in milliseconds. The histogram holds the number of samples for each of the bounds returned by
+    \l{PerformanceMonitor::histogramBounds()} and one additional bucket for samples exceeding the last bound.
+
+    \sa PerformanceMonitor
+*/
+
+/*! \enum nymeaserver::PerformanceEntry::PerformanceCategory
+    \value PerformanceCategoryEventLoop
+        The delay of the main event loop in processing a timer.
+    \value PerformanceCategoryPlugin
+        The wall time spent in an entry point or timer of an integration plugin.
+    \value PerformanceCategoryJsonRpc
+        The wall time spent in a JSON-RPC method handler.
+    \value PerformanceCategoryRule
+        The wall time spent evaluating a rule.
+*/
+
+#include "performanceentry.h"
+
+namespace nymeaserver {
+
+PerformanceEntry::PerformanceEntry()
+{
+
+}
+
+/*! Constructs a new PerformanceEntry for the code path with the given \a name in the given \a category. */
+PerformanceEntry::PerformanceEntry(PerformanceEntry::PerformanceCategory category, const QString &name):
+    m_category(category),
+    m_name(name)
+{
+
+}
+
+/*! Returns the category of this PerformanceEntry. */
+PerformanceEntry::PerformanceCategory PerformanceEntry::category() const
+{
+    return m_category;
+}
+
+/*! Returns the name of the measured code path. */
+QString PerformanceEntry::name() const
+{
+    return m_name;
+}
+
+/*! Returns the human readable label of the measured code path, i.e. the name of a rule whose entry is named by
+    its id. Empty if the name is readable already. */
+QString PerformanceEntry::label() const
+{
+    return m_label;
+}
+
+/*! Sets the human readable \a label of the measured code path. */
+void PerformanceEntry::setLabel(const QString &label)
+{
+    m_label = label;
+}
+
+/*! Returns the number of measurements taken. */
+uint PerformanceEntry::samples() const
+{
+    return m_samples;
+}
+
+/*! Sets the number of measurements taken to \a samples. */
+void PerformanceEntry::setSamples(uint samples)
+{
+    m_samples = samples;
+}
+
+/*! Returns the sum of all measurements in milliseconds. */
+double PerformanceEntry::totalTime() const
+{
+    return m_totalTime;
+}
+
+/*! Sets the sum of all measurements to \a totalTime milliseconds. */
+void PerformanceEntry::setTotalTime(double totalTime)
+{
+    m_totalTime = totalTime;
+}
+
+/*! Returns the average of all measurements in milliseconds. */
+double PerformanceEntry::averageTime() const
+{
+    return m_samples > 0 ? m_totalTime / m_samples : 0;
+}
+
+/*! Returns the longest measurement in milliseconds. */
+double PerformanceEntry::maxTime() const
+{
+    return m_maxTime;
+}
+
+/*! Sets the longest measurement to \a maxTime milliseconds. */
+void PerformanceEntry::setMaxTime(double maxTime)
+{
+    m_maxTime = maxTime;
+}
+
+/*! Returns the number of samples in each histogram bucket. */
+QList<int> PerformanceEntry::histogram() const
+{
+    return m_histogram;
+}
+
+/*! Sets the number of samples in each histogram bucket to \a histogram. */
+void PerformanceEntry::setHistogram(const QList<int> &histogram)
+{
+    m_histogram = histogram;
+}
+
+QVariant PerformanceEntries::get(int index) const
+{
+    return QVariant::fromValue(at(index));
+}
+
+void PerformanceEntries::put(const QVariant &variant)
+{
+    append(variant.value<PerformanceEntry>());
+}
+
+}
@@ -0,0 +1,109 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef PERFORMANCEENTRY_H
+#define PERFORMANCEENTRY_H
+
+#include <QList>
+#include <QString>
+#include <QVariant>
+#include <QMetaType>
+
+namespace nymeaserver {
+
+class PerformanceEntry
+{
+    Q_GADGET
+    Q_PROPERTY(PerformanceCategory category READ category)
+    Q_PROPERTY(QString name READ name)
+    Q_PROPERTY(QString label READ label USER true)
+    Q_PROPERTY(uint samples READ samples)
+    Q_PROPERTY(double totalTime READ totalTime)
+    Q_PROPERTY(double averageTime READ averageTime)
+    Q_PROPERTY(double maxTime READ maxTime)
+    Q_PROPERTY(QList<int> histogram READ histogram)
+
+public:
+    enum PerformanceCategory {
+        PerformanceCategoryEventLoop,
+        PerformanceCategoryPlugin,
+        PerformanceCategoryJsonRpc,
+        PerformanceCategoryRule
+    };
+    Q_ENUM(PerformanceCategory)
+
+    PerformanceEntry();
+    PerformanceEntry(PerformanceCategory category, const QString &name);
+
+    PerformanceCategory category() const;
+    QString name() const;
+
+    QString label() const;
+    void setLabel(const QString &label);
+
+    uint samples() const;
+    void setSamples(uint samples);
+
+    double totalTime() const;
+    void setTotalTime(double totalTime);
+
+    double averageTime() const;
+
+    double maxTime() const;
+    void setMaxTime(double maxTime);
+
+    QList<int> histogram() const;
+    void setHistogram(const QList<int> &histogram);
+
+private:
+    PerformanceCategory m_category = PerformanceCategoryEventLoop;
+    QString m_name;
+    QString m_label;
+    uint m_samples = 0;
+    double m_totalTime = 0;
+    double m_maxTime = 0;
+    QList<int> m_histogram;
+};
+
+class PerformanceEntries: public QList<PerformanceEntry>
+{
+    Q_GADGET
+    Q_PROPERTY(int count READ count)
+public:
+    Q_INVOKABLE QVariant get(int index) const;
+    Q_INVOKABLE void put(const QVariant &variant);
+};
+
+}
+
+Q_DECLARE_METATYPE(nymeaserver::PerformanceEntry)
+Q_DECLARE_METATYPE(nymeaserver::PerformanceEntries)
+
+#endif // PERFORMANCEENTRY_H
@@ -0,0 +1,278 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class nymeaserver::PerformanceMonitor
+    \brief Collects wall time histograms of the code paths which run in the event loop.
+
+    \ingroup core
+    \inmodule core
+
+    The PerformanceMonitor measures the delay of the main event loop as well as the time spent in the entry points
+    and timers of integration plugins, in JSON-RPC method handlers and in rule evaluations. The results can be
+    fetched using System.GetPerformanceStats or from the debug server.
+
+    The monitor is disabled by default and can be enabled with the \c performanceMonitoringEnabled setting in the
+    \c nymead section of the configuration. While disabled, a \l{PerformanceMeasurement} only costs a relaxed
+    atomic load. Measurements in the plugin category additionally set and restore the current owner of the thread
+    in a QThreadStorage.
+
+    \sa PerformanceEntry
+*/
+
+#include "performancemonitor.h"
+#include "loggingcategories.h"
+
+#include <QThreadStorage>
+#include <QMutexLocker>
+
+#include <algorithm>
+
+namespace nymeaserver {
+
+// Interval of the probe timer used to measure the delay of the main event loop
+static const int lagProbeInterval = 100;
+
+// Upper bounds of the histogram buckets in microseconds
+static const qint64 histogramBucketBounds[] = { 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000 };
+static const int histogramBucketCount = sizeof(histogramBucketBounds) / sizeof(histogramBucketBounds[0]) + 1;
+
+// The plugin currently executing code in a thread, used to attribute timers to their plugins
+static QThreadStorage<QString> currentOwnerStorage;
+
+std::atomic<bool> PerformanceMonitor::s_enabled(false);
+PerformanceMonitor *PerformanceMonitor::s_instance = nullptr;
+
+/*! Constructs a new disabled PerformanceMonitor with the given \a parent. Only one instance may exist at a time. */
+PerformanceMonitor::PerformanceMonitor(QObject *parent) :
+    QObject(parent)
+{
+    Q_ASSERT_X(!s_instance, "PerformanceMonitor", "There must be only one PerformanceMonitor instance.");
+    s_instance = this;
+
+    m_lagProbeTimer = new QTimer(this);
+    m_lagProbeTimer->setTimerType(Qt::PreciseTimer);
+    m_lagProbeTimer->setInterval(lagProbeInterval);
+    connect(m_lagProbeTimer, &QTimer::timeout, this, &PerformanceMonitor::onLagProbeTimeout);
+}
+
+PerformanceMonitor::~PerformanceMonitor()
+{
+    s_enabled = false;
+    s_instance = nullptr;
+}
+
+/*! Returns the PerformanceMonitor instance, or nullptr if none has been created. */
+PerformanceMonitor *PerformanceMonitor::instance()
+{
+    return s_instance;
+}
+
+/*! Enables or disables collecting measurements. Disabling keeps the collected data, see \l{reset()}. */
+void PerformanceMonitor::setEnabled(bool enabled)
+{
+    if (s_enabled == enabled)
+        return;
+
+    qCDebug(dcApplication()) << "Performance monitoring" << (enabled ? "enabled" : "disabled");
+    s_enabled = enabled;
+    if (enabled) {
+        m_lagProbeClock.start();
+        m_lagProbeTimer->start();
+    } else {
+        m_lagProbeTimer->stop();
+    }
+}
+
+/*! Returns the upper bounds of the histogram buckets in milliseconds. The histogram of each
+    \l{PerformanceEntry} has one additional bucket for samples exceeding the last bound. */
+QList<double> PerformanceMonitor::histogramBounds()
+{
+    QList<double> bounds;
+    for (int i = 0; i < histogramBucketCount - 1; i++) {
+        bounds.append(histogramBucketBounds[i] / 1000.0);
+    }
+    return bounds;
+}
+
+/*! Returns the name of the plugin currently executing code in the calling thread, if any. */
+QString PerformanceMonitor::currentOwner()
+{
+    return currentOwnerStorage.localData();
+}
+
+/*! Adds a measurement of \a nsecs nanoseconds to the histogram of \a name in \a category. If given, \a label
+    replaces the label of the entry, i.e. when a rule got renamed. This method is thread safe. */
+void PerformanceMonitor::record(PerformanceEntry::PerformanceCategory category, const QString &name, qint64 nsecs, const QString &label)
+{
+    qint64 usecs = nsecs / 1000;
+    int bucket = 0;
+    while (bucket < histogramBucketCount - 1 && usecs > histogramBucketBounds[bucket]) {
+        bucket++;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    Histogram &histogram = m_histograms[HistogramKey(static_cast<int>(category), name)];
+    if (histogram.buckets.isEmpty()) {
+        histogram.buckets.fill(0, histogramBucketCount);
+    }
+    if (!label.isEmpty()) {
+        histogram.label = label;
+    }
+    histogram.samples++;
+    histogram.totalTime += nsecs;
+    histogram.maxTime = qMax(histogram.maxTime, nsecs);
+    histogram.buckets[bucket]++;
+}
+
+/*! Returns the statistics collected so far, sorted by category and name. */
+PerformanceEntries PerformanceMonitor::entries() const
+{
+    QMutexLocker locker(&m_mutex);
+    QList<HistogramKey> keys = m_histograms.keys();
+    std::sort(keys.begin(), keys.end());
+
+    PerformanceEntries entries;
+    foreach (const HistogramKey &key, keys) {
+        Histogram histogram = m_histograms.value(key);
+        PerformanceEntry entry(static_cast<PerformanceEntry::PerformanceCategory>(key.first), key.second);
+        entry.setLabel(histogram.label);
+        entry.setSamples(histogram.samples);
+        entry.setTotalTime(histogram.totalTime / 1000000.0);
+        entry.setMaxTime(histogram.maxTime / 1000000.0);
+        QList<int> buckets;
+        foreach (quint32 count, histogram.buckets) {
+            buckets.append(static_cast<int>(count));
+        }
+        entry.setHistogram(buckets);
+        entries.append(entry);
+    }
+    return entries;
+}
+
+/*! Discards all statistics collected so far. */
+void PerformanceMonitor::reset()
+{
+    QMutexLocker locker(&m_mutex);
+    m_histograms.clear();
+}
+
+void PerformanceMonitor::onLagProbeTimeout()
+{
+    qint64 elapsed = m_lagProbeClock.nsecsElapsed();
+    m_lagProbeClock.restart();
+    // A precise timer may fire slightly early
+    qint64 lag = qMax(Q_INT64_C(0), elapsed - static_cast<qint64>(lagProbeInterval) * 1000000);
+    record(PerformanceEntry::PerformanceCategoryEventLoop, QStringLiteral("main"), lag);
+}
+
+/*!
+    \class nymeaserver::PerformanceMeasurement
+    \brief Measures the wall time of a scope for the PerformanceMonitor.
+
+    \ingroup core
+    \inmodule core
+
+    The measurement is started on construction and recorded in the \l{PerformanceMonitor} when the object goes out
+    of scope. If given, \a detail is appended to the name, separated by a dot. If the monitor is disabled,
+    nothing is measured.
+
+    Measurements in the \l{PerformanceEntry::PerformanceCategoryPlugin}{PerformanceCategoryPlugin} category
+    additionally mark the plugin given by \a name as the \l{PerformanceMonitor::currentOwner()}{current owner}
+    of the calling thread. This is done even if the monitor is disabled, so resources registered in the meantime
+    are attributed to their plugin once it gets enabled.
+*/
+
+/*! Starts measuring the code path \a name in \a category. */
+PerformanceMeasurement::PerformanceMeasurement(PerformanceEntry::PerformanceCategory category, const QString &name, const QString &detail):
+    m_category(category)
+{
+    if (m_category == PerformanceEntry::PerformanceCategoryPlugin) {
+        m_previousOwner = currentOwnerStorage.localData();
+        currentOwnerStorage.setLocalData(name);
+    }
+
+    if (!PerformanceMonitor::enabled())
+        return;
+
+    m_active = true;
+    m_name = name;
+    m_detail = detail;
+    m_timer.start();
+}
+
+/*! Starts measuring the code path identified by \a id in \a category. The id is only formatted if the monitor
+    is enabled. This can't be used in the plugin category, which requires the plugin name. */
+PerformanceMeasurement::PerformanceMeasurement(PerformanceEntry::PerformanceCategory category, const QUuid &id):
+    m_category(category)
+{
+    Q_ASSERT_X(category != PerformanceEntry::PerformanceCategoryPlugin, "PerformanceMeasurement", "Plugin measurements need the plugin name.");
+
+    if (!PerformanceMonitor::enabled())
+        return;
+
+    m_active = true;
+    m_id = id;
+    m_timer.start();
+}
+
+/*! Stops measuring and records the result. */
+PerformanceMeasurement::~PerformanceMeasurement()
+{
+    if (m_category == PerformanceEntry::PerformanceCategoryPlugin) {
+        currentOwnerStorage.setLocalData(m_previousOwner);
+    }
+
+    if (!m_active)
+        return;
+
+    qint64 nsecs = m_timer.nsecsElapsed();
+
+    // The monitor might have been disabled in the meantime, the measurement is still valid
+    PerformanceMonitor *monitor = PerformanceMonitor::instance();
+    if (monitor) {
+        QString name = m_id.isNull() ? m_name : m_id.toString();
+        monitor->record(m_category, m_detail.isEmpty() ? name : name + '.' + m_detail, nsecs, m_label);
+    }
+}
+
+/*! Returns true if this measurement is recorded. Use this to avoid building a label which isn't used. */
+bool PerformanceMeasurement::active() const
+{
+    return m_active;
+}
+
+/*! Sets a human readable \a label for the measured code path, used if the name is an id. */
+void PerformanceMeasurement::setLabel(const QString &label)
+{
+    m_label = label;
+}
+
+}
@@ -0,0 +1,123 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef PERFORMANCEMONITOR_H
+#define PERFORMANCEMONITOR_H
+
+#include <QHash>
+#include <QPair>
+#include <QMutex>
+#include <QTimer>
+#include <QObject>
+#include <QUuid>
+#include <QVector>
+#include <QElapsedTimer>
+
+#include <atomic>
+
+#include "performanceentry.h"
+
+namespace nymeaserver {
+
+class PerformanceMonitor : public QObject
+{
+    Q_OBJECT
+public:
+    explicit PerformanceMonitor(QObject *parent = nullptr);
+    ~PerformanceMonitor() override;
+
+    static PerformanceMonitor *instance();
+
+    static bool enabled() { return s_enabled.load(std::memory_order_relaxed); }
+    void setEnabled(bool enabled);
+
+    static QList<double> histogramBounds();
+    static QString currentOwner();
+
+    void record(PerformanceEntry::PerformanceCategory category, const QString &name, qint64 nsecs, const QString &label = QString());
+
+    PerformanceEntries entries() const;
+    void reset();
+
+private slots:
+    void onLagProbeTimeout();
+
+private:
+    friend class PerformanceMeasurement;
+
+    class Histogram
+    {
+    public:
+        QString label;
+        quint32 samples = 0;
+        qint64 totalTime = 0;
+        qint64 maxTime = 0;
+        QVector<quint32> buckets;
+    };
+
+    typedef QPair<int, QString> HistogramKey;
+
+    static std::atomic<bool> s_enabled;
+    static PerformanceMonitor *s_instance;
+
+    mutable QMutex m_mutex;
+    QHash<HistogramKey, Histogram> m_histograms;
+
+    QTimer *m_lagProbeTimer = nullptr;
+    QElapsedTimer m_lagProbeClock;
+};
+
+// Measures the wall time from construction to destruction. Only tracks the owning plugin if the monitor is disabled.
+class PerformanceMeasurement
+{
+public:
+    PerformanceMeasurement(PerformanceEntry::PerformanceCategory category, const QString &name, const QString &detail = QString());
+    PerformanceMeasurement(PerformanceEntry::PerformanceCategory category, const QUuid &id);
+    ~PerformanceMeasurement();
+
+    bool active() const;
+    void setLabel(const QString &label);
+
+private:
+    Q_DISABLE_COPY(PerformanceMeasurement)
+
+    bool m_active = false;
+    PerformanceEntry::PerformanceCategory m_category;
+    QString m_name;
+    QUuid m_id;
+    QString m_detail;
+    QString m_label;
+    QString m_previousOwner;
+    QElapsedTimer m_timer;
+};
+
+}
+
+#endif // PERFORMANCEMONITOR_H
@@ -0,0 +1,258 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "compiledstateevaluator.h"
+#include "nymeacore.h"
+#include "integrations/thingmanager.h"
+#include "integrations/thing.h"
+#include "loggingcategories.h"
+
+namespace nymeaserver {
+
+static bool matches(const QVariant &descriptorValue, Types::ValueOperator operatorType, const QVariant &stateValue)
+{
+    QVariant convertedValue = descriptorValue;
+    if (convertedValue.type() != stateValue.type()) {
+        // Values are converted when compiling. Only happens if a plugin sets a value of the wrong type
+        if (!convertedValue.canConvert(stateValue.type())) {
+            return false;
+        }
+        convertedValue.convert(stateValue.type());
+    }
+    switch (operatorType) {
+    case Types::ValueOperatorEquals:
+        return convertedValue == stateValue;
+    case Types::ValueOperatorGreater:
+        return stateValue > convertedValue;
+    case Types::ValueOperatorGreaterOrEqual:
+        return stateValue >= convertedValue;
+    case Types::ValueOperatorLess:
+        return stateValue < convertedValue;
+    case Types::ValueOperatorLessOrEqual:
+        return stateValue <= convertedValue;
+    case Types::ValueOperatorNotEquals:
+        return convertedValue != stateValue;
+    }
+    return false;
+}
+
+CompiledStateEvaluator::CompiledStateEvaluator()
+{
+}
+
+CompiledStateEvaluator::CompiledStateEvaluator(const StateEvaluator &stateEvaluator)
+{
+    compile(stateEvaluator, -1);
+}
+
+/*! Returns true if the result of this evaluator may change when the state \a stateTypeId of the thing \a thingId changes. */
+bool CompiledStateEvaluator::dependsOn(const ThingId &thingId, const StateTypeId &stateTypeId) const
+{
+    QHash<ThingId, QHash<StateTypeId, QVector<int> > >::const_iterator it = m_dependencies.constFind(thingId);
+    return it != m_dependencies.constEnd() && it->contains(stateTypeId);
+}
+
+/*! Returns true if any descriptor of this evaluator refers to the thing \a thingId, whether it is configured or not. */
+bool CompiledStateEvaluator::references(const ThingId &thingId) const
+{
+    return m_thingIds.contains(thingId) || m_dependencies.contains(thingId);
+}
+
+/*! Returns true if any interface descriptor of this evaluator refers to one of the given \a interfaces. */
+bool CompiledStateEvaluator::references(const QStringList &interfaces) const
+{
+    foreach (const QString &interface, interfaces) {
+        if (m_interfaces.contains(interface)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*! Evaluates all nodes and returns the result. */
+bool CompiledStateEvaluator::evaluate()
+{
+    // Children are always stored after their parents, so walking backwards evaluates bottom up
+    for (int i = m_nodes.count() - 1; i >= 0; i--) {
+        Node &node = m_nodes[i];
+        node.descriptorResult = evaluateDescriptor(node);
+        node.result = evaluateNode(node);
+    }
+    return result();
+}
+
+/*! Re-evaluates only the nodes depending on the state \a stateTypeId of the thing \a thingId and their parents. Returns the new result. */
+bool CompiledStateEvaluator::update(const ThingId &thingId, const StateTypeId &stateTypeId)
+{
+    foreach (int index, m_dependencies.value(thingId).value(stateTypeId)) {
+        Node &node = m_nodes[index];
+        bool descriptorResult = evaluateDescriptor(node);
+        if (descriptorResult == node.descriptorResult) {
+            continue;
+        }
+        node.descriptorResult = descriptorResult;
+
+        // Propagate up until a node doesn't change any more
+        while (index >= 0) {
+            Node &current = m_nodes[index];
+            bool result = evaluateNode(current);
+            if (result == current.result) {
+                break;
+            }
+            current.result = result;
+            index = current.parent;
+        }
+    }
+    return result();
+}
+
+/*! Returns the result of the last evaluation. An empty evaluator is always true. */
+bool CompiledStateEvaluator::result() const
+{
+    return m_nodes.isEmpty() || m_nodes.first().result;
+}
+
+void CompiledStateEvaluator::compile(const StateEvaluator &stateEvaluator, int parent)
+{
+    int index = m_nodes.count();
+    m_nodes.append(Node());
+    if (parent >= 0) {
+        m_nodes[parent].children.append(index);
+    }
+
+    // Note: don't hold references into m_nodes while compiling children, it may reallocate
+    Node node;
+    node.parent = parent;
+    node.operatorType = stateEvaluator.operatorType();
+
+    StateDescriptor descriptor = stateEvaluator.stateDescriptor();
+    if (descriptor.isValid()) {
+        node.hasDescriptor = true;
+        node.valueOperator = descriptor.operatorType();
+        ThingManager *thingManager = NymeaCore::instance()->thingManager();
+        if (descriptor.type() == StateDescriptor::TypeThing) {
+            m_thingIds.insert(descriptor.thingId());
+            Thing *thing = thingManager->findConfiguredThing(descriptor.thingId());
+            if (!thing) {
+                qCWarning(dcRuleEngine) << "StateEvaluator: Thing" << descriptor.thingId() << "not existing!";
+            } else if (!thing->hasState(descriptor.stateTypeId())) {
+                qCWarning(dcRuleEngine) << "StateEvaluator: Thing" << thing->name() << "found, but it does not appear to have such a state!";
+            } else {
+                StateType stateType = thingManager->findThingClass(thing->thingClassId()).stateTypes().findById(descriptor.stateTypeId());
+                addTarget(node, index, thing, stateType, descriptor.stateValue());
+            }
+        } else {
+            m_interfaces.insert(descriptor.interface());
+            foreach (Thing *thing, thingManager->configuredThings()) {
+                ThingClass thingClass = thingManager->findThingClass(thing->thingClassId());
+                if (!thingClass.interfaces().contains(descriptor.interface())) {
+                    continue;
+                }
+                StateType stateType = thingClass.stateTypes().findByName(descriptor.interfaceState());
+                if (stateType.id().isNull()) {
+                    continue;
+                }
+                addTarget(node, index, thing, stateType, descriptor.stateValue());
+            }
+        }
+    }
+    m_nodes[index] = node;
+
+    foreach (const StateEvaluator &childEvaluator, stateEvaluator.childEvaluators()) {
+        compile(childEvaluator, index);
+    }
+}
+
+void CompiledStateEvaluator::addTarget(Node &node, int nodeIndex, Thing *thing, const StateType &stateType, const QVariant &value)
+{
+    Target target;
+    target.thing = thing;
+    target.stateTypeId = stateType.id();
+    target.value = value;
+    if (target.value.canConvert(stateType.type())) {
+        target.value.convert(stateType.type());
+    }
+    States states = thing->states();
+    for (int i = 0; i < states.count(); i++) {
+        if (states.at(i).stateTypeId() == stateType.id()) {
+            target.stateIndex = i;
+            break;
+        }
+    }
+    node.targets.append(target);
+    m_dependencies[thing->id()][stateType.id()].append(nodeIndex);
+}
+
+bool CompiledStateEvaluator::evaluateDescriptor(const Node &node) const
+{
+    if (!node.hasDescriptor) {
+        return true;
+    }
+    foreach (const Target &target, node.targets) {
+        States states = target.thing->states();
+        QVariant stateValue;
+        if (target.stateIndex >= 0 && target.stateIndex < states.count() && states.at(target.stateIndex).stateTypeId() == target.stateTypeId) {
+            stateValue = states.at(target.stateIndex).value();
+        } else {
+            stateValue = target.thing->stateValue(target.stateTypeId);
+        }
+        if (matches(target.value, node.valueOperator, stateValue)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool CompiledStateEvaluator::evaluateNode(const Node &node) const
+{
+    if (node.operatorType == Types::StateOperatorOr) {
+        if (node.hasDescriptor && node.descriptorResult) {
+            return true;
+        }
+        foreach (int child, node.children) {
+            if (m_nodes.at(child).result) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    if (!node.descriptorResult) {
+        return false;
+    }
+    foreach (int child, node.children) {
+        if (!m_nodes.at(child).result) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,99 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef COMPILEDSTATEEVALUATOR_H
+#define COMPILEDSTATEEVALUATOR_H
+
+#include "stateevaluator.h"
+#include "typeutils.h"
+#include "types/statetype.h"
+
+#include <QVector>
+#include <QHash>
+#include <QSet>
+
+class Thing;
+
+namespace nymeaserver {
+
+// A flattened form of a StateEvaluator tree. Things and state indices are resolved once
+// when compiling and interface descriptors are expanded to the matching things. It caches
+// the result of every node so a state change only re-evaluates the nodes depending on it.
+// Needs to be recompiled whenever a thing it references is added or removed.
+class CompiledStateEvaluator
+{
+public:
+    CompiledStateEvaluator();
+    explicit CompiledStateEvaluator(const StateEvaluator &stateEvaluator);
+
+    bool dependsOn(const ThingId &thingId, const StateTypeId &stateTypeId) const;
+    bool references(const ThingId &thingId) const;
+    bool references(const QStringList &interfaces) const;
+
+    bool evaluate();
+    bool update(const ThingId &thingId, const StateTypeId &stateTypeId);
+    bool result() const;
+
+private:
+    class Target {
+    public:
+        Thing *thing = nullptr;
+        int stateIndex = -1;
+        StateTypeId stateTypeId;
+        QVariant value;
+    };
+
+    class Node {
+    public:
+        int parent = -1;
+        Types::StateOperator operatorType = Types::StateOperatorAnd;
+        bool hasDescriptor = false;
+        Types::ValueOperator valueOperator = Types::ValueOperatorEquals;
+        QVector<Target> targets;
+        QVector<int> children;
+        bool descriptorResult = true;
+        bool result = true;
+    };
+
+    void compile(const StateEvaluator &stateEvaluator, int parent);
+    void addTarget(Node &node, int nodeIndex, Thing *thing, const StateType &stateType, const QVariant &value);
+    bool evaluateDescriptor(const Node &node) const;
+    bool evaluateNode(const Node &node) const;
+
+    QVector<Node> m_nodes;
+    QHash<ThingId, QHash<StateTypeId, QVector<int> > > m_dependencies;
+    // Everything the descriptors refer to, including things not configured (yet)
+    QSet<ThingId> m_thingIds;
+    QSet<QString> m_interfaces;
+};
+
+}
+
+#endif // COMPILEDSTATEEVALUATOR_H
@@ -54,6 +54,10 @@
     Will be emitted whenever a \l{Rule} changed his enable/disable status.
     The parameter \a rule holds the changed rule.*/
 
+/*! \fn void nymeaserver::RuleEngine::nextTimeEvaluationChanged(const QDateTime &dateTime)
+    Will be emitted whenever the schedule of the time based rules changed.
+    \a dateTime holds the point in time at which \l{evaluateTime()} should be called next.*/
+
 /*! \enum nymeaserver::RuleEngine::RuleError
     \value RuleErrorNoError
         No error happened. Everything is fine.
@@ -119,6 +123,7 @@
 #include "types/eventdescriptor.h"
 #include "types/paramdescriptor.h"
 #include "nymeasettings.h"
+#include "performancemonitor.h"
 #include "integrations/thingmanager.h"
 #include "integrations/thing.h"
 
@@ -126,20 +131,51 @@
 #include <QStringList>
 #include <QStandardPaths>
 #include <QCoreApplication>
+#include <QDataStream>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QFileInfo>
+#include <QFile>
 
 namespace nymeaserver {
 
-/*! Constructs the RuleEngine with the given \a parent. Although it wouldn't harm to have multiple RuleEngines, there is one
+/*! Constructs the RuleEngine with the given \a dbName and \a parent. Although it wouldn't harm to have multiple RuleEngines, there is one
     instance available from \l{NymeaCore}. This one should be used instead of creating multiple ones.
  */
-RuleEngine::RuleEngine(QObject *parent) :
+RuleEngine::RuleEngine(const QString &dbName, QObject *parent) :
     QObject(parent)
 {
+    m_db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), "rules");
+    m_db.setDatabaseName(dbName);
+
+    qCDebug(dcRuleEngine()) << "Opening rules database" << m_db.databaseName();
+
+    if (!m_db.isValid()) {
+        qCWarning(dcRuleEngine()) << "The database is not valid:" << m_db.lastError().driverText() << m_db.lastError().databaseText();
+        rotate(m_db.databaseName());
+    }
+
+    if (!initDB()) {
+        qCWarning(dcRuleEngine()) << "Error initializing rules database. Trying to correct it.";
+        if (QFileInfo(m_db.databaseName()).exists()) {
+            rotate(m_db.databaseName());
+            if (!initDB()) {
+                qCWarning(dcRuleEngine()) << "Error fixing rules database. Giving up. Rules can't be stored.";
+            }
+        }
+    }
 }
 
 /*! Destructor of the \l{RuleEngine}. */
 RuleEngine::~RuleEngine()
 {
+    m_db.close();
+}
+
+/*! Returns the file name of the database the rules are stored in. */
+QString RuleEngine::databaseName() const
+{
+    return m_db.databaseName();
 }
 
 /*! Ask the Engine to evaluate all the rules for the given \a event.
@@ -165,17 +201,34 @@ QList<Rule> RuleEngine::evaluateEvent(const Event &event)
         qCDebug(dcRuleEngineDebug).nospace().noquote() << "Evaluate event: " << thing->name() << " - " << eventType.name() << " (ThingId:" << thing->id().toString() << ", EventTypeId:" << eventType.id().toString() << ")" << endl << "     " << event.params();
     }
 
+    // State change events carry the StateTypeId as EventTypeId
+    StateTypeId stateTypeId = StateTypeId(event.eventTypeId());
+
     QList<Rule> rules;
     foreach (const RuleId &id, ruleIds()) {
         Rule rule = m_rules.value(id);
+        // Rule names are neither unique nor fixed
+        PerformanceMeasurement measurement(PerformanceEntry::PerformanceCategoryRule, rule.id());
+        if (measurement.active()) {
+            measurement.setLabel(rule.name());
+        }
+        m_evaluationCounter.increment();
+
+        // Keep the cached evaluator results up to date, even for disabled rules
+        CompiledStateEvaluator &stateEvaluator = m_stateEvaluators[id];
+        bool stateChanged = stateEvaluator.dependsOn(event.thingId(), stateTypeId);
+        if (stateChanged) {
+            stateEvaluator.update(event.thingId(), stateTypeId);
+        }
+
         if (!rule.enabled()) {
             qCDebug(dcRuleEngineDebug()).nospace().noquote() << "Skipping rule " << rule.name() << " (" << rule.id().toString() << ") "  << " because it is disabled.";
             continue;
         }
 
         // If we have a state based on this event
-        if (containsState(rule.stateEvaluator(), event)) {
-            rule.setStatesActive(rule.stateEvaluator().evaluate());
+        if (stateChanged) {
+            rule.setStatesActive(stateEvaluator.result());
             m_rules[rule.id()] = rule;
         }
 
@@ -216,23 +269,57 @@ QList<Rule> RuleEngine::evaluateEvent(const Event &event)
     return rules;
 }
 
-/*! Ask the Engine to evaluate all the rules for the given \a dateTime.
-    This will search all the \l{Rule}{Rules} triggered by the given \a dateTime
-    and evaluate their \l{CalendarItem}{CalendarItems} and \l{TimeEventItem}{TimeEventItems}.
+/*! Ask the Engine to evaluate the time based rules for the given \a dateTime.
+    Only the \l{Rule}{Rules} with a transition up to the given \a dateTime get their \l{CalendarItem}{CalendarItems}
+    and \l{TimeEventItem}{TimeEventItems} evaluated, all of them if the time jumped backwards.
     It will return a list of all \l{Rule}{Rules} that are triggered or change its active state.
+
+    \sa nextTimeEvaluation()
 */
 QList<Rule> RuleEngine::evaluateTime(const QDateTime &dateTime)
 {
-    // Initialize the last datetime if not already set (current time -1 second)
-    if (!m_lastEvaluationTime.isValid()) {
-        m_lastEvaluationTime = dateTime;
-        m_lastEvaluationTime = m_lastEvaluationTime.addSecs(-1);
+    // The rules to evaluate, each with the beginning of its evaluation interval
+    QList<QPair<RuleId, QDateTime> > dueRules;
+
+    if (!m_lastEvaluationTime.isValid() || dateTime < m_lastEvaluationTime) {
+        // First evaluation or the time jumped backwards, the whole schedule is outdated
+        qCDebug(dcRuleEngine()) << "Evaluating all time based rules for" << dateTime.toString("dd.MM.yyyy hh:mm:ss");
+        m_timeSchedule.clear();
+        m_scheduledRules.clear();
+        m_pendingTimeRules.clear();
+        foreach (const RuleId &ruleId, m_ruleIds) {
+            dueRules.append(qMakePair(ruleId, dateTime));
+        }
+    } else {
+        // New rules must not trigger time events from before they got added
+        foreach (const RuleId &ruleId, m_pendingTimeRules) {
+            dueRules.append(qMakePair(ruleId, dateTime));
+        }
+        m_pendingTimeRules.clear();
+
+        while (!m_timeSchedule.isEmpty() && m_timeSchedule.firstKey() <= dateTime) {
+            QMultiMap<QDateTime, RuleId>::iterator it = m_timeSchedule.begin();
+            // Include time events happening exactly at the transition
+            dueRules.append(qMakePair(it.value(), it.key().addMSecs(-1)));
+            m_scheduledRules.remove(it.value());
+            m_timeSchedule.erase(it);
+        }
     }
 
     QList<Rule> rules;
 
-    foreach (const Rule &r, m_rules.values()) {
-        Rule rule = m_rules.value(r.id());
+    for (int i = 0; i < dueRules.count(); i++) {
+        RuleId ruleId = dueRules.at(i).first;
+        QDateTime lastEvaluationTime = dueRules.at(i).second;
+        if (!m_rules.contains(ruleId))
+            continue;
+
+        Rule rule = m_rules.value(ruleId);
+        PerformanceMeasurement measurement(PerformanceEntry::PerformanceCategoryRule, rule.id());
+        if (measurement.active()) {
+            measurement.setLabel(rule.name());
+        }
+        m_evaluationCounter.increment();
         if (!rule.enabled()) {
             qCDebug(dcRuleEngineDebug()) << "Skipping rule" + rule.name() + "because it is disabled";
             continue;
@@ -244,7 +331,7 @@ QList<Rule> RuleEngine::evaluateTime(const QDateTime &dateTime)
 
         // Check if this rule is based on calendarItems
         if (!rule.timeDescriptor().calendarItems().isEmpty()) {
-            rule.setTimeActive(rule.timeDescriptor().evaluate(m_lastEvaluationTime, dateTime));
+            rule.setTimeActive(rule.timeDescriptor().evaluate(lastEvaluationTime, dateTime));
             m_rules[rule.id()] = rule;
 
             if (rule.timeDescriptor().timeEventItems().isEmpty() && rule.eventDescriptors().isEmpty()) {
@@ -272,15 +359,18 @@ QList<Rule> RuleEngine::evaluateTime(const QDateTime &dateTime)
 
         // If we have timeEvent items
         if (!rule.timeDescriptor().timeEventItems().isEmpty()) {
-            bool valid = rule.timeDescriptor().evaluate(m_lastEvaluationTime, dateTime);
+            bool valid = rule.timeDescriptor().evaluate(lastEvaluationTime, dateTime);
             if (valid && rule.timeActive()) {
                 qCDebug(dcRuleEngine) << "Rule" << rule.id() << "time event triggert.";
                 rules.append(rule);
             }
         }
+
+        scheduleTimeEvaluation(rule, dateTime);
     }
 
     m_lastEvaluationTime = dateTime;
+    updateNextTimeEvaluation();
 
     if (rules.count() > 0) { // Don't spam the log
         qCDebug(dcRuleEngine()) << "EvaluateTimeEvent evaluated" << rules.count() << "to be executed";
@@ -289,6 +379,23 @@ QList<Rule> RuleEngine::evaluateTime(const QDateTime &dateTime)
     return rules;
 }
 
+/*! Returns the point in time at which \l{evaluateTime()} needs to be called next. Returns an invalid
+    QDateTime if no time based rule is waiting for a transition.
+
+    \sa nextTimeEvaluationChanged()
+*/
+QDateTime RuleEngine::nextTimeEvaluation() const
+{
+    // Rules which have not been evaluated yet are due immediately
+    if (!m_pendingTimeRules.isEmpty())
+        return NymeaCore::instance()->timeManager()->currentDateTime();
+
+    if (m_timeSchedule.isEmpty())
+        return QDateTime();
+
+    return m_timeSchedule.firstKey();
+}
+
 /*! Add the given \a rule to the system. If the rule will be added
     from an edit request, the parameter \a fromEdit will be true.
 */
@@ -412,6 +519,7 @@ RuleEngine::RuleError RuleEngine::addRule(const Rule &rule, bool fromEdit)
     }
 
     appendRule(rule);
+    updateNextTimeEvaluation();
     saveRule(rule);
 
     if (!fromEdit)
@@ -436,10 +544,14 @@ RuleEngine::RuleError RuleEngine::editRule(const Rule &rule)
         return RuleErrorRuleNotFound;
     }
 
+    // Replace the stored record in one go, the old one stays if adding the new rule fails
+    m_db.transaction();
+
     // First remove old rule with this id
     RuleError removeResult = removeRule(oldRule.id(), true);
     if (removeResult != RuleErrorNoError) {
         qCWarning(dcRuleEngine) << "Cannot edit rule. Could not remove the old rule.";
+        m_db.rollback();
         // no need to restore, rule is still in system
         return removeResult;
     }
@@ -448,10 +560,13 @@ RuleEngine::RuleError RuleEngine::editRule(const Rule &rule)
     RuleError addResult = addRule(rule, true);
     if (addResult != RuleErrorNoError) {
         qCWarning(dcRuleEngine) << "Cannot edit rule. Could not add the new rule. Restoring the old rule.";
+        m_db.rollback();
         // restore old rule
         appendRule(oldRule);
+        updateNextTimeEvaluation();
         return addResult;
     }
+    m_db.commit();
 
     // Successfully changed the rule
     emit ruleConfigurationChanged(rule);
@@ -490,12 +605,17 @@ RuleEngine::RuleError RuleEngine::removeRule(const RuleId &ruleId, bool fromEdit
 
     m_ruleIds.takeAt(index);
     m_rules.remove(ruleId);
+    m_stateEvaluators.remove(ruleId);
     m_activeRules.removeAll(ruleId);
-
-    NymeaSettings settings(NymeaSettings::SettingsRoleRules);
-    settings.beginGroup(ruleId.toString());
-    settings.remove("");
-    settings.endGroup();
+    unscheduleTimeEvaluation(ruleId);
+    updateNextTimeEvaluation();
+
+    QSqlQuery query(m_db);
+    query.prepare("DELETE FROM rules WHERE id = ?;");
+    query.addBindValue(ruleId.toString());
+    if (!query.exec()) {
+        qCWarning(dcRuleEngine()) << "Error removing rule" << ruleId.toString() << "from database:" << query.lastError().databaseText() << query.lastError().driverText();
+    }
 
     if (!fromEdit)
         emit ruleRemoved(ruleId);
@@ -523,7 +643,11 @@ RuleEngine::RuleError RuleEngine::enableRule(const RuleId &ruleId)
 
     rule.setEnabled(true);
     m_rules[ruleId] = rule;
-    saveRule(rule);
+    saveRuleEnabled(ruleId, true);
+    if (!rule.timeDescriptor().isEmpty()) {
+        m_pendingTimeRules.append(ruleId);
+        updateNextTimeEvaluation();
+    }
     emit ruleConfigurationChanged(rule);
 
     NymeaCore::instance()->logEngine()->logRuleEnabledChanged(rule, true);
@@ -549,7 +673,9 @@ RuleEngine::RuleError RuleEngine::disableRule(const RuleId &ruleId)
 
     rule.setEnabled(false);
     m_rules[ruleId] = rule;
-    saveRule(rule);
+    saveRuleEnabled(ruleId, false);
+    unscheduleTimeEvaluation(ruleId);
+    updateNextTimeEvaluation();
     emit ruleConfigurationChanged(rule);
 
     NymeaCore::instance()->logEngine()->logRuleEnabledChanged(rule, false);
@@ -779,17 +905,10 @@ void RuleEngine::removeThingFromRule(const RuleId &id, const ThingId &thingId)
         exitActions.takeAt(removeIndexes.takeLast());
     }
 
-    // remove the rule from settings
-    NymeaSettings settings(NymeaSettings::SettingsRoleRules);
-    settings.beginGroup(id.toString());
-    settings.remove("");
-    settings.endGroup();
-
     if (actions.isEmpty() && exitActions.isEmpty()) {
         // The rule doesn't have any actions any more and is useless at this point... let's remove it altogether
         qCDebug(dcRuleEngine()) << "Rule" << rule.name() << "(" + rule.id().toString() + ")" << "does not have any actions any more. Removing it.";
-        m_rules.take(id);
-        emit ruleRemoved(id);
+        removeRule(id);
         return;
     }
 
@@ -802,12 +921,22 @@ void RuleEngine::removeThingFromRule(const RuleId &id, const ThingId &thingId)
     newRule.setActions(actions);
     newRule.setExitActions(exitActions);
     m_rules[id] = newRule;
+    m_stateEvaluators.insert(id, CompiledStateEvaluator(stateEvalatuator));
+    m_stateEvaluators[id].evaluate();
 
     // save it
     saveRule(newRule);
     emit ruleConfigurationChanged(newRule);
 }
 
+/*! Writes the rule evaluation metrics to the given \a writer. */
+void RuleEngine::writeMetrics(MetricsWriter *writer) const
+{
+    writer->writeGauge("nymea_rules", "Number of rules in the system.", m_rules.count());
+    writer->writeGauge("nymea_rules_active", "Number of currently active rules.", m_activeRules.count());
+    writer->writeCounter("nymea_rule_evaluations_total", "Number of rule evaluations.", m_evaluationCounter.value());
+}
+
 bool RuleEngine::containsEvent(const Rule &rule, const Event &event, const ThingClassId &thingClassId)
 {
     foreach (const EventDescriptor &eventDescriptor, rule.eventDescriptors()) {
@@ -894,31 +1023,6 @@ bool RuleEngine::containsEvent(const Rule &rule, const Event &event, const Thing
     return false;
 }
 
-bool RuleEngine::containsState(const StateEvaluator &stateEvaluator, const Event &stateChangeEvent)
-{
-    if (stateEvaluator.stateDescriptor().isValid()) {
-        if (stateEvaluator.stateDescriptor().type() == StateDescriptor::TypeThing) {
-            if (stateEvaluator.stateDescriptor().stateTypeId().toString() == stateChangeEvent.eventTypeId().toString()) {
-                return true;
-            }
-        } else {
-            Thing *thing = NymeaCore::instance()->thingManager()->findConfiguredThing(stateChangeEvent.thingId());
-            ThingClass thingClass = NymeaCore::instance()->thingManager()->findThingClass(thing->thingClassId());
-            if (thingClass.interfaces().contains(stateEvaluator.stateDescriptor().interface())) {
-                return true;
-            }
-        }
-    }
-
-    foreach (const StateEvaluator &childEvaluator, stateEvaluator.childEvaluators()) {
-        if (containsState(childEvaluator, stateChangeEvent)) {
-            return true;
-        }
-    }
-
-    return false;
-}
-
 RuleEngine::RuleError RuleEngine::checkRuleAction(const RuleAction &ruleAction, const Rule &rule)
 {
     if (!ruleAction.isValid()) {
@@ -1096,171 +1200,107 @@ QVariant::Type RuleEngine::getEventParamType(const EventTypeId &eventTypeId, con
     return QVariant::Invalid;
 }
 
-void RuleEngine::appendRule(const Rule &rule)
+void RuleEngine::onThingAdded(Thing *thing)
 {
-    Rule newRule = rule;
-    newRule.setStatesActive(newRule.stateEvaluator().evaluate());
-    qCDebug(dcRuleEngine()) << "Adding Rule:" << newRule;
-    m_rules.insert(rule.id(), newRule);
-    m_ruleIds.append(rule.id());
+    QStringList interfaces = NymeaCore::instance()->thingManager()->findThingClass(thing->thingClassId()).interfaces();
+    foreach (const RuleId &ruleId, m_ruleIds) {
+        const CompiledStateEvaluator &stateEvaluator = m_stateEvaluators[ruleId];
+        if (stateEvaluator.references(thing->id()) || stateEvaluator.references(interfaces)) {
+            recompileStateEvaluator(ruleId);
+        }
+    }
 }
 
-void RuleEngine::saveRule(const Rule &rule)
+void RuleEngine::onThingRemoved(const ThingId &thingId)
 {
-    NymeaSettings settings(NymeaSettings::SettingsRoleRules);
-    settings.beginGroup(rule.id().toString());
-    settings.setValue("name", rule.name());
-    settings.setValue("enabled", rule.enabled());
-    settings.setValue("executable", rule.executable());
-
-    // Save timeDescriptor
-    settings.beginGroup("timeDescriptor");
-    if (!rule.timeDescriptor().isEmpty()) {
-        settings.beginGroup("calendarItems");
-        for (int i = 0; i < rule.timeDescriptor().calendarItems().count(); i++) {
-            settings.beginGroup("CalendarItem-" + QString::number(i));
-
-            const CalendarItem &calendarItem = rule.timeDescriptor().calendarItems().at(i);
-            if (calendarItem.dateTime().isValid())
-                settings.setValue("dateTime", calendarItem.dateTime().toTime_t());
-
-            if (calendarItem.startTime().isValid())
-                settings.setValue("startTime", calendarItem.startTime().toString("hh:mm"));
-
-            settings.setValue("duration", calendarItem.duration());
-            settings.setValue("mode", calendarItem.repeatingOption().mode());
-
-            // Save weekDays
-            settings.beginWriteArray("weekDays");
-            for (int i = 0; i < calendarItem.repeatingOption().weekDays().count(); ++i) {
-                settings.setArrayIndex(i);
-                settings.setValue("weekDay", calendarItem.repeatingOption().weekDays().at(i));
-            }
-            settings.endArray();
-
-            // Save monthDays
-            settings.beginWriteArray("monthDays");
-            for (int i = 0; i < calendarItem.repeatingOption().monthDays().count(); ++i) {
-                settings.setArrayIndex(i);
-                settings.setValue("monthDay", calendarItem.repeatingOption().monthDays().at(i));
-            }
-            settings.endArray();
-
-            settings.endGroup();
+    // Interface descriptors matching the thing depend on it too, so this covers them as well
+    foreach (const RuleId &ruleId, m_ruleIds) {
+        if (m_stateEvaluators[ruleId].references(thingId)) {
+            recompileStateEvaluator(ruleId);
         }
-        settings.endGroup();
+    }
+}
 
-        settings.beginGroup("timeEventItems");
-        for (int i = 0; i < rule.timeDescriptor().timeEventItems().count(); i++) {
-            settings.beginGroup("TimeEventItem-" + QString::number(i));
-            const TimeEventItem &timeEventItem = rule.timeDescriptor().timeEventItems().at(i);
+void RuleEngine::recompileStateEvaluator(const RuleId &ruleId)
+{
+    Rule &rule = m_rules[ruleId];
+    CompiledStateEvaluator stateEvaluator(rule.stateEvaluator());
+    bool statesActive = stateEvaluator.evaluate();
+    m_stateEvaluators.insert(ruleId, stateEvaluator);
+
+    // Rules without events pick this up on the next evaluation, just like after any other state change
+    if (rule.statesActive() != statesActive) {
+        qCDebug(dcRuleEngine()).nospace().noquote() << "States of rule " << rule.name() << " (" << rule.id().toString() << ") " << (statesActive ? "matching" : "not matching any more") << " after things changed.";
+        rule.setStatesActive(statesActive);
+    }
+}
 
-            if (timeEventItem.dateTime().isValid())
-                settings.setValue("dateTime", timeEventItem.dateTime().toTime_t());
+void RuleEngine::appendRule(const Rule &rule)
+{
+    Rule newRule = rule;
+    CompiledStateEvaluator stateEvaluator(newRule.stateEvaluator());
+    newRule.setStatesActive(stateEvaluator.evaluate());
+    m_stateEvaluators.insert(rule.id(), stateEvaluator);
+    qCDebug(dcRuleEngine()) << "Adding Rule:" << newRule;
+    m_rules.insert(rule.id(), newRule);
+    m_ruleIds.append(rule.id());
 
-            if (timeEventItem.time().isValid())
-                settings.setValue("time", timeEventItem.time().toString("hh:mm"));
+    // Time based rules get scheduled on their first evaluation
+    if (newRule.enabled() && !newRule.timeDescriptor().isEmpty())
+        m_pendingTimeRules.append(rule.id());
+}
 
-            settings.setValue("mode", timeEventItem.repeatingOption().mode());
+void RuleEngine::scheduleTimeEvaluation(const Rule &rule, const QDateTime &dateTime)
+{
+    unscheduleTimeEvaluation(rule.id());
 
-            // Save weekDays
-            settings.beginWriteArray("weekDays");
-            for (int i = 0; i < timeEventItem.repeatingOption().weekDays().count(); ++i) {
-                settings.setArrayIndex(i);
-                settings.setValue("weekDay", timeEventItem.repeatingOption().weekDays().at(i));
-            }
-            settings.endArray();
+    QDateTime nextTransition = rule.timeDescriptor().nextTransition(dateTime);
+    if (!nextTransition.isValid())
+        return;
 
-            // Save monthDays
-            settings.beginWriteArray("monthDays");
-            for (int i = 0; i < timeEventItem.repeatingOption().monthDays().count(); ++i) {
-                settings.setArrayIndex(i);
-                settings.setValue("monthDay", timeEventItem.repeatingOption().monthDays().at(i));
-            }
-            settings.endArray();
+    m_timeSchedule.insert(nextTransition, rule.id());
+    m_scheduledRules.insert(rule.id(), nextTransition);
+}
 
-            settings.endGroup();
-        }
-        settings.endGroup();
+void RuleEngine::unscheduleTimeEvaluation(const RuleId &ruleId)
+{
+    m_pendingTimeRules.removeAll(ruleId);
+    if (m_scheduledRules.contains(ruleId)) {
+        m_timeSchedule.remove(m_scheduledRules.take(ruleId), ruleId);
     }
-    settings.endGroup();
+}
 
-    // Save Events / EventDescriptors
-    settings.beginGroup("events");
-    for (int i = 0; i < rule.eventDescriptors().count(); i++) {
-        const EventDescriptor &eventDescriptor = rule.eventDescriptors().at(i);
-        settings.beginGroup("EventDescriptor-" + QString::number(i));
-        settings.setValue("thingId", eventDescriptor.thingId().toString());
-        settings.setValue("eventTypeId", eventDescriptor.eventTypeId().toString());
-        settings.setValue("interface", eventDescriptor.interface());
-        settings.setValue("interfaceEvent", eventDescriptor.interfaceEvent());
+void RuleEngine::updateNextTimeEvaluation()
+{
+    emit nextTimeEvaluationChanged(nextTimeEvaluation());
+}
 
-        foreach (const ParamDescriptor &paramDescriptor, eventDescriptor.paramDescriptors()) {
-            if (!paramDescriptor.paramTypeId().isNull()) {
-                settings.beginGroup("ParamDescriptor-" + paramDescriptor.paramTypeId().toString());
-            } else {
-                settings.beginGroup("ParamDescriptor-" + paramDescriptor.paramName());
-            }
-            settings.setValue("valueType", static_cast<int>(paramDescriptor.value().type()));
-            settings.setValue("value", paramDescriptor.value());
-            settings.setValue("operator", paramDescriptor.operatorType());
-            settings.endGroup();
-        }
-        settings.endGroup();
+void RuleEngine::saveRule(const Rule &rule)
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    writeRule(stream, rule);
+
+    QSqlQuery query(m_db);
+    query.prepare("INSERT OR REPLACE INTO rules (id, enabled, data) VALUES (?, ?, ?);");
+    query.addBindValue(rule.id().toString());
+    query.addBindValue(rule.enabled());
+    query.addBindValue(data);
+    if (!query.exec()) {
+        qCWarning(dcRuleEngine()) << "Error saving rule" << rule.id().toString() << "to database:" << query.lastError().databaseText() << query.lastError().driverText();
+        return;
     }
-    settings.endGroup();
-
-    // Save StateEvaluator
-    rule.stateEvaluator().dumpToSettings(settings, "stateEvaluator");
-
-    // Save ruleActions
-    settings.beginGroup("ruleActions");
-    saveRuleActions(&settings, rule.actions());
-    settings.endGroup();
-
-    // Save ruleExitActions
-    settings.beginGroup("ruleExitActions");
-    saveRuleActions(&settings, rule.exitActions());
-    settings.endGroup();
-    qCDebug(dcRuleEngineDebug()) << "Saved rule to config:" << rule;
+    qCDebug(dcRuleEngineDebug()) << "Saved rule to database:" << rule;
 }
 
-void RuleEngine::saveRuleActions(NymeaSettings *settings, const QList<RuleAction> &ruleActions)
+void RuleEngine::saveRuleEnabled(const RuleId &ruleId, bool enabled)
 {
-    int i = 0;
-    foreach (const RuleAction &action, ruleActions) {
-        settings->beginGroup(QString::number(i));
-        if (action.type() == RuleAction::TypeThing) {
-            settings->setValue("thingId", action.thingId().toString());
-            settings->setValue("actionTypeId", action.actionTypeId().toString());
-        } else if (action.type() == RuleAction::TypeBrowser) {
-            settings->setValue("thingId", action.thingId().toString());
-            settings->setValue("browserItemId", action.browserItemId());
-        } else if (action.type() == RuleAction::TypeInterface){
-            settings->setValue("interface", action.interface());
-            settings->setValue("interfaceAction", action.interfaceAction());
-        } else {
-            Q_ASSERT_X(false, "RuleEngine::saveRule", "Unhandled rule action type.");
-        }
-        foreach (const RuleActionParam &param, action.ruleActionParams()) {
-            if (!param.paramTypeId().isNull()) {
-                settings->beginGroup("RuleActionParam-" + param.paramTypeId().toString());
-            } else {
-                settings->beginGroup("RuleActionParam-" + param.paramName());
-            }
-            settings->setValue("valueType", static_cast<int>(param.value().type()));
-            settings->setValue("value", param.value());
-            if (param.isEventBased()) {
-                settings->setValue("eventTypeId", param.eventTypeId().toString());
-                settings->setValue("eventParamTypeId", param.eventParamTypeId());
-            } else if (param.isStateBased()) {
-                settings->setValue("stateThingId", param.stateThingId().toString());
-                settings->setValue("stateTypeId", param.stateTypeId());
-            }
-            settings->endGroup();
-        }
-        i++;
-        settings->endGroup();
+    QSqlQuery query(m_db);
+    query.prepare("UPDATE rules SET enabled = ? WHERE id = ?;");
+    query.addBindValue(enabled);
+    query.addBindValue(ruleId.toString());
+    if (!query.exec()) {
+        qCWarning(dcRuleEngine()) << "Error updating rule" << ruleId.toString() << "in database:" << query.lastError().databaseText() << query.lastError().driverText();
     }
 }
 
@@ -1339,8 +1379,279 @@ QList<RuleAction> RuleEngine::loadRuleActions(NymeaSettings *settings)
     return actions;
 }
 
+static void writeRepeatingOption(QDataStream &stream, const RepeatingOption &repeatingOption)
+{
+    stream << static_cast<qint32>(repeatingOption.mode()) << repeatingOption.weekDays() << repeatingOption.monthDays();
+}
+
+static RepeatingOption readRepeatingOption(QDataStream &stream)
+{
+    qint32 mode;
+    QList<int> weekDays;
+    QList<int> monthDays;
+    stream >> mode >> weekDays >> monthDays;
+    return RepeatingOption(static_cast<RepeatingOption::RepeatingMode>(mode), weekDays, monthDays);
+}
+
+static void writeRuleActions(QDataStream &stream, const QList<RuleAction> &ruleActions)
+{
+    stream << static_cast<quint32>(ruleActions.count());
+    foreach (const RuleAction &action, ruleActions) {
+        stream << action.thingId() << action.actionTypeId() << action.browserItemId() << action.interface() << action.interfaceAction();
+        stream << static_cast<quint32>(action.ruleActionParams().count());
+        foreach (const RuleActionParam &param, action.ruleActionParams()) {
+            stream << param.paramTypeId() << param.paramName() << param.value();
+            stream << param.eventTypeId() << param.eventParamTypeId() << param.stateThingId() << param.stateTypeId();
+        }
+    }
+}
+
+static QList<RuleAction> readRuleActions(QDataStream &stream)
+{
+    QList<RuleAction> actions;
+    quint32 count;
+    stream >> count;
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; i++) {
+        QUuid thingId, actionTypeId;
+        QString browserItemId, interface, interfaceAction;
+        quint32 paramCount;
+        stream >> thingId >> actionTypeId >> browserItemId >> interface >> interfaceAction >> paramCount;
+
+        RuleActionParams params;
+        for (quint32 j = 0; j < paramCount && stream.status() == QDataStream::Ok; j++) {
+            QUuid paramTypeId, eventTypeId, eventParamTypeId, stateThingId, stateTypeId;
+            QString paramName;
+            QVariant value;
+            stream >> paramTypeId >> paramName >> value >> eventTypeId >> eventParamTypeId >> stateThingId >> stateTypeId;
+            RuleActionParam param = paramTypeId.isNull() ? RuleActionParam(paramName, value) : RuleActionParam(ParamTypeId(paramTypeId), value);
+            param.setEventTypeId(eventTypeId);
+            param.setEventParamTypeId(eventParamTypeId);
+            param.setStateThingId(stateThingId);
+            param.setStateTypeId(stateTypeId);
+            params.append(param);
+        }
+
+        if (!actionTypeId.isNull()) {
+            actions.append(RuleAction(ActionTypeId(actionTypeId), ThingId(thingId), params));
+        } else if (!browserItemId.isEmpty()) {
+            actions.append(RuleAction(ThingId(thingId), browserItemId));
+        } else {
+            actions.append(RuleAction(interface, interfaceAction, params));
+        }
+    }
+    return actions;
+}
+
+void RuleEngine::writeRule(QDataStream &stream, const Rule &rule)
+{
+    stream << rule.id() << rule.name() << rule.enabled() << rule.executable();
+
+    stream << static_cast<quint32>(rule.timeDescriptor().calendarItems().count());
+    foreach (const CalendarItem &calendarItem, rule.timeDescriptor().calendarItems()) {
+        stream << calendarItem.dateTime() << calendarItem.startTime() << calendarItem.duration();
+        writeRepeatingOption(stream, calendarItem.repeatingOption());
+    }
+    stream << static_cast<quint32>(rule.timeDescriptor().timeEventItems().count());
+    foreach (const TimeEventItem &timeEventItem, rule.timeDescriptor().timeEventItems()) {
+        stream << timeEventItem.dateTime() << timeEventItem.time();
+        writeRepeatingOption(stream, timeEventItem.repeatingOption());
+    }
+
+    stream << static_cast<quint32>(rule.eventDescriptors().count());
+    foreach (const EventDescriptor &eventDescriptor, rule.eventDescriptors()) {
+        stream << eventDescriptor.eventTypeId() << eventDescriptor.thingId() << eventDescriptor.interface() << eventDescriptor.interfaceEvent();
+        stream << static_cast<quint32>(eventDescriptor.paramDescriptors().count());
+        foreach (const ParamDescriptor &paramDescriptor, eventDescriptor.paramDescriptors()) {
+            stream << paramDescriptor.paramTypeId() << paramDescriptor.paramName() << paramDescriptor.value() << static_cast<qint32>(paramDescriptor.operatorType());
+        }
+    }
+
+    rule.stateEvaluator().dumpToStream(stream);
+    writeRuleActions(stream, rule.actions());
+    writeRuleActions(stream, rule.exitActions());
+}
+
+Rule RuleEngine::readRule(QDataStream &stream)
+{
+    QUuid id;
+    QString name;
+    bool enabled, executable;
+    stream >> id >> name >> enabled >> executable;
+
+    QList<CalendarItem> calendarItems;
+    quint32 count;
+    stream >> count;
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; i++) {
+        QDateTime dateTime;
+        QTime startTime;
+        uint duration;
+        stream >> dateTime >> startTime >> duration;
+        CalendarItem calendarItem;
+        calendarItem.setDateTime(dateTime);
+        calendarItem.setStartTime(startTime);
+        calendarItem.setDuration(duration);
+        calendarItem.setRepeatingOption(readRepeatingOption(stream));
+        calendarItems.append(calendarItem);
+    }
+
+    QList<TimeEventItem> timeEventItems;
+    stream >> count;
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; i++) {
+        QDateTime dateTime;
+        QTime time;
+        stream >> dateTime >> time;
+        TimeEventItem timeEventItem;
+        timeEventItem.setDateTime(dateTime);
+        timeEventItem.setTime(time);
+        timeEventItem.setRepeatingOption(readRepeatingOption(stream));
+        timeEventItems.append(timeEventItem);
+    }
+
+    TimeDescriptor timeDescriptor;
+    timeDescriptor.setCalendarItems(calendarItems);
+    timeDescriptor.setTimeEventItems(timeEventItems);
+
+    QList<EventDescriptor> eventDescriptors;
+    stream >> count;
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; i++) {
+        QUuid eventTypeId, thingId;
+        QString interface, interfaceEvent;
+        quint32 paramCount;
+        stream >> eventTypeId >> thingId >> interface >> interfaceEvent >> paramCount;
+
+        QList<ParamDescriptor> params;
+        for (quint32 j = 0; j < paramCount && stream.status() == QDataStream::Ok; j++) {
+            QUuid paramTypeId;
+            QString paramName;
+            QVariant value;
+            qint32 operatorType;
+            stream >> paramTypeId >> paramName >> value >> operatorType;
+            ParamDescriptor paramDescriptor = paramTypeId.isNull() ? ParamDescriptor(paramName, value) : ParamDescriptor(ParamTypeId(paramTypeId), value);
+            paramDescriptor.setOperatorType(static_cast<Types::ValueOperator>(operatorType));
+            params.append(paramDescriptor);
+        }
+
+        if (!eventTypeId.isNull()) {
+            eventDescriptors.append(EventDescriptor(eventTypeId, thingId, params));
+        } else {
+            eventDescriptors.append(EventDescriptor(interface, interfaceEvent, params));
+        }
+    }
+
+    StateEvaluator stateEvaluator = StateEvaluator::loadFromStream(stream);
+    QList<RuleAction> actions = readRuleActions(stream);
+    QList<RuleAction> exitActions = readRuleActions(stream);
+
+    Rule rule;
+    rule.setId(id);
+    rule.setName(name);
+    rule.setTimeDescriptor(timeDescriptor);
+    rule.setEventDescriptors(eventDescriptors);
+    rule.setStateEvaluator(stateEvaluator);
+    rule.setActions(actions);
+    rule.setExitActions(exitActions);
+    rule.setEnabled(enabled);
+    rule.setExecutable(executable);
+    return rule;
+}
+
+bool RuleEngine::initDB()
+{
+    m_db.close();
+
+    if (!m_db.open()) {
+        qCWarning(dcRuleEngine()) << "Can't open rules database. Init failed.";
+        return false;
+    }
+
+    if (!m_db.tables().contains("rules")) {
+        qCDebug(dcRuleEngine()) << "Empty rules database. Setting up metadata...";
+        m_db.exec("CREATE TABLE rules (id VARCHAR(40) PRIMARY KEY, enabled BOOLEAN, data BLOB);");
+        if (m_db.lastError().isValid()) {
+            qCWarning(dcRuleEngine()) << "Error initializing rules database. Driver error:" << m_db.lastError().driverText() << "Database error:" << m_db.lastError().databaseText();
+            m_db.close();
+            return false;
+        }
+    }
+
+    qCDebug(dcRuleEngine()) << "Rules database initialized successfully.";
+    return true;
+}
+
+void RuleEngine::rotate(const QString &dbName)
+{
+    int index = 1;
+    while (QFileInfo(QString("%1.%2").arg(dbName).arg(index)).exists()) {
+        index++;
+    }
+    qCDebug(dcRuleEngine()) << "Backing up old database file to" << QString("%1.%2").arg(dbName).arg(index);
+    QFile f(dbName);
+    if (!f.rename(QString("%1.%2").arg(dbName).arg(index))) {
+        qCWarning(dcRuleEngine()) << "Error backing up old database.";
+    } else {
+        qCDebug(dcRuleEngine()) << "Successfully moved old database";
+    }
+}
+
+void RuleEngine::migrateRulesSettings()
+{
+    QString settingsFileName = NymeaSettings::settingsFileName(NymeaSettings::SettingsRoleRules);
+    if (!QFile::exists(settingsFileName)) {
+        return;
+    }
+
+    QList<Rule> rules = loadRulesSettings();
+    if (!rules.isEmpty()) {
+        qCDebug(dcRuleEngine()) << "Migrating" << rules.count() << "rules from" << settingsFileName << "to the rules database";
+        m_db.transaction();
+        foreach (const Rule &rule, rules) {
+            saveRule(rule);
+        }
+        if (!m_db.commit()) {
+            qCWarning(dcRuleEngine()) << "Error migrating rules to database:" << m_db.lastError().databaseText() << m_db.lastError().driverText();
+            return;
+        }
+    }
+
+    // Keep the old file around for downgrades, but don't import it again
+    QFile::remove(settingsFileName + ".migrated");
+    if (!QFile::rename(settingsFileName, settingsFileName + ".migrated")) {
+        qCWarning(dcRuleEngine()) << "Error moving migrated rules settings" << settingsFileName;
+    }
+}
+
 void RuleEngine::init()
 {
+    // Things are resolved when compiling the state evaluators
+    connect(NymeaCore::instance()->thingManager(), &ThingManager::thingAdded, this, &RuleEngine::onThingAdded);
+    connect(NymeaCore::instance()->thingManager(), &ThingManager::thingRemoved, this, &RuleEngine::onThingRemoved);
+
+    migrateRulesSettings();
+
+    qCDebug(dcRuleEngine) << "Loading rules from" << m_db.databaseName();
+    QSqlQuery query(m_db);
+    if (!query.exec("SELECT id, enabled, data FROM rules ORDER BY id;")) {
+        qCWarning(dcRuleEngine()) << "Error loading rules from database:" << query.lastError().databaseText() << query.lastError().driverText();
+        return;
+    }
+
+    while (query.next()) {
+        QByteArray data = query.value("data").toByteArray();
+        QDataStream stream(data);
+        Rule rule = readRule(stream);
+        if (stream.status() != QDataStream::Ok || rule.id() != RuleId(query.value("id").toString())) {
+            qCWarning(dcRuleEngine()) << "Not loading rule" << query.value("id").toString() << "because the stored record is corrupt.";
+            continue;
+        }
+        rule.setEnabled(query.value("enabled").toBool());
+        qCDebug(dcRuleEngine) << "Loading rule" << rule.name() << rule.id().toString();
+        appendRule(rule);
+    }
+}
+
+QList<Rule> RuleEngine::loadRulesSettings()
+{
+    QList<Rule> rules;
     NymeaSettings settings(NymeaSettings::SettingsRoleRules);
     qCDebug(dcRuleEngine) << "Loading rules from" << settings.fileName();
     foreach (const QString &idString, settings.childGroups()) {
@@ -1524,10 +1835,10 @@ void RuleEngine::init()
         rule.setExitActions(exitActions);
         rule.setEnabled(enabled);
         rule.setExecutable(executable);
-        rule.setStatesActive(rule.stateEvaluator().evaluate());
-        appendRule(rule);
+        rules.append(rule);
         settings.endGroup();
     }
+    return rules;
 
 }
 
@@ -33,13 +33,19 @@
 
 #include "rule.h"
 #include "stateevaluator.h"
+#include "compiledstateevaluator.h"
 #include "types/event.h"
 #include "types/thingclass.h"
+#include "metrics.h"
 
 #include <QObject>
 #include <QList>
 #include <QUuid>
 #include <QSettings>
+#include <QSqlDatabase>
+#include <QMultiMap>
+
+class QDataStream;
 
 namespace nymeaserver {
 
@@ -78,12 +84,15 @@ public:
     };
     Q_ENUM(RemovePolicy)
 
-    explicit RuleEngine(QObject *parent = nullptr);
+    explicit RuleEngine(const QString &dbName, QObject *parent = nullptr);
     ~RuleEngine();
     void init();
 
+    QString databaseName() const;
+
     QList<Rule> evaluateEvent(const Event &event);
     QList<Rule> evaluateTime(const QDateTime &dateTime);
+    QDateTime nextTimeEvaluation() const;
 
     RuleError addRule(const Rule &rule, bool fromEdit = false);
     RuleError editRule(const Rule &rule);
@@ -105,14 +114,16 @@ public:
 
     void removeThingFromRule(const RuleId &id, const ThingId &thingId);
 
+    void writeMetrics(MetricsWriter *writer) const;
+
 signals:
     void ruleAdded(const Rule &rule);
     void ruleRemoved(const RuleId &ruleId);
     void ruleConfigurationChanged(const Rule &rule);
+    void nextTimeEvaluationChanged(const QDateTime &dateTime);
 
 private:
     bool containsEvent(const Rule &rule, const Event &event, const ThingClassId &thingClassId);
-    bool containsState(const StateEvaluator &stateEvaluator, const Event &stateChangeEvent);
 
     RuleError checkRuleAction(const RuleAction &ruleAction, const Rule &rule);
     RuleError checkRuleActionParam(const RuleActionParam &ruleActionParam, const ActionType &actionType, const Rule &rule);
@@ -120,17 +131,44 @@ private:
     QVariant::Type getActionParamType(const ActionTypeId &actionTypeId, const ParamTypeId &paramTypeId);
     QVariant::Type getEventParamType(const EventTypeId &eventTypeId, const ParamTypeId &paramTypeId);
 
+    void onThingAdded(Thing *thing);
+    void onThingRemoved(const ThingId &thingId);
+    void recompileStateEvaluator(const RuleId &ruleId);
+    void scheduleTimeEvaluation(const Rule &rule, const QDateTime &dateTime);
+    void unscheduleTimeEvaluation(const RuleId &ruleId);
+    void updateNextTimeEvaluation();
     void appendRule(const Rule &rule);
     void saveRule(const Rule &rule);
-    void saveRuleActions(NymeaSettings *settings, const QList<RuleAction> &ruleActions);
+    void saveRuleEnabled(const RuleId &ruleId, bool enabled);
+
+    static void writeRule(QDataStream &stream, const Rule &rule);
+    static Rule readRule(QDataStream &stream);
+
+    bool initDB();
+    void rotate(const QString &dbName);
+
+    // Migration from rules.conf (nymea <= 0.22)
+    void migrateRulesSettings();
+    QList<Rule> loadRulesSettings();
     QList<RuleAction> loadRuleActions(NymeaSettings *settings);
 
 private:
+    QSqlDatabase m_db;
+
     QList<RuleId> m_ruleIds; // Keeping a list of RuleIds to keep sorting order...
     QHash<RuleId, Rule> m_rules; // ...but use a Hash for faster finding
+    QHash<RuleId, CompiledStateEvaluator> m_stateEvaluators;
     QList<RuleId> m_activeRules;
 
     QDateTime m_lastEvaluationTime;
+
+    // Time based rules ordered by their next transition
+    QMultiMap<QDateTime, RuleId> m_timeSchedule;
+    QHash<RuleId, QDateTime> m_scheduledRules;
+    // Time based rules which have not been evaluated since they got added or enabled
+    QList<RuleId> m_pendingTimeRules;
+
+    MetricsCounter m_evaluationCounter;
 };
 
 }
@@ -35,6 +35,8 @@
 #include "loggingcategories.h"
 #include "nymeasettings.h"
 
+#include <QDataStream>
+
 namespace nymeaserver {
 
 StateEvaluator::StateEvaluator(const StateDescriptor &stateDescriptor):
@@ -263,6 +265,45 @@ StateEvaluator StateEvaluator::loadFromSettings(NymeaSettings &settings, const Q
     return ret;
 }
 
+void StateEvaluator::dumpToStream(QDataStream &stream) const
+{
+    stream << m_stateDescriptor.stateTypeId() << m_stateDescriptor.thingId();
+    stream << m_stateDescriptor.interface() << m_stateDescriptor.interfaceState();
+    stream << m_stateDescriptor.stateValue() << static_cast<qint32>(m_stateDescriptor.operatorType());
+    stream << static_cast<qint32>(m_operatorType);
+
+    stream << static_cast<quint32>(m_childEvaluators.count());
+    foreach (const StateEvaluator &childEvaluator, m_childEvaluators) {
+        childEvaluator.dumpToStream(stream);
+    }
+}
+
+StateEvaluator StateEvaluator::loadFromStream(QDataStream &stream)
+{
+    QUuid stateTypeId, thingId;
+    QString interface, interfaceState;
+    QVariant stateValue;
+    qint32 valueOperator, stateOperator;
+    stream >> stateTypeId >> thingId >> interface >> interfaceState >> stateValue >> valueOperator >> stateOperator;
+
+    StateDescriptor stateDescriptor;
+    if (!thingId.isNull() && !stateTypeId.isNull()) {
+        stateDescriptor = StateDescriptor(stateTypeId, thingId, stateValue, static_cast<Types::ValueOperator>(valueOperator));
+    } else {
+        stateDescriptor = StateDescriptor(interface, interfaceState, stateValue, static_cast<Types::ValueOperator>(valueOperator));
+    }
+
+    StateEvaluator ret(stateDescriptor);
+    ret.setOperatorType(static_cast<Types::StateOperator>(stateOperator));
+
+    quint32 childCount;
+    stream >> childCount;
+    for (quint32 i = 0; i < childCount && stream.status() == QDataStream::Ok; i++) {
+        ret.appendEvaluator(StateEvaluator::loadFromStream(stream));
+    }
+    return ret;
+}
+
 bool StateEvaluator::isValid() const
 {
     if (m_stateDescriptor.isValid()) {
@@ -37,6 +37,7 @@
 #include <QDebug>
 
 class NymeaSettings;
+class QDataStream;
 
 namespace nymeaserver {
 class StateEvaluator;
@@ -80,6 +81,8 @@ public:
 
     void dumpToSettings(NymeaSettings &settings, const QString &groupName) const;
     static StateEvaluator loadFromSettings(NymeaSettings &settings, const QString &groupPrefix);
+    void dumpToStream(QDataStream &stream) const;
+    static StateEvaluator loadFromStream(QDataStream &stream);
 
     bool isValid() const;
     bool isEmpty() const;
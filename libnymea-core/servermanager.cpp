@@ -57,6 +57,7 @@
 #include "servers/webserver.h"
 #include "servers/bluetoothserver.h"
 #include "servers/mqttbroker.h"
+#include "servers/tlssessioncache.h"
 
 #include "network/zeroconf/zeroconfservicepublisher.h"
 
@@ -105,6 +106,10 @@ ServerManager::ServerManager(Platform *platform, NymeaConfiguration *configurati
             m_sslConfiguration.setProtocol(QSsl::TlsV1_2OrLater);
             m_sslConfiguration.setPrivateKey(m_certificateKey);
             m_sslConfiguration.setLocalCertificate(m_certificate);
+            m_sslConfiguration.setSslOption(QSsl::SslOptionDisableSessionTickets, false);
+
+            // Allow reconnecting clients to resume their TLS session instead of doing a full handshake
+            TlsSessionCache::instance()->enable(m_certificate.digest(QCryptographicHash::Sha256));
         }
     }
 
@@ -57,6 +57,8 @@
         The request has no content but it was expected.
     \value Found
         The resource was found.
+    \value NotModified
+        The resource has not been modified since the version given in the conditional request.
     \value PermanentRedirect
         The resource redirects permanent to given url.
     \value BadRequest
@@ -172,7 +174,7 @@ HttpReply::HttpReply(QObject *parent) :
     setHeader(HttpHeaderType::CacheControlHeader, "no-cache");
     setHeader(HttpHeaderType::ConnectionHeader, "Keep-Alive");
     setRawHeader("Access-Control-Allow-Origin","*");
-    setRawHeader("Keep-Alive", QString("timeout=%1, max=50").arg(m_timeout).toUtf8());
+    setRawHeader("Keep-Alive", QString("timeout=%1, max=50").arg(m_timeout / 1000).toUtf8());
     packReply();
 }
 
@@ -181,6 +183,7 @@ HttpReply::HttpReply(const HttpReply::HttpStatusCode &statusCode, const HttpRepl
     m_statusCode(statusCode),
     m_type(type),
     m_payload(QByteArray()),
+    m_closeConnection(false),
     m_timedOut(false)
 {
     m_timer = new QTimer(this);
@@ -195,7 +198,7 @@ HttpReply::HttpReply(const HttpReply::HttpStatusCode &statusCode, const HttpRepl
     setHeader(HttpHeaderType::CacheControlHeader, "no-cache");
     setHeader(HttpHeaderType::ConnectionHeader, "Keep-Alive");
     setRawHeader("Access-Control-Allow-Origin","*");
-    setRawHeader("Keep-Alive", QString("timeout=%1, max=50").arg(m_timeout).toUtf8());
+    setRawHeader("Keep-Alive", QString("timeout=%1, max=50").arg(m_timeout / 1000).toUtf8());
     packReply();
 }
 
@@ -287,6 +290,13 @@ void HttpReply::setRawHeader(const QByteArray headerType, const QByteArray &valu
     packReply();
 }
 
+/*! Removes the header \a headerType from the header list of this \l{HttpReply}. */
+void HttpReply::removeRawHeader(const QByteArray &headerType)
+{
+    m_rawHeaderList.remove(headerType);
+    packReply();
+}
+
 /*! This method appends a known header to the header list of this \l{HttpReply}.
     The Header will be set to \a headerType : \a value.
 */
@@ -392,6 +402,9 @@ QByteArray HttpReply::getHttpReasonPhrase(const HttpReply::HttpStatusCode &statu
     case Found:
         response = QString("Found").toUtf8();
         break;
+    case NotModified:
+        response = QString("Not Modified").toUtf8();
+        break;
     case PermanentRedirect:
         response = QString("Permanent Redirect").toUtf8();
         break;
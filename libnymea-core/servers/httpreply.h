@@ -52,6 +52,7 @@ public:
         Accepted                = 202,
         NoContent               = 204,
         Found                   = 302,
+        NotModified             = 304,
         PermanentRedirect       = 308,
         BadRequest              = 400,
         Forbidden               = 403,
@@ -105,6 +106,7 @@ public:
     QByteArray payload() const;
 
     void setRawHeader(const QByteArray headerType, const QByteArray &value);
+    void removeRawHeader(const QByteArray &headerType);
     void setHeader(const HttpHeaderType &headerType, const QByteArray &value);
     QHash<QByteArray, QByteArray> rawHeaderList() const;
     QByteArray rawHeader() const;
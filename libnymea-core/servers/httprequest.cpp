@@ -68,11 +68,18 @@
 
 #include <QUrlQuery>
 
+#include <cctype>
+#include <cstring>
+
 namespace nymeaserver {
 
+// Limits protecting against clients sending endless headers or bodies
+static const int maxLineLength = 8192;
+static const int maxHeaderSize = 65536;
+static const qint64 maxBodySize = 16 * 1024 * 1024;
+
 /*! Construct an empty \l{HttpRequest}. */
 HttpRequest::HttpRequest() :
-    m_rawData(QByteArray()),
     m_valid(false),
     m_isComplete(false)
 {
@@ -84,11 +91,10 @@ HttpRequest::HttpRequest() :
     \sa isValid(), isComplete()
 */
 HttpRequest::HttpRequest(QByteArray rawData) :
-    m_rawData(rawData),
     m_valid(false),
     m_isComplete(false)
 {
-    validate();
+    appendData(rawData);
 }
 
 /*! Returns the raw header of this request.*/
@@ -103,6 +109,20 @@ QHash<QByteArray, QByteArray> HttpRequest::rawHeaderList() const
     return m_rawHeaderList;
 }
 
+/*! Returns the value of the header with the given \a name, or an empty byte array if the header is not set. Header names are compared case-insensitively. */
+QByteArray HttpRequest::header(const QByteArray &name) const
+{
+    QHash<QByteArray, QByteArray>::const_iterator it = m_rawHeaderList.constFind(name);
+    if (it != m_rawHeaderList.constEnd())
+        return it.value();
+
+    for (it = m_rawHeaderList.constBegin(); it != m_rawHeaderList.constEnd(); ++it) {
+        if (qstricmp(it.key().constData(), name.constData()) == 0)
+            return it.value();
+    }
+    return QByteArray();
+}
+
 /*! Returns the \l{RequestMethod} of this request.
 
   \sa RequestMethod
@@ -142,13 +162,14 @@ QByteArray HttpRequest::payload() const
     return m_payload;
 }
 
-/*! Returns true if this \l{HttpRequest} is valid. A HTTP request is valid if the header and the payload were paresed successfully without errors.*/
+/*! Returns true if this \l{HttpRequest} is valid. A HTTP request is valid if the header and the payload were paresed successfully without errors.
+    Requests announcing or sending a payload bigger than 16 MiB are not valid.*/
 bool HttpRequest::isValid() const
 {
     return m_valid;
 }
 
-/*! Returns true if this \l{HttpRequest} is complete. A HTTP request is complete if "Content-Length" header value matches the actual payload size. Bigger packages will be sent in multiple TCP packages. */
+/*! Returns true if this \l{HttpRequest} is complete. A HTTP request is complete once the header and the whole payload, as announced by the "Content-Length" header or the chunked transfer encoding, have been received, or if an error was found while parsing. Bigger packages will be sent in multiple TCP packages. */
 bool HttpRequest::isComplete() const
 {
     return m_isComplete;
@@ -161,101 +182,259 @@ bool HttpRequest::hasPayload() const
 }
 
 /*! Appends the given \a data to the current raw data of this \l{HttpRequest}.
- *  This method will be used if a \l{HttpRequest} is not complete yet.
+ *  This method will be used if a \l{HttpRequest} is not complete yet. The parser continues where it stopped
+ *  with the previous data, so a request arriving in many TCP packages is parsed only once.
  *
  *  \sa isComplete()
 */
 void HttpRequest::appendData(const QByteArray &data)
 {
-    m_rawData.append(data);
-    validate();
+    m_buffer.append(data);
+    parse();
+}
+
+/*! Returns the data received after the end of this \l{HttpRequest}, i.e. the beginning of the next request on the same connection.
+ *  This is only set once the request is complete.
+*/
+QByteArray HttpRequest::excessData() const
+{
+    if (m_state != ParserStateComplete)
+        return QByteArray();
+
+    return m_buffer.mid(m_position);
 }
 
-void HttpRequest::validate()
+void HttpRequest::parse()
 {
-    m_isComplete = true; m_valid = false;
+    const char *line = nullptr;
+    int length = 0;
+    bool needMoreData = false;
+
+    while (!needMoreData && m_state != ParserStateComplete && m_state != ParserStateError) {
+        switch (m_state) {
+        case ParserStateRequestLine:
+            if (!takeLine(&line, &length)) {
+                needMoreData = true;
+            } else if (length == 0) {
+                // Ignore empty lines in front of the request line (RFC 7230 3.5)
+            } else if (parseRequestLine(line, length)) {
+                m_rawHeader.append(line, length);
+                m_state = ParserStateHeaders;
+            } else {
+                setError();
+            }
+            break;
+        case ParserStateHeaders:
+            if (!takeLine(&line, &length)) {
+                needMoreData = true;
+            } else if (length == 0) {
+                finishHeaders();
+            } else if (parseHeaderLine(line, length)) {
+                m_rawHeader.append("\r\n");
+                m_rawHeader.append(line, length);
+                if (m_rawHeader.size() > maxHeaderSize) {
+                    qCWarning(dcWebServer()) << "HTTP header exceeds" << maxHeaderSize << "bytes.";
+                    setError();
+                }
+            } else {
+                setError();
+            }
+            break;
+        case ParserStateBody:
+        case ParserStateChunkData: {
+            int available = static_cast<int>(qMin(static_cast<qint64>(m_buffer.size() - m_position), m_bodyRemaining));
+            if (available == 0) {
+                needMoreData = true;
+                break;
+            }
+            m_payload.append(m_buffer.constData() + m_position, available);
+            m_position += available;
+            m_bodyRemaining -= available;
+            if (m_bodyRemaining == 0) {
+                m_state = m_state == ParserStateBody ? ParserStateComplete : ParserStateChunkDataEnd;
+            }
+            break;
+        }
+        case ParserStateChunkSize:
+            if (!takeLine(&line, &length)) {
+                needMoreData = true;
+            } else if (!parseChunkSize(line, length)) {
+                setError();
+            }
+            break;
+        case ParserStateChunkDataEnd:
+            if (!takeLine(&line, &length)) {
+                needMoreData = true;
+            } else if (length != 0) {
+                qCWarning(dcWebServer()) << "Chunk data is longer than its size.";
+                setError();
+            } else {
+                m_state = ParserStateChunkSize;
+            }
+            break;
+        case ParserStateTrailers:
+            if (!takeLine(&line, &length)) {
+                needMoreData = true;
+            } else if (length == 0) {
+                m_state = ParserStateComplete;
+            } else if (!parseHeaderLine(line, length)) {
+                setError();
+            }
+            break;
+        case ParserStateComplete:
+        case ParserStateError:
+            break;
+        }
+    }
+
+    // Drop what has been parsed already. Once complete, the buffer keeps the excess data.
+    if (m_state != ParserStateComplete && m_position > 0) {
+        m_buffer.remove(0, m_position);
+        m_position = 0;
+    }
+    if (m_state == ParserStateError) {
+        m_buffer.clear();
+        m_position = 0;
+    }
 
-    // Parese the HTTP request. The request is invalid, until the end of the parse process.
-    if (m_rawData.isEmpty())
-        return;
+    m_isComplete = m_state == ParserStateComplete || m_state == ParserStateError;
+    m_valid = m_state == ParserStateComplete;
+}
 
-    // split the data into header and payload
-    int headerEndIndex = m_rawData.indexOf("\r\n\r\n");
-    if (headerEndIndex < 0) {
-        qCWarning(dcWebServer()) << "Could not parse end of HTTP header (empty line between header and body):" << m_rawData;
-        return;
+bool HttpRequest::takeLine(const char **line, int *length)
+{
+    int index = m_buffer.indexOf("\r\n", m_position + qMax(m_scanned - 1, 0));
+    if (index < 0) {
+        m_scanned = m_buffer.size() - m_position;
+        if (m_scanned > maxLineLength) {
+            qCWarning(dcWebServer()) << "HTTP line exceeds" << maxLineLength << "bytes.";
+            setError();
+        }
+        return false;
     }
 
-    m_rawHeader = m_rawData.left(headerEndIndex);
-    m_payload = m_rawData.right(m_rawData.length() - headerEndIndex).simplified();
+    *line = m_buffer.constData() + m_position;
+    *length = index - m_position;
+    m_position = index + 2;
+    m_scanned = 0;
+    return true;
+}
 
-    // parse status line
-    QStringList headerLines = QString(m_rawHeader).split(QRegExp("\r\n"));
-    QString statusLine = headerLines.takeFirst();
-    QStringList statusLineTokens = statusLine.split(QRegExp("[ \r\n][ \r\n]*"));
-    if (statusLineTokens.count() != 3) {
-        qCWarning(dcWebServer()) << "Could not parse HTTP status line:" << statusLine;
-        return;
+bool HttpRequest::parseRequestLine(const char *line, int length)
+{
+    QList<QByteArray> tokens = QByteArray(line, length).simplified().split(' ');
+    if (tokens.count() != 3) {
+        qCWarning(dcWebServer()) << "Could not parse HTTP status line:" << QByteArray(line, length);
+        return false;
     }
 
     // verify http version
-    m_httpVersion = statusLineTokens.at(2).toUtf8().simplified();
+    m_httpVersion = tokens.at(2);
     if (!m_httpVersion.contains("HTTP")) {
         qCWarning(dcWebServer()) << "Unknown HTTP version:" << m_httpVersion;
-        return;
+        return false;
     }
-    m_methodString = statusLineTokens.at(0).simplified();
+    m_methodString = QString::fromLatin1(tokens.at(0));
     m_method = getRequestMethodType(m_methodString);
 
-    m_url = QUrl("http://example.com" + statusLineTokens.at(1).simplified());
+    m_url = QUrl("http://example.com" + QString::fromUtf8(tokens.at(1)));
 
     if (m_url.hasQuery())
         m_urlQuery = QUrlQuery(m_url.query());
 
-    // verify header formating
-    foreach (const QString &line, headerLines) {
-        if (!line.contains(":")) {
-            qCWarning(dcWebServer()) << "Invalid HTTP header:" << line;
-            return;
+    return true;
+}
+
+bool HttpRequest::parseHeaderLine(const char *line, int length)
+{
+    const char *colon = static_cast<const char *>(memchr(line, ':', static_cast<size_t>(length)));
+    if (!colon) {
+        qCWarning(dcWebServer()) << "Invalid HTTP header:" << QByteArray(line, length);
+        return false;
+    }
+
+    // Trim the key and value in place, only the results get copied
+    const char *keyBegin = line;
+    const char *keyEnd = colon;
+    const char *valueBegin = colon + 1;
+    const char *valueEnd = line + length;
+    while (keyBegin < keyEnd && isspace(static_cast<unsigned char>(*keyBegin))) keyBegin++;
+    while (keyEnd > keyBegin && isspace(static_cast<unsigned char>(*(keyEnd - 1)))) keyEnd--;
+    while (valueBegin < valueEnd && isspace(static_cast<unsigned char>(*valueBegin))) valueBegin++;
+    while (valueEnd > valueBegin && isspace(static_cast<unsigned char>(*(valueEnd - 1)))) valueEnd--;
+
+    QByteArray key(keyBegin, static_cast<int>(keyEnd - keyBegin));
+    QByteArray value(valueBegin, static_cast<int>(valueEnd - valueBegin));
+
+    // Header names are case insensitive
+    if (qstricmp(key.constData(), "Content-Length") == 0) {
+        bool ok = false;
+        qint64 contentLength = value.toLongLong(&ok);
+        if (!ok || contentLength < 0 || (m_contentLength >= 0 && m_contentLength != contentLength)) {
+            qCWarning(dcWebServer()) << "Could not parse Content-Length.";
+            return false;
         }
-        int index = line.indexOf(":");
-        QByteArray key = line.left(index).toUtf8().simplified();
-        QByteArray value = line.right(line.count() - index - 1).toUtf8().simplified();
-        m_rawHeaderList.insert(key, value);
+        m_contentLength = contentLength;
+    } else if (qstricmp(key.constData(), "Transfer-Encoding") == 0) {
+        m_chunked = value.toLower().contains("chunked");
     }
 
+    m_rawHeaderList.insert(key, value);
+    return true;
+}
+
+void HttpRequest::finishHeaders()
+{
     // check User-Agent
     if (!m_rawHeaderList.contains("User-Agent"))
         qCWarning(dcWebServer()) << "User-Agent header is missing";
 
+    // The transfer encoding overrides the Content-Length (RFC 7230 3.3.3)
+    if (m_chunked) {
+        m_state = ParserStateChunkSize;
+    } else if (m_contentLength > maxBodySize) {
+        qCWarning(dcWebServer()) << "HTTP body of" << m_contentLength << "bytes exceeds" << maxBodySize << "bytes.";
+        setError();
+    } else if (m_contentLength > 0) {
+        m_bodyRemaining = m_contentLength;
+        m_state = ParserStateBody;
+    } else {
+        m_state = ParserStateComplete;
+    }
+}
 
-    // verify content length with actual payload
-    if (m_rawHeaderList.contains("Content-Length")) {
-        bool ok = false;
-        int contentLength = m_rawHeaderList.value("Content-Length").toInt(&ok);
-        if (!ok) {
-            qCWarning(dcWebServer()) << "Could not parse Content-Length.";
-            return;
-        }
-        // check if we have all data
-        if (m_payload.size() < contentLength) {
-            qCDebug(dcWebServer()) << "Request incomplete:";
-            qCDebug(dcWebServer()) << "   -> Content-Length:" << contentLength;
-            qCDebug(dcWebServer()) << "   -> Payload size  :" << payload().size();
-            m_isComplete = false;
-            return;
-        }
-        // check if the content length bigger than header Content-Length
-        if (m_payload.size() > contentLength) {
-            qCWarning(dcWebServer()) << "Payload size greater than header Content-Length:";
-            qCWarning(dcWebServer()) << "   -> Content-Length:" << contentLength;
-            qCWarning(dcWebServer()) << "   -> Payload size  :" << payload().size();
-            m_isComplete = true;
-            return;
-        }
+bool HttpRequest::parseChunkSize(const char *line, int length)
+{
+    // Chunk extensions after ';' are ignored
+    QByteArray size(line, length);
+    int extensionIndex = size.indexOf(';');
+    if (extensionIndex >= 0)
+        size.truncate(extensionIndex);
+
+    bool ok = false;
+    qint64 chunkSize = size.trimmed().toLongLong(&ok, 16);
+    if (!ok || chunkSize < 0) {
+        qCWarning(dcWebServer()) << "Could not parse chunk size:" << QByteArray(line, length);
+        return false;
+    }
 
+    if (chunkSize > maxBodySize - m_payload.size()) {
+        qCWarning(dcWebServer()) << "Chunked HTTP body exceeds" << maxBodySize << "bytes.";
+        return false;
     }
-    m_valid = true;
+
+    if (chunkSize == 0) {
+        m_state = ParserStateTrailers;
+    } else {
+        m_bodyRemaining = chunkSize;
+        m_state = ParserStateChunkData;
+    }
+    return true;
+}
+
+void HttpRequest::setError()
+{
+    m_state = ParserStateError;
 }
 
 HttpRequest::RequestMethod HttpRequest::getRequestMethodType(const QString &methodString)
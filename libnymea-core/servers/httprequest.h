@@ -55,6 +55,7 @@ public:
 
     QByteArray rawHeader() const;
     QHash<QByteArray, QByteArray> rawHeaderList() const;
+    QByteArray header(const QByteArray &name) const;
 
     RequestMethod method() const;
     QString methodString() const;
@@ -70,13 +71,35 @@ public:
     bool hasPayload() const;
 
     void appendData(const QByteArray &data);
+    QByteArray excessData() const;
 
 private:
-    QByteArray m_rawData;
+    enum ParserState {
+        ParserStateRequestLine,
+        ParserStateHeaders,
+        ParserStateBody,
+        ParserStateChunkSize,
+        ParserStateChunkData,
+        ParserStateChunkDataEnd,
+        ParserStateTrailers,
+        ParserStateComplete,
+        ParserStateError
+    };
+
+    // Not yet consumed input, everything before m_position has been parsed already
+    QByteArray m_buffer;
+    int m_position = 0;
+    // Bytes after m_position already searched for the end of the current line
+    int m_scanned = 0;
+    ParserState m_state = ParserStateRequestLine;
+    qint64 m_contentLength = -1;
+    bool m_chunked = false;
+    qint64 m_bodyRemaining = 0;
+
     QByteArray m_rawHeader;
     QHash<QByteArray, QByteArray> m_rawHeaderList;
 
-    RequestMethod m_method;
+    RequestMethod m_method = Unhandled;
     QString m_methodString;
     QByteArray m_httpVersion;
 
@@ -88,7 +111,13 @@ private:
     bool m_valid;
     bool m_isComplete;
 
-    void validate();
+    void parse();
+    bool takeLine(const char **line, int *length);
+    bool parseRequestLine(const char *line, int length);
+    bool parseHeaderLine(const char *line, int length);
+    void finishHeaders();
+    bool parseChunkSize(const char *line, int length);
+    void setError();
     RequestMethod getRequestMethodType(const QString &methodString);
 };
 
@@ -66,8 +66,7 @@ public:
         if (!m_broker->m_policies.contains(clientId)) {
             return false;
         }
-        MqttPolicy policy = m_broker->m_policies.value(clientId);
-        return matchPolicy(policy.allowedSubscribeTopicFilters, topicFilter);
+        return m_broker->m_subscribeFilters.matches(topicFilter, clientId);
     }
 
     bool authorizePublish(int serverAddressId, const QString &clientId, const QString &topic) override {
@@ -77,42 +76,7 @@ public:
         if (!m_broker->m_policies.contains(clientId)) {
             return false;
         }
-        MqttPolicy policy = m_broker->m_policies.value(clientId);
-        return matchPolicy(policy.allowedPublishTopicFilters, topic);
-    }
-
-    bool matchPolicy(const QStringList &policies, const QString &topic) {
-        foreach (const QString &policyFilter, policies) {
-            QStringList policyParts = policyFilter.split('/');
-            QStringList topicParts = topic.split('/');
-            if (topicParts.count() < policyParts.count() - 1) {
-                // Nope... actual topic is shorter than filter
-                continue;
-            }
-            bool bad = false;
-            for (int i = 0; i < policyParts.length(); i++) {
-                if (policyParts.at(i) == QStringLiteral("+")) {
-                    continue;
-                }
-                if (policyParts.at(i) == QStringLiteral("#")) {
-                    continue;
-                }
-                if (policyParts.at(i) == topicParts.at(i)) {
-                    continue;
-                }
-                // Nope... this part does neither match nor is covered by a wildcard in the policy
-                bad = true;
-            }
-            if (bad) {
-                continue;
-            }
-            if (policyParts.count() == topicParts.count() || policyFilter.endsWith('#')) {
-                // OK, either the policy is matching or the topicFilter is longer as the policy and policy ends with #
-                return true;
-            }
-        }
-        // Nope... none of the policies matched...
-        return false;
+        return m_broker->m_publishFilters.matches(topic, clientId);
     }
 
 private:
@@ -201,12 +165,15 @@ MqttPolicy MqttBroker::policy(const QString &clientId)
 void MqttBroker::updatePolicy(const MqttPolicy &policy)
 {
     if (m_policies.contains(policy.clientId)) {
+        removePolicyFilters(m_policies.value(policy.clientId));
+        addPolicyFilters(policy);
         m_policies[policy.clientId] = policy;
         qCDebug(dcMqtt) << "Policy for client" << policy.clientId << "updated.";
         emit policyChanged(policy);
         return;
     }
     qCDebug(dcMqtt) << "Policy for client" << policy.clientId << "added.";
+    addPolicyFilters(policy);
     m_policies.insert(policy.clientId, policy);
     emit policyAdded(policy);
 }
@@ -227,7 +194,9 @@ bool MqttBroker::removePolicy(const QString &clientId)
         }
 
         qCDebug(dcMqtt) << "Policy for client" << clientId << "removed";
-        emit policyRemoved(m_policies.take(clientId));
+        MqttPolicy policy = m_policies.take(clientId);
+        removePolicyFilters(policy);
+        emit policyRemoved(policy);
         return true;
     }
     return false;
@@ -236,18 +205,53 @@ bool MqttBroker::removePolicy(const QString &clientId)
 void MqttBroker::publish(const QString &topic, const QByteArray &payload)
 {
     m_server->publish(topic, payload);
+    m_publishedCounter.increment();
+}
+
+bool MqttBroker::isClientConnected(const QString &clientId) const
+{
+    return m_connectedClients.contains(clientId);
+}
+
+void MqttBroker::writeMetrics(MetricsWriter *writer) const
+{
+    writer->writeGauge("nymea_mqtt_clients", "Number of clients connected to the MQTT broker.", m_connectedClients.count());
+    writer->writeCounter("nymea_mqtt_messages_received_total", "Number of messages published by MQTT clients.", m_receivedCounter.value());
+    writer->writeCounter("nymea_mqtt_messages_published_total", "Number of messages published by nymea.", m_publishedCounter.value());
+}
+
+void MqttBroker::addPolicyFilters(const MqttPolicy &policy)
+{
+    foreach (const QString &topicFilter, policy.allowedPublishTopicFilters) {
+        m_publishFilters.insert(topicFilter, policy.clientId);
+    }
+    foreach (const QString &topicFilter, policy.allowedSubscribeTopicFilters) {
+        m_subscribeFilters.insert(topicFilter, policy.clientId);
+    }
+}
+
+void MqttBroker::removePolicyFilters(const MqttPolicy &policy)
+{
+    foreach (const QString &topicFilter, policy.allowedPublishTopicFilters) {
+        m_publishFilters.remove(topicFilter, policy.clientId);
+    }
+    foreach (const QString &topicFilter, policy.allowedSubscribeTopicFilters) {
+        m_subscribeFilters.remove(topicFilter, policy.clientId);
+    }
 }
 
 void MqttBroker::onClientConnected(int serverAddressId, const QString &clientId, const QString &username, const QHostAddress &clientAddress)
 {
     Q_UNUSED(serverAddressId)
     qCDebug(dcMqtt) << "Client" << clientId << "connected with username" << username << "from" << clientAddress.toString();
+    m_connectedClients.insert(clientId);
     emit clientConnected(clientId);
 }
 
 void MqttBroker::onClientDisconnected(const QString &clientId)
 {
     qCDebug(dcMqtt) << "Client" << clientId << "disconnected";
+    m_connectedClients.remove(clientId);
     emit clientDisconnected(clientId);
 }
 
@@ -255,6 +259,7 @@ void MqttBroker::onPublishReceived(const QString &clientId, quint16 packetId, co
 {
     Q_UNUSED(packetId)
     qCDebug(dcMqtt) << "Publish received from client" << clientId << ":" << topic << ">" << payload;
+    m_receivedCounter.increment();
     emit publishReceived(clientId, topic, payload);
 }
 
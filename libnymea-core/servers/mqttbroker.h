@@ -32,11 +32,14 @@
 #define MQTTBROKER_H
 
 #include <QObject>
+#include <QSet>
 #include <QHostAddress>
 #include <QSslConfiguration>
 
 #include "nymea-mqtt/mqtt.h"
 #include "nymeaconfiguration.h"
+#include "metrics.h"
+#include "mqtttopictrie.h"
 
 class MqttServer;
 
@@ -65,6 +68,14 @@ public:
 
     void publish(const QString &topic, const QByteArray &payload);
 
+    bool isClientConnected(const QString &clientId) const;
+
+    void writeMetrics(MetricsWriter *writer) const;
+
+private:
+    void addPolicyFilters(const MqttPolicy &policy);
+    void removePolicyFilters(const MqttPolicy &policy);
+
 private slots:
     void onClientConnected(int serverAddressId, const QString &clientId, const QString &username, const QHostAddress &clientAddress);
     void onClientDisconnected(const QString &clientId);
@@ -87,7 +98,13 @@ private:
     NymeaMqttAuthorizer *m_authorizer = nullptr;
     QHash<int, ServerConfiguration> m_configs;
     QHash<QString, MqttPolicy> m_policies;
+    // Allowed topic filters of all policies, the values are client ids
+    MqttTopicTrie<QString> m_publishFilters;
+    MqttTopicTrie<QString> m_subscribeFilters;
 
+    QSet<QString> m_connectedClients;
+    MetricsCounter m_receivedCounter;
+    MetricsCounter m_publishedCounter;
 
     friend class NymeaMqttAuthorizer;
 };
@@ -0,0 +1,160 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef MQTTTOPICTRIE_H
+#define MQTTTOPICTRIE_H
+
+#include <QHash>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+
+namespace nymeaserver {
+
+// Stores values under MQTT topic filters and finds the values whose filters match a topic.
+// The lookup costs one hash lookup per topic level and wildcard instead of comparing the
+// topic with every filter. A topic passed to matches() may be a topic filter itself, e.g.
+// when authorizing a subscription, in which case '+' only matches '+' or '#' and '#' only
+// matches '#'.
+template <typename T>
+class MqttTopicTrie
+{
+public:
+    MqttTopicTrie() = default;
+    ~MqttTopicTrie() { clear(); }
+
+    void insert(const QString &topicFilter, const T &value) {
+        Node *node = &m_root;
+        foreach (const QString &level, topicFilter.split('/')) {
+            Node *child = node->children.value(level);
+            if (!child) {
+                child = new Node();
+                node->children.insert(level, child);
+            }
+            node = child;
+        }
+        node->values.insert(value);
+    }
+
+    bool remove(const QString &topicFilter, const T &value) {
+        return remove(&m_root, topicFilter.split('/'), 0, value);
+    }
+
+    void clear() {
+        deleteChildren(&m_root);
+        m_root.values.clear();
+    }
+
+    bool isEmpty() const {
+        return m_root.children.isEmpty() && m_root.values.isEmpty();
+    }
+
+    // Returns true if a filter stored for value matches the topic
+    bool matches(const QString &topic, const T &value) const {
+        return walk(&m_root, topic.split('/'), 0, [&value](const QSet<T> &values) -> bool {
+            return values.contains(value);
+        });
+    }
+
+    // Returns all values with a filter matching the topic
+    QSet<T> values(const QString &topic) const {
+        QSet<T> result;
+        walk(&m_root, topic.split('/'), 0, [&result](const QSet<T> &values) -> bool {
+            result.unite(values);
+            return false;
+        });
+        return result;
+    }
+
+private:
+    Q_DISABLE_COPY(MqttTopicTrie)
+
+    class Node
+    {
+    public:
+        QHash<QString, Node *> children;
+        QSet<T> values;
+    };
+
+    Node m_root;
+
+    // Calls visit for the values of each matching node until it returns true
+    template <typename Visitor>
+    static bool walk(const Node *node, const QStringList &levels, int index, const Visitor &visit) {
+        // A trailing '#' also matches the parent level, "a/#" matches "a"
+        const Node *multiLevel = node->children.value(QStringLiteral("#"));
+        if (multiLevel && visit(multiLevel->values))
+            return true;
+
+        if (index == levels.count())
+            return visit(node->values);
+
+        const QString &level = levels.at(index);
+        if (level == QLatin1String("#"))
+            return false;
+
+        const Node *singleLevel = node->children.value(QStringLiteral("+"));
+        if (singleLevel && walk(singleLevel, levels, index + 1, visit))
+            return true;
+
+        if (level == QLatin1String("+"))
+            return false;
+
+        const Node *child = node->children.value(level);
+        return child && walk(child, levels, index + 1, visit);
+    }
+
+    static bool remove(Node *node, const QStringList &levels, int index, const T &value) {
+        if (index == levels.count())
+            return node->values.remove(value);
+
+        Node *child = node->children.value(levels.at(index));
+        if (!child || !remove(child, levels, index + 1, value))
+            return false;
+
+        // Drop branches which hold no values anymore
+        if (child->values.isEmpty() && child->children.isEmpty())
+            delete node->children.take(levels.at(index));
+
+        return true;
+    }
+
+    static void deleteChildren(Node *node) {
+        foreach (Node *child, node->children) {
+            deleteChildren(child);
+            delete child;
+        }
+        node->children.clear();
+    }
+};
+
+}
+
+#endif // MQTTTOPICTRIE_H
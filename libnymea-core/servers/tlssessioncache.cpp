@@ -0,0 +1,436 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class nymeaserver::TlsSessionCache
+    \brief Shares TLS sessions and session ticket keys between all TLS servers of nymead.
+
+    \ingroup server
+    \inmodule core
+
+    QSslSocket sets up a new OpenSSL context for every connection, which means that the session
+    cache and the session ticket keys OpenSSL keeps per context are thrown away together with the
+    connection. Clients reconnecting after a network change would need a full handshake every time.
+
+    Once enabled, the TlsSessionCache hooks into the creation of every SSL object in the process and
+    attaches a shared session cache for session ID resumption and a shared set of session ticket
+    keys to the ones used by a server. Client connections made by nymead are left alone. The cache holds at most \l{maxSessions()} sessions and drops the least recently used
+    ones first. Ticket keys are rotated every \l{lifetime()} seconds. Tickets encrypted with the
+    previous key are still accepted and get renewed with the current one.
+
+    \sa TcpServer, WebSocketServer
+*/
+
+#include "tlssessioncache.h"
+#include "loggingcategories.h"
+
+#include <QSslSocket>
+
+#include <openssl/rand.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#include <openssl/params.h>
+#else
+#include <openssl/hmac.h>
+#endif
+
+#include <cstring>
+
+namespace nymeaserver {
+
+static const int ticketKeyNameLength = 16;
+static const int ticketAesKeyLength = 32;
+static const int ticketHmacKeyLength = 32;
+
+TlsSessionCache *TlsSessionCache::s_instance = nullptr;
+
+/*! Returns the process wide instance of the \l{TlsSessionCache}. */
+TlsSessionCache *TlsSessionCache::instance()
+{
+    // Never deleted, OpenSSL may call into the cache until the very last SSL object is gone
+    if (!s_instance) {
+        s_instance = new TlsSessionCache();
+    }
+    return s_instance;
+}
+
+TlsSessionCache::TlsSessionCache():
+    m_sessions(1000)
+{
+    m_clock.start();
+}
+
+/*! Enables session resumption for all SSL objects created from now on. Sessions are only resumed
+    if they have been created with the same \a sessionIdContext, e.g. a digest of the server certificate.
+*/
+void TlsSessionCache::enable(const QByteArray &sessionIdContext)
+{
+    QMutexLocker locker(&m_mutex);
+    m_sessionIdContext = sessionIdContext.left(SSL_MAX_SID_CTX_LENGTH);
+    if (m_enabled) {
+        return;
+    }
+
+    // The hooks are registered in the OpenSSL library nymea is linked against. If Qt loaded a different one, they never fire.
+    if (QSslSocket::sslLibraryVersionNumber() != static_cast<long>(OpenSSL_version_num())) {
+        qCWarning(dcServerManager()) << "Qt uses" << QSslSocket::sslLibraryVersionString() << "but nymea is linked against" << OpenSSL_version(OPENSSL_VERSION) << ". TLS session resumption will not work.";
+    }
+
+    m_contextIndex = SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, &TlsSessionCache::onContextFreed);
+    m_sslIndex = SSL_get_ex_new_index(0, nullptr, &TlsSessionCache::onSslCreated, nullptr, nullptr);
+    if (m_contextIndex < 0 || m_sslIndex < 0) {
+        qCWarning(dcServerManager()) << "Failed to register TLS session cache hooks. TLS session resumption disabled.";
+        return;
+    }
+    m_enabled = true;
+    qCDebug(dcServerManager()) << "TLS session resumption enabled. Caching up to" << m_sessions.maxCost() << "sessions for" << m_lifetime << "seconds";
+}
+
+/*! Returns true if session resumption has been enabled. */
+bool TlsSessionCache::enabled() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_enabled;
+}
+
+/*! Returns the maximum number of sessions held in the cache. */
+int TlsSessionCache::maxSessions() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_sessions.maxCost();
+}
+
+/*! Sets the maximum number of sessions held in the cache to \a maxSessions. */
+void TlsSessionCache::setMaxSessions(int maxSessions)
+{
+    QMutexLocker locker(&m_mutex);
+    m_sessions.setMaxCost(maxSessions);
+}
+
+/*! Returns the time in seconds a session can be resumed and a ticket key is used to issue new tickets. */
+int TlsSessionCache::lifetime() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_lifetime;
+}
+
+/*! Sets the session and ticket key lifetime to \a seconds. Applies to connections created afterwards. */
+void TlsSessionCache::setLifetime(int seconds)
+{
+    QMutexLocker locker(&m_mutex);
+    m_lifetime = seconds;
+}
+
+/*! Returns the number of sessions currently held in the cache. */
+int TlsSessionCache::sessionCount() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_sessions.count();
+}
+
+/*! Returns how many sessions have been restored from the cache or from a session ticket so far. */
+quint64 TlsSessionCache::resumedSessions() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_resumedSessions;
+}
+
+/*! Drops all cached sessions and ticket keys. Clients have to do a full handshake on their next connection. */
+void TlsSessionCache::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_sessions.clear();
+    m_ticketKeys.clear();
+}
+
+void TlsSessionCache::onSslCreated(void *parent, void *ptr, CRYPTO_EX_DATA *ad, int index, long argl, void *argp)
+{
+    Q_UNUSED(ptr)
+    Q_UNUSED(ad)
+    Q_UNUSED(index)
+    Q_UNUSED(argl)
+    Q_UNUSED(argp)
+
+    SSL *ssl = static_cast<SSL*>(parent);
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+    // Whether this is a server or a client is only known once the handshake starts. The
+    // client hello callback only runs on the server side.
+    SSL_CTX_set_client_hello_cb(SSL_get_SSL_CTX(ssl), &TlsSessionCache::onClientHello, nullptr);
+#else
+    // Servers always have a certificate, clients only if they use one to authenticate
+    if (SSL_CTX_get0_certificate(SSL_get_SSL_CTX(ssl))) {
+        instance()->setupSsl(ssl);
+    }
+#endif
+}
+
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+int TlsSessionCache::onClientHello(SSL *ssl, int *alert, void *arg)
+{
+    Q_UNUSED(alert)
+    Q_UNUSED(arg)
+
+    // Runs before OpenSSL looks for a session to resume
+    instance()->setupSsl(ssl);
+    return SSL_CLIENT_HELLO_SUCCESS;
+}
+#endif
+
+void TlsSessionCache::onContextFreed(void *parent, void *ptr, CRYPTO_EX_DATA *ad, int index, long argl, void *argp)
+{
+    Q_UNUSED(parent)
+    Q_UNUSED(ad)
+    Q_UNUSED(index)
+    Q_UNUSED(argl)
+    Q_UNUSED(argp)
+    delete static_cast<ContextHooks*>(ptr);
+}
+
+void TlsSessionCache::setupSsl(SSL *ssl)
+{
+    QMutexLocker locker(&m_mutex);
+
+    // Without a session ID context OpenSSL refuses to resume sessions when peer verification is requested.
+    // Also makes sure sessions created for another certificate are never resumed.
+    SSL_set_session_id_context(ssl, reinterpret_cast<const unsigned char*>(m_sessionIdContext.constData()), static_cast<unsigned int>(m_sessionIdContext.size()));
+
+    // The context has been created by QSslSocket for this connection only
+    SSL_CTX *context = SSL_get_SSL_CTX(ssl);
+    ContextHooks *hooks = static_cast<ContextHooks*>(SSL_CTX_get_ex_data(context, m_contextIndex));
+    if (!hooks) {
+        hooks = new ContextHooks();
+        SSL_CTX_set_ex_data(context, m_contextIndex, hooks);
+        setupContext(context, hooks);
+    }
+
+    // Resumptions are counted once the handshake succeeded. Qt might use the info callback for alerts, keep it.
+    if (SSL_get_info_callback(ssl) != &TlsSessionCache::onInfo) {
+        hooks->previousInfoCallback = SSL_get_info_callback(ssl) ? SSL_get_info_callback(ssl) : SSL_CTX_get_info_callback(context);
+        SSL_set_info_callback(ssl, &TlsSessionCache::onInfo);
+    }
+}
+
+void TlsSessionCache::setupContext(SSL_CTX *context, ContextHooks *hooks)
+{
+    // Qt uses the new session callback for client side session tickets. Keep it for client connections.
+    hooks->previousNewSession = SSL_CTX_sess_get_new_cb(context);
+
+    SSL_CTX_set_session_cache_mode(context, SSL_CTX_get_session_cache_mode(context) | SSL_SESS_CACHE_SERVER | SSL_SESS_CACHE_NO_INTERNAL);
+    SSL_CTX_sess_set_new_cb(context, &TlsSessionCache::onNewSession);
+    SSL_CTX_sess_set_get_cb(context, &TlsSessionCache::onGetSession);
+    SSL_CTX_sess_set_remove_cb(context, &TlsSessionCache::onRemoveSession);
+    SSL_CTX_set_timeout(context, m_lifetime);
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    SSL_CTX_set_tlsext_ticket_key_evp_cb(context, &TlsSessionCache::onTicketKey);
+#else
+    SSL_CTX_set_tlsext_ticket_key_cb(context, &TlsSessionCache::onTicketKey);
+#endif
+}
+
+int TlsSessionCache::onNewSession(SSL *ssl, SSL_SESSION *session)
+{
+    TlsSessionCache *cache = instance();
+
+    if (!SSL_is_server(ssl)) {
+        ContextHooks *hooks = static_cast<ContextHooks*>(SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), cache->m_contextIndex));
+        if (hooks && hooks->previousNewSession) {
+            return hooks->previousNewSession(ssl, session);
+        }
+        return 0;
+    }
+
+    unsigned int idLength = 0;
+    const unsigned char *id = SSL_SESSION_get_id(session, &idLength);
+    int size = i2d_SSL_SESSION(session, nullptr);
+    if (idLength == 0 || size <= 0) {
+        return 0;
+    }
+
+    QByteArray *data = new QByteArray(size, Qt::Uninitialized);
+    unsigned char *buffer = reinterpret_cast<unsigned char*>(data->data());
+    i2d_SSL_SESSION(session, &buffer);
+
+    QMutexLocker locker(&cache->m_mutex);
+    cache->m_sessions.insert(QByteArray(reinterpret_cast<const char*>(id), static_cast<int>(idLength)), data);
+
+    // The session has been copied, OpenSSL keeps ownership of the object
+    return 0;
+}
+
+SSL_SESSION *TlsSessionCache::onGetSession(SSL *ssl, const unsigned char *id, int idLength, int *copy)
+{
+    Q_UNUSED(ssl)
+
+    // The returned session is handed over to OpenSSL without incrementing its reference count
+    *copy = 0;
+
+    TlsSessionCache *cache = instance();
+    QMutexLocker locker(&cache->m_mutex);
+    QByteArray *data = cache->m_sessions.object(QByteArray(reinterpret_cast<const char*>(id), idLength));
+    if (!data) {
+        return nullptr;
+    }
+
+    // OpenSSL might still reject the session, resumptions are counted in onInfo()
+    const unsigned char *buffer = reinterpret_cast<const unsigned char*>(data->constData());
+    return d2i_SSL_SESSION(nullptr, &buffer, data->size());
+}
+
+void TlsSessionCache::onRemoveSession(SSL_CTX *context, SSL_SESSION *session)
+{
+    Q_UNUSED(context)
+
+    unsigned int idLength = 0;
+    const unsigned char *id = SSL_SESSION_get_id(session, &idLength);
+
+    TlsSessionCache *cache = instance();
+    QMutexLocker locker(&cache->m_mutex);
+    cache->m_sessions.remove(QByteArray(reinterpret_cast<const char*>(id), static_cast<int>(idLength)));
+}
+
+void TlsSessionCache::onInfo(const SSL *ssl, int where, int ret)
+{
+    TlsSessionCache *cache = instance();
+    ContextHooks *hooks = static_cast<ContextHooks*>(SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), cache->m_contextIndex));
+    if (hooks && hooks->previousInfoCallback) {
+        hooks->previousInfoCallback(ssl, where, ret);
+    }
+
+    if (!(where & SSL_CB_HANDSHAKE_DONE) || !SSL_is_server(ssl)) {
+        return;
+    }
+
+    // TLS 1.3 also reports post-handshake messages as done handshakes, count every connection only once
+    SSL *connection = const_cast<SSL*>(ssl);
+    if (SSL_get_ex_data(connection, cache->m_sslIndex) || !SSL_session_reused(connection)) {
+        return;
+    }
+    SSL_set_ex_data(connection, cache->m_sslIndex, cache);
+
+    QMutexLocker locker(&cache->m_mutex);
+    cache->m_resumedSessions++;
+}
+
+int TlsSessionCache::onTicketKey(SSL *ssl, unsigned char *keyName, unsigned char *iv, EVP_CIPHER_CTX *cipherContext, TicketMacContext *macContext, int encrypt)
+{
+    Q_UNUSED(ssl)
+
+    TlsSessionCache *cache = instance();
+    QMutexLocker locker(&cache->m_mutex);
+    if (!cache->rotateTicketKeys()) {
+        // Neither issue nor accept tickets without a key, clients fall back to a full handshake
+        return 0;
+    }
+
+    if (encrypt) {
+        const TicketKey &key = cache->m_ticketKeys.first();
+        if (RAND_bytes(iv, EVP_CIPHER_iv_length(EVP_aes_256_cbc())) != 1) {
+            return -1;
+        }
+        memcpy(keyName, key.name.constData(), ticketKeyNameLength);
+        if (EVP_EncryptInit_ex(cipherContext, EVP_aes_256_cbc(), nullptr, reinterpret_cast<const unsigned char*>(key.aesKey.constData()), iv) != 1) {
+            return -1;
+        }
+        if (!initTicketMac(macContext, key.hmacKey)) {
+            return -1;
+        }
+        return 1;
+    }
+
+    QByteArray name(reinterpret_cast<const char*>(keyName), ticketKeyNameLength);
+    for (int i = 0; i < cache->m_ticketKeys.count(); i++) {
+        const TicketKey &key = cache->m_ticketKeys.at(i);
+        if (key.name != name) {
+            continue;
+        }
+        if (!initTicketMac(macContext, key.hmacKey)) {
+            return -1;
+        }
+        if (EVP_DecryptInit_ex(cipherContext, EVP_aes_256_cbc(), nullptr, reinterpret_cast<const unsigned char*>(key.aesKey.constData()), iv) != 1) {
+            return -1;
+        }
+        // The ticket is not verified yet, resumptions are counted in onInfo()
+        // Ask OpenSSL to issue a new ticket with the current key if this one has been rotated out already
+        return i == 0 ? 1 : 2;
+    }
+
+    // Unknown or expired key, fall back to a full handshake
+    return 0;
+}
+
+bool TlsSessionCache::initTicketMac(TicketMacContext *macContext, const QByteArray &hmacKey)
+{
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    char digest[] = "SHA256";
+    OSSL_PARAM params[] = {
+        OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY, const_cast<char*>(hmacKey.constData()), static_cast<size_t>(hmacKey.size())),
+        OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, digest, 0),
+        OSSL_PARAM_construct_end()
+    };
+    return EVP_MAC_CTX_set_params(macContext, params) == 1;
+#else
+    return HMAC_Init_ex(macContext, hmacKey.constData(), hmacKey.size(), EVP_sha256(), nullptr) == 1;
+#endif
+}
+
+bool TlsSessionCache::rotateTicketKeys()
+{
+    qint64 now = m_clock.elapsed();
+    qint64 lifetime = static_cast<qint64>(m_lifetime) * 1000;
+
+    // Tickets issued with the previous key stay valid for one more lifetime
+    while (!m_ticketKeys.isEmpty() && now - m_ticketKeys.last().created >= 2 * lifetime) {
+        m_ticketKeys.removeLast();
+    }
+    if (!m_ticketKeys.isEmpty() && now - m_ticketKeys.first().created < lifetime) {
+        return true;
+    }
+
+    TicketKey key;
+    key.name = QByteArray(ticketKeyNameLength, Qt::Uninitialized);
+    key.aesKey = QByteArray(ticketAesKeyLength, Qt::Uninitialized);
+    key.hmacKey = QByteArray(ticketHmacKeyLength, Qt::Uninitialized);
+    key.created = now;
+    if (RAND_bytes(reinterpret_cast<unsigned char*>(key.name.data()), ticketKeyNameLength) != 1
+            || RAND_bytes(reinterpret_cast<unsigned char*>(key.aesKey.data()), ticketAesKeyLength) != 1
+            || RAND_bytes(reinterpret_cast<unsigned char*>(key.hmacKey.data()), ticketHmacKeyLength) != 1) {
+        qCWarning(dcServerManager()) << "Failed to generate a TLS session ticket key.";
+        return !m_ticketKeys.isEmpty();
+    }
+
+    qCDebug(dcServerManager()) << "Rotating TLS session ticket key";
+    m_ticketKeys.prepend(key);
+    while (m_ticketKeys.count() > 2) {
+        m_ticketKeys.removeLast();
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,124 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef TLSSESSIONCACHE_H
+#define TLSSESSIONCACHE_H
+
+#include <QByteArray>
+#include <QCache>
+#include <QElapsedTimer>
+#include <QList>
+#include <QMutex>
+
+#include <openssl/ssl.h>
+
+namespace nymeaserver {
+
+// Lets clients resume TLS sessions with any of the servers in this process instead of doing a
+// full handshake on every reconnect. QSslSocket creates a fresh SSL_CTX per connection, so the
+// session cache and ticket keys OpenSSL keeps per context never survive a connection. This class
+// attaches one shared, bounded session cache and a set of rotating ticket keys to every server
+// side SSL object created in the process once enabled.
+class TlsSessionCache
+{
+public:
+    static TlsSessionCache *instance();
+
+    void enable(const QByteArray &sessionIdContext);
+    bool enabled() const;
+
+    int maxSessions() const;
+    void setMaxSessions(int maxSessions);
+
+    int lifetime() const;
+    void setLifetime(int seconds);
+
+    int sessionCount() const;
+    quint64 resumedSessions() const;
+
+    void clear();
+
+private:
+    TlsSessionCache();
+
+    class TicketKey {
+    public:
+        QByteArray name;
+        QByteArray aesKey;
+        QByteArray hmacKey;
+        qint64 created = 0;
+    };
+
+    class ContextHooks {
+    public:
+        int (*previousNewSession)(SSL *ssl, SSL_SESSION *session) = nullptr;
+        void (*previousInfoCallback)(const SSL *ssl, int where, int ret) = nullptr;
+    };
+
+    // OpenSSL 3 deprecates HMAC_CTX, the ticket key callback gets an EVP_MAC_CTX instead
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    typedef EVP_MAC_CTX TicketMacContext;
+#else
+    typedef HMAC_CTX TicketMacContext;
+#endif
+
+    static void onSslCreated(void *parent, void *ptr, CRYPTO_EX_DATA *ad, int index, long argl, void *argp);
+    static void onContextFreed(void *parent, void *ptr, CRYPTO_EX_DATA *ad, int index, long argl, void *argp);
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+    static int onClientHello(SSL *ssl, int *alert, void *arg);
+#endif
+    static int onNewSession(SSL *ssl, SSL_SESSION *session);
+    static SSL_SESSION *onGetSession(SSL *ssl, const unsigned char *id, int idLength, int *copy);
+    static void onRemoveSession(SSL_CTX *context, SSL_SESSION *session);
+    static void onInfo(const SSL *ssl, int where, int ret);
+    static int onTicketKey(SSL *ssl, unsigned char *keyName, unsigned char *iv, EVP_CIPHER_CTX *cipherContext, TicketMacContext *macContext, int encrypt);
+    static bool initTicketMac(TicketMacContext *macContext, const QByteArray &hmacKey);
+
+    void setupSsl(SSL *ssl);
+    void setupContext(SSL_CTX *context, ContextHooks *hooks);
+    bool rotateTicketKeys();
+
+    static TlsSessionCache *s_instance;
+
+    mutable QMutex m_mutex;
+    bool m_enabled = false;
+    int m_sslIndex = -1;
+    int m_contextIndex = -1;
+    QByteArray m_sessionIdContext;
+    int m_lifetime = 12 * 60 * 60;
+    QCache<QByteArray, QByteArray> m_sessions;
+    QList<TicketKey> m_ticketKeys;
+    QElapsedTimer m_clock;
+    quint64 m_resumedSessions = 0;
+};
+
+}
+
+#endif // TLSSESSIONCACHE_H
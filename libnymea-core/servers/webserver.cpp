@@ -42,6 +42,14 @@
     \l{https://en.wikipedia.org/wiki/List_of_TCP_and_UDP_port_numbers}{list}
     officially free.
 
+    Connections are persistent: pipelined requests are answered in order, idle connections
+    are closed after 30 seconds and a connection is closed after 100 requests.
+
+    Public files and icons are cached in memory and replies carry an \tt ETag and a
+    \tt Last-Modified header for conditional requests. If a \tt .gz file exists next to
+    the requested file, it gets served to clients accepting the gzip encoding. Large files
+    are sent with \tt sendfile on unencrypted connections.
+
     The URL for the insecure nymea-webinterface access:
     \code http://localhost:3333\endcode
 
@@ -87,6 +95,7 @@
 #include "httpreply.h"
 #include "httprequest.h"
 #include "debugserverhandler.h"
+#include "metricshandler.h"
 #include "version.h"
 
 #include <QJsonDocument>
@@ -100,9 +109,81 @@
 #include <QUuid>
 #include <QUrl>
 #include <QFile>
+#include <QLocale>
+
+#include <sys/sendfile.h>
+#include <errno.h>
+#include <string.h>
 
 namespace nymeaserver {
 
+// Seconds a keep-alive connection may stay idle before it gets closed
+static const int webServerIdleTimeout = 30;
+// Requests served on one connection before the server closes it
+static const int webServerMaxRequestsPerConnection = 100;
+// Pipelined requests waiting for their reply before the server stops reading
+static const int webServerMaxPendingRequests = 16;
+// Bytes buffered from a client while reading is paused
+static const qint64 webServerPausedReadBufferSize = 4096;
+// Memory used for cached public files and icons
+static const int webServerFileCacheSize = 8 * 1024 * 1024;
+// Bigger files are not cached and are sent with sendfile on unencrypted connections
+static const qint64 webServerMaxCachedFileSize = 512 * 1024;
+// Bytes queued through the socket while the kernel send buffer is full
+static const qint64 webServerSendFileChunkSize = 64 * 1024;
+
+static QByteArray contentTypeForFile(const QString &fileName)
+{
+    if (fileName.endsWith(".html")) {
+        return "text/html; charset=\"utf-8\";";
+    } else if (fileName.endsWith(".css")) {
+        return "text/css; charset=\"utf-8\";";
+    } else if (fileName.endsWith(".pdf")) {
+        return "application/pdf";
+    } else if (fileName.endsWith(".js")) {
+        return "text/javascript; charset=\"utf-8\";";
+    } else if (fileName.endsWith(".ttf")) {
+        return "application/x-font-ttf";
+    } else if (fileName.endsWith(".eot")) {
+        return "application/vnd.ms-fontobject";
+    } else if (fileName.endsWith(".woff")) {
+        return "application/x-font-woff";
+    } else if (fileName.endsWith(".jpg") || fileName.endsWith(".jpeg")) {
+        return "image/jpeg";
+    } else if (fileName.endsWith(".png") || fileName.endsWith(".PNG")) {
+        return "image/png";
+    } else if (fileName.endsWith(".ico")) {
+        return "image/x-icon";
+    } else if (fileName.endsWith(".svg")) {
+        return "image/svg+xml; charset=\"utf-8\";";
+    }
+    return QByteArray();
+}
+
+static QByteArray httpDate(const QDateTime &dateTime)
+{
+    return QLocale::c().toString(dateTime.toUTC(), "ddd, dd MMM yyyy hh:mm:ss 'GMT'").toUtf8();
+}
+
+static bool acceptsGzip(const HttpRequest &request)
+{
+    foreach (const QByteArray &coding, request.header("Accept-Encoding").split(',')) {
+        QList<QByteArray> parameters = coding.split(';');
+        QByteArray name = parameters.takeFirst().trimmed().toLower();
+        if (name != "gzip" && name != "*")
+            continue;
+
+        // "gzip;q=0" explicitly refuses the encoding
+        foreach (const QByteArray &parameter, parameters) {
+            QByteArray value = parameter.trimmed();
+            if (value.startsWith("q=") && value.mid(2).toDouble() <= 0)
+                return false;
+        }
+        return true;
+    }
+    return false;
+}
+
 /*! Constructs a \l{WebServer} with the given \a configuration, \a sslConfiguration and \a parent.
  *
  *  \sa ServerManager, WebServerConfiguration
@@ -115,6 +196,12 @@ WebServer::WebServer(const WebServerConfiguration &configuration, const QSslConf
     if (QCoreApplication::instance()->organizationName() == "nymea-test") {
         m_configuration.publicFolder = QCoreApplication::applicationDirPath();
     }
+    m_fileCache.setMaxCost(webServerFileCacheSize);
+    m_timeoutWheel.resize(webServerIdleTimeout + 1);
+    m_timeoutTimer = new QTimer(this);
+    m_timeoutTimer->setInterval(1000);
+    connect(m_timeoutTimer, &QTimer::timeout, this, &WebServer::onTimeoutTick);
+
     qCDebug(dcWebServer()) << "Starting WebServer. Interface:" << m_configuration.address << "Port:" << m_configuration.port << "SSL:" << m_configuration.sslEnabled << "AUTH:" << m_configuration.authenticationEnabled << "Public folder:" << QDir(m_configuration.publicFolder).canonicalPath();
 }
 
@@ -133,11 +220,22 @@ QUrl WebServer::serverUrl() const
 }
 
 /*! Send the given \a reply map to the corresponding client.
+ *
+ * Replies to pipelined requests are sent in the order the requests arrived. The
+ * connection is kept open unless the client, the reply or the request limit asks
+ * for closing it.
  *
  * \sa HttpReply
  */
 void WebServer::sendHttpReply(HttpReply *reply)
 {
+    queueReply(reply);
+}
+
+void WebServer::queueReply(HttpReply *reply, const QString &sendFileName, qint64 sendFileSize)
+{
+    quint64 sequence = m_asyncReplySequences.contains(reply) ? m_asyncReplySequences.take(reply) : m_currentSequence;
+
     // get the right socket
     QSslSocket *socket = nullptr;
     socket = m_clientList.value(reply->clientId());
@@ -146,11 +244,34 @@ void WebServer::sendHttpReply(HttpReply *reply)
         return;
     }
 
-    // send raw data
-    reply->packReply();
+    QHash<QSslSocket *, Connection>::iterator it = m_connections.find(socket);
+    if (it == m_connections.end()) {
+        qCWarning(dcWebServer()) << "Connection of client" << reply->clientId().toString() << "already closed. Dropping reply.";
+        return;
+    }
+    Connection &connection = it.value();
+    if (reply->closeConnection() && (!connection.closing || sequence < connection.closeSequence)) {
+        connection.closing = true;
+        connection.closeSequence = sequence;
+    }
+
+    if (connection.closing && sequence == connection.closeSequence) {
+        reply->setHeader(HttpReply::ConnectionHeader, "close");
+        reply->removeRawHeader("Keep-Alive");
+    } else {
+        int remainingRequests = webServerMaxRequestsPerConnection - static_cast<int>(sequence) - 1;
+        reply->setHeader(HttpReply::ConnectionHeader, "Keep-Alive");
+        reply->setRawHeader("Keep-Alive", QString("timeout=%1, max=%2").arg(webServerIdleTimeout).arg(remainingRequests).toUtf8());
+    }
+
     qCDebug(dcWebServerTraffic()) << "Send reply to" << socket->peerAddress().toString() << reply;
     qCDebug(dcWebServer()) << "Respond" << socket->peerAddress().toString() << reply->httpStatusCode() << reply->httpReasonPhrase();
-    socket->write(reply->data());
+    PendingReply pendingReply;
+    pendingReply.data = reply->data();
+    pendingReply.sendFileName = sendFileName;
+    pendingReply.sendFileSize = sendFileSize;
+    connection.finishedReplies.insert(sequence, pendingReply);
+    writeReplies(socket);
 }
 
 bool WebServer::verifyFile(QSslSocket *socket, const QString &fileName)
@@ -202,26 +323,144 @@ QString WebServer::fileName(const QString &query)
     return m_configuration.publicFolder + "/" + fileName;
 }
 
-HttpReply *WebServer::processIconRequest(const QString &fileName)
+HttpReply *WebServer::processIconRequest(const HttpRequest &request, const QString &fileName)
 {
     if (!fileName.endsWith(".png"))
         return HttpReply::createErrorReply(HttpReply::NotFound);
 
-    QByteArray imageData;
-
-    QImage image(":" + fileName);
-    QBuffer buffer(&imageData);
-    buffer.open(QIODevice::WriteOnly);
-    image.save(&buffer, "png");
+    // Icons are compiled into the resources and only need to be encoded once
+    QString resourceName = ":" + fileName;
+    CachedFile *cachedIcon = m_fileCache.object(resourceName);
+    if (!cachedIcon) {
+        QByteArray imageData;
+
+        QImage image(resourceName);
+        QBuffer buffer(&imageData);
+        buffer.open(QIODevice::WriteOnly);
+        image.save(&buffer, "png");
+
+        if (imageData.isEmpty())
+            return HttpReply::createErrorReply(HttpReply::NotFound);
+
+        cachedIcon = new CachedFile();
+        cachedIcon->data = imageData;
+        cachedIcon->size = imageData.size();
+        cachedIcon->etag = "\"icon-" + QByteArray::number(qHash(imageData), 16) + "\"";
+        m_fileCache.insert(resourceName, cachedIcon, imageData.size());
+    }
 
-    if (!imageData.isEmpty()) {
-        HttpReply *reply = HttpReply::createSuccessReply();
+    HttpReply *reply = nullptr;
+    if (isNotModified(request, cachedIcon->etag, QDateTime())) {
+        reply = new HttpReply(HttpReply::NotModified);
+    } else {
+        reply = HttpReply::createSuccessReply();
         reply->setHeader(HttpReply::ContentTypeHeader, "image/png");
-        reply->setPayload(imageData);
-        return reply;
+        reply->setPayload(cachedIcon->data);
+    }
+    reply->setRawHeader("ETag", cachedIcon->etag);
+    return reply;
+}
+
+bool WebServer::isNotModified(const HttpRequest &request, const QByteArray &etag, const QDateTime &lastModified) const
+{
+    // If-None-Match takes precedence over If-Modified-Since (RFC 7232 3.3)
+    QByteArray ifNoneMatch = request.header("If-None-Match");
+    if (!ifNoneMatch.isEmpty()) {
+        foreach (QByteArray tag, ifNoneMatch.split(',')) {
+            tag = tag.trimmed();
+            if (tag.startsWith("W/"))
+                tag = tag.mid(2);
+            if (tag == "*" || tag == etag)
+                return true;
+        }
+        return false;
+    }
+
+    QByteArray ifModifiedSince = request.header("If-Modified-Since");
+    if (ifModifiedSince.isEmpty() || !lastModified.isValid())
+        return false;
+
+    QDateTime since = QLocale::c().toDateTime(QString::fromUtf8(ifModifiedSince), "ddd, dd MMM yyyy hh:mm:ss 'GMT'");
+    if (!since.isValid())
+        return false;
+
+    since.setTimeSpec(Qt::UTC);
+    // HTTP dates have a resolution of one second
+    return lastModified.toUTC().toMSecsSinceEpoch() / 1000 <= since.toMSecsSinceEpoch() / 1000;
+}
+
+void WebServer::processFileRequest(QSslSocket *socket, const QUuid &clientId, const HttpRequest &request, const QString &fileName)
+{
+    QFileInfo fileInfo(fileName);
+    QByteArray contentType = contentTypeForFile(fileName);
+
+    // Serve a precompressed sibling if the client accepts it and it is up to date
+    QFileInfo gzipInfo(fileName + ".gz");
+    bool hasGzip = gzipInfo.isFile() && gzipInfo.isReadable() && gzipInfo.lastModified() >= fileInfo.lastModified()
+            && gzipInfo.canonicalFilePath().startsWith(QDir(m_configuration.publicFolder).canonicalPath());
+    bool useGzip = hasGzip && acceptsGzip(request);
+    if (useGzip)
+        fileInfo = gzipInfo;
+
+    QString path = fileInfo.filePath();
+    QDateTime lastModified = fileInfo.lastModified();
+    QByteArray etag = "\"" + QByteArray::number(fileInfo.size(), 16) + "-" + QByteArray::number(lastModified.toMSecsSinceEpoch(), 16) + (useGzip ? "-gzip" : "") + "\"";
+
+    HttpReply *reply = nullptr;
+    QString sendFileName;
+    if (isNotModified(request, etag, lastModified)) {
+        reply = new HttpReply(HttpReply::NotModified);
+    } else if (fileInfo.size() > webServerMaxCachedFileSize && !socket->isEncrypted()) {
+        qCDebug(dcWebServer()) << "Send file" << path;
+        reply = new HttpReply(HttpReply::Ok);
+        reply->setHeader(HttpReply::ContentLenghtHeader, QByteArray::number(fileInfo.size()));
+        sendFileName = path;
+    } else {
+        CachedFile *cachedFile = m_fileCache.object(path);
+        if (!cachedFile || cachedFile->lastModified != lastModified || cachedFile->size != fileInfo.size()) {
+            QFile file(path);
+            if (!file.open(QFile::ReadOnly)) {
+                qCWarning(dcWebServer()) << "Could not open" << path << file.errorString();
+                reply = HttpReply::createErrorReply(HttpReply::Forbidden);
+                reply->setClientId(clientId);
+                sendHttpReply(reply);
+                reply->deleteLater();
+                return;
+            }
+
+            qCDebug(dcWebServer()) << "Load file" << file.fileName();
+            cachedFile = new CachedFile();
+            cachedFile->data = file.readAll();
+            cachedFile->lastModified = lastModified;
+            cachedFile->size = fileInfo.size();
+            cachedFile->etag = etag;
+            if (cachedFile->data.size() <= webServerMaxCachedFileSize) {
+                m_fileCache.insert(path, cachedFile, cachedFile->data.size());
+            } else {
+                reply = HttpReply::createSuccessReply();
+                reply->setPayload(cachedFile->data);
+                delete cachedFile;
+                cachedFile = nullptr;
+            }
+        }
+
+        if (cachedFile) {
+            reply = HttpReply::createSuccessReply();
+            reply->setPayload(cachedFile->data);
+        }
     }
 
-    return HttpReply::createErrorReply(HttpReply::NotFound);
+    if (!contentType.isEmpty())
+        reply->setHeader(HttpReply::ContentTypeHeader, contentType);
+    if (useGzip)
+        reply->setRawHeader("Content-Encoding", "gzip");
+    if (hasGzip)
+        reply->setRawHeader("Vary", "Accept-Encoding");
+    reply->setRawHeader("ETag", etag);
+    reply->setRawHeader("Last-Modified", httpDate(lastModified));
+    reply->setClientId(clientId);
+    queueReply(reply, sendFileName, fileInfo.size());
+    reply->deleteLater();
 }
 
 void WebServer::incomingConnection(qintptr socketDescriptor)
@@ -263,6 +502,11 @@ void WebServer::incomingConnection(qintptr socketDescriptor)
     QUuid clientId = QUuid::createUuid();
     m_clientList.insert(clientId, socket);
 
+    Connection connection;
+    connection.clientId = clientId;
+    m_connections.insert(socket, connection);
+    resetIdleTimeout(socket);
+
     qCDebug(dcWebServer()).noquote() << QString("Webserver client %1:%2 connected").arg(socket->peerAddress().toString()).arg(socket->peerPort());
 
     if (m_configuration.sslEnabled) {
@@ -275,6 +519,7 @@ void WebServer::incomingConnection(qintptr socketDescriptor)
     }
 
     connect(socket, SIGNAL(readyRead()), this, SLOT(readClient()));
+    connect(socket, SIGNAL(bytesWritten(qint64)), this, SLOT(onBytesWritten()));
     connect(socket, SIGNAL(disconnected()), this, SLOT(onDisconnected()));
     connect(socket, SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(onError(QAbstractSocket::SocketError)));
 
@@ -287,33 +532,224 @@ void WebServer::readClient()
         return;
 
     QSslSocket *socket = qobject_cast<QSslSocket *>(sender());
-    QUuid clientId = m_clientList.key(socket);
+    QHash<QSslSocket *, Connection>::iterator it = m_connections.find(socket);
 
     // Check client
-    if (clientId.isNull()) {
+    if (it == m_connections.end()) {
         qCWarning(dcWebServer()) << "Client not recognized";
         socket->close();
         return;
     }
 
-    // Read HTTP request
-    QByteArray data = socket->readAll();
+    readRequests(socket);
+}
 
-    HttpRequest request;
-    if (m_incompleteRequests.contains(socket)) {
-        qCDebug(dcWebServer()) << "Append data to incomlete request";
-        request = m_incompleteRequests.take(socket);
-        request.appendData(data);
-    } else {
-        request = HttpRequest(data);
+void WebServer::readRequests(QSslSocket *socket)
+{
+    QHash<QSslSocket *, Connection>::iterator it = m_connections.find(socket);
+    if (it == m_connections.end())
+        return;
+
+    // Leave the data in the socket while too many requests are waiting for their reply. With
+    // the small read buffer, the kernel buffers fill up and TCP slows the client down.
+    Connection &connection = it.value();
+    if (connection.readingPaused)
+        return;
+
+    if (pendingRequestsLimitReached(connection)) {
+        connection.readingPaused = true;
+        socket->setReadBufferSize(webServerPausedReadBufferSize);
+        return;
     }
 
-    // Check if the request is complete
-    if (!request.isComplete()) {
-        m_incompleteRequests.insert(socket, request);
+    // Read HTTP request data, it may contain several pipelined requests
+    connection.request.appendData(socket->readAll());
+    resetIdleTimeout(socket);
+    processRequests(socket);
+}
+
+bool WebServer::pendingRequestsLimitReached(const Connection &connection) const
+{
+    return connection.nextSequence - connection.nextReplySequence >= static_cast<quint64>(webServerMaxPendingRequests);
+}
+
+void WebServer::processRequests(QSslSocket *socket)
+{
+    QHash<QSslSocket *, Connection>::iterator it = m_connections.find(socket);
+    if (it == m_connections.end() || it.value().processing)
         return;
+
+    it.value().processing = true;
+    forever {
+        Connection &connection = it.value();
+        if (connection.closing || !connection.request.isComplete())
+            break;
+
+        // Stop parsing until the client has read the pending replies
+        if (pendingRequestsLimitReached(connection))
+            break;
+
+        HttpRequest request = connection.request;
+        connection.request = HttpRequest(request.excessData());
+        connection.handledRequests++;
+
+        quint64 sequence = connection.nextSequence++;
+        if (!keepAlive(request, connection.handledRequests)) {
+            connection.closing = true;
+            connection.closeSequence = sequence;
+        }
+
+        m_currentSequence = sequence;
+        processRequest(socket, connection.clientId, request);
+
+        // The socket might have been disconnected while processing the request
+        it = m_connections.find(socket);
+        if (it == m_connections.end())
+            return;
     }
+    it.value().processing = false;
+}
+
+bool WebServer::keepAlive(const HttpRequest &request, int handledRequests) const
+{
+    if (!request.isValid() || handledRequests >= webServerMaxRequestsPerConnection)
+        return false;
+
+    QByteArray connectionHeader = request.header("Connection").toLower();
+    if (request.httpVersion() == "HTTP/1.1")
+        return !connectionHeader.contains("close");
+
+    if (request.httpVersion() == "HTTP/1.0")
+        return connectionHeader.contains("keep-alive");
 
+    return false;
+}
+
+void WebServer::writeReplies(QSslSocket *socket)
+{
+    QHash<QSslSocket *, Connection>::iterator it = m_connections.find(socket);
+    if (it == m_connections.end())
+        return;
+
+    Connection &connection = it.value();
+    forever {
+        if (connection.sendFile) {
+            // Wait for bytesWritten if the file could not be written completely
+            if (!continueSendFile(socket, connection))
+                return;
+
+            quint64 sequence = connection.sendFileSequence;
+            connection.sendFile.clear();
+            if (connection.closing && sequence == connection.closeSequence) {
+                socket->disconnectFromHost();
+                return;
+            }
+        }
+
+        if (!connection.finishedReplies.contains(connection.nextReplySequence))
+            break;
+
+        quint64 sequence = connection.nextReplySequence++;
+        PendingReply reply = connection.finishedReplies.take(sequence);
+        socket->write(reply.data);
+        if (!reply.sendFileName.isEmpty()) {
+            QSharedPointer<QFile> file(new QFile(reply.sendFileName));
+            if (!file->open(QFile::ReadOnly)) {
+                qCWarning(dcWebServer()) << "Could not open" << reply.sendFileName << file->errorString() << "-> closing connection";
+                socket->abort();
+                return;
+            }
+            connection.sendFile = file;
+            connection.sendFileOffset = 0;
+            connection.sendFileRemaining = reply.sendFileSize;
+            connection.sendFileSequence = sequence;
+            continue;
+        }
+
+        if (connection.closing && sequence == connection.closeSequence) {
+            socket->disconnectFromHost();
+            return;
+        }
+    }
+
+    resetIdleTimeout(socket);
+
+    // Resume reading once there is room for more requests, this also continues with the held back ones
+    if (connection.readingPaused && !pendingRequestsLimitReached(connection)) {
+        connection.readingPaused = false;
+        socket->setReadBufferSize(0);
+        readRequests(socket);
+        return;
+    }
+
+    // Continue with pipelined requests which have been held back
+    if (!connection.processing && connection.request.isComplete())
+        processRequests(socket);
+}
+
+bool WebServer::continueSendFile(QSslSocket *socket, Connection &connection)
+{
+    // Data queued in the socket has to be sent before the file content
+    if (socket->bytesToWrite() > 0) {
+        socket->flush();
+        if (socket->bytesToWrite() > 0)
+            return false;
+    }
+
+    while (connection.sendFileRemaining > 0) {
+        off_t offset = static_cast<off_t>(connection.sendFileOffset);
+        ssize_t sent = ::sendfile(static_cast<int>(socket->socketDescriptor()), connection.sendFile->handle(), &offset, static_cast<size_t>(connection.sendFileRemaining));
+        int error = errno;
+        if (sent > 0) {
+            connection.sendFileOffset += sent;
+            connection.sendFileRemaining -= sent;
+            continue;
+        }
+
+        if (sent < 0 && error == EINTR)
+            continue;
+
+        if (sent < 0 && (error == EAGAIN || error == EWOULDBLOCK)) {
+            // The kernel buffer is full. Queue a chunk through the socket, its bytesWritten
+            // signal tells when to continue.
+            connection.sendFile->seek(connection.sendFileOffset);
+            QByteArray chunk = connection.sendFile->read(qMin(connection.sendFileRemaining, webServerSendFileChunkSize));
+            if (!chunk.isEmpty()) {
+                connection.sendFileOffset += chunk.size();
+                connection.sendFileRemaining -= chunk.size();
+                socket->write(chunk);
+                return connection.sendFileRemaining == 0;
+            }
+        }
+
+        // The file got truncated or the socket failed. The announced Content-Length can't be kept.
+        qCWarning(dcWebServer()) << "Could not send" << connection.sendFile->fileName() << (sent < 0 ? strerror(error) : "file truncated") << "-> closing connection";
+        socket->abort();
+        return false;
+    }
+    return true;
+}
+
+void WebServer::resetIdleTimeout(QSslSocket *socket)
+{
+    QHash<QSslSocket *, Connection>::iterator it = m_connections.find(socket);
+    if (it == m_connections.end())
+        return;
+
+    // Move the socket into the slot which expires last
+    int slot = (m_timeoutPosition + webServerIdleTimeout) % m_timeoutWheel.count();
+    if (it.value().timeoutSlot == slot)
+        return;
+
+    if (it.value().timeoutSlot >= 0)
+        m_timeoutWheel[it.value().timeoutSlot].remove(socket);
+
+    m_timeoutWheel[slot].insert(socket);
+    it.value().timeoutSlot = slot;
+}
+
+void WebServer::processRequest(QSslSocket *socket, const QUuid &clientId, const HttpRequest &request)
+{
     qCDebug(dcWebServerTraffic()) << "Received request from" << clientId.toString() << socket->peerAddress().toString() << request;
 
     // Check if the request is valid
@@ -321,6 +757,7 @@ void WebServer::readClient()
         qCWarning(dcWebServer()) << "Got invalid request:" << request.url().path();
         HttpReply *reply = HttpReply::createErrorReply(HttpReply::BadRequest);
         reply->setClientId(clientId);
+        reply->setCloseConnection(true);
         sendHttpReply(reply);
         reply->deleteLater();
         return;
@@ -331,6 +768,7 @@ void WebServer::readClient()
         qCWarning(dcWebServer()) << "HTTP version is not supported." << request.httpVersion();
         HttpReply *reply = HttpReply::createErrorReply(HttpReply::HttpVersionNotSupported);
         reply->setClientId(clientId);
+        reply->setCloseConnection(true);
         sendHttpReply(reply);
         reply->deleteLater();
         return;
@@ -338,14 +776,6 @@ void WebServer::readClient()
 
     qCDebug(dcWebServer()).noquote() << QString("Got valid request from %1:%2").arg(socket->peerAddress().toString()).arg(socket->peerPort()) << request.methodString() << request.url().path() << request.urlQuery().toString();
 
-    // Reset timout
-    foreach (WebServerClient *webserverClient, m_webServerClients) {
-        if (webserverClient->address() == socket->peerAddress()) {
-            webserverClient->resetTimout(socket);
-            break;
-        }
-    }
-
     // Verify method
     if (request.method() == HttpRequest::Unhandled) {
         HttpReply *reply = HttpReply::createErrorReply(HttpReply::MethodNotAllowed);
@@ -358,7 +788,7 @@ void WebServer::readClient()
 
     // Check icon call
     if (request.url().path().startsWith("/icons/") && request.method() == HttpRequest::Get) {
-        HttpReply *reply = processIconRequest(request.url().path());
+        HttpReply *reply = processIconRequest(request, request.url().path());
         reply->setClientId(clientId);
         sendHttpReply(reply);
         reply->deleteLater();
@@ -385,6 +815,7 @@ void WebServer::readClient()
 
             // Handle async replies
             if (reply->type() == HttpReply::TypeAsync) {
+                m_asyncReplySequences.insert(reply, m_currentSequence);
                 connect(reply, &HttpReply::finished, this, &WebServer::onAsyncReplyFinished);
                 reply->startWait();
             } else {
@@ -402,6 +833,34 @@ void WebServer::readClient()
         }
     }
 
+    // Check if this is a metrics call
+    if (request.url().path() == "/metrics") {
+        if (!NymeaCore::instance()->configuration()->metricsEnabled()) {
+            qCWarning(dcWebServer()) << "The metrics are disabled. You can enable them by adding \'metricsEnabled=true\' in the \'nymead\' section of the nymead.conf file.";
+            HttpReply *reply = HttpReply::createErrorReply(HttpReply::NotFound);
+            reply->setClientId(clientId);
+            sendHttpReply(reply);
+            reply->deleteLater();
+            return;
+        }
+
+        if (request.method() != HttpRequest::Get) {
+            HttpReply *reply = HttpReply::createErrorReply(HttpReply::MethodNotAllowed);
+            reply->setClientId(clientId);
+            reply->setHeader(HttpReply::AllowHeader, "GET");
+            sendHttpReply(reply);
+            reply->deleteLater();
+            return;
+        }
+
+        qCDebug(dcWebServer()) << "Metrics request call";
+        HttpReply *reply = NymeaCore::instance()->metricsHandler()->processMetricsRequest();
+        reply->setClientId(clientId);
+        sendHttpReply(reply);
+        reply->deleteLater();
+        return;
+    }
+
     // Check server.xml call
     if (request.url().path() == "/server.xml" && request.method() == HttpRequest::Get) {
         qCDebug(dcWebServer()) << "Server XML request call";
@@ -432,40 +891,8 @@ void WebServer::readClient()
         if (!verifyFile(socket, path))
             return;
 
-        QFile file(path);
-        if (file.open(QFile::ReadOnly | QFile::Truncate)) {
-            qCDebug(dcWebServer()) << "Load file" << file.fileName();
-            HttpReply *reply = HttpReply::createSuccessReply();
-
-            // Check content type
-            if (file.fileName().endsWith(".html")) {
-                reply->setHeader(HttpReply::ContentTypeHeader, "text/html; charset=\"utf-8\";");
-            } else if (file.fileName().endsWith(".css")) {
-                reply->setHeader(HttpReply::ContentTypeHeader, "text/css; charset=\"utf-8\";");
-            } else if (file.fileName().endsWith(".pdf")) {
-                reply->setHeader(HttpReply::ContentTypeHeader, "application/pdf");
-            } else if (file.fileName().endsWith(".js")) {
-                reply->setHeader(HttpReply::ContentTypeHeader, "text/javascript; charset=\"utf-8\";");
-            } else if (file.fileName().endsWith(".ttf")) {
-                reply->setHeader(HttpReply::ContentTypeHeader, "application/x-font-ttf");
-            } else if (file.fileName().endsWith(".eot")) {
-                reply->setHeader(HttpReply::ContentTypeHeader, "application/vnd.ms-fontobject");
-            } else if (file.fileName().endsWith(".woff")) {
-                reply->setHeader(HttpReply::ContentTypeHeader, "application/x-font-woff");
-            } else if (file.fileName().endsWith(".jpg") || file.fileName().endsWith(".jpeg")) {
-                reply->setHeader(HttpReply::ContentTypeHeader, "image/jpeg");
-            } else if (file.fileName().endsWith(".png") || file.fileName().endsWith(".PNG")) {
-                reply->setHeader(HttpReply::ContentTypeHeader, "image/png");
-            } else if (file.fileName().endsWith(".ico")) {
-                reply->setHeader(HttpReply::ContentTypeHeader, "image/x-icon");
-            } else if (file.fileName().endsWith(".svg")) {
-                reply->setHeader(HttpReply::ContentTypeHeader, "image/svg+xml; charset=\"utf-8\";");
-            }
-
-            reply->setPayload(file.readAll());
-            reply->setClientId(clientId);
-            sendHttpReply(reply);
-            reply->deleteLater();
+        if (QFileInfo(path).isFile()) {
+            processFileRequest(socket, clientId, request, path);
             return;
         }
     }
@@ -498,10 +925,12 @@ void WebServer::onDisconnected()
     qCDebug(dcWebServer()).noquote() << QString("Webserver client disonnected %1:%2").arg(socket->peerAddress().toString()).arg(socket->peerPort());
 
     // clean up
-    QUuid clientId = m_clientList.key(socket);
-    m_clientList.remove(clientId);
-    m_incompleteRequests.remove(socket);
-    emit clientDisconnected(clientId);
+    Connection connection = m_connections.take(socket);
+    if (connection.timeoutSlot >= 0)
+        m_timeoutWheel[connection.timeoutSlot].remove(socket);
+
+    m_clientList.remove(connection.clientId);
+    emit clientDisconnected(connection.clientId);
 
     socket->deleteLater();
 }
@@ -545,6 +974,40 @@ void WebServer::onAsyncReplyFinished()
     reply->deleteLater();
 }
 
+void WebServer::onBytesWritten()
+{
+    // Continue a file transfer once the socket is writable again
+    QSslSocket *socket = static_cast<QSslSocket *>(sender());
+    QHash<QSslSocket *, Connection>::iterator it = m_connections.find(socket);
+    if (it != m_connections.end() && it.value().sendFile)
+        writeReplies(socket);
+}
+
+void WebServer::onTimeoutTick()
+{
+    m_timeoutPosition = (m_timeoutPosition + 1) % m_timeoutWheel.count();
+
+    // Everything in the current slot has not been used for the whole idle timeout
+    QSet<QSslSocket *> expired;
+    expired.swap(m_timeoutWheel[m_timeoutPosition]);
+    foreach (QSslSocket *socket, expired) {
+        QHash<QSslSocket *, Connection>::iterator it = m_connections.find(socket);
+        if (it == m_connections.end())
+            continue;
+
+        it.value().timeoutSlot = -1;
+
+        // Keep connections waiting for an async reply
+        if (it.value().nextReplySequence < it.value().nextSequence) {
+            resetIdleTimeout(socket);
+            continue;
+        }
+
+        qCDebug(dcWebServer()).noquote() << QString("Client connection timeout %1:%2 -> closing connection").arg(socket->peerAddress().toString()).arg(socket->peerPort());
+        socket->disconnectFromHost();
+    }
+}
+
 /*! Set the configuration of this \l{WebServer} to the given \a config.
  *
  * \sa WebServerConfiguration
@@ -581,6 +1044,7 @@ bool WebServer::startServer()
 
     qCDebug(dcWebServer()) << "Started web server on" << serverUrl().toString();
 
+    m_timeoutTimer->start();
     m_enabled = true;
     return true;
 }
@@ -592,6 +1056,7 @@ bool WebServer::stopServer()
         client->close();
 
     close();
+    m_timeoutTimer->stop();
     m_enabled = false;
     qCDebug(dcWebServer()) << "Webserver closed.";
     return true;
@@ -763,8 +1228,7 @@ QByteArray WebServer::createServerXmlDocument(QHostAddress address)
     \inmodule core
 
     The \l{WebServerClient} represents a client for the nymea \l{WebServer}. Each client can
-    have up to 50 connections and each connection will timeout after 12 seconds if the
-    connection will not be used.
+    have up to 50 connections. Idle connections are closed by the \l{WebServer}.
 
     If all connections of a \l{WebServerClient} are closed, the client will be removed from
     system.
@@ -792,50 +1256,17 @@ QList<QSslSocket *> WebServerClient::connections()
 }
 
 /*! Adds a new connection (\a socket) to this \l{WebServerClient}. A \l{WebServerClient}
- *  can have up to 50 connecections. The connection will timout and closed if the client
- *  does not use the connection for 65 seconds.
+ *  can have up to 50 connecections.
  */
 void WebServerClient::addConnection(QSslSocket *socket)
 {
-    QTimer *timer = new QTimer(this);
-    timer->setSingleShot(true);
-    timer->setInterval(65000);
-    connect(timer, &QTimer::timeout, this, &WebServerClient::onTimout);
-
-    m_runningConnections.insert(timer, socket);
     m_connections.append(socket);
-
-    timer->start();
 }
 
 /*! Removes a connection the given \a socket from the connection list of this \l{WebServerClient}. */
 void WebServerClient::removeConnection(QSslSocket *socket)
 {
-    QTimer *timer = m_runningConnections.key(socket);
-    m_runningConnections.remove(timer);
     m_connections.removeAll(socket);
-
-    delete timer;
-}
-
-/*! Resets the connection timeout for the given \a socket. If the socket will not be used for 12 seconds the
- *  connection will be closed.
- */
-void WebServerClient::resetTimout(QSslSocket *socket)
-{
-    QTimer *timer = nullptr;
-    timer = m_runningConnections.key(socket);
-    if (timer)
-        timer->start();
-}
-
-void WebServerClient::onTimout()
-{
-    QTimer *timer =  static_cast<QTimer *>(sender());
-    QSslSocket *socket = m_runningConnections.value(timer);
-    qCDebug(dcWebServer()).noquote() << QString("Client connection timout %1:%2 -> closing connection").arg(socket->peerAddress().toString()).arg(socket->peerPort());
-    removeConnection(socket);
-    socket->close();
 }
 
 }
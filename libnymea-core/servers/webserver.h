@@ -35,7 +35,13 @@
 #include <QTcpServer>
 #include <QTcpSocket>
 #include <QHash>
+#include <QSet>
+#include <QCache>
+#include <QSharedPointer>
+#include <QDateTime>
+#include <QVector>
 #include <QDir>
+#include <QFile>
 #include <QTimer>
 #include <QImage>
 #include <QBuffer>
@@ -45,6 +51,7 @@
 #include <QSslKey>
 
 #include "nymeaconfiguration.h"
+#include "httprequest.h"
 
 // Note: Hypertext Transfer Protocol (HTTP/1.1) from the Internet Engineering Task Force (IETF):
 //       https://tools.ietf.org/html/rfc7231
@@ -52,7 +59,6 @@
 namespace nymeaserver {
 
 class HttpReply;
-class HttpRequest;
 
 class WebServerClient : public QObject
 {
@@ -66,15 +72,9 @@ public:
     void addConnection(QSslSocket *socket);
     void removeConnection(QSslSocket *socket);
 
-    void resetTimout(QSslSocket *socket);
-
 private:
     QHostAddress m_address;
     QList<QSslSocket *> m_connections;
-    QHash<QTimer *, QSslSocket *> m_runningConnections;
-
-private slots:
-    void onTimout();
 };
 
 
@@ -90,9 +90,61 @@ public:
     void sendHttpReply(HttpReply *reply);
 
 private:
+    // Packed reply waiting for its turn. Large files are appended with sendfile after the header.
+    class PendingReply
+    {
+    public:
+        QByteArray data;
+        QString sendFileName;
+        qint64 sendFileSize = 0;
+    };
+
+    // State of a persistent connection. Requests are numbered in the order they arrive,
+    // replies are written in the same order, even if an async reply finishes earlier.
+    class Connection
+    {
+    public:
+        QUuid clientId;
+        HttpRequest request;
+        int handledRequests = 0;
+        quint64 nextSequence = 0;
+        quint64 nextReplySequence = 0;
+        QHash<quint64, PendingReply> finishedReplies;
+        bool closing = false;
+        quint64 closeSequence = 0;
+        bool processing = false;
+        bool readingPaused = false;
+        int timeoutSlot = -1;
+
+        // File currently written with sendfile
+        QSharedPointer<QFile> sendFile;
+        qint64 sendFileOffset = 0;
+        qint64 sendFileRemaining = 0;
+        quint64 sendFileSequence = 0;
+    };
+
+    // Public files and encoded icons, validated against the modification time and size on each request
+    class CachedFile
+    {
+    public:
+        QByteArray data;
+        QDateTime lastModified;
+        qint64 size = 0;
+        QByteArray etag;
+    };
+
     QHash<QUuid, QSslSocket *> m_clientList;
     QList<WebServerClient *> m_webServerClients;
-    QHash<QSslSocket *, HttpRequest> m_incompleteRequests;
+    QHash<QSslSocket *, Connection> m_connections;
+    QHash<HttpReply *, quint64> m_asyncReplySequences;
+    quint64 m_currentSequence = 0;
+
+    // Idle connections are closed by a timer wheel with one slot per second
+    QTimer *m_timeoutTimer = nullptr;
+    QVector<QSet<QSslSocket *>> m_timeoutWheel;
+    int m_timeoutPosition = 0;
+
+    QCache<QString, CachedFile> m_fileCache;
 
     QString m_serverName;
     WebServerConfiguration m_configuration;
@@ -102,9 +154,21 @@ private:
 
     bool verifyFile(QSslSocket *socket, const QString &fileName);
     QString fileName(const QString &query);
+    void processFileRequest(QSslSocket *socket, const QUuid &clientId, const HttpRequest &request, const QString &fileName);
+    bool isNotModified(const HttpRequest &request, const QByteArray &etag, const QDateTime &lastModified) const;
+    void queueReply(HttpReply *reply, const QString &sendFileName = QString(), qint64 sendFileSize = 0);
+    bool continueSendFile(QSslSocket *socket, Connection &connection);
+
+    void readRequests(QSslSocket *socket);
+    bool pendingRequestsLimitReached(const Connection &connection) const;
+    void processRequests(QSslSocket *socket);
+    void processRequest(QSslSocket *socket, const QUuid &clientId, const HttpRequest &request);
+    bool keepAlive(const HttpRequest &request, int handledRequests) const;
+    void writeReplies(QSslSocket *socket);
+    void resetIdleTimeout(QSslSocket *socket);
 
     QByteArray createServerXmlDocument(QHostAddress address);
-    HttpReply *processIconRequest(const QString &fileName);
+    HttpReply *processIconRequest(const HttpRequest &request, const QString &fileName);
     HttpReply *processDebugRequest(const QString &requestPath);
 
 protected:
@@ -121,6 +185,8 @@ private slots:
     void onEncrypted();
     void onError(QAbstractSocket::SocketError error);
     void onAsyncReplyFinished();
+    void onTimeoutTick();
+    void onBytesWritten();
 
 public slots:
     void reconfigureServer(const WebServerConfiguration &config);
@@ -0,0 +1,168 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "settingssnapshot.h"
+#include "loggingcategories.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QCryptographicHash>
+
+static const quint32 snapshotMagic = 0x4e595353; // "NYSS"
+static const quint32 snapshotFormatVersion = 1;
+
+bool SettingsSnapshot::s_enabled = false;
+
+SettingsSnapshot::SettingsSnapshot(NymeaSettings::SettingsRole role, quint32 version):
+    m_role(role),
+    m_version(version)
+{
+    QFileInfo source(NymeaSettings::settingsFileName(role));
+    m_file.setFileName(NymeaSettings::storagePath() + "/snapshots/" + source.completeBaseName() + ".snapshot");
+}
+
+SettingsSnapshot::~SettingsSnapshot()
+{
+    if (m_map) {
+        m_file.unmap(m_map);
+    }
+}
+
+bool SettingsSnapshot::enabled()
+{
+    return s_enabled;
+}
+
+void SettingsSnapshot::setEnabled(bool enabled)
+{
+    s_enabled = enabled;
+}
+
+/*! Maps the snapshot file and verifies it. Returns false if the snapshot does not exist,
+    is corrupt, has been written by a different version or doesn't match the settings file. */
+bool SettingsSnapshot::load()
+{
+    if (!m_file.exists()) {
+        return false;
+    }
+
+    if (!m_file.open(QFile::ReadOnly)) {
+        qCWarning(dcApplication()) << "Unable to open settings snapshot" << m_file.fileName() << m_file.errorString();
+        return false;
+    }
+
+    m_map = m_file.map(0, m_file.size());
+    if (!m_map) {
+        qCWarning(dcApplication()) << "Unable to map settings snapshot" << m_file.fileName() << m_file.errorString();
+        m_file.close();
+        return false;
+    }
+
+    QByteArray raw = QByteArray::fromRawData(reinterpret_cast<const char*>(m_map), static_cast<int>(m_file.size()));
+    QDataStream stream(raw);
+    quint32 magic, formatVersion, version;
+    QByteArray storedSourceChecksum, storedChecksum;
+    stream >> magic >> formatVersion >> version >> storedSourceChecksum >> storedChecksum;
+    if (stream.status() != QDataStream::Ok || magic != snapshotMagic || formatVersion != snapshotFormatVersion || version != m_version) {
+        qCDebug(dcApplication()) << "Settings snapshot" << m_file.fileName() << "has an unknown format. Ignoring it.";
+        return false;
+    }
+
+    QByteArray payload = QByteArray::fromRawData(raw.constData() + stream.device()->pos(), raw.size() - static_cast<int>(stream.device()->pos()));
+    if (QCryptographicHash::hash(payload, QCryptographicHash::Md5) != storedChecksum) {
+        qCWarning(dcApplication()) << "Settings snapshot" << m_file.fileName() << "is corrupt. Ignoring it.";
+        return false;
+    }
+
+    if (sourceChecksum() != storedSourceChecksum) {
+        qCDebug(dcApplication()) << "Settings snapshot" << m_file.fileName() << "is outdated. Ignoring it.";
+        return false;
+    }
+
+    m_data = payload;
+    return true;
+}
+
+/*! Returns the payload of a successfully loaded snapshot. The data references the mapped
+    file and is only valid as long as this object exists. */
+QByteArray SettingsSnapshot::data() const
+{
+    return m_data;
+}
+
+/*! Atomically writes \a data as the snapshot for the current content of the settings file. */
+bool SettingsSnapshot::save(const QByteArray &data)
+{
+    QDir dir(QFileInfo(m_file.fileName()).absolutePath());
+    if (!dir.exists() && !dir.mkpath(dir.absolutePath())) {
+        qCWarning(dcApplication()) << "Unable to create settings snapshot directory" << dir.absolutePath();
+        return false;
+    }
+
+    QSaveFile file(m_file.fileName());
+    if (!file.open(QFile::WriteOnly)) {
+        qCWarning(dcApplication()) << "Unable to open settings snapshot" << file.fileName() << "for writing:" << file.errorString();
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream << snapshotMagic << snapshotFormatVersion << m_version;
+    stream << sourceChecksum() << QCryptographicHash::hash(data, QCryptographicHash::Md5);
+    stream.writeRawData(data.constData(), data.size());
+    if (stream.status() != QDataStream::Ok || !file.commit()) {
+        qCWarning(dcApplication()) << "Error writing settings snapshot" << file.fileName() << file.errorString();
+        return false;
+    }
+    return true;
+}
+
+void SettingsSnapshot::remove()
+{
+    if (m_map) {
+        m_file.unmap(m_map);
+        m_map = nullptr;
+        m_data.clear();
+    }
+    m_file.close();
+    m_file.remove();
+}
+
+QByteArray SettingsSnapshot::sourceChecksum() const
+{
+    QFile source(NymeaSettings::settingsFileName(m_role));
+    if (!source.open(QFile::ReadOnly)) {
+        return QByteArray();
+    }
+    QCryptographicHash hash(QCryptographicHash::Md5);
+    hash.addData(&source);
+    return hash.result();
+}
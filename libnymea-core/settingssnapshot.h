@@ -0,0 +1,69 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef SETTINGSSNAPSHOT_H
+#define SETTINGSSNAPSHOT_H
+
+#include "nymeasettings.h"
+
+#include <QFile>
+#include <QByteArray>
+
+// A versioned, checksummed binary copy of the data stored in a settings file.
+// The settings file always remains the source of truth. A snapshot is only
+// considered valid if it was written for the exact content of the settings file.
+class SettingsSnapshot
+{
+public:
+    SettingsSnapshot(NymeaSettings::SettingsRole role, quint32 version);
+    ~SettingsSnapshot();
+
+    static bool enabled();
+    static void setEnabled(bool enabled);
+
+    bool load();
+    QByteArray data() const;
+
+    bool save(const QByteArray &data);
+    void remove();
+
+private:
+    QByteArray sourceChecksum() const;
+
+    NymeaSettings::SettingsRole m_role;
+    quint32 m_version;
+    QFile m_file;
+    uchar *m_map = nullptr;
+    QByteArray m_data;
+
+    static bool s_enabled;
+};
+
+#endif // SETTINGSSNAPSHOT_H
@@ -32,6 +32,9 @@
 #include "integrations/thingmanager.h"
 #include "ruleengine/ruleengine.h"
 #include "nymeasettings.h"
+#include "settingssnapshot.h"
+
+#include <QDataStream>
 
 namespace nymeaserver {
 
@@ -41,7 +44,35 @@ TagsStorage::TagsStorage(ThingManager *thingManager, RuleEngine *ruleEngine, QOb
     m_ruleEngine(ruleEngine)
 {
     connect(thingManager, &ThingManager::thingRemoved, this, &TagsStorage::thingRemoved);
+    connect(ruleEngine, &RuleEngine::ruleRemoved, this, &TagsStorage::ruleRemoved);
+
+    m_saveTimer.setSingleShot(true);
+    m_saveTimer.setInterval(500);
+    connect(&m_saveTimer, &QTimer::timeout, this, &TagsStorage::saveTags);
+
+    if (!SettingsSnapshot::enabled()) {
+        loadTagsSettings();
+    } else if (!loadTagsSnapshot()) {
+        loadTagsSettings();
+        saveTagsSnapshot();
+    }
 
+    // Loading marks everything as changed, nothing needs to be written yet
+    m_dirtyThings.clear();
+    m_dirtyRules.clear();
+    m_saveTimer.stop();
+}
+
+TagsStorage::~TagsStorage()
+{
+    // Don't lose pending changes on shutdown
+    if (m_saveTimer.isActive()) {
+        saveTags();
+    }
+}
+
+void TagsStorage::loadTagsSettings()
+{
     NymeaSettings settings(NymeaSettings::SettingsRoleTags);
 
     if (settings.childGroups().contains("Things")) {
@@ -56,7 +87,7 @@ TagsStorage::TagsStorage(ThingManager *thingManager, RuleEngine *ruleEngine, QOb
             settings.beginGroup(appId);
             foreach (const QString &tagId, settings.childKeys()) {
                 Tag tag(ThingId(thingId), appId, tagId, settings.value(tagId).toString());
-                m_tags.append(tag);
+                insertTag(tag);
             }
             settings.endGroup();
         }
@@ -67,9 +98,7 @@ TagsStorage::TagsStorage(ThingManager *thingManager, RuleEngine *ruleEngine, QOb
     // Migration path from nymea <= 0.19
     if (settings.childGroups().contains("Devices")) {
         // Save all Devices tags to things tags and drop Devices group
-        foreach (const Tag &tag, m_tags) {
-            saveTag(tag);
-        }
+        saveTags();
         settings.remove("Devices");
     }
 
@@ -80,7 +109,7 @@ TagsStorage::TagsStorage(ThingManager *thingManager, RuleEngine *ruleEngine, QOb
             settings.beginGroup(appId);
             foreach (const QString &tagId, settings.childKeys()) {
                 Tag tag(RuleId(ruleId), appId, tagId, settings.value(tagId).toString());
-                m_tags.append(tag);
+                insertTag(tag);
             }
             settings.endGroup();
         }
@@ -89,34 +118,128 @@ TagsStorage::TagsStorage(ThingManager *thingManager, RuleEngine *ruleEngine, QOb
     settings.endGroup();
 }
 
+bool TagsStorage::loadTagsSnapshot()
+{
+    SettingsSnapshot snapshot(NymeaSettings::SettingsRoleTags, 1);
+    if (!snapshot.load()) {
+        return false;
+    }
+
+    QDataStream stream(snapshot.data());
+    quint32 count;
+    stream >> count;
+    QList<Tag> tags;
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; i++) {
+        QUuid thingId, ruleId;
+        QString appId, tagId, value;
+        stream >> thingId >> ruleId >> appId >> tagId >> value;
+        if (!thingId.isNull()) {
+            tags.append(Tag(ThingId(thingId), appId, tagId, value));
+        } else {
+            tags.append(Tag(RuleId(ruleId), appId, tagId, value));
+        }
+    }
+    if (stream.status() != QDataStream::Ok) {
+        return false;
+    }
+    foreach (const Tag &tag, tags) {
+        insertTag(tag);
+    }
+    return true;
+}
+
+void TagsStorage::saveTagsSnapshot()
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream << static_cast<quint32>(m_tags.count());
+    foreach (const Tag &tag, m_tags) {
+        stream << tag.thingId() << tag.ruleId() << tag.appId() << tag.tagId() << tag.value();
+    }
+    SettingsSnapshot(NymeaSettings::SettingsRoleTags, 1).save(data);
+}
+
 QList<Tag> TagsStorage::tags() const
 {
-    return m_tags;
+    return m_tags.values();
 }
 
 QList<Tag> TagsStorage::tags(const ThingId &thingId) const
 {
-    QList<Tag> ret;
-    foreach (const Tag &tag, m_tags) {
-        if (tag.thingId() == thingId) {
-            ret.append(tag);
+    return collectTags(m_tags, m_thingIndex.value(thingId));
+}
+
+QList<Tag> TagsStorage::tags(const RuleId &ruleId) const
+{
+    return collectTags(m_tags, m_ruleIndex.value(ruleId));
+}
+
+QList<Tag> TagsStorage::appTags(const QString &appId) const
+{
+    return collectTags(m_tags, m_appIndex.value(appId));
+}
+
+TagsStorage::TagError TagsStorage::addTag(const Tag &tag)
+{
+    return addTags(QList<Tag>() << tag);
+}
+
+TagsStorage::TagError TagsStorage::removeTag(const Tag &tag)
+{
+    return removeTags(QList<Tag>() << tag);
+}
+
+TagsStorage::TagError TagsStorage::addTags(const QList<Tag> &tags)
+{
+    // All or nothing, verify everything before changing anything
+    foreach (const Tag &tag, tags) {
+        TagError error = verifyTag(tag);
+        if (error != TagErrorNoError) {
+            return error;
         }
     }
-    return ret;
+
+    foreach (const Tag &tag, tags) {
+        bool existing = m_tags.contains(tagKey(tag));
+        insertTag(tag);
+        if (existing) {
+            emit tagValueChanged(tag);
+        } else {
+            emit tagAdded(tag);
+        }
+    }
+    return TagErrorNoError;
 }
 
-QList<Tag> TagsStorage::tags(const RuleId &ruleId) const
+TagsStorage::TagError TagsStorage::removeTags(const QList<Tag> &tags)
 {
-    QList<Tag> ret;
-    foreach (const Tag &tag, m_tags) {
-        if (tag.ruleId() == ruleId) {
-            ret.append(tag);
+    foreach (const Tag &tag, tags) {
+        if (!m_tags.contains(tagKey(tag))) {
+            return TagErrorTagNotFound;
         }
     }
-    return ret;
+
+    foreach (const Tag &tag, tags) {
+        // The same tag might be listed twice
+        if (m_tags.contains(tagKey(tag))) {
+            takeTag(tag);
+            emit tagRemoved(tag);
+        }
+    }
+    return TagErrorNoError;
 }
 
-TagsStorage::TagError TagsStorage::addTag(const Tag &tag)
+void TagsStorage::thingRemoved(const ThingId &thingId)
+{
+    removeTags(tags(thingId));
+}
+
+void TagsStorage::ruleRemoved(const RuleId &ruleId)
+{
+    removeTags(tags(ruleId));
+}
+
+TagsStorage::TagError TagsStorage::verifyTag(const Tag &tag) const
 {
     if (!tag.thingId().isNull()) {
         if (!m_thingManager->findConfiguredThing(tag.thingId())) {
@@ -127,85 +250,105 @@ TagsStorage::TagError TagsStorage::addTag(const Tag &tag)
            return TagsStorage::TagErrorRuleNotFound;
        }
     }
-
-    int index = m_tags.indexOf(tag);
-    if (index >= 0) {
-        m_tags.replace(index, tag);
-        emit tagValueChanged(tag);
-    } else {
-        m_tags.append(tag);
-        emit tagAdded(tag);
-    }
-    saveTag(tag);
     return TagsStorage::TagErrorNoError;
 }
 
-TagsStorage::TagError TagsStorage::removeTag(const Tag &tag)
+void TagsStorage::insertTag(const Tag &tag)
 {
-    if (!m_tags.contains(tag)) {
-        return TagErrorTagNotFound;
+    QString key = tagKey(tag);
+    m_tags.insert(key, tag);
+    if (!tag.thingId().isNull()) {
+        m_thingIndex[tag.thingId()].insert(key);
+        m_dirtyThings.insert(tag.thingId());
+    } else {
+        m_ruleIndex[tag.ruleId()].insert(key);
+        m_dirtyRules.insert(tag.ruleId());
     }
-    m_tags.removeAll(tag);
-    unsaveTag(tag);
-    emit tagRemoved(tag);
-    return TagErrorNoError;
+    m_appIndex[tag.appId()].insert(key);
+    m_saveTimer.start();
 }
 
-
-void TagsStorage::thingRemoved(const ThingId &thingId)
+void TagsStorage::takeTag(const Tag &tag)
 {
-    QList<Tag> tagsToRemove;
-    foreach (const Tag &tag, m_tags) {
-        if (tag.thingId() == thingId) {
-            tagsToRemove.append(tag);
+    QString key = tagKey(tag);
+    m_tags.remove(key);
+    if (!tag.thingId().isNull()) {
+        m_thingIndex[tag.thingId()].remove(key);
+        if (m_thingIndex.value(tag.thingId()).isEmpty()) {
+            m_thingIndex.remove(tag.thingId());
         }
+        m_dirtyThings.insert(tag.thingId());
+    } else {
+        m_ruleIndex[tag.ruleId()].remove(key);
+        if (m_ruleIndex.value(tag.ruleId()).isEmpty()) {
+            m_ruleIndex.remove(tag.ruleId());
+        }
+        m_dirtyRules.insert(tag.ruleId());
     }
-    while (!tagsToRemove.isEmpty()) {
-        removeTag(tagsToRemove.takeFirst());
+    m_appIndex[tag.appId()].remove(key);
+    if (m_appIndex.value(tag.appId()).isEmpty()) {
+        m_appIndex.remove(tag.appId());
     }
+    m_saveTimer.start();
 }
 
-void TagsStorage::ruleRemoved(const RuleId &ruleId)
+QString TagsStorage::tagKey(const Tag &tag)
 {
-    QList<Tag> tagsToRemove;
-    foreach (const Tag &tag, m_tags) {
-        if (tag.ruleId() == ruleId) {
-            tagsToRemove.append(tag);
-        }
-    }
-    while (!tagsToRemove.isEmpty()) {
-        removeTag(tagsToRemove.takeFirst());
-    }
+    QUuid owner = !tag.thingId().isNull() ? static_cast<QUuid>(tag.thingId()) : static_cast<QUuid>(tag.ruleId());
+    return owner.toString() + '\n' + tag.appId() + '\n' + tag.tagId();
 }
 
-void TagsStorage::saveTag(const Tag &tag)
+QList<Tag> TagsStorage::collectTags(const QMap<QString, Tag> &tags, const QSet<QString> &keys)
 {
-    NymeaSettings settings(NymeaSettings::SettingsRoleTags);
-
-    if (!tag.thingId().isNull()) {
-        settings.beginGroup("Things");
-        settings.beginGroup(tag.thingId().toString());
-    } else {
-        settings.beginGroup("Rules");
-        settings.beginGroup(tag.ruleId().toString());
+    // Sorted by key, like tags()
+    QMap<QString, Tag> ret;
+    foreach (const QString &key, keys) {
+        ret.insert(key, tags.value(key));
     }
-    settings.beginGroup(tag.appId());
-    settings.setValue(tag.tagId(), tag.value());
+    return ret.values();
 }
 
-void TagsStorage::unsaveTag(const Tag &tag)
+void TagsStorage::saveTags()
 {
-    NymeaSettings settings(NymeaSettings::SettingsRoleTags);
+    m_saveTimer.stop();
+
+    // Rewrite the groups of all things and rules changed since the last save. The settings
+    // are written to disk once, when the settings object goes out of scope.
+    {
+        NymeaSettings settings(NymeaSettings::SettingsRoleTags);
 
-    if (!tag.thingId().isNull()) {
         settings.beginGroup("Things");
-        settings.beginGroup(tag.thingId().toString());
-    } else {
+        foreach (const ThingId &thingId, m_dirtyThings) {
+            settings.remove(thingId.toString());
+            settings.beginGroup(thingId.toString());
+            foreach (const Tag &tag, tags(thingId)) {
+                settings.beginGroup(tag.appId());
+                settings.setValue(tag.tagId(), tag.value());
+                settings.endGroup();
+            }
+            settings.endGroup();
+        }
+        settings.endGroup();
+
         settings.beginGroup("Rules");
-        settings.beginGroup(tag.thingId().toString());
+        foreach (const RuleId &ruleId, m_dirtyRules) {
+            settings.remove(ruleId.toString());
+            settings.beginGroup(ruleId.toString());
+            foreach (const Tag &tag, tags(ruleId)) {
+                settings.beginGroup(tag.appId());
+                settings.setValue(tag.tagId(), tag.value());
+                settings.endGroup();
+            }
+            settings.endGroup();
+        }
+        settings.endGroup();
+    }
+    m_dirtyThings.clear();
+    m_dirtyRules.clear();
+
+    if (SettingsSnapshot::enabled()) {
+        saveTagsSnapshot();
     }
-    settings.beginGroup(tag.appId());
-    settings.remove(tag.tagId());
 }
 
 }
@@ -36,6 +36,10 @@
 
 #include <QObject>
 #include <QVector>
+#include <QTimer>
+#include <QHash>
+#include <QMap>
+#include <QSet>
 
 class ThingManager;
 
@@ -56,13 +60,18 @@ public:
     Q_ENUM(TagError)
 
     explicit TagsStorage(ThingManager* thingManager, RuleEngine* ruleEngine, QObject *parent = nullptr);
+    ~TagsStorage() override;
 
     TagError addTag(const Tag &tag);
     TagError removeTag(const Tag &tag);
 
+    TagError addTags(const QList<Tag> &tags);
+    TagError removeTags(const QList<Tag> &tags);
+
     QList<Tag> tags() const;
     QList<Tag> tags(const ThingId &thingId) const;
     QList<Tag> tags(const RuleId &ruleId) const;
+    QList<Tag> appTags(const QString &appId) const;
 
 signals:
     void tagAdded(const Tag &tag);
@@ -72,15 +81,34 @@ signals:
 private slots:
     void thingRemoved(const ThingId &thingId);
     void ruleRemoved(const RuleId &ruleId);
+    void saveTags();
 
 private:
-    void saveTag(const Tag &tag);
-    void unsaveTag(const Tag &tag);
+    TagError verifyTag(const Tag &tag) const;
+    void insertTag(const Tag &tag);
+    void takeTag(const Tag &tag);
+    static QString tagKey(const Tag &tag);
+    static QList<Tag> collectTags(const QMap<QString, Tag> &tags, const QSet<QString> &keys);
+
+    void loadTagsSettings();
+    bool loadTagsSnapshot();
+    void saveTagsSnapshot();
 
 private:
     ThingManager *m_thingManager;
     RuleEngine *m_ruleEngine;
-    QList<Tag> m_tags;
+
+    // All tags by tagKey(), plus the keys indexed by thing, rule and appId. Ordered
+    // by key so the tags are always listed in the same order.
+    QMap<QString, Tag> m_tags;
+    QHash<ThingId, QSet<QString>> m_thingIndex;
+    QHash<RuleId, QSet<QString>> m_ruleIndex;
+    QHash<QString, QSet<QString>> m_appIndex;
+
+    // Changes are written to disk in one go, shortly after the last change
+    QTimer m_saveTimer;
+    QSet<ThingId> m_dirtyThings;
+    QSet<RuleId> m_dirtyRules;
 };
 
 }
@@ -36,12 +36,9 @@
     \inmodule core
 */
 
-/*! \fn void nymeaserver::TimeManager::tick()
-    Represents the central time tick. Will be emitted every second.
-*/
-
 /*! \fn void nymeaserver::TimeManager::dateTimeChanged(const QDateTime &dateTime);
-    Will be emitted when the \a dateTime has changed.
+    Will be emitted with the current \a dateTime when a wakeup scheduled with \l{scheduleWakeup()}
+    is due or when the system clock has been changed.
 */
 
 #include "timemanager.h"
@@ -49,11 +46,17 @@
 
 namespace nymeaserver {
 
+// Upper limit for sleeping, used to notice system clock changes (i.e. NTP) in time
+static const int maxWakeupInterval = 5 * 60 * 1000;
+
 /*! Constructs a new \l{TimeManager} with the given \a timeZone and \a parent. */
 TimeManager::TimeManager(QObject *parent) :
     QObject(parent)
 {
-    m_timerId = startTimer(1000, Qt::VeryCoarseTimer);
+    m_wakeupTimer = new QTimer(this);
+    m_wakeupTimer->setSingleShot(true);
+    m_wakeupTimer->setTimerType(Qt::PreciseTimer);
+    connect(m_wakeupTimer, &QTimer::timeout, this, &TimeManager::onWakeupTimeout);
 }
 
 /*! Returns the current dateTime of this \l{TimeManager}. */
@@ -62,6 +65,16 @@ QDateTime TimeManager::currentDateTime() const
     return QDateTime::currentDateTime().addSecs(m_overrideDifference);
 }
 
+/*! Schedules the next emission of \l{dateTimeChanged()} at the given \a dateTime. Only the latest
+    scheduled wakeup is kept. An invalid \a dateTime cancels the pending wakeup, a \a dateTime in the
+    past wakes up immediately.
+*/
+void TimeManager::scheduleWakeup(const QDateTime &dateTime)
+{
+    m_nextWakeup = dateTime;
+    armWakeupTimer();
+}
+
 /*! Stop the time.
  *
  * \note This method should only be used in tests.
@@ -70,7 +83,8 @@ void TimeManager::stopTimer()
 {
     qCWarning(dcTimeManager()) << "TimeManager timer stopped. You should only see this in tests.";
     // Stop clock (used for testing)
-    killTimer(m_timerId);
+    m_stopped = true;
+    m_wakeupTimer->stop();
 }
 
 /*! Set the current time of this TimeManager to the given \a dateTime.
@@ -85,18 +99,40 @@ void TimeManager::setTime(const QDateTime &dateTime)
     emit dateTimeChanged(dateTime);
 }
 
-void TimeManager::timerEvent(QTimerEvent *event)
+void TimeManager::onWakeupTimeout()
 {
-    Q_UNUSED(event)
+    QDateTime now = currentDateTime();
 
-    emit tick();
+    // The timer runs on the monotonic clock, compare it with the wall clock
+    qint64 clockOffset = QDateTime::currentMSecsSinceEpoch() - m_wakeupArmedTime - m_wakeupElapsedTimer.elapsed();
+    bool clockChanged = qAbs(clockOffset) > 1000;
+    if (clockChanged) {
+        qCDebug(dcTimeManager()) << "System clock changed by" << clockOffset << "ms";
+    }
 
-    // Minute based nymea time
-    QDateTime now = QDateTime::currentDateTime();
-    if (m_lastEvent.time().minute() != now.time().minute()) {
-        m_lastEvent = now;
-        emit dateTimeChanged(now.addSecs(m_overrideDifference));
+    if (clockChanged || (m_nextWakeup.isValid() && m_nextWakeup <= now)) {
+        emit dateTimeChanged(now);
+
+        // Don't spin if nobody scheduled a new wakeup
+        if (m_nextWakeup.isValid() && m_nextWakeup <= now) {
+            m_nextWakeup = QDateTime();
+        }
     }
+
+    armWakeupTimer();
+}
+
+void TimeManager::armWakeupTimer()
+{
+    if (m_stopped || !m_nextWakeup.isValid()) {
+        m_wakeupTimer->stop();
+        return;
+    }
+
+    qint64 interval = qBound<qint64>(0, currentDateTime().msecsTo(m_nextWakeup), maxWakeupInterval);
+    m_wakeupArmedTime = QDateTime::currentMSecsSinceEpoch();
+    m_wakeupElapsedTimer.start();
+    m_wakeupTimer->start(static_cast<int>(interval));
 }
 
 }
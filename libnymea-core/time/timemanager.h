@@ -35,6 +35,7 @@
 #include <QObject>
 #include <QDateTime>
 #include <QTimeZone>
+#include <QElapsedTimer>
 
 namespace nymeaserver {
 
@@ -46,20 +47,29 @@ public:
 
     QDateTime currentDateTime() const;
 
+    void scheduleWakeup(const QDateTime &dateTime);
+
     // For testability only
     void stopTimer();
     void setTime(const QDateTime &dateTime);
 
 signals:
-    void tick();
     void dateTimeChanged(const QDateTime &dateTime);
 
-protected:
-    void timerEvent(QTimerEvent *event) override;
+private slots:
+    void onWakeupTimeout();
 
 private:
-    int m_timerId = 0;
-    QDateTime m_lastEvent;
+    bool m_stopped = false;
+
+    QTimer *m_wakeupTimer = nullptr;
+    QDateTime m_nextWakeup;
+
+    // Used to detect system clock changes while sleeping
+    QElapsedTimer m_wakeupElapsedTimer;
+    qint64 m_wakeupArmedTime = 0;
+
+    void armWakeupTimer();
 
     // For testability
     qint64 m_overrideDifference = 0;
@@ -89,8 +89,13 @@ Q_LOGGING_CATEGORY(dcCoap, "Coap")
 /*! Constructs a Coap access manager with the given \a parent and \a port. */
 Coap::Coap(QObject *parent, const quint16 &port) :
     QObject(parent),
-    m_reply(nullptr)
+    m_maxOutstandingRequests(1),
+    m_nextMessageId((quint16)qrand())
 {
+    // Large enough for any datagram on a typical link (RFC7252 section 4.6), grown on demand
+    m_receiveBuffer.resize(1152);
+    m_sendBuffer.resize(1152);
+
     m_socket = new QUdpSocket(this);
 
     if (!m_socket->bind(QHostAddress::Any, port, QAbstractSocket::ShareAddress))
@@ -115,13 +120,7 @@ CoapReply *Coap::ping(const CoapRequest &request)
         return reply;
     }
 
-    // check if there is a request running
-    if (m_reply == 0) {
-        m_reply = reply;
-        lookupHost();
-    } else {
-        m_replyQueue.enqueue(reply);
-    }
+    enqueueRequest(reply);
 
     return reply;
 }
@@ -142,13 +141,7 @@ CoapReply *Coap::get(const CoapRequest &request)
         return reply;
     }
 
-    // check if there is a request running
-    if (m_reply == 0) {
-        m_reply = reply;
-        lookupHost();
-    } else {
-        m_replyQueue.enqueue(reply);
-    }
+    enqueueRequest(reply);
     return reply;
 }
 
@@ -169,13 +162,7 @@ CoapReply *Coap::put(const CoapRequest &request, const QByteArray &data)
         return reply;
     }
 
-    // check if there is a request running
-    if (m_reply == 0) {
-        m_reply = reply;
-        lookupHost();
-    } else {
-        m_replyQueue.enqueue(reply);
-    }
+    enqueueRequest(reply);
 
     return reply;
 }
@@ -197,13 +184,7 @@ CoapReply *Coap::post(const CoapRequest &request, const QByteArray &data)
         return reply;
     }
 
-    // check if there is a request running
-    if (m_reply == 0) {
-        m_reply = reply;
-        lookupHost();
-    } else {
-        m_replyQueue.enqueue(reply);
-    }
+    enqueueRequest(reply);
 
     return reply;
 }
@@ -224,13 +205,7 @@ CoapReply *Coap::deleteResource(const CoapRequest &request)
         return reply;
     }
 
-    // check if there is a request running
-    if (m_reply.isNull()) {
-        m_reply = reply;
-        lookupHost();
-    } else {
-        m_replyQueue.enqueue(reply);
-    }
+    enqueueRequest(reply);
 
     return reply;
 }
@@ -254,13 +229,7 @@ CoapReply *Coap::enableResourceNotifications(const CoapRequest &request)
         return reply;
     }
 
-    // check if there is a request running
-    if (m_reply.isNull()) {
-        m_reply = reply;
-        lookupHost();
-    } else {
-        m_replyQueue.enqueue(reply);
-    }
+    enqueueRequest(reply);
 
     return reply;
 }
@@ -285,21 +254,56 @@ CoapReply *Coap::disableNotifications(const CoapRequest &request)
         return reply;
     }
 
-    // check if there is a request running
-    if (m_reply == 0) {
-        m_reply = reply;
-        lookupHost();
-    } else {
-        m_replyQueue.enqueue(reply);
-    }
+    enqueueRequest(reply);
 
     return reply;
 }
 
-void Coap::lookupHost()
+/*! Returns the maximum number of simultaneous outstanding interactions with a single peer. The default is 1 (NSTART).
+    \sa setMaxOutstandingRequests()
+*/
+int Coap::maxOutstandingRequests() const
+{
+    return m_maxOutstandingRequests;
+}
+
+/*! Sets the maximum number of simultaneous outstanding interactions with a single peer to \a maxOutstandingRequests.
+    Requests to different peers are always sent concurrently. Requests exceeding this limit for a peer are queued
+    until one of the running interactions with that peer finishes.
+
+    According to \l{https://tools.ietf.org/html/rfc7252#section-4.7}{RFC7252 section 4.7} (NSTART) this should only
+    be increased if the peer is known to handle it, e.g. for devices in the local network.
+*/
+void Coap::setMaxOutstandingRequests(int maxOutstandingRequests)
+{
+    m_maxOutstandingRequests = qMax(1, maxOutstandingRequests);
+
+    // Send the queued requests the new limit allows
+    foreach (const QString &peer, m_peerQueues.keys())
+        startQueuedRequests(peer);
+}
+
+void Coap::enqueueRequest(CoapReply *reply)
+{
+    connect(reply, &CoapReply::destroyed, this, &Coap::onReplyDestroyed);
+
+    // The peer is known once the host has been resolved
+    int lookupId = QHostInfo::lookupHost(reply->request().url().host(), this, SLOT(hostLookupFinished(QHostInfo)));
+    m_runningHostLookups.insert(lookupId, reply);
+}
+
+void Coap::dispatchRequest(CoapReply *reply)
 {
-    int lookupId = QHostInfo::lookupHost(m_reply->request().url().host(), this, SLOT(hostLookupFinished(QHostInfo)));
-    m_runningHostLookups.insert(lookupId, m_reply);
+    QString peer = peerKey(reply->hostAddress(), reply->port());
+    if (m_peerOutstandingCount.value(peer) >= m_maxOutstandingRequests) {
+        qCDebug(dcCoap) << "Queueing request for" << peer << "(" << m_peerOutstandingCount.value(peer) << "outstanding )";
+        m_peerQueues[peer].enqueue(reply);
+        return;
+    }
+
+    m_peerOutstandingCount[peer] += 1;
+    m_outstandingReplies.insert(reply, peer);
+    sendRequest(reply, reply->request().url().host() != reply->hostAddress().toString());
 }
 
 void Coap::sendRequest(CoapReply *reply, const bool &lookedUp)
@@ -307,8 +311,8 @@ void Coap::sendRequest(CoapReply *reply, const bool &lookedUp)
     CoapPdu pdu;
     pdu.setMessageType(reply->request().messageType());
     pdu.setStatusCode(reply->requestMethod());
-    pdu.createMessageId();
-    pdu.createToken();
+    pdu.setMessageId(createMessageId());
+    pdu.setToken(createToken());
 
     // Add the options in correct order
     // Option number 3
@@ -368,8 +372,9 @@ void Coap::sendRequest(CoapReply *reply, const bool &lookedUp)
 
     QByteArray pduData = pdu.pack();
     reply->setRequestData(pduData);
-    reply->setMessageId(pdu.messageId());
+    setReplyMessageId(reply, pdu.messageId());
     reply->setMessageToken(pdu.token());
+    m_tokenReplies.insert(pdu.token(), reply);
     reply->m_lockedUp = lookedUp;
     reply->m_timer->start();
 
@@ -394,32 +399,124 @@ void Coap::sendCoapPdu(const QHostAddress &hostAddress, const quint16 &port, con
     m_socket->writeDatagram(pdu.pack(), hostAddress, port);
 }
 
+quint16 Coap::createMessageId()
+{
+    // Sequential IDs starting at a random value (RFC7252 section 4.4), skipping the ones still in use
+    while (m_messageIdReplies.contains(m_nextMessageId))
+        m_nextMessageId++;
+
+    return m_nextMessageId++;
+}
+
+QByteArray Coap::createToken()
+{
+    CoapPdu pdu;
+    do {
+        pdu.createToken();
+    } while (m_tokenReplies.contains(pdu.token()) || m_observeResources.contains(pdu.token()));
+
+    return pdu.token();
+}
+
+void Coap::setReplyMessageId(CoapReply *reply, const quint16 &messageId)
+{
+    if (m_messageIdReplies.value(reply->messageId()) == reply)
+        m_messageIdReplies.remove(reply->messageId());
+
+    reply->setMessageId(messageId);
+    m_messageIdReplies.insert(messageId, reply);
+}
+
+void Coap::unregisterReply(CoapReply *reply)
+{
+    if (m_messageIdReplies.value(reply->messageId()) == reply)
+        m_messageIdReplies.remove(reply->messageId());
+
+    if (m_tokenReplies.value(reply->messageToken()) == reply)
+        m_tokenReplies.remove(reply->messageToken());
+}
+
+void Coap::releaseOutstanding(CoapReply *reply)
+{
+    if (!m_outstandingReplies.contains(reply))
+        return;
+
+    QString peer = m_outstandingReplies.take(reply);
+    m_peerOutstandingCount[peer] -= 1;
+    if (m_peerOutstandingCount.value(peer) <= 0)
+        m_peerOutstandingCount.remove(peer);
+
+    // Start the next waiting request for this peer
+    startQueuedRequests(peer);
+}
+
+void Coap::startQueuedRequests(const QString &peer)
+{
+    // Note: dispatching may finish replies synchronously (non confirmable), which modifies the queues
+    while (m_peerQueues.contains(peer) && m_peerOutstandingCount.value(peer) < m_maxOutstandingRequests) {
+        QPointer<CoapReply> nextReply = m_peerQueues[peer].dequeue();
+        if (m_peerQueues.value(peer).isEmpty())
+            m_peerQueues.remove(peer);
+
+        if (nextReply)
+            dispatchRequest(nextReply);
+    }
+}
+
+QString Coap::peerKey(const QHostAddress &address, const quint16 &port)
+{
+    // Make sure IPv4 mapped IPv6 addresses match the plain IPv4 address
+    bool isIPv4 = false;
+    quint32 ipv4Address = address.toIPv4Address(&isIPv4);
+    if (isIPv4)
+        return QString("%1:%2").arg(QHostAddress(ipv4Address).toString()).arg(port);
+
+    return QString("%1:%2").arg(address.toString()).arg(port);
+}
+
+CoapReply *Coap::findReply(const quint16 &messageId, const QByteArray &token, const QHostAddress &address, const quint16 &port) const
+{
+    QString peer = peerKey(address, port);
+
+    // Message id based match (piggybacked responses and empty ACKs)
+    CoapReply *reply = m_messageIdReplies.value(messageId);
+    if (reply && peerKey(reply->hostAddress(), reply->port()) == peer)
+        return reply;
+
+    // Token based match (separate responses)
+    reply = m_tokenReplies.value(token);
+    if (reply && peerKey(reply->hostAddress(), reply->port()) == peer)
+        return reply;
+
+    return nullptr;
+}
+
 void Coap::processResponse(const CoapPdu &pdu, const QHostAddress &address, const quint16 &port)
 {
-    // if we are waiting for a reply response
-    if (m_reply) {
+    // check if we are waiting for a response of this peer
+    CoapReply *reply = findReply(pdu.messageId(), pdu.token(), address, port);
+    if (reply) {
         qCDebug(dcCoap) << "<---" << QString("%1:%2").arg(address.toString()).arg(QString::number(port)) << pdu;
         if (!pdu.isValid()) {
             qCWarning(dcCoap) << "Got invalid PDU";
-            m_reply->setError(CoapReply::InvalidPduError);
-            m_reply->setFinished();
+            reply->setError(CoapReply::InvalidPduError);
+            reply->setFinished();
             return;
         }
 
         // check if the message is a response to a reply (message id based check)
-        if (m_reply->messageId() == pdu.messageId()) {
-            processIdBasedResponse(m_reply, pdu);
+        if (reply->messageId() == pdu.messageId()) {
+            processIdBasedResponse(reply, pdu);
             return;
         }
 
         // check if we know the message by token (message token based check)
-        if (m_reply->messageToken() == pdu.token()) {
-            processTokenBasedResponse(m_reply, pdu);
+        if (reply->messageToken() == pdu.token()) {
+            processTokenBasedResponse(reply, pdu);
             return;
         }
     }
 
-
     if (m_observerReply) {
         processBlock2Notification(m_observerReply, pdu);
         return;
@@ -445,6 +542,8 @@ void Coap::processIdBasedResponse(CoapReply *reply, const CoapPdu &pdu)
     if (pdu.statusCode() == CoapPdu::Empty && pdu.messageType() == CoapPdu::Acknowledgement) {
         reply->m_timer->stop();
         qCDebug(dcCoap) << "Got empty ACK. Data will be sent separated.";
+        // The interaction is not outstanding any more (RFC7252 section 4.7)
+        releaseOutstanding(reply);
         return;
     }
 
@@ -585,6 +684,29 @@ void Coap::processNotification(const CoapPdu &pdu, const QHostAddress &address,
     emit notificationReceived(resource, notificationNumber, pdu.payload());
 }
 
+bool Coap::processNotificationInPlace(const CoapPduView &pdu, const QHostAddress &address, const quint16 &port)
+{
+    // Only plain notifications are handled here, everything else goes through CoapPdu
+    if (!pdu.isValid() || !m_observerReply.isNull() || pdu.hasOption(CoapOption::Block2))
+        return false;
+
+    if (findReply(pdu.messageId(), pdu.token(), address, port) || !m_observeResources.contains(pdu.token()))
+        return false;
+
+    CoapObserveResource resource = m_observeResources.value(pdu.token());
+    int notificationNumber = pdu.optionValue(CoapOption::Observe);
+    qCDebug(dcCoap) << "<--- Notification" << QString("%1:%2").arg(address.toString()).arg(port) << "#" << notificationNumber << "payload size:" << pdu.payloadSize();
+
+    // respond with ACK
+    CoapPduWriter responseWriter(m_sendBuffer.data(), m_sendBuffer.size());
+    responseWriter.writeHeader(CoapPdu::Acknowledgement, CoapPdu::Empty, pdu.messageId(), pdu.token());
+    m_socket->writeDatagram(responseWriter.data(), responseWriter.size(), address, port);
+
+    // The receive buffer will be reused, the payload has to be copied for the receivers
+    emit notificationReceived(resource, notificationNumber, QByteArray(pdu.payloadData(), pdu.payloadSize()));
+    return true;
+}
+
 void Coap::processBlock1Response(CoapReply *reply, const CoapPdu &pdu)
 {
     qCDebug(dcCoap) << "Sent successfully block #" << pdu.block().blockNumber();
@@ -610,7 +732,7 @@ void Coap::processBlock1Response(CoapReply *reply, const CoapPdu &pdu)
     nextBlockRequest.setContentType(reply->request().contentType());
     nextBlockRequest.setMessageType(reply->request().messageType());
     nextBlockRequest.setStatusCode(reply->requestMethod());
-    nextBlockRequest.setMessageId(pdu.messageId() + 1);
+    nextBlockRequest.setMessageId(createMessageId());
     nextBlockRequest.setToken(pdu.token());
 
     // Add the options in correct order
@@ -643,7 +765,7 @@ void Coap::processBlock1Response(CoapReply *reply, const CoapPdu &pdu)
     reply->m_timer->start();
     reply->m_retransmissions = 1;
 
-    reply->setMessageId(nextBlockRequest.messageId());
+    setReplyMessageId(reply, nextBlockRequest.messageId());
 
     qCDebug(dcCoap) << "--->" << nextBlockRequest;
     sendData(reply->hostAddress(), reply->port(), pduData);
@@ -665,7 +787,7 @@ void Coap::processBlock2Response(CoapReply *reply, const CoapPdu &pdu)
     nextBlockRequest.setContentType(reply->request().contentType());
     nextBlockRequest.setMessageType(reply->request().messageType());
     nextBlockRequest.setStatusCode(reply->requestMethod());
-    nextBlockRequest.setMessageId(pdu.messageId() + 1);
+    nextBlockRequest.setMessageId(createMessageId());
     nextBlockRequest.setToken(pdu.token());
 
     // Add the options in correct order
@@ -695,7 +817,7 @@ void Coap::processBlock2Response(CoapReply *reply, const CoapPdu &pdu)
     reply->setRequestData(pduData);
     reply->m_timer->start();
 
-    reply->setMessageId(nextBlockRequest.messageId());
+    setReplyMessageId(reply, nextBlockRequest.messageId());
 
     qCDebug(dcCoap) << "--->" << nextBlockRequest;
     sendData(reply->hostAddress(), reply->port(), pduData);
@@ -776,10 +898,15 @@ void Coap::processBlock2Notification(CoapReply *reply, const CoapPdu &pdu)
 
 void Coap::hostLookupFinished(const QHostInfo &hostInfo)
 {
-    CoapReply *reply = m_runningHostLookups.take(hostInfo.lookupId());;
+    QPointer<CoapReply> reply = m_runningHostLookups.take(hostInfo.lookupId());
+    if (reply.isNull()) {
+        qCDebug(dcCoap) << "Reply has been deleted while looking up" << hostInfo.hostName();
+        return;
+    }
+
     reply->setPort(reply->request().url().port(5683));
 
-    if (hostInfo.error() != QHostInfo::NoError) {
+    if (hostInfo.error() != QHostInfo::NoError || hostInfo.addresses().isEmpty()) {
         qCDebug(dcCoap) << "Host lookup for" << reply->request().url().host() << "failed:" << hostInfo.errorString();
         reply->setError(CoapReply::HostNotFoundError);
         reply->setFinished();
@@ -790,27 +917,34 @@ void Coap::hostLookupFinished(const QHostInfo &hostInfo)
     reply->setHostAddress(hostAddress);
 
     // check if the url had to be looked up
-    if (reply->request().url().host() != hostAddress.toString()) {
+    if (reply->request().url().host() != hostAddress.toString())
         qCDebug(dcCoap) << reply->request().url().host() << " -> " << hostAddress.toString();
-        sendRequest(reply, true);
-    } else {
-        sendRequest(reply);
-    }
+
+    dispatchRequest(reply);
 }
 
 void Coap::onReadyRead()
 {
     QHostAddress hostAddress;
-    QByteArray data;
     quint16 port;
 
     while (m_socket->hasPendingDatagrams()) {
-        data.resize(m_socket->pendingDatagramSize());
-        m_socket->readDatagram(data.data(), data.size(), &hostAddress, &port);
-    }
+        int size = qMax<qint64>(0, m_socket->pendingDatagramSize());
+        if (m_receiveBuffer.size() < size)
+            m_receiveBuffer.resize(size);
+
+        size = m_socket->readDatagram(m_receiveBuffer.data(), size, &hostAddress, &port);
+        if (size < 0)
+            continue;
 
-    CoapPdu pdu(data);
-    processResponse(pdu, hostAddress, port);
+        // Parse in place, notifications can be handled without copying the datagram
+        CoapPduView pduView(m_receiveBuffer.constData(), size);
+        if (processNotificationInPlace(pduView, hostAddress, port))
+            continue;
+
+        CoapPdu pdu(QByteArray(m_receiveBuffer.constData(), size));
+        processResponse(pdu, hostAddress, port);
+    }
 }
 
 void Coap::onReplyTimeout()
@@ -835,16 +969,27 @@ void Coap::onReplyFinished()
         return;
     }
 
-    if (reply != m_reply)
-        qCWarning(dcCoap) << "This should never happen!! Please report a bug if you get this message!";
-
+    unregisterReply(reply);
     emit replyFinished(reply);
-    m_reply.clear();
 
-    // check if there is a request in the queue
-    if (!m_replyQueue.isEmpty()) {
-        m_reply = m_replyQueue.dequeue();
-        if (m_reply)
-            lookupHost();
+    // check if there is a request waiting for this peer
+    releaseOutstanding(reply);
+}
+
+void Coap::onReplyDestroyed(QObject *object)
+{
+    // Only the pointer value is used here, the reply is already gone
+    CoapReply *reply = static_cast<CoapReply *>(object);
+
+    foreach (const quint16 &messageId, m_messageIdReplies.keys(reply))
+        m_messageIdReplies.remove(messageId);
+
+    foreach (const QByteArray &token, m_tokenReplies.keys(reply))
+        m_tokenReplies.remove(token);
+
+    if (m_outstandingReplies.contains(reply)) {
+        QString peer = m_outstandingReplies.value(reply);
+        releaseOutstanding(reply);
+        qCDebug(dcCoap) << "Running reply for" << peer << "has been deleted";
     }
 }
@@ -42,6 +42,7 @@
 #include "libnymea.h"
 #include "coaprequest.h"
 #include "coapreply.h"
+#include "coappduview.h"
 #include "coapobserveresource.h"
 
 /* Information about CoAP
@@ -70,14 +71,28 @@ public:
     CoapReply *enableResourceNotifications(const CoapRequest &request);
     CoapReply *disableNotifications(const CoapRequest &request);
 
+    // Congestion control (NSTART)
+    int maxOutstandingRequests() const;
+    void setMaxOutstandingRequests(int maxOutstandingRequests);
 
 private:
     QUdpSocket *m_socket;
 
-    QPointer<CoapReply> m_reply;
-    QQueue<CoapReply *> m_replyQueue;
+    int m_maxOutstandingRequests;
+    quint16 m_nextMessageId;
 
-    QHash<int, CoapReply *> m_runningHostLookups;
+    // Preallocated datagram buffers
+    QByteArray m_receiveBuffer;
+    QByteArray m_sendBuffer;
+
+    QHash<int, QPointer<CoapReply> > m_runningHostLookups;             // lookup id | reply
+
+    // Running exchanges
+    QHash<quint16, CoapReply *> m_messageIdReplies;                     // message id | reply
+    QHash<QByteArray, CoapReply *> m_tokenReplies;                      // token | reply
+    QHash<CoapReply *, QString> m_outstandingReplies;                   // reply | peer
+    QHash<QString, int> m_peerOutstandingCount;                         // peer | outstanding interactions
+    QHash<QString, QQueue<QPointer<CoapReply> > > m_peerQueues;         // peer | waiting replies
 
     QHash<QByteArray, CoapObserveResource> m_observeResources;          // token | resource
 
@@ -86,16 +101,28 @@ private:
     QHash<CoapReply *, CoapObserveResource> m_observeReplyResource;     // observe reply | resource
     QHash<CoapReply *, int> m_observeBlockwise;                         // observe reply | observe nr.
 
-    void lookupHost();
+    void enqueueRequest(CoapReply *reply);
+    void dispatchRequest(CoapReply *reply);
     void sendRequest(CoapReply *reply, const bool &lookedUp = false);
     void sendData(const QHostAddress &hostAddress, const quint16 &port, const QByteArray &data);
     void sendCoapPdu(const QHostAddress &address, const quint16 &port, const CoapPdu &pdu);
 
+    quint16 createMessageId();
+    QByteArray createToken();
+    void setReplyMessageId(CoapReply *reply, const quint16 &messageId);
+    void unregisterReply(CoapReply *reply);
+    void releaseOutstanding(CoapReply *reply);
+    void startQueuedRequests(const QString &peer);
+
+    static QString peerKey(const QHostAddress &address, const quint16 &port);
+    CoapReply *findReply(const quint16 &messageId, const QByteArray &token, const QHostAddress &address, const quint16 &port) const;
+
     void processResponse(const CoapPdu &pdu, const QHostAddress &address, const quint16 &port);
     void processIdBasedResponse(CoapReply *reply, const CoapPdu &pdu);
     void processTokenBasedResponse(CoapReply *reply, const CoapPdu &pdu);
 
     void processNotification(const CoapPdu &pdu, const QHostAddress &address, const quint16 &port);
+    bool processNotificationInPlace(const CoapPduView &pdu, const QHostAddress &address, const quint16 &port);
 
     void processBlock1Response(CoapReply *reply, const CoapPdu &pdu);
     void processBlock2Response(CoapReply *reply, const CoapPdu &pdu);
@@ -111,6 +138,7 @@ private slots:
     void onReadyRead();
     void onReplyTimeout();
     void onReplyFinished();
+    void onReplyDestroyed(QObject *object);
 
 };
 
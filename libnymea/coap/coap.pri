@@ -9,6 +9,7 @@ DEPENDPATH += $$PWD
 HEADERS += \
     $$PWD/coap.h \
     $$PWD/coappdu.h \
+    $$PWD/coappduview.h \
     $$PWD/coapoption.h \
     $$PWD/coaprequest.h \
     $$PWD/coapreply.h \
@@ -20,6 +21,7 @@ HEADERS += \
 SOURCES += \
     $$PWD/coap.cpp \
     $$PWD/coappdu.cpp \
+    $$PWD/coappduview.cpp \
     $$PWD/coapoption.cpp \
     $$PWD/coaprequest.cpp \
     $$PWD/coapreply.cpp \
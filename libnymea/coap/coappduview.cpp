@@ -0,0 +1,606 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*!
+    \class CoapPduView
+    \brief Represents a read only view on a received CoAP PDU.
+
+    \ingroup coap-group
+    \inmodule libnymea
+
+    In contrast to \l{CoapPdu}, the CoapPduView does not copy the token, the options or the payload out of the datagram.
+    The header is validated once on construction and all accessors read directly from the underlying buffer. The token,
+    option and payload byte arrays returned by this class are created with \l{http://doc.qt.io/qt-5/qbytearray.html#fromRawData}{QByteArray::fromRawData()},
+    which means they are only valid as long as the buffer the view was created on.
+
+    If the view was created from a \l{QByteArray}, the view holds a shallow copy of it and the data stays valid for the
+    lifetime of the view. If the view was created from a raw pointer, the caller is responsible for keeping the buffer alive.
+
+    \sa CoapPdu, CoapPduWriter
+*/
+
+/*!
+    \class CoapPduView::OptionRef
+    \brief Represents a single option inside a \l{CoapPduView}.
+
+    \ingroup coap-group
+    \inmodule libnymea
+
+    \sa CoapPduView::options()
+*/
+
+/*!
+    \class CoapPduView::OptionIterator
+    \brief Iterates the options of a \l{CoapPduView} in the order they appear in the PDU.
+
+    \ingroup coap-group
+    \inmodule libnymea
+
+    \code
+        CoapPduView::OptionIterator it = view.options();
+        while (it.hasNext()) {
+            CoapPduView::OptionRef option = it.next();
+            qDebug() << option.option() << option.toByteArray();
+        }
+    \endcode
+*/
+
+/*!
+    \class CoapPduWriter
+    \brief Serializes a CoAP PDU into a preallocated buffer.
+
+    \ingroup coap-group
+    \inmodule libnymea
+
+    The CoapPduWriter writes the header, the options and the payload of a PDU directly into the given buffer without
+    any heap allocation. Options have to be added in ascending option number order, as they appear on the wire.
+    If the buffer is too small or the options are not ordered, the writer becomes invalid and \l{isValid()} returns false.
+
+    \sa CoapPduView, CoapPdu
+*/
+
+#include "coappduview.h"
+
+#include <string.h>
+
+static const quint8 payloadMarker = 0xff;
+
+/*! Constructs an empty \l{CoapPduView::OptionRef}. */
+CoapPduView::OptionRef::OptionRef() :
+    m_number(0),
+    m_data(nullptr),
+    m_length(0)
+{
+
+}
+
+/*! Returns the option number of this option as \l{CoapOption::Option}. */
+CoapOption::Option CoapPduView::OptionRef::option() const
+{
+    return static_cast<CoapOption::Option>(m_number);
+}
+
+/*! Returns the option number of this option. */
+quint16 CoapPduView::OptionRef::number() const
+{
+    return m_number;
+}
+
+/*! Returns a pointer to the option value inside the PDU buffer. */
+const char *CoapPduView::OptionRef::data() const
+{
+    return m_data;
+}
+
+/*! Returns the length of the option value. */
+int CoapPduView::OptionRef::length() const
+{
+    return m_length;
+}
+
+/*! Returns the option value as \l{QByteArray} without copying the data. */
+QByteArray CoapPduView::OptionRef::toByteArray() const
+{
+    return QByteArray::fromRawData(m_data, m_length);
+}
+
+/*! Returns the option value interpreted as unsigned integer in network byte order. */
+quint32 CoapPduView::OptionRef::toUInt() const
+{
+    quint32 value = 0;
+    for (int i = 0; i < m_length && i < 4; i++)
+        value = (value << 8) | (quint8)m_data[i];
+
+    return value;
+}
+
+CoapPduView::OptionIterator::OptionIterator(const CoapPduView *view) :
+    m_view(view),
+    m_position(view->m_optionsOffset),
+    m_number(0)
+{
+
+}
+
+/*! Returns true if there is another option to read. */
+bool CoapPduView::OptionIterator::hasNext() const
+{
+    return m_view->isValid() && m_position < m_view->m_optionsEnd;
+}
+
+/*! Returns the next option and advances the iterator. */
+CoapPduView::OptionRef CoapPduView::OptionIterator::next()
+{
+    OptionRef option;
+    CoapPdu::Error error = CoapPdu::NoError;
+    m_position = m_view->readOption(m_position, m_number, &option, &error);
+    if (m_position < 0)
+        m_position = m_view->m_optionsEnd;
+
+    m_number = option.number();
+    return option;
+}
+
+/*! Constructs an empty, invalid \l{CoapPduView}. */
+CoapPduView::CoapPduView() :
+    m_data(nullptr),
+    m_size(0)
+{
+    parse();
+}
+
+/*! Constructs a \l{CoapPduView} on the given \a data. The view keeps a shallow copy of \a data, no bytes get copied. */
+CoapPduView::CoapPduView(const QByteArray &data) :
+    m_buffer(data),
+    m_data(m_buffer.constData()),
+    m_size(m_buffer.size())
+{
+    parse();
+}
+
+/*! Constructs a \l{CoapPduView} on the given raw \a data with the given \a size. The \a data must stay valid as long as this view is in use. */
+CoapPduView::CoapPduView(const char *data, int size) :
+    m_data(data),
+    m_size(size)
+{
+    parse();
+}
+
+/*! Returns true if the PDU could be parsed without errors. */
+bool CoapPduView::isValid() const
+{
+    return m_error == CoapPdu::NoError;
+}
+
+/*! Returns the \l{CoapPdu::Error} which occurred while parsing the PDU. */
+CoapPdu::Error CoapPduView::error() const
+{
+    return m_error;
+}
+
+/*! Returns the CoAP version of this PDU. */
+quint8 CoapPduView::version() const
+{
+    if (m_size < 4)
+        return 0;
+
+    return ((quint8)m_data[0] & 0xc0) >> 6;
+}
+
+/*! Returns the \l{CoapPdu::MessageType} of this PDU. */
+CoapPdu::MessageType CoapPduView::messageType() const
+{
+    if (m_size < 4)
+        return CoapPdu::Reset;
+
+    return static_cast<CoapPdu::MessageType>(((quint8)m_data[0] & 0x30) >> 4);
+}
+
+/*! Returns the \l{CoapPdu::StatusCode} of this PDU. */
+CoapPdu::StatusCode CoapPduView::statusCode() const
+{
+    if (m_size < 4)
+        return CoapPdu::Empty;
+
+    return static_cast<CoapPdu::StatusCode>((quint8)m_data[1]);
+}
+
+/*! Returns the message id of this PDU. */
+quint16 CoapPduView::messageId() const
+{
+    if (m_size < 4)
+        return 0;
+
+    return ((quint8)m_data[2] << 8) | (quint8)m_data[3];
+}
+
+/*! Returns the token of this PDU without copying it. */
+QByteArray CoapPduView::token() const
+{
+    if (m_optionsOffset < 4)
+        return QByteArray();
+
+    return QByteArray::fromRawData(m_data + 4, m_optionsOffset - 4);
+}
+
+/*! Returns an iterator over all options of this PDU. */
+CoapPduView::OptionIterator CoapPduView::options() const
+{
+    return OptionIterator(this);
+}
+
+/*! Returns true if this PDU contains the given \a option. */
+bool CoapPduView::hasOption(const CoapOption::Option &option) const
+{
+    return this->option(option).data() != nullptr;
+}
+
+/*! Returns the first occurrence of the given \a option. If the option is not available, the returned \l{CoapPduView::OptionRef} has no data. */
+CoapPduView::OptionRef CoapPduView::option(const CoapOption::Option &option) const
+{
+    OptionIterator iterator = options();
+    while (iterator.hasNext()) {
+        OptionRef optionRef = iterator.next();
+        if (optionRef.option() == option)
+            return optionRef;
+
+        // Options are sorted, no need to look any further
+        if (optionRef.number() > option)
+            break;
+    }
+    return OptionRef();
+}
+
+/*! Returns the value of the given \a option interpreted as unsigned integer, or \a defaultValue if the option is not available. */
+quint32 CoapPduView::optionValue(const CoapOption::Option &option, quint32 defaultValue) const
+{
+    OptionRef optionRef = this->option(option);
+    if (!optionRef.data())
+        return defaultValue;
+
+    return optionRef.toUInt();
+}
+
+/*! Returns the \l{CoapPdu::ContentType} of this PDU. */
+CoapPdu::ContentType CoapPduView::contentType() const
+{
+    return static_cast<CoapPdu::ContentType>(optionValue(CoapOption::ContentFormat, CoapPdu::TextPlain));
+}
+
+/*! Returns the \l{CoapPduBlock} of this PDU. Like \l{CoapPdu::block()} this is the last Block1 or Block2 option of the PDU. */
+CoapPduBlock CoapPduView::block() const
+{
+    OptionRef blockOption;
+    OptionIterator iterator = options();
+    while (iterator.hasNext()) {
+        OptionRef optionRef = iterator.next();
+        if (optionRef.option() == CoapOption::Block1 || optionRef.option() == CoapOption::Block2)
+            blockOption = optionRef;
+    }
+    return CoapPduBlock(blockOption.toByteArray());
+}
+
+/*! Returns a pointer to the payload inside the PDU buffer. */
+const char *CoapPduView::payloadData() const
+{
+    return m_data + m_payloadOffset;
+}
+
+/*! Returns the size of the payload. */
+int CoapPduView::payloadSize() const
+{
+    return m_size - m_payloadOffset;
+}
+
+/*! Returns the payload of this PDU without copying it. */
+QByteArray CoapPduView::payload() const
+{
+    if (payloadSize() <= 0)
+        return QByteArray();
+
+    return QByteArray::fromRawData(payloadData(), payloadSize());
+}
+
+void CoapPduView::parse()
+{
+    m_error = CoapPdu::NoError;
+    m_optionsOffset = 0;
+    m_optionsEnd = 0;
+    m_payloadOffset = m_size;
+
+    if (!m_data || m_size < 4) {
+        m_error = CoapPdu::InvalidPduSizeError;
+        m_payloadOffset = 0;
+        m_size = 0;
+        return;
+    }
+
+    int tokenLength = (quint8)m_data[0] & 0x0f;
+    if (tokenLength > 8 || 4 + tokenLength > m_size) {
+        m_error = CoapPdu::InvalidTokenError;
+        m_payloadOffset = m_size;
+        return;
+    }
+
+    m_optionsOffset = 4 + tokenLength;
+
+    // Walk the options once to validate them and to find the payload
+    int position = m_optionsOffset;
+    quint16 number = 0;
+    while (position < m_size) {
+        if ((quint8)m_data[position] == payloadMarker) {
+            m_optionsEnd = position;
+            m_payloadOffset = position + 1;
+
+            // A payload marker followed by an empty payload is a message format error (RFC7252 section 3)
+            if (m_payloadOffset == m_size)
+                m_error = CoapPdu::InvalidPduSizeError;
+
+            return;
+        }
+
+        OptionRef option;
+        position = readOption(position, number, &option, &m_error);
+        if (position < 0) {
+            m_optionsEnd = m_optionsOffset;
+            return;
+        }
+        number = option.m_number;
+    }
+
+    m_optionsEnd = position;
+}
+
+int CoapPduView::readOption(int position, quint16 previousNumber, OptionRef *option, CoapPdu::Error *error) const
+{
+    const quint8 *rawData = reinterpret_cast<const quint8 *>(m_data);
+    quint8 optionByte = rawData[position++];
+    quint32 delta = (optionByte & 0xf0) >> 4;
+    quint32 length = (optionByte & 0x0f);
+
+    // Option delta
+    if (delta == 13) {
+        if (position + 1 > m_size) {
+            *error = CoapPdu::InvalidOptionDeltaError;
+            return -1;
+        }
+        delta = rawData[position] + 13;
+        position += 1;
+    } else if (delta == 14) {
+        if (position + 2 > m_size) {
+            *error = CoapPdu::InvalidOptionDeltaError;
+            return -1;
+        }
+        delta = ((rawData[position] << 8) | rawData[position + 1]) + 269;
+        position += 2;
+    } else if (delta == 15) {
+        *error = CoapPdu::InvalidOptionDeltaError;
+        return -1;
+    }
+
+    // Option length
+    if (length == 13) {
+        if (position + 1 > m_size) {
+            *error = CoapPdu::InvalidOptionLengthError;
+            return -1;
+        }
+        length = rawData[position] + 13;
+        position += 1;
+    } else if (length == 14) {
+        if (position + 2 > m_size) {
+            *error = CoapPdu::InvalidOptionLengthError;
+            return -1;
+        }
+        length = ((rawData[position] << 8) | rawData[position + 1]) + 269;
+        position += 2;
+    } else if (length == 15) {
+        *error = CoapPdu::InvalidOptionLengthError;
+        return -1;
+    }
+
+    if (previousNumber + delta > 0xffff) {
+        *error = CoapPdu::InvalidOptionDeltaError;
+        return -1;
+    }
+
+    if (position + (int)length > m_size) {
+        *error = CoapPdu::InvalidOptionLengthError;
+        return -1;
+    }
+
+    option->m_number = previousNumber + delta;
+    option->m_data = m_data + position;
+    option->m_length = length;
+    return position + length;
+}
+
+/*! Constructs a \l{CoapPduWriter} writing into the given \a buffer with the given \a capacity. */
+CoapPduWriter::CoapPduWriter(char *buffer, int capacity) :
+    m_buffer(buffer),
+    m_capacity(capacity),
+    m_size(0),
+    m_lastOption(0),
+    m_hasPayload(false),
+    m_valid(true)
+{
+
+}
+
+/*! Starts a new PDU in the buffer with the given \a messageType, \a statusCode, \a messageId and \a token. Any data written before will be discarded. */
+void CoapPduWriter::writeHeader(const CoapPdu::MessageType &messageType, const CoapPdu::StatusCode &statusCode, const quint16 &messageId, const QByteArray &token)
+{
+    m_size = 0;
+    m_lastOption = 0;
+    m_hasPayload = false;
+    m_valid = token.size() <= 8;
+    if (!m_valid)
+        return;
+
+    appendByte((1 << 6) | ((quint8)messageType << 4) | (quint8)token.size());
+    appendByte((quint8)statusCode);
+    appendByte((quint8)(messageId >> 8));
+    appendByte((quint8)(messageId & 0xff));
+    append(token.constData(), token.size());
+}
+
+/*! Adds the given \a option with the value \a data of the given \a length. Options must be added in ascending order. */
+void CoapPduWriter::addOption(const CoapOption::Option &option, const char *data, int length)
+{
+    if (!m_valid)
+        return;
+
+    if (m_size < 4 || m_hasPayload || (quint16)option < m_lastOption) {
+        m_valid = false;
+        return;
+    }
+
+    if (!appendOptionHeader((quint16)option - m_lastOption, length) || !append(data, length))
+        return;
+
+    m_lastOption = (quint16)option;
+}
+
+/*! Adds the given \a option with the value \a data. Options must be added in ascending order. */
+void CoapPduWriter::addOption(const CoapOption::Option &option, const QByteArray &data)
+{
+    addOption(option, data.constData(), data.size());
+}
+
+/*! Adds the given \a option with the given unsigned integer \a value, using the shortest possible encoding. */
+void CoapPduWriter::addUIntOption(const CoapOption::Option &option, quint32 value)
+{
+    char data[4];
+    int length = 0;
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        quint8 byte = (value >> shift) & 0xff;
+        if (length == 0 && byte == 0)
+            continue;
+
+        data[length++] = (char)byte;
+    }
+    addOption(option, data, length);
+}
+
+/*! Sets the payload of the PDU to the given \a data with the given \a length. No options can be added afterwards. */
+void CoapPduWriter::setPayload(const char *data, int length)
+{
+    if (!m_valid || length <= 0)
+        return;
+
+    if (m_size < 4 || m_hasPayload) {
+        m_valid = false;
+        return;
+    }
+
+    if (appendByte(payloadMarker) && append(data, length))
+        m_hasPayload = true;
+}
+
+/*! Sets the payload of the PDU to the given \a payload. No options can be added afterwards. */
+void CoapPduWriter::setPayload(const QByteArray &payload)
+{
+    setPayload(payload.constData(), payload.size());
+}
+
+/*! Returns true if the PDU has been written completely into the buffer. */
+bool CoapPduWriter::isValid() const
+{
+    return m_valid && m_size >= 4;
+}
+
+/*! Returns the buffer containing the serialized PDU. */
+const char *CoapPduWriter::data() const
+{
+    return m_buffer;
+}
+
+/*! Returns the size of the serialized PDU. */
+int CoapPduWriter::size() const
+{
+    return m_size;
+}
+
+bool CoapPduWriter::append(const char *data, int length)
+{
+    if (m_size + length > m_capacity) {
+        m_valid = false;
+        return false;
+    }
+
+    if (length > 0)
+        memcpy(m_buffer + m_size, data, length);
+
+    m_size += length;
+    return true;
+}
+
+bool CoapPduWriter::appendByte(quint8 byte)
+{
+    char data = (char)byte;
+    return append(&data, 1);
+}
+
+bool CoapPduWriter::appendOptionHeader(quint16 delta, int length)
+{
+    if (length < 0 || length > 0xffff + 269) {
+        m_valid = false;
+        return false;
+    }
+
+    // Header byte with the delta and length nibbles, followed by the extended fields (RFC7252 section 3.1)
+    quint8 extended[4];
+    int extendedLength = 0;
+
+    quint8 deltaNibble = 0;
+    if (delta < 13) {
+        deltaNibble = delta;
+    } else if (delta < 269) {
+        deltaNibble = 13;
+        extended[extendedLength++] = delta - 13;
+    } else {
+        deltaNibble = 14;
+        extended[extendedLength++] = ((delta - 269) >> 8) & 0xff;
+        extended[extendedLength++] = (delta - 269) & 0xff;
+    }
+
+    quint8 lengthNibble = 0;
+    if (length < 13) {
+        lengthNibble = length;
+    } else if (length < 269) {
+        lengthNibble = 13;
+        extended[extendedLength++] = length - 13;
+    } else {
+        lengthNibble = 14;
+        extended[extendedLength++] = ((length - 269) >> 8) & 0xff;
+        extended[extendedLength++] = (length - 269) & 0xff;
+    }
+
+    return appendByte((deltaNibble << 4) | lengthNibble) && append(reinterpret_cast<const char *>(extended), extendedLength);
+}
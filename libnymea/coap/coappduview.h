@@ -0,0 +1,151 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef COAPPDUVIEW_H
+#define COAPPDUVIEW_H
+
+#include <QByteArray>
+
+#include "libnymea.h"
+#include "coappdu.h"
+#include "coapoption.h"
+#include "coappdublock.h"
+
+class LIBNYMEA_EXPORT CoapPduView
+{
+public:
+    class LIBNYMEA_EXPORT OptionRef
+    {
+    public:
+        OptionRef();
+
+        CoapOption::Option option() const;
+        quint16 number() const;
+
+        const char *data() const;
+        int length() const;
+
+        QByteArray toByteArray() const;
+        quint32 toUInt() const;
+
+    private:
+        friend class CoapPduView;
+        quint16 m_number;
+        const char *m_data;
+        int m_length;
+    };
+
+    class LIBNYMEA_EXPORT OptionIterator
+    {
+    public:
+        bool hasNext() const;
+        OptionRef next();
+
+    private:
+        friend class CoapPduView;
+        OptionIterator(const CoapPduView *view);
+
+        const CoapPduView *m_view;
+        int m_position;
+        quint16 m_number;
+    };
+
+    CoapPduView();
+    explicit CoapPduView(const QByteArray &data);
+    CoapPduView(const char *data, int size);
+
+    bool isValid() const;
+    CoapPdu::Error error() const;
+
+    quint8 version() const;
+    CoapPdu::MessageType messageType() const;
+    CoapPdu::StatusCode statusCode() const;
+    quint16 messageId() const;
+
+    QByteArray token() const;
+
+    OptionIterator options() const;
+    bool hasOption(const CoapOption::Option &option) const;
+    OptionRef option(const CoapOption::Option &option) const;
+    quint32 optionValue(const CoapOption::Option &option, quint32 defaultValue = 0) const;
+
+    CoapPdu::ContentType contentType() const;
+    CoapPduBlock block() const;
+
+    const char *payloadData() const;
+    int payloadSize() const;
+    QByteArray payload() const;
+
+private:
+    QByteArray m_buffer;
+    const char *m_data;
+    int m_size;
+
+    CoapPdu::Error m_error;
+    int m_optionsOffset;
+    int m_optionsEnd;
+    int m_payloadOffset;
+
+    void parse();
+    int readOption(int position, quint16 previousNumber, OptionRef *option, CoapPdu::Error *error) const;
+};
+
+class LIBNYMEA_EXPORT CoapPduWriter
+{
+public:
+    CoapPduWriter(char *buffer, int capacity);
+
+    void writeHeader(const CoapPdu::MessageType &messageType, const CoapPdu::StatusCode &statusCode, const quint16 &messageId, const QByteArray &token = QByteArray());
+
+    void addOption(const CoapOption::Option &option, const char *data, int length);
+    void addOption(const CoapOption::Option &option, const QByteArray &data);
+    void addUIntOption(const CoapOption::Option &option, quint32 value);
+
+    void setPayload(const char *data, int length);
+    void setPayload(const QByteArray &payload);
+
+    bool isValid() const;
+    const char *data() const;
+    int size() const;
+
+private:
+    char *m_buffer;
+    int m_capacity;
+    int m_size;
+    quint16 m_lastOption;
+    bool m_hasPayload;
+    bool m_valid;
+
+    bool append(const char *data, int length);
+    bool appendByte(quint8 byte);
+    bool appendOptionHeader(quint16 delta, int length);
+};
+
+#endif // COAPPDUVIEW_H
@@ -46,6 +46,9 @@
     This method starts a Bluetooth discovery process running for \a interval milli seconds. Returns a BluetoothDiscoveryReply object
     which will emits the \l{BluetoothDiscoveryReply::finished()}{finished()} signal when the
     \l{BluetoothDiscoveryReply::discoveredDevices()}{discoveredDevices()} list is ready.
+
+    If another discovery is already running, the scan will be shared and the reply finishes with all devices seen by the
+    running scan once \a interval elapsed.
 */
 
 /*! \fn BluetoothLowEnergyDevice *BluetoothLowEnergyManager::registerDevice(const QBluetoothDeviceInfo &deviceInfo, const QLowEnergyController::RemoteAddressType &addressType = QLowEnergyController::RandomAddress);
@@ -139,12 +139,19 @@
 
 #include <QDebug>
 
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+static QString s_sysfsDirectory = "/sys/class/gpio";
+
 /*! Constructs a \l{Gpio} object to represent a GPIO with the given \a gpio number and \a parent. */
 Gpio::Gpio(const int &gpio, QObject *parent) :
     QObject(parent),
     m_gpio(gpio),
     m_direction(Gpio::DirectionInvalid),
-    m_gpioDirectory(QDir(QString("/sys/class/gpio/gpio%1/").arg(QString::number(gpio))))
+    m_gpioDirectory(QDir(QString("%1/gpio%2/").arg(s_sysfsDirectory).arg(QString::number(gpio))))
 {
     m_direction = direction();
 }
@@ -152,6 +159,7 @@ Gpio::Gpio(const int &gpio, QObject *parent) :
 /*! Destroys and unexports the \l{Gpio}. */
 Gpio::~Gpio()
 {
+    closeValueFile();
     unexportGpio();
 }
 
@@ -171,7 +179,19 @@ int Gpio::gpioNumber() const
 /*! Returns true if the directories \tt {/sys/class/gpio} and \tt {/sys/class/gpio/export} do exist. */
 bool Gpio::isAvailable()
 {
-    return QFile("/sys/class/gpio/export").exists();
+    return QFile(s_sysfsDirectory + "/export").exists();
+}
+
+/*! Returns the sysfs GPIO directory used by all \l{Gpio}{Gpios}. By default this is \tt {/sys/class/gpio}. */
+QString Gpio::sysfsDirectory()
+{
+    return s_sysfsDirectory;
+}
+
+/*! Sets the sysfs GPIO \a directory used by all \l{Gpio}{Gpios} created afterwards, e.g. to run against a fake sysfs tree in tests. */
+void Gpio::setSysfsDirectory(const QString &directory)
+{
+    s_sysfsDirectory = directory;
 }
 
 /*! Returns true if this \l{Gpio} could be exported in the system file \tt {/sys/class/gpio/export}. If this Gpio is already exported, this function will return true. */
@@ -181,7 +201,7 @@ bool Gpio::exportGpio()
     if (m_gpioDirectory.exists())
         return true;
 
-    QFile exportFile("/sys/class/gpio/export");
+    QFile exportFile(s_sysfsDirectory + "/export");
     if (!exportFile.open(QIODevice::WriteOnly | QIODevice::Text)) {
         qCWarning(dcHardware()) << "Gpio: Could not open GPIO export file:" << exportFile.errorString();
         return false;
@@ -196,7 +216,9 @@ bool Gpio::exportGpio()
 /*! Returns true if this \l{Gpio} could be unexported in the system file \tt {/sys/class/gpio/unexport}. */
 bool Gpio::unexportGpio()
 {
-    QFile unexportFile("/sys/class/gpio/unexport");
+    closeValueFile();
+
+    QFile unexportFile(s_sysfsDirectory + "/unexport");
     if (!unexportFile.open(QIODevice::WriteOnly | QIODevice::Text)) {
         qCWarning(dcHardware()) << "Gpio: Could not open GPIO unexport file:" << unexportFile.errorString();
         return false;
@@ -285,52 +307,56 @@ bool Gpio::setValue(Gpio::Value value)
         return false;
     }
 
-    QFile valueFile(m_gpioDirectory.path() + "/value");
-    if (!valueFile.open(QIODevice::WriteOnly | QIODevice::Text)) {
-        qCWarning(dcHardware()) << "Gpio: Could not open GPIO" << m_gpio << "value file:" << valueFile.errorString();
-        return false;
-    }
-
-    QTextStream out(&valueFile);
-    switch (value) {
-    case ValueLow:
-        out << "0";
-        break;
-    case ValueHigh:
-        out << "1";
-        break;
-    default:
-        valueFile.close();
-        return false;
-    }
-
-    valueFile.close();
-    return true;
+    return writeValue(value);
 }
 
 /*! Returns the current digital value of this \l{Gpio}. */
 Gpio::Value Gpio::value()
 {
-    QFile valueFile(m_gpioDirectory.path() + "/value");
-    if (!valueFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        qCWarning(dcHardware()) << "Gpio: Could not open GPIO" << m_gpio << "value file:" << valueFile.errorString();
+    if (!openValueFile())
         return Gpio::ValueInvalid;
-    }
 
-    QString value;
-    QTextStream in(&valueFile);
-    in >> value;
-    valueFile.close();
+    // The value file stays open, sysfs attributes get read again from offset 0
+    char buffer[2];
+    if (pread(m_valueFileDescriptor, buffer, sizeof(buffer), 0) < 1) {
+        qCWarning(dcHardware()) << "Gpio: Could not read GPIO" << m_gpio << "value:" << strerror(errno);
+        return Gpio::ValueInvalid;
+    }
 
-    if (value == "0") {
+    if (buffer[0] == '0') {
         return Gpio::ValueLow;
-    } else if (value == "1") {
+    } else if (buffer[0] == '1') {
         return Gpio::ValueHigh;
     }
 
     return Gpio::ValueInvalid;
 }
 
+/*! Sets all given \a values at once. All GPIOs and values get validated before anything is written,
+    so either all or none of the values are written unless writing to the system fails.
+    Returns true if all values could be written.
+
+    \sa setValue()
+*/
+bool Gpio::setValues(const QHash<Gpio *, Gpio::Value> &values)
+{
+    QHash<Gpio *, Gpio::Value>::const_iterator it;
+    for (it = values.constBegin(); it != values.constEnd(); ++it) {
+        if (it.value() == Gpio::ValueInvalid || it.key()->m_direction != Gpio::DirectionOutput) {
+            qCWarning(dcHardware()) << "Gpio: Cannot set value" << it.value() << "of GPIO" << it.key()->gpioNumber();
+            return false;
+        }
+
+        if (!it.key()->openValueFile())
+            return false;
+    }
+
+    bool success = true;
+    for (it = values.constBegin(); it != values.constEnd(); ++it) {
+        success &= it.key()->writeValue(it.value());
+    }
+    return success;
+}
 /*! This method allows to invert the logic of this \l{Gpio}. Returns true, if the GPIO could be set \a activeLow. */
 bool Gpio::setActiveLow(bool activeLow)
 {
@@ -437,6 +463,47 @@ Gpio::Edge Gpio::edgeInterrupt()
 
 
 
+bool Gpio::openValueFile()
+{
+    if (m_valueFileDescriptor >= 0)
+        return true;
+
+    QString fileName = m_gpioDirectory.path() + "/value";
+    m_valueFileDescriptor = open(fileName.toUtf8().constData(), O_RDWR | O_CLOEXEC);
+    if (m_valueFileDescriptor < 0) {
+        // Inputs might not be writable
+        m_valueFileDescriptor = open(fileName.toUtf8().constData(), O_RDONLY | O_CLOEXEC);
+    }
+
+    if (m_valueFileDescriptor < 0) {
+        qCWarning(dcHardware()) << "Gpio: Could not open GPIO" << m_gpio << "value file:" << strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+void Gpio::closeValueFile()
+{
+    if (m_valueFileDescriptor < 0)
+        return;
+
+    close(m_valueFileDescriptor);
+    m_valueFileDescriptor = -1;
+}
+
+bool Gpio::writeValue(Gpio::Value value)
+{
+    if (!openValueFile())
+        return false;
+
+    const char data = (value == Gpio::ValueHigh) ? '1' : '0';
+    if (pwrite(m_valueFileDescriptor, &data, 1, 0) != 1) {
+        qCWarning(dcHardware()) << "Gpio: Could not write GPIO" << m_gpio << "value:" << strerror(errno);
+        return false;
+    }
+    return true;
+}
+
 QDebug operator<<(QDebug debug, Gpio *gpio)
 {
     debug.nospace() << "Gpio(" << gpio->gpioNumber() << ", ";
@@ -36,6 +36,7 @@
 #include <QDir>
 #include <QFile>
 #include <QTextStream>
+#include <QHash>
 
 #include "libnymea.h"
 
@@ -70,6 +71,9 @@ public:
 
     static bool isAvailable();
 
+    static QString sysfsDirectory();
+    static void setSysfsDirectory(const QString &directory);
+
     bool exportGpio();
     bool unexportGpio();
 
@@ -79,6 +83,8 @@ public:
     bool setValue(Gpio::Value value);
     Gpio::Value value();
 
+    static bool setValues(const QHash<Gpio *, Gpio::Value> &values);
+
     bool setActiveLow(bool activeLow);
     bool activeLow();
 
@@ -90,6 +96,11 @@ private:
     int m_gpio;
     Gpio::Direction m_direction;
     QDir m_gpioDirectory;
+    int m_valueFileDescriptor = -1;
+
+    bool openValueFile();
+    void closeValueFile();
+    bool writeValue(Gpio::Value value);
 
 };
 
@@ -0,0 +1,251 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "gpioeventloop.h"
+#include "gpiomonitor.h"
+#include "loggingcategories.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+
+#if defined(__has_include)
+#if __has_include(<linux/gpio.h>)
+#include <linux/gpio.h>
+#endif
+#endif
+
+Q_GLOBAL_STATIC(GpioEventLoop, gpioEventLoop)
+
+GpioEventLoop *GpioEventLoop::instance()
+{
+    return gpioEventLoop();
+}
+
+GpioEventLoop::GpioEventLoop(QObject *parent) :
+    QThread(parent)
+{
+    m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+    m_wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (m_epollFd < 0 || m_wakeFd < 0) {
+        qCWarning(dcHardware()) << "GpioEventLoop: Could not create epoll instance:" << strerror(errno);
+        return;
+    }
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = m_wakeFd;
+    epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_wakeFd, &event);
+}
+
+GpioEventLoop::~GpioEventLoop()
+{
+    m_mutex.lock();
+    m_stopping = true;
+    m_mutex.unlock();
+    wakeUp();
+    wait();
+
+    if (m_wakeFd >= 0)
+        close(m_wakeFd);
+
+    if (m_epollFd >= 0)
+        close(m_epollFd);
+}
+
+bool GpioEventLoop::registerMonitor(GpioMonitor *monitor, int fileDescriptor, GpioEventLoop::Source source)
+{
+    if (m_epollFd < 0)
+        return false;
+
+    QMutexLocker locker(&m_mutex);
+    Registration registration;
+    registration.monitor = monitor;
+    registration.source = source;
+    registration.polled = false;
+    registration.lastValue = readValue(fileDescriptor, source);
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = (source == SourceSysfsValue) ? (EPOLLPRI | EPOLLERR) : EPOLLIN;
+    event.data.fd = fileDescriptor;
+    if (epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fileDescriptor, &event) < 0) {
+        if (errno != EPERM) {
+            qCWarning(dcHardware()) << "GpioEventLoop: Could not watch file descriptor" << fileDescriptor << strerror(errno);
+            return false;
+        }
+
+        // Regular files (i.e. not a real sysfs) can't be waited for, fall back to polling them
+        registration.polled = true;
+        m_polledCount++;
+    }
+    m_registrations.insert(fileDescriptor, registration);
+    locker.unlock();
+
+    if (!isRunning())
+        start();
+
+    wakeUp();
+    return true;
+}
+
+void GpioEventLoop::unregisterMonitor(GpioMonitor *monitor)
+{
+    // Once this returns, no more events will be posted to the monitor
+    QMutexLocker locker(&m_mutex);
+    foreach (int fileDescriptor, m_registrations.keys()) {
+        Registration registration = m_registrations.value(fileDescriptor);
+        if (registration.monitor != monitor)
+            continue;
+
+        if (registration.polled) {
+            m_polledCount--;
+        } else {
+            epoll_ctl(m_epollFd, EPOLL_CTL_DEL, fileDescriptor, nullptr);
+        }
+        m_registrations.remove(fileDescriptor);
+    }
+}
+
+int GpioEventLoop::readValue(int fileDescriptor, GpioEventLoop::Source source)
+{
+    if (source == SourceSysfsValue) {
+        char buffer[2];
+        if (pread(fileDescriptor, buffer, sizeof(buffer), 0) < 1)
+            return -1;
+
+        if (buffer[0] == '1')
+            return 1;
+
+        if (buffer[0] == '0')
+            return 0;
+
+        return -1;
+    }
+
+#ifdef GPIOHANDLE_GET_LINE_VALUES_IOCTL
+    struct gpiohandle_data data;
+    memset(&data, 0, sizeof(data));
+    if (ioctl(fileDescriptor, GPIOHANDLE_GET_LINE_VALUES_IOCTL, &data) < 0)
+        return -1;
+
+    return data.values[0] ? 1 : 0;
+#else
+    return -1;
+#endif
+}
+
+void GpioEventLoop::run()
+{
+    struct epoll_event events[16];
+    forever {
+        m_mutex.lock();
+        bool stopping = m_stopping;
+        int timeout = m_polledCount > 0 ? 50 : -1;
+        m_mutex.unlock();
+
+        if (stopping)
+            return;
+
+        int count = epoll_wait(m_epollFd, events, 16, timeout);
+        if (count < 0) {
+            if (errno == EINTR)
+                continue;
+
+            qCWarning(dcHardware()) << "GpioEventLoop: Waiting for GPIO events failed:" << strerror(errno);
+            return;
+        }
+
+        QMutexLocker locker(&m_mutex);
+        for (int i = 0; i < count; i++) {
+            if (events[i].data.fd == m_wakeFd) {
+                quint64 counter;
+                ssize_t size = read(m_wakeFd, &counter, sizeof(counter));
+                Q_UNUSED(size)
+                continue;
+            }
+            processEvent(events[i].data.fd);
+        }
+
+        if (m_polledCount == 0)
+            continue;
+
+        QHash<int, Registration>::iterator it;
+        for (it = m_registrations.begin(); it != m_registrations.end(); ++it) {
+            if (!it->polled)
+                continue;
+
+            int value = readValue(it.key(), it->source);
+            if (value < 0 || value == it->lastValue)
+                continue;
+
+            it->lastValue = value;
+            QMetaObject::invokeMethod(it->monitor, "onValueChanged", Qt::QueuedConnection, Q_ARG(bool, value == 1));
+        }
+    }
+}
+
+void GpioEventLoop::wakeUp()
+{
+    quint64 counter = 1;
+    if (m_wakeFd >= 0 && write(m_wakeFd, &counter, sizeof(counter)) < 0) {
+        qCWarning(dcHardware()) << "GpioEventLoop: Could not wake up the event loop:" << strerror(errno);
+    }
+}
+
+void GpioEventLoop::processEvent(int fileDescriptor)
+{
+    if (!m_registrations.contains(fileDescriptor))
+        return;
+
+    Registration &registration = m_registrations[fileDescriptor];
+
+#ifdef GPIO_GET_LINEEVENT_IOCTL
+    if (registration.source == SourceLineEvent) {
+        // Consume the edge event, the value is read from the line afterwards
+        struct gpioevent_data eventData;
+        if (read(fileDescriptor, &eventData, sizeof(eventData)) < 0) {
+            qCWarning(dcHardware()) << "GpioEventLoop: Could not read line event:" << strerror(errno);
+            return;
+        }
+    }
+#endif
+
+    int value = readValue(fileDescriptor, registration.source);
+    if (value < 0)
+        return;
+
+    registration.lastValue = value;
+    QMetaObject::invokeMethod(registration.monitor, "onValueChanged", Qt::QueuedConnection, Q_ARG(bool, value == 1));
+}
@@ -0,0 +1,84 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef GPIOEVENTLOOP_H
+#define GPIOEVENTLOOP_H
+
+#include <QHash>
+#include <QMutex>
+#include <QThread>
+
+class GpioMonitor;
+
+// One shared thread waiting for value changes of all monitored GPIOs
+class GpioEventLoop : public QThread
+{
+    Q_OBJECT
+public:
+    enum Source {
+        SourceSysfsValue,
+        SourceLineEvent
+    };
+
+    static GpioEventLoop *instance();
+
+    explicit GpioEventLoop(QObject *parent = nullptr);
+    ~GpioEventLoop() override;
+
+    bool registerMonitor(GpioMonitor *monitor, int fileDescriptor, Source source);
+    void unregisterMonitor(GpioMonitor *monitor);
+
+    static int readValue(int fileDescriptor, Source source);
+
+protected:
+    void run() override;
+
+private:
+    class Registration {
+    public:
+        GpioMonitor *monitor;
+        Source source;
+        bool polled;
+        int lastValue;
+    };
+
+    int m_epollFd = -1;
+    int m_wakeFd = -1;
+    bool m_stopping = false;
+
+    QMutex m_mutex;
+    QHash<int, Registration> m_registrations;     // file descriptor | registration
+    int m_polledCount = 0;
+
+    void wakeUp();
+    void processEvent(int fileDescriptor);
+};
+
+#endif // GPIOEVENTLOOP_H
@@ -35,10 +35,14 @@
     \ingroup hardware
     \inmodule libnymea
 
-    An instance of this class creates a thread, which monitors each of the added GPIOs. The object
-    emits a signal if one of the added GPIOs changes its value. The GpioMonitor configures a GPIO as an
+    All instances of this class share one thread, which waits for interrupts of all monitored GPIOs using epoll.
+    The object emits a signal if the monitored GPIO changes its value. The GpioMonitor configures a GPIO as an
     input, with the edge interrupt EDGE_BOTH (\l{Gpio::setEdgeInterrupt()}{setEdgeInterrupt}).
 
+    By default the sysfs interface (\tt {/sys/class/gpio}) is used. If a monitor gets created with the name of a GPIO chip
+    and a line offset, the GPIO character device (\tt {/dev/gpiochipN}) line event API is used instead. This backend is
+    only available if nymea was built against kernel headers providing it, see \l{isCharacterDeviceAvailable()}.
+
     \chapter Example
     Following example shows how to use the GpioMonitor class for a button on the Raspberry Pi. There are two possibilitys
     to connect a button. Following picture shows the schematics:
@@ -76,24 +80,92 @@
     \endcode
 */
 
+/*! \enum GpioMonitor::Backend
+
+    This enum type specifies the kernel interface used by a \l{GpioMonitor}.
+
+    \value BackendSysfs
+        The GPIO is monitored using the sysfs interface.
+    \value BackendCharacterDevice
+        The GPIO line is monitored using the GPIO character device line events.
+*/
+
 /*! \fn void GpioMonitor::valueChanged(const bool &value);
  *  This signal will be emitted, if the monitored \l{Gpio}{Gpios} changed his \a value. */
 
 #include "gpiomonitor.h"
+#include "gpioeventloop.h"
 #include "loggingcategories.h"
 
+#include <QDir>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+#if defined(__has_include)
+#if __has_include(<linux/gpio.h>)
+#include <linux/gpio.h>
+#endif
+#endif
+
 /*! Constructs a \l{GpioMonitor} object with the given \a gpio number and \a parent. */
 GpioMonitor::GpioMonitor(int gpio, QObject *parent) :
     QObject(parent),
+    m_backend(BackendSysfs),
     m_gpioNumber(gpio)
 {
-    m_valueFile.setFileName("/sys/class/gpio/gpio" + QString::number(m_gpioNumber) + "/value");
+    m_valueFile.setFileName(Gpio::sysfsDirectory() + "/gpio" + QString::number(m_gpioNumber) + "/value");
+}
+
+/*! Constructs a \l{GpioMonitor} object for the given \a line of the GPIO chip with the given \a chipName (e.g. "gpiochip0")
+    and \a parent. This monitor uses the GPIO character device.
+
+    \sa isCharacterDeviceAvailable()
+*/
+GpioMonitor::GpioMonitor(const QString &chipName, int line, QObject *parent) :
+    QObject(parent),
+    m_backend(BackendCharacterDevice),
+    m_chipName(chipName),
+    m_line(line)
+{
+
+}
+
+/*! Destroys this \l{GpioMonitor} and disables it if required. */
+GpioMonitor::~GpioMonitor()
+{
+    disable();
+}
+
+/*! Returns true if nymea has been built with support for the GPIO character device and there is at least one GPIO chip in the system. */
+bool GpioMonitor::isCharacterDeviceAvailable()
+{
+#ifdef GPIO_GET_LINEEVENT_IOCTL
+    return !QDir("/dev").entryList({"gpiochip*"}, QDir::System).isEmpty();
+#else
+    return false;
+#endif
+}
+
+/*! Returns the \l{GpioMonitor::Backend} used by this monitor. */
+GpioMonitor::Backend GpioMonitor::backend() const
+{
+    return m_backend;
 }
 
 /*! Returns true if this \l{GpioMonitor} could be enabled successfully. With the \a activeLow parameter the values can be inverted.
     With the \a edgeInterrupt parameter the interrupt type can be specified. */
 bool GpioMonitor::enable(bool activeLow, Gpio::Edge edgeInterrupt)
 {
+    if (m_running)
+        return true;
+
+    if (m_backend == BackendCharacterDevice)
+        return enableCharacterDevice(activeLow, edgeInterrupt);
+
     if (!Gpio::isAvailable())
         return false;
 
@@ -103,29 +175,48 @@ bool GpioMonitor::enable(bool activeLow, Gpio::Edge edgeInterrupt)
             !m_gpio->setActiveLow(activeLow) ||
             !m_gpio->setEdgeInterrupt(edgeInterrupt)) {
         qCWarning(dcHardware()) << "GpioMonitor: Error while initializing GPIO" << m_gpio->gpioNumber();
+        delete m_gpio;
+        m_gpio = nullptr;
         return false;
     }
 
     if (!m_valueFile.open(QFile::ReadOnly)) {
         qWarning(dcHardware()) << "GpioMonitor: Could not open value file for gpio monitor" << m_gpio->gpioNumber();
+        delete m_gpio;
+        m_gpio = nullptr;
         return false;
     }
 
-    m_notifier = new QSocketNotifier(m_valueFile.handle(), QSocketNotifier::Exception);
-    connect(m_notifier, &QSocketNotifier::activated, this, &GpioMonitor::readyReady);
+    m_currentValue = GpioEventLoop::readValue(m_valueFile.handle(), GpioEventLoop::SourceSysfsValue) == 1;
 
-    m_notifier->setEnabled(true);
+    if (!GpioEventLoop::instance()->registerMonitor(this, m_valueFile.handle(), GpioEventLoop::SourceSysfsValue)) {
+        m_valueFile.close();
+        delete m_gpio;
+        m_gpio = nullptr;
+        return false;
+    }
+
+    m_running = true;
     return true;
 }
 
 /*! Disables this \l{GpioMonitor}. */
 void GpioMonitor::disable()
 {
-    delete m_notifier;
-    delete m_gpio;
+    if (m_running) {
+        GpioEventLoop *eventLoop = GpioEventLoop::instance();
+        if (eventLoop)
+            eventLoop->unregisterMonitor(this);
+    }
+    m_running = false;
 
-    m_notifier = 0;
-    m_gpio = 0;
+    if (m_lineEventFd >= 0) {
+        close(m_lineEventFd);
+        m_lineEventFd = -1;
+    }
+
+    delete m_gpio;
+    m_gpio = nullptr;
 
     m_valueFile.close();
 }
@@ -133,10 +224,7 @@ void GpioMonitor::disable()
 /*! Returns true if this \l{GpioMonitor} is running. */
 bool GpioMonitor::isRunning() const
 {
-    if (!m_notifier)
-        return false;
-
-    return m_notifier->isEnabled();
+    return m_running;
 }
 
 /*! Returns the current value of this \l{GpioMonitor}. */
@@ -145,28 +233,73 @@ bool GpioMonitor::value() const
     return m_currentValue;
 }
 
-/*! Returns the \l{Gpio} of this \l{GpioMonitor}. */
+/*! Returns the \l{Gpio} of this \l{GpioMonitor}. Monitors using the GPIO character device have no \l{Gpio} object. */
 Gpio *GpioMonitor::gpio()
 {
     return m_gpio;
 }
 
-void GpioMonitor::readyReady(const int &ready)
+bool GpioMonitor::enableCharacterDevice(bool activeLow, Gpio::Edge edgeInterrupt)
 {
-    Q_UNUSED(ready)
-
-    m_valueFile.seek(0);
-    QByteArray data = m_valueFile.readAll();
-
-    bool value = false;
-    if (data[0] == '1') {
-        value = true;
-    } else if (data[0] == '0') {
-        value = false;
-    } else {
-        return;
+#ifdef GPIO_GET_LINEEVENT_IOCTL
+    struct gpioevent_request request;
+    memset(&request, 0, sizeof(request));
+    request.lineoffset = m_line;
+    request.handleflags = GPIOHANDLE_REQUEST_INPUT;
+    if (activeLow)
+        request.handleflags |= GPIOHANDLE_REQUEST_ACTIVE_LOW;
+
+    switch (edgeInterrupt) {
+    case Gpio::EdgeFalling:
+        request.eventflags = GPIOEVENT_REQUEST_FALLING_EDGE;
+        break;
+    case Gpio::EdgeRising:
+        request.eventflags = GPIOEVENT_REQUEST_RISING_EDGE;
+        break;
+    case Gpio::EdgeBoth:
+        request.eventflags = GPIOEVENT_REQUEST_BOTH_EDGES;
+        break;
+    default:
+        qCWarning(dcHardware()) << "GpioMonitor: Line events require an edge interrupt for" << m_chipName << m_line;
+        return false;
+    }
+    strncpy(request.consumer_label, "nymea", sizeof(request.consumer_label) - 1);
+
+    QString chipFileName = m_chipName.startsWith("/") ? m_chipName : "/dev/" + m_chipName;
+    int chipFd = open(chipFileName.toUtf8().constData(), O_RDONLY | O_CLOEXEC);
+    if (chipFd < 0) {
+        qCWarning(dcHardware()) << "GpioMonitor: Could not open GPIO chip" << chipFileName << strerror(errno);
+        return false;
     }
 
+    int result = ioctl(chipFd, GPIO_GET_LINEEVENT_IOCTL, &request);
+    close(chipFd);
+    if (result < 0) {
+        qCWarning(dcHardware()) << "GpioMonitor: Could not request line events for" << m_chipName << m_line << strerror(errno);
+        return false;
+    }
+
+    m_lineEventFd = request.fd;
+    m_currentValue = GpioEventLoop::readValue(m_lineEventFd, GpioEventLoop::SourceLineEvent) == 1;
+
+    if (!GpioEventLoop::instance()->registerMonitor(this, m_lineEventFd, GpioEventLoop::SourceLineEvent)) {
+        close(m_lineEventFd);
+        m_lineEventFd = -1;
+        return false;
+    }
+
+    m_running = true;
+    return true;
+#else
+    Q_UNUSED(activeLow)
+    Q_UNUSED(edgeInterrupt)
+    qCWarning(dcHardware()) << "GpioMonitor: The GPIO character device is not supported by this build.";
+    return false;
+#endif
+}
+
+void GpioMonitor::onValueChanged(bool value)
+{
     m_currentValue = value;
     emit valueChanged(value);
 }
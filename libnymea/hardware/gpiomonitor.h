@@ -33,7 +33,6 @@
 
 #include <QObject>
 #include <QDebug>
-#include <QSocketNotifier>
 #include <QFile>
 
 #include "libnymea.h"
@@ -44,7 +43,18 @@ class LIBNYMEA_EXPORT GpioMonitor : public QObject
     Q_OBJECT
 
 public:
+    enum Backend {
+        BackendSysfs,
+        BackendCharacterDevice
+    };
+
     explicit GpioMonitor(int gpio, QObject *parent = nullptr);
+    GpioMonitor(const QString &chipName, int line, QObject *parent = nullptr);
+    ~GpioMonitor();
+
+    static bool isCharacterDeviceAvailable();
+
+    Backend backend() const;
 
     bool enable(bool activeLow = false, Gpio::Edge edgeInterrupt = Gpio::EdgeBoth);
     void disable();
@@ -55,17 +65,24 @@ public:
     Gpio* gpio();
 
 private:
-    int m_gpioNumber;
-    Gpio *m_gpio;
-    QSocketNotifier *m_notifier;
+    Backend m_backend;
+    int m_gpioNumber = -1;
+    QString m_chipName;
+    int m_line = -1;
+
+    Gpio *m_gpio = nullptr;
     QFile m_valueFile;
-    bool m_currentValue;
+    int m_lineEventFd = -1;
+    bool m_running = false;
+    bool m_currentValue = false;
+
+    bool enableCharacterDevice(bool activeLow, Gpio::Edge edgeInterrupt);
 
 signals:
     void valueChanged(const bool &value);
 
 private slots:
-    void readyReady(const int &ready);
+    void onValueChanged(bool value);
 
 };
 
@@ -51,7 +51,8 @@
         Start reading from the given \a i2cDevice. When calling this, the I2CManager will start
         polling the given \a i2cDevice. Optionally, the interface can be given.
         Note that the interval might not be met, for example if the device is busy by other
-        readers.
+        readers. Each I2C port is served by its own thread, so only devices on the same port
+        can delay each other.
         The given \a i2cDevice is required to be opened first.
  */
 
@@ -62,7 +63,8 @@
 /*! \fn bool I2CManager::writeData(I2CDevice *i2cDevice, const QByteArray &data)
         Write the given \a data to the given \a i2cDevice.
         The data will be put into a write buffer and will be written to the device
-        in a different thread when the i2c device is available.
+        in a different thread when the i2c device is available. Pending writes are
+        served before pending readings on the same port.
         The given \a i2cDevice is required to be opened first.
  */
 
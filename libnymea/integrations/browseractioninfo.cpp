@@ -32,6 +32,7 @@
 #include "thingmanager.h"
 
 #include <QTimer>
+#include <QThread>
 
 BrowserActionInfo::BrowserActionInfo(Thing *thing, ThingManager *thingManager, const BrowserAction &browserAction, QObject *parent, quint32 timeout):
     QObject (parent),
@@ -85,6 +86,16 @@ QString BrowserActionInfo::translatedDisplayMessage(const QLocale &locale)
 
 void BrowserActionInfo::finish(Thing::ThingError status, const QString &displayMessage)
 {
+    if (QThread::currentThread() != thread()) {
+        // Marshalled like ThingActionInfo::finish()
+        QTimer::singleShot(0, this, [this, status, displayMessage](){
+            if (!m_finished) {
+                finish(status, displayMessage);
+            }
+        });
+        return;
+    }
+
     m_finished = true;
     m_status = status;
     m_displayMessage = displayMessage;
@@ -32,6 +32,7 @@
 #include "thingmanager.h"
 
 #include <QTimer>
+#include <QThread>
 
 BrowseResult::BrowseResult(Thing *thing, ThingManager *thingManager, const QString &itemId, const QLocale &locale, QObject *parent, quint32 timeout):
     QObject(parent),
@@ -106,6 +107,16 @@ void BrowseResult::addItems(const BrowserItems &items)
 
 void BrowseResult::finish(Thing::ThingError status, const QString &displayMessage)
 {
+    if (QThread::currentThread() != thread()) {
+        // Marshalled like ThingActionInfo::finish()
+        QTimer::singleShot(0, this, [this, status, displayMessage](){
+            if (!m_finished) {
+                finish(status, displayMessage);
+            }
+        });
+        return;
+    }
+
     m_finished = true;
     m_status = status;
     m_displayMessage = displayMessage;
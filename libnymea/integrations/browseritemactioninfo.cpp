@@ -32,6 +32,7 @@
 #include "thingmanager.h"
 
 #include <QTimer>
+#include <QThread>
 
 BrowserItemActionInfo::BrowserItemActionInfo(Thing *thing, ThingManager *thingManager, const BrowserItemAction &browserItemAction, QObject *parent, quint32 timeout):
     QObject(parent),
@@ -85,6 +86,16 @@ QString BrowserItemActionInfo::translatedDisplayMessage(const QLocale &locale)
 
 void BrowserItemActionInfo::finish(Thing::ThingError status, const QString &displayMessage)
 {
+    if (QThread::currentThread() != thread()) {
+        // Marshalled like ThingActionInfo::finish()
+        QTimer::singleShot(0, this, [this, status, displayMessage](){
+            if (!m_finished) {
+                finish(status, displayMessage);
+            }
+        });
+        return;
+    }
+
     m_finished = true;
     m_status = status;
     m_displayMessage = displayMessage;
@@ -32,6 +32,7 @@
 #include "thingmanager.h"
 
 #include <QTimer>
+#include <QThread>
 
 BrowserItemResult::BrowserItemResult(Thing *thing, ThingManager *thingManager, const QString &itemId, const QLocale &locale, QObject *parent, quint32 timeout):
     QObject(parent),
@@ -96,12 +97,31 @@ QString BrowserItemResult::translatedDisplayMessage(const QLocale &locale)
 
 void BrowserItemResult::finish(const BrowserItem &item)
 {
+    if (QThread::currentThread() != thread()) {
+        QTimer::singleShot(0, this, [this, item](){
+            if (!m_finished) {
+                finish(item);
+            }
+        });
+        return;
+    }
+
     m_item = item;
     finish(Thing::ThingErrorNoError);
 }
 
 void BrowserItemResult::finish(Thing::ThingError status, const QString &displayMessage)
 {
+    if (QThread::currentThread() != thread()) {
+        // Marshalled like ThingActionInfo::finish()
+        QTimer::singleShot(0, this, [this, status, displayMessage](){
+            if (!m_finished) {
+                finish(status, displayMessage);
+            }
+        });
+        return;
+    }
+
     m_finished = true;
     m_status = status;
     m_displayMessage = displayMessage;
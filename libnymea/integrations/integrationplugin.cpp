@@ -382,6 +382,7 @@ void IntegrationPlugin::initPlugin(const PluginMetadata &metadata, ThingManager
 */
 ParamList IntegrationPlugin::configuration() const
 {
+    QMutexLocker locker(&m_configMutex);
     return m_config;
 }
 
@@ -393,6 +394,7 @@ ParamList IntegrationPlugin::configuration() const
 */
 QVariant IntegrationPlugin::configValue(const ParamTypeId &paramTypeId) const
 {
+    QMutexLocker locker(&m_configMutex);
     return m_config.paramValue(paramTypeId);
 }
 
@@ -429,6 +431,7 @@ Thing::ThingError IntegrationPlugin::setConfigValue(const ParamTypeId &paramType
         return Thing::ThingErrorInvalidParameter;
     }
 
+    QMutexLocker locker(&m_configMutex);
     if (m_config.hasParam(paramTypeId)) {
         if (!m_config.setParamValue(paramTypeId, value)) {
             qCWarning(dcThingManager()) << "Could not set param value" << value << "for param with id" << paramTypeId.toString();
@@ -437,6 +440,7 @@ Thing::ThingError IntegrationPlugin::setConfigValue(const ParamTypeId &paramType
     } else {
         m_config.append(Param(paramTypeId, value));
     }
+    locker.unlock();
 
     emit configValueChanged(paramTypeId, value);
     return Thing::ThingErrorNoError;
@@ -63,6 +63,7 @@
 #include <QPair>
 #include <QSettings>
 #include <QMetaType>
+#include <QMutex>
 
 class ThingManager;
 
@@ -146,6 +147,8 @@ private:
     QSettings *m_storage = nullptr;
 
     PluginMetadata m_metaData;
+    // Read by the system while a plugin running in its own thread may be changing it
+    mutable QMutex m_configMutex;
     ParamList m_config;
 };
 Q_DECLARE_INTERFACE(IntegrationPlugin, "io.nymea.IntegrationPlugin")
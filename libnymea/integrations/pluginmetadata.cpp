@@ -83,6 +83,11 @@ bool PluginMetadata::isBuiltIn() const
     return m_isBuiltIn;
 }
 
+bool PluginMetadata::isThreaded() const
+{
+    return m_isThreaded;
+}
+
 ParamTypes PluginMetadata::pluginSettings() const
 {
     return m_pluginSettings;
@@ -104,7 +109,7 @@ void PluginMetadata::parse(const QJsonObject &jsonObject)
 
     // General plugin info
     QStringList pluginMandatoryJsonProperties = QStringList() << "id" << "name" << "displayName" << "vendors";
-    QStringList pluginJsonProperties = QStringList() << "id" << "name" << "displayName" << "vendors" << "paramTypes" << "builtIn";
+    QStringList pluginJsonProperties = QStringList() << "id" << "name" << "displayName" << "vendors" << "paramTypes" << "builtIn" << "threaded";
     QPair<QStringList, QStringList> verificationResult = verifyFields(pluginJsonProperties, pluginMandatoryJsonProperties, jsonObject);
     if (!verificationResult.first.isEmpty()) {
         m_validationErrors.append("Plugin metadata has missing fields: " + verificationResult.first.join(", "));
@@ -116,6 +121,7 @@ void PluginMetadata::parse(const QJsonObject &jsonObject)
     m_pluginId = PluginId(jsonObject.value("id").toString());
     m_pluginName = jsonObject.value("name").toString();
     m_pluginDisplayName = jsonObject.value("displayName").toString();
+    m_isThreaded = jsonObject.value("threaded").toBool();
 
     if (!verificationResult.second.isEmpty()) {
         m_validationErrors.append("Plugin \"" + m_pluginName + "\" has unknown fields: \"" + verificationResult.second.join("\", \"") + "\"");
@@ -47,6 +47,7 @@ public:
     QString pluginName() const;
     QString pluginDisplayName() const;
     bool isBuiltIn() const;
+    bool isThreaded() const;
 
     ParamTypes pluginSettings() const;
 
@@ -66,6 +67,7 @@ private:
 private:
     bool m_isValid = false;
     bool m_isBuiltIn = false;
+    bool m_isThreaded = false;
     PluginId m_pluginId;
     QString m_pluginName;
     QString m_pluginDisplayName;
@@ -135,6 +135,7 @@
 #include "loggingcategories.h"
 
 #include <QDebug>
+#include <QThread>
 
 /*! Construct a Thing with the given \a pluginId, \a id, \a thingClassId and \a parent. */
 Thing::Thing(const PluginId &pluginId, const ThingClass &thingClass, const ThingId &id, QObject *parent):
@@ -287,6 +288,7 @@ void Thing::setSettingValue(const ParamTypeId &paramTypeId, const QVariant &valu
 /*! Returns the states of this thing. It must match the \l{StateType} description in the associated \l{ThingClass}. */
 States Thing::states() const
 {
+    QMutexLocker locker(&m_stateMutex);
     return m_states;
 }
 
@@ -299,12 +301,14 @@ bool Thing::hasParam(const ParamTypeId &paramTypeId) const
 /*! Set the \l{State}{States} of this \l{Thing} to the given \a states.*/
 void Thing::setStates(const States &states)
 {
+    QMutexLocker locker(&m_stateMutex);
     m_states = states;
 }
 
 /*! Returns true, a \l{State} with the given \a stateTypeId exists for this thing. */
 bool Thing::hasState(const StateTypeId &stateTypeId) const
 {
+    QMutexLocker locker(&m_stateMutex);
     foreach (const State &state, m_states) {
         if (state.stateTypeId() == stateTypeId) {
             return true;
@@ -316,6 +320,7 @@ bool Thing::hasState(const StateTypeId &stateTypeId) const
 /*! For convenience, this finds the \l{State} matching the given \a stateTypeId and returns the current valie in this thing. */
 QVariant Thing::stateValue(const StateTypeId &stateTypeId) const
 {
+    QMutexLocker locker(&m_stateMutex);
     foreach (const State &state, m_states) {
         if (state.stateTypeId() == stateTypeId) {
             return state.value();
@@ -324,9 +329,17 @@ QVariant Thing::stateValue(const StateTypeId &stateTypeId) const
     return QVariant();
 }
 
-/*! For convenience, this finds the \l{State} matching the given \a stateTypeId in this thing and sets the current value to \a value. */
+/*! For convenience, this finds the \l{State} matching the given \a stateTypeId in this thing and sets the current value to \a value.
+
+    When called from a plugin running in its own thread, the new value is returned by stateValue() right away, but the
+    change notification is queued and emitted in the thread of this thing together with all other changes made until
+    then. Only the latest value for each state will be notified.
+*/
 void Thing::setStateValue(const StateTypeId &stateTypeId, const QVariant &value)
 {
+    bool foreignThread = QThread::currentThread() != thread();
+
+    QMutexLocker locker(&m_stateMutex);
     for (int i = 0; i < m_states.count(); ++i) {
         if (m_states.at(i).stateTypeId() == stateTypeId) {
             if (m_states.at(i).value() == value)
@@ -336,19 +349,40 @@ void Thing::setStateValue(const StateTypeId &stateTypeId, const QVariant &value)
             // TODO: check min/max value + possible values
             //       to prevent an invalid state type from the plugin side
 
+            QVariant previousValue = m_states.at(i).value();
             State newState(stateTypeId, m_id);
             newState.setValue(value);
             m_states[i] = newState;
+
+            if (foreignThread) {
+                // Remember the last value the thing's thread was notified about
+                bool flushScheduled = !m_pendingStateTypeIds.isEmpty();
+                if (!m_pendingStateValues.contains(stateTypeId)) {
+                    m_pendingStateTypeIds.append(stateTypeId);
+                    m_pendingStateValues.insert(stateTypeId, previousValue);
+                }
+                if (!flushScheduled) {
+                    QMetaObject::invokeMethod(this, "flushPendingStateValues", Qt::QueuedConnection);
+                }
+                return;
+            }
+
+            if (m_pendingStateValues.contains(stateTypeId)) {
+                m_pendingStateValues.insert(stateTypeId, value);
+            }
+            locker.unlock();
             emit stateValueChanged(stateTypeId, value);
             return;
         }
     }
+    locker.unlock();
     qCWarning(dcThingManager) << "Failed setting state for" << m_name << value;
 }
 
 /*! Returns the \l{State} with the given \a stateTypeId of this thing. */
 State Thing::state(const StateTypeId &stateTypeId) const
 {
+    QMutexLocker locker(&m_stateMutex);
     for (int i = 0; i < m_states.count(); ++i) {
         if (m_states.at(i).stateTypeId() == stateTypeId) {
             return m_states.at(i);
@@ -357,6 +391,27 @@ State Thing::state(const StateTypeId &stateTypeId) const
     return State(StateTypeId(), ThingId());
 }
 
+void Thing::flushPendingStateValues()
+{
+    QMutexLocker locker(&m_stateMutex);
+    QList<QPair<StateTypeId, QVariant> > changes;
+    foreach (const StateTypeId &stateTypeId, m_pendingStateTypeIds) {
+        foreach (const State &state, m_states) {
+            // Changed back and forth in the meantime, nothing to notify
+            if (state.stateTypeId() == stateTypeId && state.value() != m_pendingStateValues.value(stateTypeId)) {
+                changes.append(qMakePair(stateTypeId, state.value()));
+            }
+        }
+    }
+    m_pendingStateTypeIds.clear();
+    m_pendingStateValues.clear();
+    locker.unlock();
+
+    for (int i = 0; i < changes.count(); ++i) {
+        emit stateValueChanged(changes.at(i).first, changes.at(i).second);
+    }
+}
+
 /*! Returns the \l{ThingId} of the parent of this thing. If the parentId
     is not set, this thing does not have a parent.
 */
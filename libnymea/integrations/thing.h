@@ -43,6 +43,7 @@
 #include <QObject>
 #include <QUuid>
 #include <QVariant>
+#include <QMutex>
 
 class IntegrationPlugin;
 
@@ -162,6 +163,9 @@ private:
 
     void setSetupStatus(ThingSetupStatus status, ThingError setupError, const QString &displayMessage = QString());
 
+private slots:
+    void flushPendingStateValues();
+
 private:
     ThingClass m_thingClass;
     PluginId m_pluginId;
@@ -173,6 +177,12 @@ private:
     States m_states;
     bool m_autoCreated = false;
 
+    // State changes from plugins running in their own thread are notified in batches in the thread of this thing.
+    // The pending values are the ones last notified.
+    mutable QMutex m_stateMutex;
+    QList<StateTypeId> m_pendingStateTypeIds;
+    QHash<StateTypeId, QVariant> m_pendingStateValues;
+
     ThingSetupStatus m_setupStatus = ThingSetupStatusNone;
     ThingError m_setupError = ThingErrorNoError;
     QString m_setupDisplayMessage;
@@ -33,6 +33,7 @@
 #include "thingmanager.h"
 
 #include <QTimer>
+#include <QThread>
 
 ThingActionInfo::ThingActionInfo(Thing *thing, const Action &action, ThingManager *parent, quint32 timeout):
     QObject(parent),
@@ -85,6 +86,17 @@ QString ThingActionInfo::translatedDisplayMessage(const QLocale &locale)
 
 void ThingActionInfo::finish(Thing::ThingError status, const QString &displayMessage)
 {
+    if (QThread::currentThread() != thread()) {
+        // Plugins running in their own thread finish in there, the info is only touched in the thread it lives in.
+        // Finishing again after it timed out has no effect.
+        QTimer::singleShot(0, this, [this, status, displayMessage](){
+            if (!m_finished) {
+                finish(status, displayMessage);
+            }
+        });
+        return;
+    }
+
     m_finished = true;
     m_status = status;
     m_displayMessage = displayMessage;
@@ -32,6 +32,7 @@
 #include "thingmanager.h"
 
 #include <QTimer>
+#include <QThread>
 
 ThingDiscoveryInfo::ThingDiscoveryInfo(const ThingClassId &thingClassId, const ParamList &params, ThingManager *thingManager, quint32 timeout):
     QObject(thingManager),
@@ -100,6 +101,16 @@ QString ThingDiscoveryInfo::translatedDisplayMessage(const QLocale &locale)
 
 void ThingDiscoveryInfo::finish(Thing::ThingError status, const QString &displayMessage)
 {
+    if (QThread::currentThread() != thread()) {
+        // Marshalled like ThingActionInfo::finish()
+        QTimer::singleShot(0, this, [this, status, displayMessage](){
+            if (!m_finished) {
+                finish(status, displayMessage);
+            }
+        });
+        return;
+    }
+
     m_finished = true;
     m_status = status;
     m_displayMessage = displayMessage;
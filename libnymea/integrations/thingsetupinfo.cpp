@@ -34,6 +34,7 @@
 #include "thingmanager.h"
 
 #include <QTimer>
+#include <QThread>
 
 ThingSetupInfo::ThingSetupInfo(Thing *thing, ThingManager *thingManager, quint32 timeout):
     QObject(thingManager),
@@ -81,6 +82,16 @@ QString ThingSetupInfo::translatedDisplayMessage(const QLocale &locale)
 
 void ThingSetupInfo::finish(Thing::ThingError status, const QString &displayMessage)
 {
+    if (QThread::currentThread() != thread()) {
+        // Marshalled like ThingActionInfo::finish()
+        QTimer::singleShot(0, this, [this, status, displayMessage](){
+            if (!m_finished) {
+                finish(status, displayMessage);
+            }
+        });
+        return;
+    }
+
     m_finished = true;
     m_status = status;
     m_displayMessage = displayMessage;
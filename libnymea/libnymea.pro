@@ -39,9 +39,11 @@ HEADERS += \
     types/thingclass.h \
     typeutils.h \
     loggingcategories.h \
+    logwriter.h \
     nymeasettings.h \
     hardware/gpio.h \
     hardware/gpiomonitor.h \
+    hardware/gpioeventloop.h \
     hardware/pwm.h \
     hardware/radio433/radio433.h \
     network/upnp/upnpdiscovery.h \
@@ -60,6 +62,7 @@ HEADERS += \
     hardware/i2c/i2cdevice.h \
     coap/coap.h \
     coap/coappdu.h \
+    coap/coappduview.h \
     coap/coapoption.h \
     coap/coaprequest.h \
     coap/coapreply.h \
@@ -116,11 +119,13 @@ SOURCES += \
     jsonrpc/jsonreply.cpp \
     jsonrpc/jsonrpcserver.cpp \
     loggingcategories.cpp \
+    logwriter.cpp \
     nymeasettings.cpp \
     platform/package.cpp \
     platform/repository.cpp \
     hardware/gpio.cpp \
     hardware/gpiomonitor.cpp \
+    hardware/gpioeventloop.cpp \
     hardware/pwm.cpp \
     hardware/radio433/radio433.cpp \
     network/upnp/upnpdiscovery.cpp \
@@ -139,6 +144,7 @@ SOURCES += \
     hardware/i2c/i2cdevice.cpp \
     coap/coap.cpp \
     coap/coappdu.cpp \
+    coap/coappduview.cpp \
     coap/coapoption.cpp \
     coap/coaprequest.cpp \
     coap/coapreply.cpp \
@@ -29,9 +29,7 @@
 * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 #include "loggingcategories.h"
-#include <QFileInfo>
-#include <QDir>
-#include <QDateTime>
+#include "logwriter.h"
 
 Q_LOGGING_CATEGORY(dcApplication, "Application")
 Q_LOGGING_CATEGORY(dcPluginMetadata, "PluginMetadata")
@@ -75,90 +73,48 @@ Q_LOGGING_CATEGORY(dcTranslations, "Translations")
 Q_LOGGING_CATEGORY(dcI2C, "I2C")
 
 
-static QFile s_logFile;
-static bool s_useColors;
-static QList<QtMessageHandler> s_handlers;
-
-static const char *const normal = "\033[0m";
-static const char *const warning = "\033[33m";
-static const char *const error = "\033[31m";
-
+// The handler is called asynchronously from the log writer thread, never from the thread
+// logging the message. It must be thread safe. The file and function of the context are null.
 void nymeaInstallMessageHandler(QtMessageHandler handler)
 {
-    s_handlers.append(handler);
+    LogWriter::instance()->installHandler(handler);
 }
 
 void nymeaUninstallMessageHandler(QtMessageHandler handler)
 {
-    s_handlers.removeAll(handler);
+    LogWriter::instance()->uninstallHandler(handler);
 }
 
 void nymeaLogMessageHandler(QtMsgType type, const QMessageLogContext &context, const QString &message)
 {
-    // Copy message to all installed nymea handlers
-    foreach (QtMessageHandler handler, s_handlers) {
-        handler(type, context, message);
-    }
-
-    QString messageString;
-    QString timeString = QDateTime::currentDateTime().toString("yyyy.MM.dd hh:mm:ss.zzz");
-    switch (type) {
-#if (QT_VERSION >= QT_VERSION_CHECK(5, 5, 0))
-    case QtInfoMsg:
-        messageString = QString(" I %1 | %2: %3").arg(timeString).arg(context.category).arg(message);
-        fprintf(stdout, " I | %s: %s\n", context.category, message.toUtf8().data());
-        break;
-#endif
-    case QtDebugMsg:
-        messageString = QString(" I %1 | %2: %3").arg(timeString).arg(context.category).arg(message);
-        fprintf(stdout, " I | %s: %s\n", context.category, message.toUtf8().data());
-        break;
-    case QtWarningMsg:
-        messageString = QString(" W %1 | %2: %3").arg(timeString).arg(context.category).arg(message);
-        fprintf(stdout, "%s W | %s: %s%s\n", s_useColors ? warning : "", context.category, message.toUtf8().data(), s_useColors ? normal : "");
-        break;
-    case QtCriticalMsg:
-        messageString = QString(" C %1 | %2: %3").arg(timeString).arg(context.category).arg(message);
-        fprintf(stdout, "%s C | %s: %s%s\n", s_useColors ? error : "", context.category, message.toUtf8().data(), s_useColors ? error : "");
-        break;
-    case QtFatalMsg:
-        messageString = QString(" F %1 | %2: %3").arg(timeString).arg(context.category).arg(message);
-        fprintf(stdout, "%s F | %s: %s%s\n", s_useColors ? error : "", context.category, message.toUtf8().data(), s_useColors ? error: "");
-        break;
-    }
-    fflush(stdout);
-
-    if (s_logFile.isOpen()) {
-        QTextStream textStream(&s_logFile);
-        textStream << messageString << endl;
-    }
+    // Formatting and writing happens in the log writer thread
+    LogWriter::instance()->log(type, context, message);
 }
 
 bool initLogging(const QString &fileName, bool useColors)
 {
-    s_useColors = useColors;
+    LogWriter::instance()->setUseColors(useColors);
 
     qInstallMessageHandler(nymeaLogMessageHandler);
 
-    if (!fileName.isEmpty()) {
-        QFileInfo fi(fileName);
-        QDir dir(fi.absolutePath());
-        if (!dir.exists() && !dir.mkpath(dir.absolutePath())) {
-            qWarning() << "Error logfile path:" << fileName;
-            return false;
-        }
-        s_logFile.setFileName(fileName);
-        if (!s_logFile.open(QFile::WriteOnly | QFile::Append)) {
-            qWarning() << "Error opening log file:" << fileName;
-            return false;
-        }
+    if (!LogWriter::instance()->openLogFile(fileName)) {
+        qWarning() << "Error opening log file:" << fileName;
+        return false;
     }
     return true;
 }
 
+void setLogFileRotation(qint64 maxFileSize, int maxFiles)
+{
+    LogWriter::instance()->setRotation(maxFileSize, maxFiles);
+}
+
+quint64 droppedLogMessages()
+{
+    return LogWriter::instance()->droppedMessages();
+}
+
 void closeLogFile()
 {
-    if (s_logFile.isOpen()) {
-        s_logFile.close();
-    }
+    LogWriter::instance()->closeLogFile();
 }
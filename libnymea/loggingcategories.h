@@ -89,11 +89,19 @@ Q_DECLARE_LOGGING_CATEGORY(dcI2C)
   for the entire system (e.g. redirect to a different logging category, the Qt's
   mechanism of qInstallMessageHandler() is still available and will always be called
   *before* distributing the message to every nymea message handler.
+
+  Log messages are written asynchronously. The nymea message handlers are called
+  from the log writer thread, in batches, not from the thread that logged the message.
+  The file and function of the message context passed to them are always null.
+  If a thread logs faster than the messages can be written, messages are dropped
+  and counted in droppedLogMessages().
 */
 
 void nymeaInstallMessageHandler(QtMessageHandler handler);
 void nymeaUninstallMessageHandler(QtMessageHandler handler);
 bool initLogging(const QString &fileName, bool useColors);
+void setLogFileRotation(qint64 maxFileSize, int maxFiles);
+quint64 droppedLogMessages();
 void closeLogFile();
 
 #endif // LOGGINGCATEGORYS_H
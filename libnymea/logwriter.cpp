@@ -0,0 +1,449 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "logwriter.h"
+
+#include <QDateTime>
+#include <QFileInfo>
+#include <QVector>
+#include <QDir>
+
+#include <algorithm>
+
+static const char *const normal = "\033[0m";
+static const char *const warning = "\033[33m";
+static const char *const error = "\033[31m";
+
+namespace {
+
+// Releases the ring buffer of a thread when it finishes, so the next new thread can reuse it
+struct ThreadBufferHandle {
+    ~ThreadBufferHandle() {
+        if (owned) {
+            owned->store(false, std::memory_order_release);
+        }
+    }
+    void *buffer = nullptr;
+    std::atomic<bool> *owned = nullptr;
+};
+
+}
+
+static thread_local ThreadBufferHandle s_threadBuffer;
+
+LogWriter *LogWriter::instance()
+{
+    // Intentionally never deleted, messages may be logged until the very end of the process
+    static LogWriter *writer = new LogWriter();
+    return writer;
+}
+
+LogWriter::LogWriter() :
+    QThread(),
+    m_consumerMutex(QMutex::Recursive)
+{
+
+}
+
+void LogWriter::setUseColors(bool useColors)
+{
+    QMutexLocker locker(&m_consumerMutex);
+    m_useColors = useColors;
+}
+
+bool LogWriter::openLogFile(const QString &fileName)
+{
+    QMutexLocker locker(&m_consumerMutex);
+    if (!fileName.isEmpty()) {
+        QFileInfo fi(fileName);
+        QDir dir(fi.absolutePath());
+        if (!dir.exists() && !dir.mkpath(dir.absolutePath())) {
+            return false;
+        }
+        m_logFile.setFileName(fileName);
+        if (!m_logFile.open(QFile::WriteOnly | QFile::Append)) {
+            return false;
+        }
+    }
+
+    if (!m_running) {
+        m_stopping = false;
+        m_running = true;
+        start();
+    }
+    return true;
+}
+
+void LogWriter::closeLogFile()
+{
+    stop();
+
+    QMutexLocker locker(&m_consumerMutex);
+    if (m_logFile.isOpen()) {
+        m_logFile.close();
+    }
+}
+
+void LogWriter::setRotation(qint64 maxFileSize, int maxFiles)
+{
+    QMutexLocker locker(&m_consumerMutex);
+    m_maxFileSize = maxFileSize;
+    m_maxFiles = qMax(maxFiles, 1);
+}
+
+void LogWriter::installHandler(QtMessageHandler handler)
+{
+    QMutexLocker locker(&m_handlersMutex);
+    m_handlers.append(handler);
+}
+
+void LogWriter::uninstallHandler(QtMessageHandler handler)
+{
+    QMutexLocker locker(&m_handlersMutex);
+    m_handlers.removeAll(handler);
+}
+
+void LogWriter::log(QtMsgType type, const QMessageLogContext &context, const QString &message)
+{
+    if (m_running && type != QtFatalMsg) {
+        if (!threadBuffer()->push(type, context, message)) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        wakeUp();
+        return;
+    }
+
+    // The writer is not running, or the process is about to abort. Write everything
+    // still queued and this message right away.
+    Entry entry;
+    entry.type = type;
+    entry.timestamp = QDateTime::currentMSecsSinceEpoch();
+    qstrncpy(entry.category, context.category ? context.category : "default", sizeof(entry.category));
+    entry.line = context.line;
+    entry.message = message;
+
+    QMutexLocker locker(&m_consumerMutex);
+    drain();
+    QByteArray console, file;
+    writeEntry(entry, &console, &file);
+    flush(console, file);
+    callHandlers(QVector<Entry>() << entry);
+}
+
+quint64 LogWriter::droppedMessages() const
+{
+    return m_dropped.load(std::memory_order_relaxed);
+}
+
+void LogWriter::run()
+{
+    while (!m_stopping) {
+        m_consumerMutex.lock();
+        int count = drain();
+        m_consumerMutex.unlock();
+        if (count > 0) {
+            continue;
+        }
+
+        // Nothing to do, sleep until a producer wakes us up. Check once more after
+        // announcing the idle state so a message pushed in between is not missed.
+        m_idle = true;
+        m_consumerMutex.lock();
+        count = drain();
+        m_consumerMutex.unlock();
+        if (count > 0) {
+            m_idle = false;
+            continue;
+        }
+
+        QMutexLocker locker(&m_wakeMutex);
+        if (m_idle && !m_stopping) {
+            m_wakeCondition.wait(&m_wakeMutex, 1000);
+        }
+        m_idle = false;
+    }
+}
+
+LogWriter::RingBuffer *LogWriter::threadBuffer()
+{
+    RingBuffer *buffer = static_cast<RingBuffer*>(s_threadBuffer.buffer);
+    if (buffer) {
+        return buffer;
+    }
+
+    // First message of this thread, reuse the buffer of a finished thread or create a new one
+    QMutexLocker locker(&m_buffersMutex);
+    foreach (RingBuffer *candidate, m_buffers) {
+        bool expected = false;
+        if (candidate->owned.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+            buffer = candidate;
+            break;
+        }
+    }
+    if (!buffer) {
+        buffer = new RingBuffer();
+        m_buffers.append(buffer);
+    }
+    s_threadBuffer.buffer = buffer;
+    s_threadBuffer.owned = &buffer->owned;
+    return buffer;
+}
+
+void LogWriter::wakeUp()
+{
+    if (m_idle.exchange(false)) {
+        QMutexLocker locker(&m_wakeMutex);
+        m_wakeCondition.wakeOne();
+    }
+}
+
+void LogWriter::stop()
+{
+    if (!m_running) {
+        return;
+    }
+
+    m_stopping = true;
+    {
+        QMutexLocker locker(&m_wakeMutex);
+        m_wakeCondition.wakeOne();
+    }
+    wait();
+    m_running = false;
+
+    QMutexLocker locker(&m_consumerMutex);
+    drain();
+}
+
+int LogWriter::drain()
+{
+    QList<RingBuffer*> buffers;
+    m_buffersMutex.lock();
+    buffers = m_buffers;
+    m_buffersMutex.unlock();
+
+    QVector<Entry> entries;
+    Entry entry;
+    foreach (RingBuffer *buffer, buffers) {
+        while (buffer->pop(&entry)) {
+            entries.append(entry);
+        }
+    }
+
+    QByteArray console, file;
+    if (!entries.isEmpty()) {
+        // Messages from different threads are merged by their time of logging
+        std::stable_sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) {
+            return a.timestamp < b.timestamp;
+        });
+
+        for (int i = 0; i < entries.count(); i++) {
+            writeEntry(entries.at(i), &console, &file);
+        }
+    }
+    writeDropReport(&console, &file);
+    flush(console, file);
+    callHandlers(entries);
+
+    return entries.count();
+}
+
+void LogWriter::callHandlers(const QVector<Entry> &entries)
+{
+    if (entries.isEmpty()) {
+        return;
+    }
+
+    m_handlersMutex.lock();
+    QList<QtMessageHandler> handlers = m_handlers;
+    m_handlersMutex.unlock();
+
+    foreach (QtMessageHandler handler, handlers) {
+        for (int i = 0; i < entries.count(); i++) {
+            const Entry &entry = entries.at(i);
+            QMessageLogContext context(nullptr, entry.line, nullptr, entry.category);
+            handler(entry.type, context, entry.message);
+        }
+    }
+}
+
+void LogWriter::writeEntry(const Entry &entry, QByteArray *console, QByteArray *file)
+{
+    const char *prefix = "";
+    const char *suffix = "";
+    char typeChar = 'I';
+    switch (entry.type) {
+    case QtDebugMsg:
+    case QtInfoMsg:
+        break;
+    case QtWarningMsg:
+        typeChar = 'W';
+        prefix = m_useColors ? warning : "";
+        suffix = m_useColors ? normal : "";
+        break;
+    case QtCriticalMsg:
+        typeChar = 'C';
+        prefix = m_useColors ? error : "";
+        suffix = m_useColors ? normal : "";
+        break;
+    case QtFatalMsg:
+        typeChar = 'F';
+        prefix = m_useColors ? error : "";
+        suffix = m_useColors ? normal : "";
+        break;
+    }
+
+    QByteArray message = entry.message.toUtf8();
+
+    console->append(prefix);
+    console->append(' ');
+    console->append(typeChar);
+    console->append(" | ");
+    console->append(entry.category);
+    console->append(": ");
+    console->append(message);
+    console->append(suffix);
+    console->append('\n');
+
+    if (m_logFile.isOpen()) {
+        file->append(' ');
+        file->append(typeChar);
+        file->append(' ');
+        file->append(formatTimestamp(entry.timestamp));
+        file->append(" | ");
+        file->append(entry.category);
+        file->append(": ");
+        file->append(message);
+        file->append('\n');
+    }
+}
+
+void LogWriter::writeDropReport(QByteArray *console, QByteArray *file)
+{
+    quint64 dropped = m_dropped.load(std::memory_order_relaxed);
+    if (dropped == m_reportedDrops) {
+        return;
+    }
+
+    Entry entry;
+    entry.type = QtWarningMsg;
+    entry.timestamp = QDateTime::currentMSecsSinceEpoch();
+    qstrncpy(entry.category, "Application", sizeof(entry.category));
+    entry.message = QString("Dropped %1 log messages because the log buffer was full.").arg(dropped - m_reportedDrops);
+    writeEntry(entry, console, file);
+    m_reportedDrops = dropped;
+}
+
+void LogWriter::flush(const QByteArray &console, const QByteArray &file)
+{
+    if (!console.isEmpty()) {
+        fwrite(console.constData(), 1, static_cast<size_t>(console.size()), stdout);
+        fflush(stdout);
+    }
+
+    if (!file.isEmpty() && m_logFile.isOpen()) {
+        m_logFile.write(file);
+        m_logFile.flush();
+        if (m_maxFileSize > 0 && m_logFile.size() >= m_maxFileSize) {
+            rotateLogFile();
+        }
+    }
+}
+
+void LogWriter::rotateLogFile()
+{
+    // nymead.log -> nymead.log.1 -> nymead.log.2 ... up to the configured number of files
+    QString fileName = m_logFile.fileName();
+    m_logFile.close();
+
+    QFile::remove(QString("%1.%2").arg(fileName).arg(m_maxFiles));
+    for (int i = m_maxFiles - 1; i >= 1; i--) {
+        QFile::rename(QString("%1.%2").arg(fileName).arg(i), QString("%1.%2").arg(fileName).arg(i + 1));
+    }
+    QFile::rename(fileName, fileName + ".1");
+
+    m_logFile.setFileName(fileName);
+    if (!m_logFile.open(QFile::WriteOnly | QFile::Append)) {
+        QByteArray errorMessage = " W | Application: Could not open log file " + fileName.toUtf8() + " after rotating it.\n";
+        fwrite(errorMessage.constData(), 1, static_cast<size_t>(errorMessage.size()), stderr);
+    }
+}
+
+QByteArray LogWriter::formatTimestamp(qint64 timestamp)
+{
+    // Formatting the date is expensive, only do it once per second
+    qint64 second = timestamp / 1000;
+    if (second != m_cachedSecond) {
+        m_cachedSecond = second;
+        m_cachedTimestamp = QDateTime::fromMSecsSinceEpoch(second * 1000).toString("yyyy.MM.dd hh:mm:ss.").toUtf8();
+    }
+
+    int msecs = static_cast<int>(timestamp % 1000);
+    QByteArray result = m_cachedTimestamp;
+    result.append(static_cast<char>('0' + msecs / 100));
+    result.append(static_cast<char>('0' + msecs / 10 % 10));
+    result.append(static_cast<char>('0' + msecs % 10));
+    return result;
+}
+
+bool LogWriter::RingBuffer::push(QtMsgType type, const QMessageLogContext &context, const QString &message)
+{
+    uint head = m_head.load(std::memory_order_relaxed);
+    if (head - m_tail.load(std::memory_order_acquire) >= capacity) {
+        return false;
+    }
+
+    Entry &entry = m_entries[head % capacity];
+    entry.type = type;
+    entry.timestamp = QDateTime::currentMSecsSinceEpoch();
+    qstrncpy(entry.category, context.category ? context.category : "default", sizeof(entry.category));
+    entry.line = context.line;
+    entry.message = message;
+
+    m_head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+bool LogWriter::RingBuffer::pop(Entry *entry)
+{
+    uint tail = m_tail.load(std::memory_order_relaxed);
+    if (tail == m_head.load(std::memory_order_acquire)) {
+        return false;
+    }
+
+    Entry &slot = m_entries[tail % capacity];
+    *entry = slot;
+    // Release the message here, not in the logging thread on the next round
+    slot.message = QString();
+
+    m_tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
@@ -0,0 +1,134 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef LOGWRITER_H
+#define LOGWRITER_H
+
+#include <QFile>
+#include <QList>
+#include <QVector>
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+
+#include <atomic>
+
+// Writes the log messages of all threads asynchronously. Every logging thread gets its
+// own lock-free ring buffer, the writer thread drains them and writes the messages in
+// batches to stdout, the log file and the installed nymea message handlers. If a ring
+// buffer is full, the message is dropped and counted instead of blocking the caller.
+class LogWriter : public QThread
+{
+public:
+    static LogWriter *instance();
+
+    void setUseColors(bool useColors);
+    bool openLogFile(const QString &fileName);
+    void closeLogFile();
+    void setRotation(qint64 maxFileSize, int maxFiles);
+
+    void installHandler(QtMessageHandler handler);
+    void uninstallHandler(QtMessageHandler handler);
+
+    void log(QtMsgType type, const QMessageLogContext &context, const QString &message);
+    quint64 droppedMessages() const;
+
+protected:
+    void run() override;
+
+private:
+    struct Entry {
+        QtMsgType type = QtDebugMsg;
+        qint64 timestamp = 0;
+        char category[48];
+        // No file and function, those strings are gone once the plugin logging them is unloaded
+        int line = 0;
+        QString message;
+    };
+
+    // Single producer (the owning thread), single consumer (whoever holds m_consumerMutex)
+    class RingBuffer
+    {
+    public:
+        static const uint capacity = 1024;
+
+        bool push(QtMsgType type, const QMessageLogContext &context, const QString &message);
+        bool pop(Entry *entry);
+
+        std::atomic<bool> owned{true};
+
+    private:
+        Entry m_entries[capacity];
+        std::atomic<uint> m_head{0};
+        std::atomic<uint> m_tail{0};
+    };
+
+    explicit LogWriter();
+
+    RingBuffer *threadBuffer();
+    void wakeUp();
+    void stop();
+
+    int drain();
+    void writeEntry(const Entry &entry, QByteArray *console, QByteArray *file);
+    void writeDropReport(QByteArray *console, QByteArray *file);
+    void callHandlers(const QVector<Entry> &entries);
+    void flush(const QByteArray &console, const QByteArray &file);
+    void rotateLogFile();
+    QByteArray formatTimestamp(qint64 timestamp);
+
+    bool m_useColors = false;
+    std::atomic<bool> m_running{false};
+    std::atomic<bool> m_stopping{false};
+    std::atomic<bool> m_idle{false};
+    std::atomic<quint64> m_dropped{0};
+    quint64 m_reportedDrops = 0;
+
+    QMutex m_buffersMutex;
+    QList<RingBuffer*> m_buffers;
+
+    QMutex m_handlersMutex;
+    QList<QtMessageHandler> m_handlers;
+
+    QMutex m_wakeMutex;
+    QWaitCondition m_wakeCondition;
+
+    // Held by the writer thread while draining, or by the caller while writing synchronously.
+    // Recursive because the nymea message handlers may log themselves.
+    QMutex m_consumerMutex;
+    QFile m_logFile;
+    qint64 m_maxFileSize = 0;
+    int m_maxFiles = 5;
+
+    qint64 m_cachedSecond = -1;
+    QByteArray m_cachedTimestamp;
+};
+
+#endif // LOGWRITER_H
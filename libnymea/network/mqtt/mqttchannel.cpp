@@ -36,6 +36,10 @@
     \inmodule libnymea
 
     The MQTT channel class holds the required data to connect to the nymea internal MQTT broker.
+
+    Retained messages stored in the broker for the topic prefixes of a channel are emitted with
+    \l{publishReceived()} shortly after the channel has been created, so a plugin gets the current
+    state of a device without waiting for it to publish again. Only the new channel receives them.
 */
 
 /*! \fn QString MqttChannel::clientId();
@@ -74,6 +78,21 @@
     as publishing to "topicPrefix/..."
 */
 
+/*! \fn bool MqttChannel::isOnline() const;
+    Returns true if the device of this channel is online. The state follows the availability
+    messages of the device, like the Tasmota "LWT" or the Shelly "online" topic, including the
+    last will the broker publishes when the device drops off. Without availability messages the
+    state follows the connection of the client with the clientId of this channel.
+
+    \sa onlineChanged()
+*/
+
+/*! \fn void MqttChannel::onlineChanged(MqttChannel* channel, bool online);
+    This signal is emitted when the device of the given \a channel went \a online or offline.
+
+    \sa isOnline()
+*/
+
 #include "mqttchannel.h"
 
 
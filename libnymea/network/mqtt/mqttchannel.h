@@ -50,12 +50,15 @@ public:
     virtual quint16 serverPort() const = 0;
     virtual QStringList topicPrefixList() const = 0;
 
+    virtual bool isOnline() const = 0;
+
     virtual void publish(const QString &topic, const QByteArray &payload) = 0;
 
 signals:
     void clientConnected(MqttChannel* channel);
     void clientDisconnected(MqttChannel* channel);
     void publishReceived(MqttChannel* channel, const QString &topic, const QByteArray &payload);
+    void onlineChanged(MqttChannel* channel, bool online);
 };
 
 #endif // MQTTCHANNEL_H
@@ -102,6 +102,7 @@
 
 /*! \fn UpnpDiscoveryReply *UpnpDiscovery::discoverDevices(const QString &searchTarget = "ssdp:all", const QString &userAgent = QString(), const int &timeout = 5000);
     Start a UPnP discovery request for devices listening on the given \a searchTarget and \a userAgent. The discovery duration can be specified with \a timeout parameter.
+    Concurrent discoveries for the same \a searchTarget and \a userAgent share their search messages and results.
 */
 
 /*! \fn void UpnpDiscovery::sendToMulticast(const QByteArray &data);
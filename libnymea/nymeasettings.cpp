@@ -50,7 +50,8 @@
     \value SettingsRoleDevices
         This role will create the \b{things.conf} file and is used to store the configured \l{Device}{Devices}.
     \value SettingsRoleRules
-        This role will create the \b{rules.conf} file and is used to store the configured \l{nymeaserver::Rule}{Rules}.
+        This role will create the \b{rules.conf} file. It was used to store the configured \l{nymeaserver::Rule}{Rules}
+        and is only read to migrate them to the rules database.
     \value SettingsRolePlugins
         This role will create the \b{plugins.conf} file and is used to store the \l{DevicePlugin}{Plugin} configurations.
     \value SettingsRoleGlobal
@@ -79,6 +80,34 @@
 NymeaSettings::NymeaSettings(const SettingsRole &role, QObject *parent):
     QObject(parent),
     m_role(role)
+{
+    m_settings = new QSettings(settingsFileName(role), QSettings::IniFormat, this);
+}
+
+/*! Destructor of the NymeaSettings.*/
+NymeaSettings::~NymeaSettings()
+{
+    m_settings->sync();
+    delete m_settings;
+}
+
+/*! Returns the \l{SettingsRole} of this \l{NymeaSettings}.*/
+NymeaSettings::SettingsRole NymeaSettings::settingsRole() const
+{
+    return m_role;
+}
+
+/*! Returns true if nymead is started as \b{root}.*/
+bool NymeaSettings::isRoot()
+{
+    if (getuid() != 0)
+        return false;
+
+    return true;
+}
+
+/*! Returns the absolute path of the settings file used for the given \a role without opening it. */
+QString NymeaSettings::settingsFileName(const SettingsRole &role)
 {
     QString settingsPrefix = QCoreApplication::instance()->organizationName() + "/";
 
@@ -123,29 +152,7 @@ NymeaSettings::NymeaSettings(const SettingsRole &role, QObject *parent):
         fileName = "ioconnections.conf";
         break;
     }
-    m_settings = new QSettings(basePath + settingsPrefix + fileName, QSettings::IniFormat, this);
-}
-
-/*! Destructor of the NymeaSettings.*/
-NymeaSettings::~NymeaSettings()
-{
-    m_settings->sync();
-    delete m_settings;
-}
-
-/*! Returns the \l{SettingsRole} of this \l{NymeaSettings}.*/
-NymeaSettings::SettingsRole NymeaSettings::settingsRole() const
-{
-    return m_role;
-}
-
-/*! Returns true if nymead is started as \b{root}.*/
-bool NymeaSettings::isRoot()
-{
-    if (getuid() != 0)
-        return false;
-
-    return true;
+    return basePath + settingsPrefix + fileName;
 }
 
 /*! Returns the path to the folder where the NymeaSettings will be saved i.e. \tt{/etc/nymea}. */
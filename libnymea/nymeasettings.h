@@ -61,6 +61,7 @@ public:
 
     static bool isRoot();
     static QString settingsPath();
+    static QString settingsFileName(const SettingsRole &role);
     static QString translationsPath();
     static QString storagePath();
 
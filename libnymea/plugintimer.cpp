@@ -37,7 +37,8 @@
 
     The plugin timer allows to trigger repeating actions in a device plugin. This timer does not represent a precise timer
     should be used for not time critical things. The PluginTimerManager will schedule the requested timer as needed and
-    trigger the timeout() method.
+    trigger the timeout() method. Timers registered with the same interval get spread over the interval, so the first
+    timeout may happen up to half an interval earlier.
 
 
     \chapter Example
@@ -94,6 +95,10 @@
     This property holds the timeout interval in seconds.
 */
 
+/*! \fn int PluginTimer::intervalMSecs() const;
+    This property holds the timeout interval in milliseconds.
+*/
+
 /*! \fn int PluginTimer::currentTick() const;
     Returns the current timer tick of this PluginTimer in seconds.
 */
@@ -110,7 +115,8 @@
 */
 
 /*! \fn void PluginTimer::currentTickChanged(const int &currentTick);
-    This signal will be emitted whenever the \a currentTick of this PluginTimer changed.
+    This signal will be emitted whenever this PluginTimer gets reset or timed out. The
+    \a currentTick is not updated every second.
 
     \sa currentTick()
 */
@@ -184,6 +190,13 @@
     \sa unregisterTimer()
 */
 
+/*! \fn PluginTimer *PluginTimerManager::registerTimerMSecs(int msecs);
+    Registers a new PluginTimer with an interval of the given \a msecs parameter. Intervals below 100 ms
+    are not supported. Returns a new PluginTimer object.
+
+    \sa registerTimer(), unregisterTimer()
+*/
+
 /*! \fn void unregisterTimer(PluginTimer *timer = nullptr);
     Unregisters the given \a timer. The PluginTimerManager will delete the object once the unregister process is complete.
 
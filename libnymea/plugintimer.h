@@ -46,6 +46,7 @@ public:
     virtual ~PluginTimer() = default;
 
     virtual int interval() const = 0;
+    virtual int intervalMSecs() const = 0;
     virtual int currentTick() const = 0;
     virtual bool running() const = 0;
 
@@ -75,6 +76,7 @@ public:
     virtual ~PluginTimerManager() = default;
 
     Q_INVOKABLE virtual PluginTimer *registerTimer(int seconds = 60) = 0;
+    Q_INVOKABLE virtual PluginTimer *registerTimerMSecs(int msecs) = 0;
     Q_INVOKABLE virtual void unregisterTimer(PluginTimer *timer = nullptr) = 0;
 };
 
@@ -140,6 +140,102 @@ bool CalendarItem::evaluate(const QDateTime &dateTime) const
     return dateTime >= m_dateTime && dateTime < m_dateTime.addSecs(duration() * 60);
 }
 
+/*! Returns the first point in time after the given \a dateTime at which the result of
+    \l{evaluate()} can change. Returns an invalid QDateTime if the result will never change again.
+*/
+QDateTime CalendarItem::nextTransition(const QDateTime &dateTime) const
+{
+    // Start and end of every interval which could be relevant around the given dateTime
+    QList<QDateTime> transitions;
+    auto appendInterval = [this, &transitions](const QDateTime &startDateTime) {
+        transitions.append(startDateTime);
+        transitions.append(startDateTime.addSecs(duration() * 60));
+    };
+
+    if (m_startTime.isValid()) {
+        switch (m_repeatingOption.mode()) {
+        case RepeatingOption::RepeatingModeHourly: {
+            // Always true if the duration is longer than a hour
+            if (duration() >= 60)
+                return QDateTime();
+
+            QDateTime hourStartDateTime = QDateTime(dateTime.date(), QTime(dateTime.time().hour(), 0));
+            for (int i = -1; i <= 1; i++) {
+                appendInterval(hourStartDateTime.addSecs(i * 3600 + startTime().minute() * 60));
+            }
+
+            // Only the interval of the current hour gets evaluated
+            transitions.append(hourStartDateTime.addSecs(3600));
+
+            // Week and month days are checked against the current day
+            if (!repeatingOption().weekDays().isEmpty() || !repeatingOption().monthDays().isEmpty())
+                transitions.append(QDateTime(dateTime.date().addDays(1), QTime(0, 0)));
+
+            break;
+        }
+        case RepeatingOption::RepeatingModeNone:
+        case RepeatingOption::RepeatingModeDaily:
+            // Always true if the duration is longer than a day
+            if (duration() >= 1440)
+                return QDateTime();
+
+            for (int i = -1; i <= 1; i++) {
+                appendInterval(QDateTime(dateTime.date().addDays(i), startTime()));
+            }
+            break;
+        case RepeatingOption::RepeatingModeWeekly:
+            // Always true if the duration is longer than a week
+            if (duration() >= 10080)
+                return QDateTime();
+
+            for (int i = -7; i <= 7; i++) {
+                QDate date = dateTime.date().addDays(i);
+                if (repeatingOption().weekDays().contains(date.dayOfWeek())) {
+                    appendInterval(QDateTime(date, startTime()));
+                }
+            }
+            break;
+        case RepeatingOption::RepeatingModeMonthly: {
+            // Same calculation as in evaluateMonthly(), including overflowing month days
+            QDate monthStartDate = QDate(dateTime.date().year(), dateTime.date().month(), 1);
+            for (int i = -1; i <= 1; i++) {
+                QDateTime monthStartDateTime = QDateTime(monthStartDate.addMonths(i), startTime());
+                foreach (const int &monthDay, repeatingOption().monthDays()) {
+                    QDateTime startDateTime = monthStartDateTime.addDays(monthDay - 1);
+                    appendInterval(startDateTime);
+                    appendInterval(startDateTime.addMonths(-1));
+                }
+            }
+
+            // The intervals are calculated relative to the current month
+            transitions.append(QDateTime(monthStartDate.addMonths(1), QTime(0, 0)));
+            break;
+        }
+        case RepeatingOption::RepeatingModeYearly:
+            // A start time can not be repeated yearly
+            return QDateTime();
+        }
+    } else if (m_repeatingOption.mode() == RepeatingOption::RepeatingModeYearly) {
+        for (int i = -1; i <= 1; i++) {
+            QDate date = QDate(dateTime.date().year() + i, m_dateTime.date().month(), m_dateTime.date().day());
+            if (date.isValid()) {
+                appendInterval(QDateTime(date, m_dateTime.time()));
+            }
+        }
+    } else {
+        appendInterval(m_dateTime);
+    }
+
+    QDateTime nextTransition;
+    foreach (const QDateTime &transition, transitions) {
+        if (transition > dateTime && (!nextTransition.isValid() || transition < nextTransition)) {
+            nextTransition = transition;
+        }
+    }
+
+    return nextTransition;
+}
+
 bool CalendarItem::evaluateHourly(const QDateTime &dateTime) const
 {
     // If the duration is longer than a hour, this calendar item is always true
@@ -60,6 +60,7 @@ public:
 
     bool isValid() const;
     bool evaluate(const QDateTime &dateTime) const;
+    QDateTime nextTransition(const QDateTime &dateTime) const;
 
 private:
     QDateTime m_dateTime;
@@ -115,6 +115,31 @@ bool TimeDescriptor::evaluate(const QDateTime &lastEvaluationTime, const QDateTi
     return false;
 }
 
+/*! Returns the first point in time after the given \a dateTime at which this \l{TimeDescriptor}
+    needs to be evaluated again, either because a \l{CalendarItem} starts or ends or because a
+    \l{TimeEventItem} triggers. Returns an invalid QDateTime if nothing will happen any more.
+*/
+QDateTime TimeDescriptor::nextTransition(const QDateTime &dateTime) const
+{
+    QDateTime nextTransition;
+
+    foreach (const CalendarItem &calendarItem, m_calendarItems) {
+        QDateTime transition = calendarItem.nextTransition(dateTime);
+        if (transition.isValid() && (!nextTransition.isValid() || transition < nextTransition)) {
+            nextTransition = transition;
+        }
+    }
+
+    foreach (const TimeEventItem &timeEventItem, m_timeEventItems) {
+        QDateTime occurrence = timeEventItem.nextOccurrence(dateTime);
+        if (occurrence.isValid() && (!nextTransition.isValid() || occurrence < nextTransition)) {
+            nextTransition = occurrence;
+        }
+    }
+
+    return nextTransition;
+}
+
 /*! Print a TimeDescriptor including the full lists of CalendarItems and TimeEventItems to QDebug. */
 QDebug operator<<(QDebug dbg, const TimeDescriptor &timeDescriptor)
 {
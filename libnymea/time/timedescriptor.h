@@ -52,6 +52,7 @@ public:
     bool isEmpty() const;
 
     bool evaluate(const QDateTime &lastEvaluationTime, const QDateTime &dateTime) const;
+    QDateTime nextTransition(const QDateTime &dateTime) const;
 
 //    void dumpToSettings(NymeaSettings &settings, const QString &groupName) const;
 //    static TimeDescriptor loadFromSettings(NymeaSettings &settings, const QString &groupPrefix);
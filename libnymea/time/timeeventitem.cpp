@@ -142,6 +142,68 @@ bool TimeEventItem::evaluate(const QDateTime &lastEvaluationTime, const QDateTim
     return lastEvaluationTime < m_dateTime && m_dateTime <= dateTime;
 }
 
+/*! Returns the first point in time after the given \a dateTime at which this \l{TimeEventItem}
+    triggers. Returns an invalid QDateTime if this \l{TimeEventItem} will never trigger again.
+*/
+QDateTime TimeEventItem::nextOccurrence(const QDateTime &dateTime) const
+{
+    if (m_time.isValid()) {
+        switch (m_repeatingOption.mode()) {
+        case RepeatingOption::RepeatingModeNone:
+        case RepeatingOption::RepeatingModeDaily: {
+            QDateTime occurrence = QDateTime(dateTime.date(), m_time);
+            if (occurrence <= dateTime)
+                occurrence = QDateTime(dateTime.date().addDays(1), m_time);
+
+            return occurrence;
+        }
+        case RepeatingOption::RepeatingModeHourly: {
+            QDateTime occurrence = QDateTime(dateTime.date(), QTime(dateTime.time().hour(), m_time.minute(), m_time.second()));
+            if (occurrence <= dateTime)
+                occurrence = occurrence.addSecs(3600);
+
+            return occurrence;
+        }
+        case RepeatingOption::RepeatingModeWeekly:
+        case RepeatingOption::RepeatingModeMonthly:
+            // Look ahead at most two months for a matching week or month day
+            for (int i = 0; i <= 62; i++) {
+                QDateTime occurrence = QDateTime(dateTime.date().addDays(i), m_time);
+                if (occurrence <= dateTime)
+                    continue;
+
+                if (m_repeatingOption.mode() == RepeatingOption::RepeatingModeWeekly && m_repeatingOption.evaluateWeekDay(occurrence))
+                    return occurrence;
+
+                if (m_repeatingOption.mode() == RepeatingOption::RepeatingModeMonthly && m_repeatingOption.evaluateMonthDay(occurrence))
+                    return occurrence;
+            }
+            return QDateTime();
+        case RepeatingOption::RepeatingModeYearly:
+            return QDateTime();
+        }
+    }
+
+    // Yearly repeating dateTime, skipping years without this date (29. February)
+    if (m_repeatingOption.mode() == RepeatingOption::RepeatingModeYearly) {
+        for (int i = 0; i <= 8; i++) {
+            QDate date = QDate(dateTime.date().year() + i, m_dateTime.date().month(), m_dateTime.date().day());
+            if (!date.isValid())
+                continue;
+
+            QDateTime occurrence = QDateTime(date, m_dateTime.time());
+            if (occurrence > dateTime)
+                return occurrence;
+        }
+        return QDateTime();
+    }
+
+    if (m_dateTime > dateTime)
+        return m_dateTime;
+
+    return QDateTime();
+}
+
 /*! Print a TimeEvent to QDebug. */
 QDebug operator<<(QDebug dbg, const TimeEventItem &timeEventItem)
 {
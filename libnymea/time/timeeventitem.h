@@ -59,6 +59,7 @@ public:
     bool isValid() const;
 
     bool evaluate(const QDateTime &lastEvaluationTime, const QDateTime &dateTime) const;
+    QDateTime nextOccurrence(const QDateTime &dateTime) const;
 
 private:
     QDateTime m_dateTime;
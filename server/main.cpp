@@ -116,6 +116,12 @@ int main(int argc, char *argv[])
     QCommandLineOption logOption({"l", "log"}, QCoreApplication::translate("nymea", "Specify a log file to write to, if this option is not specified, logs will be printed to the standard output."), "logfile");
     parser.addOption(logOption);
 
+    QCommandLineOption logSizeOption("log-max-size", QCoreApplication::translate("nymea", "Rotate the log file once it exceeds the given size in MiB. By default the log file is not rotated."), "megabytes");
+    parser.addOption(logSizeOption);
+
+    QCommandLineOption logFilesOption("log-files", QCoreApplication::translate("nymea", "The number of rotated log files to keep. The default is 5."), "count", "5");
+    parser.addOption(logFilesOption);
+
     QCommandLineOption noColorOption({"c", "no-colors"}, QCoreApplication::translate("nymea", "Log output is colorized by default. Use this option to disable colors."));
     parser.addOption(noColorOption);
 
@@ -128,6 +134,9 @@ int main(int argc, char *argv[])
     parser.process(application);
 
     // Open the logfile, if any specified
+    if (parser.isSet(logSizeOption)) {
+        setLogFileRotation(parser.value(logSizeOption).toLongLong() * 1024 * 1024, parser.value(logFilesOption).toInt());
+    }
     if (!initLogging(parser.value(logOption), !parser.isSet(noColorOption))) {
         qWarning() << "Error opening log file" << parser.value(logOption);
         return 1;
@@ -2,26 +2,35 @@ TEMPLATE = subdirs
 
 SUBDIRS = \
         actions \
+        bootsnapshot \
+        cloudtransport \
+        coap \
         configurations \
         devices \
         events \
+        gpio \
+        i2c \
         integrations \
         ioconnections \
         jsonrpc \
         logging \
         loggingdirect \
         loggingloading \
+        logwriter \
         mqttbroker \
+        pluginloading \
         plugins \
+        plugintimers \
         rules \
         scripts \
         states \
         tags \
+        threadedplugins \
         timemanager \
+        upnp \
         userloading \
         usermanager \
         versioning \
         webserver \
-        websocketserver \
-        #coap \ # temporary removed until fixed
+        websocketserver
 
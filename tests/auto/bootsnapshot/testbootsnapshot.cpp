@@ -0,0 +1,305 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "nymeatestbase.h"
+#include "nymeacore.h"
+#include "nymeasettings.h"
+
+#include "servers/mocktcpserver.h"
+
+using namespace nymeaserver;
+
+class TestBootSnapshot : public NymeaTestBase
+{
+    Q_OBJECT
+
+private:
+    void populateSettings(int thingCount, int ruleCount);
+    void setSnapshotsEnabled(bool enabled);
+    QVariantList sortedById(const QVariantList &list);
+    void startServer();
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void benchmarkBoot_data();
+    void benchmarkBoot();
+
+    void snapshotMatchesSettings();
+
+    void corruptSnapshotFallsBack();
+
+    void unloadableThingKeepsSettings();
+};
+
+void TestBootSnapshot::populateSettings(int thingCount, int ruleCount)
+{
+    QList<ThingId> thingIds;
+    NymeaSettings thingSettings(NymeaSettings::SettingsRoleThings);
+    thingSettings.beginGroup("ThingConfig");
+    for (int i = 0; i < thingCount; i++) {
+        ThingId thingId = ThingId::createThingId();
+        thingSettings.beginGroup(thingId.toString());
+        thingSettings.setValue("autoCreated", false);
+        thingSettings.setValue("thingName", QString("Light %1").arg(i));
+        thingSettings.setValue("thingClassId", virtualIoLightMockThingClassId.toString());
+        thingSettings.setValue("pluginid", mockPluginId.toString());
+        thingSettings.endGroup();
+        thingIds.append(thingId);
+    }
+    thingSettings.endGroup();
+
+    NymeaSettings ruleSettings(NymeaSettings::SettingsRoleRules);
+    for (int i = 0; i < ruleCount; i++) {
+        ThingId inputThingId = thingIds.at(i % thingIds.count());
+        ThingId outputThingId = thingIds.at((i + 1) % thingIds.count());
+        ruleSettings.beginGroup(RuleId::createRuleId().toString());
+        ruleSettings.setValue("name", QString("Rule %1").arg(i));
+        ruleSettings.setValue("enabled", true);
+        ruleSettings.setValue("executable", true);
+
+        ruleSettings.beginGroup("stateEvaluator");
+        ruleSettings.beginGroup("stateDescriptor");
+        ruleSettings.setValue("stateTypeId", virtualIoLightMockPowerStateTypeId.toString());
+        ruleSettings.setValue("thingId", inputThingId.toString());
+        ruleSettings.setValue("value", true);
+        ruleSettings.setValue("valueType", static_cast<int>(QVariant::Bool));
+        ruleSettings.setValue("operator", Types::ValueOperatorEquals);
+        ruleSettings.endGroup();
+        ruleSettings.setValue("operator", Types::StateOperatorAnd);
+        ruleSettings.endGroup();
+
+        ruleSettings.beginGroup("ruleActions");
+        ruleSettings.beginGroup("0");
+        ruleSettings.setValue("thingId", outputThingId.toString());
+        ruleSettings.setValue("actionTypeId", virtualIoLightMockPowerActionTypeId.toString());
+        ruleSettings.beginGroup("RuleActionParam-" + virtualIoLightMockPowerActionPowerParamTypeId.toString());
+        ruleSettings.setValue("valueType", static_cast<int>(QVariant::Bool));
+        ruleSettings.setValue("value", true);
+        ruleSettings.endGroup();
+        ruleSettings.endGroup();
+        ruleSettings.endGroup();
+
+        ruleSettings.endGroup();
+    }
+}
+
+void TestBootSnapshot::setSnapshotsEnabled(bool enabled)
+{
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("nymead");
+    settings.setValue("bootSnapshotEnabled", enabled);
+    settings.endGroup();
+}
+
+QVariantList TestBootSnapshot::sortedById(const QVariantList &list)
+{
+    QMap<QString, QVariant> sorted;
+    foreach (const QVariant &entry, list) {
+        sorted.insert(entry.toMap().value("id").toString(), entry);
+    }
+    return sorted.values();
+}
+
+void TestBootSnapshot::startServer()
+{
+    NymeaCore::instance()->init();
+    QSignalSpy coreSpy(NymeaCore::instance(), SIGNAL(initialized()));
+    coreSpy.wait();
+    m_mockTcpServer = MockTcpServer::servers().first();
+    m_mockTcpServer->clientConnected(m_clientId);
+    injectAndWait("JSONRPC.Hello");
+}
+
+void TestBootSnapshot::initTestCase()
+{
+    // Setting timeout to 20 mins
+    qputenv("QTEST_FUNCTION_TIMEOUT", "1200000");
+    QDir(NymeaSettings::storagePath() + "/snapshots").removeRecursively();
+
+    NymeaTestBase::initTestCase();
+    QLoggingCategory::setFilterRules("*.debug=false\n"
+                                     "Tests.debug=true\n");
+
+    // Stop the server while we prepare the configuration so it doesn't overwrite it
+    NymeaCore::instance()->destroy();
+    populateSettings(1000, 500);
+    startServer();
+}
+
+void TestBootSnapshot::cleanupTestCase()
+{
+    setSnapshotsEnabled(false);
+    NymeaTestBase::cleanupTestCase();
+    QDir(NymeaSettings::storagePath() + "/snapshots").removeRecursively();
+}
+
+void TestBootSnapshot::benchmarkBoot_data()
+{
+    QTest::addColumn<bool>("snapshotsEnabled");
+
+    QTest::newRow("settings") << false;
+    QTest::newRow("snapshot") << true;
+}
+
+void TestBootSnapshot::benchmarkBoot()
+{
+    QFETCH(bool, snapshotsEnabled);
+
+    setSnapshotsEnabled(snapshotsEnabled);
+
+    // Warm up, this also writes the snapshots if they're enabled
+    restartServer();
+
+    QBENCHMARK_ONCE {
+        restartServer();
+    }
+
+    QVariant response = injectAndWait("Integrations.GetThings");
+    QVERIFY(response.toMap().value("params").toMap().value("things").toList().count() >= 1000);
+    response = injectAndWait("Rules.GetRules");
+    QCOMPARE(response.toMap().value("params").toMap().value("ruleDescriptions").toList().count(), 500);
+}
+
+void TestBootSnapshot::snapshotMatchesSettings()
+{
+    setSnapshotsEnabled(false);
+    restartServer();
+
+    QVariantList settingsThings = sortedById(injectAndWait("Integrations.GetThings").toMap().value("params").toMap().value("things").toList());
+    QVariantList settingsRules = sortedById(injectAndWait("Rules.GetRules").toMap().value("params").toMap().value("ruleDescriptions").toList());
+
+    setSnapshotsEnabled(true);
+    restartServer();
+    restartServer();
+
+    QVariantList snapshotThings = sortedById(injectAndWait("Integrations.GetThings").toMap().value("params").toMap().value("things").toList());
+    QVariantList snapshotRules = sortedById(injectAndWait("Rules.GetRules").toMap().value("params").toMap().value("ruleDescriptions").toList());
+
+    QCOMPARE(snapshotThings.count(), settingsThings.count());
+    for (int i = 0; i < settingsThings.count(); i++) {
+        QVariantMap settingsThing = settingsThings.at(i).toMap();
+        QVariantMap snapshotThing = snapshotThings.at(i).toMap();
+        QCOMPARE(snapshotThing.value("id"), settingsThing.value("id"));
+        QCOMPARE(snapshotThing.value("name"), settingsThing.value("name"));
+        QCOMPARE(snapshotThing.value("thingClassId"), settingsThing.value("thingClassId"));
+        QCOMPARE(snapshotThing.value("parentId"), settingsThing.value("parentId"));
+        QCOMPARE(snapshotThing.value("params"), settingsThing.value("params"));
+        QCOMPARE(snapshotThing.value("settings"), settingsThing.value("settings"));
+    }
+
+    QCOMPARE(snapshotRules, settingsRules);
+    for (int i = 0; i < settingsRules.count(); i += 50) {
+        QVariantMap params;
+        params.insert("ruleId", settingsRules.at(i).toMap().value("id"));
+        QVariant response = injectAndWait("Rules.GetRuleDetails", params);
+        QVariantMap rule = response.toMap().value("params").toMap().value("rule").toMap();
+        QCOMPARE(rule.value("name"), settingsRules.at(i).toMap().value("name"));
+        QCOMPARE(rule.value("actions").toList().count(), 1);
+        QCOMPARE(rule.value("stateEvaluator").toMap().value("stateDescriptor").toMap().value("stateTypeId").toUuid(), QUuid(virtualIoLightMockPowerStateTypeId));
+    }
+}
+
+void TestBootSnapshot::corruptSnapshotFallsBack()
+{
+    setSnapshotsEnabled(true);
+    restartServer();
+
+    QVariantList things = injectAndWait("Integrations.GetThings").toMap().value("params").toMap().value("things").toList();
+
+    // Flip some bytes in the payload of the things snapshot
+    QFile snapshotFile(NymeaSettings::storagePath() + "/snapshots/things.snapshot");
+    QVERIFY(snapshotFile.exists());
+    QVERIFY(snapshotFile.open(QFile::ReadWrite));
+    QByteArray data = snapshotFile.readAll();
+    for (int i = data.size() / 2; i < data.size() / 2 + 16; i++) {
+        data[i] = ~data.at(i);
+    }
+    snapshotFile.seek(0);
+    snapshotFile.write(data);
+    snapshotFile.close();
+
+    restartServer();
+
+    QVariantList reloadedThings = injectAndWait("Integrations.GetThings").toMap().value("params").toMap().value("things").toList();
+    QCOMPARE(reloadedThings.count(), things.count());
+}
+
+void TestBootSnapshot::unloadableThingKeepsSettings()
+{
+    setSnapshotsEnabled(true);
+    restartServer();
+
+    QString snapshotFileName = NymeaSettings::storagePath() + "/snapshots/things.snapshot";
+    QVERIFY(QFile::exists(snapshotFileName));
+    int thingCount = injectAndWait("Integrations.GetThings").toMap().value("params").toMap().value("things").toList().count();
+
+    // Add a thing whose thing class can't be found while the server is down
+    NymeaCore::instance()->destroy();
+    ThingId unknownThingId = ThingId::createThingId();
+    {
+        NymeaSettings thingSettings(NymeaSettings::SettingsRoleThings);
+        thingSettings.beginGroup("ThingConfig");
+        thingSettings.beginGroup(unknownThingId.toString());
+        thingSettings.setValue("autoCreated", false);
+        thingSettings.setValue("thingName", "Unknown thing");
+        thingSettings.setValue("thingClassId", QUuid::createUuid().toString());
+        thingSettings.setValue("pluginid", mockPluginId.toString());
+        thingSettings.endGroup();
+        thingSettings.endGroup();
+    }
+    startServer();
+
+    // The thing is skipped, but must neither be dropped from the settings nor end up in a snapshot missing it
+    QCOMPARE(injectAndWait("Integrations.GetThings").toMap().value("params").toMap().value("things").toList().count(), thingCount);
+    QVERIFY(!QFile::exists(snapshotFileName));
+    restartServer();
+    QVERIFY(!QFile::exists(snapshotFileName));
+    {
+        NymeaSettings thingSettings(NymeaSettings::SettingsRoleThings);
+        thingSettings.beginGroup("ThingConfig");
+        QVERIFY(thingSettings.childGroups().contains(unknownThingId.toString()));
+    }
+
+    // Once the settings only hold loadable things again, the snapshot is written again
+    NymeaCore::instance()->destroy();
+    {
+        NymeaSettings thingSettings(NymeaSettings::SettingsRoleThings);
+        thingSettings.beginGroup("ThingConfig");
+        thingSettings.remove(unknownThingId.toString());
+        thingSettings.endGroup();
+    }
+    startServer();
+    QVERIFY(QFile::exists(snapshotFileName));
+}
+
+#include "testbootsnapshot.moc"
+QTEST_MAIN(TestBootSnapshot)
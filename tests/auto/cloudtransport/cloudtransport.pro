@@ -0,0 +1,5 @@
+include(../../../nymea.pri)
+include(../autotests.pri)
+
+TARGET = cloudtransport
+SOURCES += testcloudtransport.cpp
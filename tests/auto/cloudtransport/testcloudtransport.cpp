@@ -0,0 +1,188 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "cloud/cloudtransport.h"
+
+#include <QtTest>
+
+using namespace nymeaserver;
+using namespace remoteproxyclient;
+
+// Records the tunnel writes instead of sending them to a proxy server
+class FakeCloudTransport : public CloudTransport
+{
+public:
+    FakeCloudTransport() : CloudTransport(ServerConfiguration()) { }
+
+    QUuid addFakeTunnel(RemoteProxyConnection *proxyConnection) {
+        return addTunnel(proxyConnection, "token", "nonce");
+    }
+
+    QList<QPair<RemoteProxyConnection*, QByteArray>> writes;
+    QList<RemoteProxyConnection*> closedTunnels;
+    QHash<RemoteProxyConnection*, qint64> bytesToWrite;
+
+protected:
+    void writeTunnel(RemoteProxyConnection *proxyConnection, const QByteArray &data) override {
+        writes.append(qMakePair(proxyConnection, data));
+    }
+    void closeTunnel(RemoteProxyConnection *proxyConnection) override {
+        closedTunnels.append(proxyConnection);
+        removeTunnel(proxyConnection);
+    }
+    qint64 tunnelBytesToWrite(RemoteProxyConnection *proxyConnection) const override {
+        return bytesToWrite.value(proxyConnection);
+    }
+};
+
+class TestCloudTransport: public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void sendToClient();
+    void coalesceMessages();
+    void pendingLimit();
+    void pendingLimitWithinCycle();
+};
+
+void TestCloudTransport::sendToClient()
+{
+    FakeCloudTransport transport;
+    RemoteProxyConnection *first = new RemoteProxyConnection(QUuid::createUuid().toString(), "first", &transport);
+    RemoteProxyConnection *second = new RemoteProxyConnection(QUuid::createUuid().toString(), "second", &transport);
+    QUuid firstId = transport.addFakeTunnel(first);
+    QUuid secondId = transport.addFakeTunnel(second);
+
+    // Data goes to the tunnel of the client
+    transport.sendData(secondId, "to second");
+    QTRY_COMPARE(transport.writes.count(), 1);
+    QCOMPARE(transport.writes.first().first, second);
+    QCOMPARE(transport.writes.first().second, QByteArray("to second\n"));
+
+    // Unknown clients are ignored
+    transport.writes.clear();
+    transport.sendData(QUuid::createUuid(), "to nobody");
+    QTest::qWait(10);
+    QCOMPARE(transport.writes.count(), 0);
+
+    // Sending to several clients writes to each of their tunnels
+    transport.sendData(QList<QUuid>() << firstId << secondId << QUuid::createUuid(), "to all");
+    QTRY_COMPARE(transport.writes.count(), 2);
+    QList<RemoteProxyConnection*> written;
+    for (int i = 0; i < transport.writes.count(); i++) {
+        QCOMPARE(transport.writes.at(i).second, QByteArray("to all\n"));
+        written.append(transport.writes.at(i).first);
+    }
+    QVERIFY(written.contains(first));
+    QVERIFY(written.contains(second));
+
+    // A terminated client is gone from the index
+    QSignalSpy disconnectedSpy(&transport, &CloudTransport::clientDisconnected);
+    transport.terminateClientConnection(firstId);
+    QCOMPARE(disconnectedSpy.count(), 1);
+    QCOMPARE(disconnectedSpy.first().first().toUuid(), firstId);
+    transport.writes.clear();
+    transport.sendData(firstId, "to first");
+    QTest::qWait(10);
+    QCOMPARE(transport.writes.count(), 0);
+}
+
+void TestCloudTransport::coalesceMessages()
+{
+    FakeCloudTransport transport;
+    RemoteProxyConnection *proxyConnection = new RemoteProxyConnection(QUuid::createUuid().toString(), "test", &transport);
+    QUuid clientId = transport.addFakeTunnel(proxyConnection);
+
+    // Messages sent within one event loop cycle are written as one tunnel message, each terminated by a newline
+    transport.sendData(clientId, "{\"id\": 1}");
+    transport.sendData(clientId, "{\"id\": 2}");
+    transport.sendData(QList<QUuid>() << clientId, "{\"id\": 3}");
+    QTRY_COMPARE(transport.writes.count(), 1);
+    QCOMPARE(transport.writes.first().second, QByteArray("{\"id\": 1}\n{\"id\": 2}\n{\"id\": 3}\n"));
+
+    // The next cycle starts a new tunnel message, which can't run into the previous one
+    transport.sendData(clientId, "{\"id\": 4}");
+    QTRY_COMPARE(transport.writes.count(), 2);
+    QCOMPARE(transport.writes.last().second, QByteArray("{\"id\": 4}\n"));
+}
+
+void TestCloudTransport::pendingLimit()
+{
+    FakeCloudTransport transport;
+    RemoteProxyConnection *slow = new RemoteProxyConnection(QUuid::createUuid().toString(), "slow", &transport);
+    RemoteProxyConnection *other = new RemoteProxyConnection(QUuid::createUuid().toString(), "other", &transport);
+    QUuid slowId = transport.addFakeTunnel(slow);
+    QUuid otherId = transport.addFakeTunnel(other);
+    QSignalSpy disconnectedSpy(&transport, &CloudTransport::clientDisconnected);
+
+    // Data is written as long as the tunnel sends it
+    QByteArray data(3 * 1024 * 1024, 'x');
+    transport.sendData(slowId, data);
+    QTRY_COMPARE(transport.writes.count(), 1);
+    transport.sendData(slowId, data);
+    QTRY_COMPARE(transport.writes.count(), 2);
+    QCOMPARE(disconnectedSpy.count(), 0);
+
+    // Data still buffered in the tunnel counts towards the limit, even if it was written in an earlier cycle
+    transport.writes.clear();
+    transport.bytesToWrite.insert(slow, data.size());
+    transport.sendData(otherId, "other");
+    transport.sendData(slowId, data);
+    QCOMPARE(transport.closedTunnels, QList<RemoteProxyConnection*>() << slow);
+    QCOMPARE(disconnectedSpy.count(), 1);
+    QCOMPARE(disconnectedSpy.first().first().toUuid(), slowId);
+    transport.sendData(slowId, "more");
+
+    // Other clients are not affected
+    QTRY_COMPARE(transport.writes.count(), 1);
+    QCOMPARE(transport.writes.first().first, other);
+    QCOMPARE(transport.writes.first().second, QByteArray("other\n"));
+}
+
+void TestCloudTransport::pendingLimitWithinCycle()
+{
+    FakeCloudTransport transport;
+    RemoteProxyConnection *proxyConnection = new RemoteProxyConnection(QUuid::createUuid().toString(), "test", &transport);
+    QUuid clientId = transport.addFakeTunnel(proxyConnection);
+    QSignalSpy disconnectedSpy(&transport, &CloudTransport::clientDisconnected);
+
+    // Queueing more than 4 MiB in one cycle disconnects the client and drops its data
+    QByteArray data(3 * 1024 * 1024, 'x');
+    transport.sendData(clientId, data);
+    transport.sendData(clientId, data);
+    QCOMPARE(transport.closedTunnels, QList<RemoteProxyConnection*>() << proxyConnection);
+    QCOMPARE(disconnectedSpy.count(), 1);
+    QTest::qWait(10);
+    QCOMPARE(transport.writes.count(), 0);
+}
+
+#include "testcloudtransport.moc"
+QTEST_MAIN(TestCloudTransport)
@@ -4,8 +4,10 @@ include(../autotests.pri)
 TARGET = coaptests
 
 SOURCES += \
-    coaptests.cpp
+    coaptests.cpp \
+    coaptestserver.cpp
 
 HEADERS += \
-    coaptests.h
+    coaptests.h \
+    coaptestserver.h
 
@@ -55,6 +55,45 @@ CoapTests::CoapTests(QObject *parent) : QObject(parent)
 
 }
 
+bool CoapTests::hostReachable(const QString &host)
+{
+    Coap coap;
+    CoapRequest request(QUrl(QString("coap://%1/").arg(host)));
+    QSignalSpy spy(&coap, SIGNAL(replyFinished(CoapReply*)));
+    CoapReply *reply = coap.ping(request);
+    spy.wait(5000);
+    return reply->isFinished() && reply->error() == CoapReply::NoError;
+}
+
+void CoapTests::initTestCase()
+{
+    // Most tests talk to public CoAP test servers, check once which of them can be reached from here
+    foreach (const QString &host, QStringList() << "coap.me" << "vs0.inf.ethz.ch") {
+        if (hostReachable(host)) {
+            m_reachableHosts.append(host);
+        } else {
+            qWarning() << "CoAP test server" << host << "is not reachable. Tests using it will be skipped.";
+        }
+    }
+}
+
+void CoapTests::init()
+{
+    // These tests only use the local test server or no network at all
+    static const QStringList localTests = QStringList() << "invalidUrl" << "invalidScheme"
+                                                        << "loopbackParallelPeers" << "loopbackOutstandingLimit" << "loopbackThroughput"
+                                                        << "pduView" << "pduWriter" << "benchmarkPduParse" << "benchmarkPduPack";
+    QString testFunction = QTest::currentTestFunction();
+    if (localTests.contains(testFunction)) {
+        return;
+    }
+
+    QString host = testFunction.startsWith("observe") ? "vs0.inf.ethz.ch" : "coap.me";
+    if (!m_reachableHosts.contains(host)) {
+        QSKIP(QString("CoAP test server %1 is not reachable.").arg(host).toUtf8());
+    }
+}
+
 void CoapTests::invalidUrl_data()
 {
     QTest::addColumn<QUrl>("url");
@@ -523,6 +562,96 @@ void CoapTests::multipleCalls()
     qDeleteAll(replies);
 }
 
+void CoapTests::loopbackParallelPeers()
+{
+    // Requests to different peers must not wait for each other
+    CoapTestServer firstServer;
+    CoapTestServer secondServer;
+    firstServer.setResponseDelay(300);
+    secondServer.setResponseDelay(300);
+
+    Coap coap(this, 0);
+    QSignalSpy spy(&coap, SIGNAL(replyFinished(CoapReply*)));
+
+    QElapsedTimer timer;
+    timer.start();
+    CoapReply *firstReply = coap.get(CoapRequest(QUrl(QString("coap://127.0.0.1:%1/first").arg(firstServer.port()))));
+    CoapReply *secondReply = coap.get(CoapRequest(QUrl(QString("coap://127.0.0.1:%1/second").arg(secondServer.port()))));
+
+    QTRY_COMPARE_WITH_TIMEOUT(spy.count(), 2, 5000);
+    QVERIFY2(timer.elapsed() < 600, "Requests to different peers have been serialized.");
+
+    QCOMPARE(firstReply->error(), CoapReply::NoError);
+    QCOMPARE(secondReply->error(), CoapReply::NoError);
+    QCOMPARE(firstReply->payload(), QByteArray("nymea"));
+    QCOMPARE(secondReply->payload(), QByteArray("nymea"));
+
+    firstReply->deleteLater();
+    secondReply->deleteLater();
+}
+
+void CoapTests::loopbackOutstandingLimit()
+{
+    CoapTestServer server;
+    server.setResponseDelay(50);
+
+    Coap coap(this, 0);
+    coap.setMaxOutstandingRequests(3);
+    QSignalSpy spy(&coap, SIGNAL(replyFinished(CoapReply*)));
+
+    QList<CoapReply *> replies;
+    for (int i = 0; i < 10; i++)
+        replies.append(coap.get(CoapRequest(QUrl(QString("coap://127.0.0.1:%1/resource%2").arg(server.port()).arg(i)))));
+
+    QTRY_COMPARE_WITH_TIMEOUT(spy.count(), 10, 5000);
+    QCOMPARE(server.requestCount(), 10);
+    QCOMPARE(server.maxPendingRequests(), 3);
+
+    foreach (CoapReply *reply, replies) {
+        QCOMPARE(reply->error(), CoapReply::NoError);
+        QCOMPARE(reply->statusCode(), CoapPdu::Content);
+        reply->deleteLater();
+    }
+}
+
+void CoapTests::loopbackThroughput_data()
+{
+    QTest::addColumn<int>("maxOutstandingRequests");
+
+    QTest::newRow("NSTART 1") << 1;
+    QTest::newRow("NSTART 4") << 4;
+    QTest::newRow("NSTART 16") << 16;
+}
+
+void CoapTests::loopbackThroughput()
+{
+    QFETCH(int, maxOutstandingRequests);
+
+    const int requestCount = 1000;
+
+    CoapTestServer server;
+    Coap coap(this, 0);
+    coap.setMaxOutstandingRequests(maxOutstandingRequests);
+    QSignalSpy spy(&coap, SIGNAL(replyFinished(CoapReply*)));
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QList<CoapReply *> replies;
+    for (int i = 0; i < requestCount; i++)
+        replies.append(coap.get(CoapRequest(QUrl(QString("coap://127.0.0.1:%1/hello").arg(server.port())))));
+
+    QTRY_COMPARE_WITH_TIMEOUT(spy.count(), requestCount, 30000);
+    qint64 elapsed = qMax<qint64>(1, timer.elapsed());
+    qDebug() << "NSTART" << maxOutstandingRequests << ":" << requestCount << "requests in" << elapsed << "ms ->" << (requestCount * 1000 / elapsed) << "requests/s";
+
+    foreach (CoapReply *reply, replies) {
+        QCOMPARE(reply->error(), CoapReply::NoError);
+        QCOMPARE(reply->payload(), QByteArray("nymea"));
+        reply->deleteLater();
+    }
+}
+
 void CoapTests::coreLinkParser()
 {
     CoapRequest request(QUrl("coap://coap.me/.well-known/core"));
@@ -548,6 +677,171 @@ void CoapTests::coreLinkParser()
     reply->deleteLater();
 }
 
+static QByteArray createNotificationData()
+{
+    CoapPdu pdu;
+    pdu.setMessageType(CoapPdu::Confirmable);
+    pdu.setStatusCode(CoapPdu::Content);
+    pdu.setMessageId(4242);
+    pdu.setToken(QByteArray::fromHex("a1b2c3d4"));
+    pdu.addOption(CoapOption::Observe, QByteArray::fromHex("01e240"));
+    pdu.addOption(CoapOption::ContentFormat, QByteArray(1, (char)CoapPdu::ApplicationJson));
+    pdu.setPayload("{\"3311\":[{\"5850\":1,\"5851\":254,\"5706\":\"f1e0b5\",\"9003\":65537}],\"9001\":\"Living room\",\"9002\":1550000000}");
+    return pdu.pack();
+}
+
+void CoapTests::pduView()
+{
+    QByteArray data = createNotificationData();
+    CoapPdu pdu(data);
+    CoapPduView view(data);
+
+    QVERIFY(pdu.isValid());
+    QVERIFY(view.isValid());
+    QCOMPARE(view.version(), pdu.version());
+    QCOMPARE(view.messageType(), pdu.messageType());
+    QCOMPARE(view.statusCode(), pdu.statusCode());
+    QCOMPARE(view.messageId(), pdu.messageId());
+    QCOMPARE(view.token(), pdu.token());
+    QCOMPARE(view.contentType(), CoapPdu::ApplicationJson);
+    QCOMPARE(view.optionValue(CoapOption::Observe), (quint32)123456);
+    QCOMPARE(view.payload(), pdu.payload());
+    QVERIFY(!view.hasOption(CoapOption::Block2));
+
+    // The view must not copy the datagram
+    QVERIFY(view.payloadData() == data.constData() + data.size() - view.payloadSize());
+
+    int optionCount = 0;
+    CoapPduView::OptionIterator iterator = view.options();
+    while (iterator.hasNext()) {
+        CoapPduView::OptionRef option = iterator.next();
+        QCOMPARE(option.option(), pdu.options().at(optionCount).option());
+        QCOMPARE(option.toByteArray(), pdu.options().at(optionCount).data());
+        optionCount++;
+    }
+    QCOMPARE(optionCount, pdu.options().count());
+
+    // Truncated datagrams must be rejected without reading beyond the buffer
+    QVERIFY(!CoapPduView(data.constData(), 3).isValid());
+    QVERIFY(!CoapPduView(data.constData(), 6).isValid());
+    QVERIFY(!CoapPduView(data.left(9)).isValid());
+    QVERIFY(!CoapPduView(data.left(data.size() - view.payloadSize())).isValid());
+}
+
+void CoapTests::pduWriter()
+{
+    char buffer[1152];
+    CoapPduWriter writer(buffer, sizeof(buffer));
+    writer.writeHeader(CoapPdu::Confirmable, CoapPdu::Get, 1234, QByteArray::fromHex("cafe"));
+    writer.addOption(CoapOption::UriHost, QByteArray("example.com"));
+    writer.addUIntOption(CoapOption::Observe, 0);
+    writer.addOption(CoapOption::UriPath, QByteArray("a-long-path-segment-exceeding-thirteen-bytes"));
+    writer.addOption(CoapOption::UriPath, QByteArray("sub"));
+    writer.addUIntOption(CoapOption::Block2, 2);
+    writer.addOption(CoapOption::Size1, QByteArray(300, 'x'));
+    writer.setPayload(QByteArray("payload"));
+    QVERIFY(writer.isValid());
+
+    CoapPduView view(writer.data(), writer.size());
+    QVERIFY(view.isValid());
+    QCOMPARE(view.messageId(), (quint16)1234);
+    QCOMPARE(view.token(), QByteArray::fromHex("cafe"));
+    QCOMPARE(view.option(CoapOption::UriHost).toByteArray(), QByteArray("example.com"));
+    QVERIFY(view.hasOption(CoapOption::Observe));
+    QCOMPARE(view.option(CoapOption::Observe).length(), 0);
+    QCOMPARE(view.option(CoapOption::UriPath).toByteArray(), QByteArray("a-long-path-segment-exceeding-thirteen-bytes"));
+    QCOMPARE(view.optionValue(CoapOption::Block2), (quint32)2);
+    QCOMPARE(view.option(CoapOption::Size1).length(), 300);
+    QCOMPARE(view.payload(), QByteArray("payload"));
+
+    // Options have to be ordered
+    writer.writeHeader(CoapPdu::Confirmable, CoapPdu::Get, 1);
+    writer.addOption(CoapOption::UriPath, QByteArray("a"));
+    writer.addOption(CoapOption::UriHost, QByteArray("b"));
+    QVERIFY(!writer.isValid());
+
+    // The buffer must not overflow
+    CoapPduWriter smallWriter(buffer, 8);
+    smallWriter.writeHeader(CoapPdu::Confirmable, CoapPdu::Get, 1);
+    smallWriter.setPayload(QByteArray("too large"));
+    QVERIFY(!smallWriter.isValid());
+}
+
+void CoapTests::benchmarkPduParse_data()
+{
+    QTest::addColumn<bool>("inPlace");
+
+    QTest::newRow("CoapPdu") << false;
+    QTest::newRow("CoapPduView") << true;
+}
+
+void CoapTests::benchmarkPduParse()
+{
+    QFETCH(bool, inPlace);
+
+    QByteArray data = createNotificationData();
+    int observe = 0;
+    if (inPlace) {
+        QBENCHMARK {
+            CoapPduView view(data.constData(), data.size());
+            observe = view.optionValue(CoapOption::Observe);
+        }
+    } else {
+        QBENCHMARK {
+            CoapPdu pdu(data);
+            foreach (const CoapOption &option, pdu.options()) {
+                if (option.option() == CoapOption::Observe) {
+                    observe = option.data().toHex().toInt(0, 16);
+                }
+            }
+        }
+    }
+    QCOMPARE(observe, 123456);
+}
+
+void CoapTests::benchmarkPduPack_data()
+{
+    QTest::addColumn<bool>("inPlace");
+
+    QTest::newRow("CoapPdu") << false;
+    QTest::newRow("CoapPduWriter") << true;
+}
+
+void CoapTests::benchmarkPduPack()
+{
+    QFETCH(bool, inPlace);
+
+    QByteArray token = QByteArray::fromHex("a1b2c3d4");
+    QByteArray payload = QByteArray(64, 'x');
+    int size = 0;
+    if (inPlace) {
+        QByteArray buffer(1152, 0);
+        QBENCHMARK {
+            CoapPduWriter writer(buffer.data(), buffer.size());
+            writer.writeHeader(CoapPdu::Confirmable, CoapPdu::Get, 4242, token);
+            writer.addOption(CoapOption::UriPath, QByteArray::fromRawData("15001", 5));
+            writer.addOption(CoapOption::UriPath, QByteArray::fromRawData("65537", 5));
+            writer.addUIntOption(CoapOption::Block2, 2);
+            writer.setPayload(payload);
+            size = writer.size();
+        }
+    } else {
+        QBENCHMARK {
+            CoapPdu pdu;
+            pdu.setMessageType(CoapPdu::Confirmable);
+            pdu.setStatusCode(CoapPdu::Get);
+            pdu.setMessageId(4242);
+            pdu.setToken(token);
+            pdu.addOption(CoapOption::UriPath, "15001");
+            pdu.addOption(CoapOption::UriPath, "65537");
+            pdu.addOption(CoapOption::Block2, CoapPduBlock::createBlock(0));
+            pdu.setPayload(payload);
+            size = pdu.pack().size();
+        }
+    }
+    QVERIFY(size > 0);
+}
+
 void CoapTests::observeResource()
 {
     CoapRequest request(QUrl("coap://vs0.inf.ethz.ch/obs"));
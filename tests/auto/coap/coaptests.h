@@ -31,9 +31,12 @@
 
 #include "coap/coap.h"
 #include "coap/coappdu.h"
+#include "coap/coappduview.h"
 #include "coap/coapreply.h"
 #include "coap/corelinkparser.h"
 
+#include "coaptestserver.h"
+
 class CoapTests : public QObject
 {
     Q_OBJECT
@@ -44,8 +47,14 @@ public:
 private:
     Coap *m_coap;
     QByteArray m_uploadData;
+    QStringList m_reachableHosts;
+
+    bool hostReachable(const QString &host);
 
 private slots:
+    void initTestCase();
+    void init();
+
     void invalidUrl_data();
     void invalidUrl();
 
@@ -78,8 +87,20 @@ private slots:
 
     void multipleCalls();
 
+    void loopbackParallelPeers();
+    void loopbackOutstandingLimit();
+    void loopbackThroughput_data();
+    void loopbackThroughput();
+
     void coreLinkParser();
 
+    void pduView();
+    void pduWriter();
+    void benchmarkPduParse_data();
+    void benchmarkPduParse();
+    void benchmarkPduPack_data();
+    void benchmarkPduPack();
+
     void observeResource();
     void observeLargeResource();
 
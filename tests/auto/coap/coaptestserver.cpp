@@ -0,0 +1,112 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "coaptestserver.h"
+
+#include <QTimer>
+
+CoapTestServer::CoapTestServer(QObject *parent) :
+    QObject(parent)
+{
+    m_socket = new QUdpSocket(this);
+    if (!m_socket->bind(QHostAddress::LocalHost, 0))
+        qWarning() << "Could not bind CoAP test server" << m_socket->errorString();
+
+    connect(m_socket, &QUdpSocket::readyRead, this, &CoapTestServer::onReadyRead);
+}
+
+quint16 CoapTestServer::port() const
+{
+    return m_socket->localPort();
+}
+
+void CoapTestServer::setResponseDelay(int msecs)
+{
+    m_responseDelay = msecs;
+}
+
+int CoapTestServer::requestCount() const
+{
+    return m_requestCount;
+}
+
+int CoapTestServer::maxPendingRequests() const
+{
+    return m_maxPendingRequests;
+}
+
+void CoapTestServer::respond(const CoapPdu &request, const QHostAddress &address, quint16 port)
+{
+    CoapPdu response;
+    response.setMessageType(CoapPdu::Acknowledgement);
+    response.setMessageId(request.messageId());
+
+    if (request.statusCode() == CoapPdu::Empty) {
+        // Ping
+        response.setMessageType(CoapPdu::Reset);
+    } else {
+        response.setToken(request.token());
+        response.setStatusCode(CoapPdu::Content);
+        response.setPayload("nymea");
+    }
+
+    m_socket->writeDatagram(response.pack(), address, port);
+}
+
+void CoapTestServer::onReadyRead()
+{
+    while (m_socket->hasPendingDatagrams()) {
+        QByteArray data;
+        QHostAddress address;
+        quint16 port;
+        data.resize(m_socket->pendingDatagramSize());
+        m_socket->readDatagram(data.data(), data.size(), &address, &port);
+
+        CoapPdu request(data);
+        if (!request.isValid() || request.messageType() != CoapPdu::Confirmable)
+            continue;
+
+        m_requestCount++;
+
+        if (m_responseDelay <= 0) {
+            respond(request, address, port);
+            continue;
+        }
+
+        m_pendingRequests++;
+        m_maxPendingRequests = qMax(m_maxPendingRequests, m_pendingRequests);
+
+        // CoapPdu is a QObject, keep the raw data for the delayed response
+        QTimer::singleShot(m_responseDelay, this, [this, data, address, port]() {
+            m_pendingRequests--;
+            respond(CoapPdu(data), address, port);
+        });
+    }
+}
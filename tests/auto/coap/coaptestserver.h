@@ -0,0 +1,68 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef COAPTESTSERVER_H
+#define COAPTESTSERVER_H
+
+#include <QObject>
+#include <QUdpSocket>
+
+#include "coap/coappdu.h"
+
+// Minimal CoAP server on the loopback interface answering every confirmable request with a piggybacked response
+class CoapTestServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit CoapTestServer(QObject *parent = nullptr);
+
+    quint16 port() const;
+
+    void setResponseDelay(int msecs);
+
+    int requestCount() const;
+    int maxPendingRequests() const;
+
+private:
+    QUdpSocket *m_socket;
+    int m_responseDelay = 0;
+    int m_requestCount = 0;
+    int m_pendingRequests = 0;
+    int m_maxPendingRequests = 0;
+
+    void respond(const CoapPdu &request, const QHostAddress &address, quint16 port);
+
+private slots:
+    void onReadyRead();
+
+};
+
+#endif // COAPTESTSERVER_H
@@ -0,0 +1,213 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "hardware/gpio.h"
+#include "hardware/gpiomonitor.h"
+
+#include <QtTest>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+
+class TestGpio : public QObject
+{
+    Q_OBJECT
+
+private:
+    QTemporaryDir m_sysfs;
+
+    void createGpio(int number, const QString &direction);
+    void writeSysfsFile(const QString &fileName, const QByteArray &data);
+    QByteArray readSysfsFile(const QString &fileName);
+
+private slots:
+    void init();
+    void cleanup();
+
+    void valueReadWrite();
+    void batchedValues();
+    void invalidBatch();
+    void monitorValueChanges();
+    void manyMonitors();
+};
+
+void TestGpio::createGpio(int number, const QString &direction)
+{
+    // Fake sysfs tree: the GPIO is already exported
+    QDir(m_sysfs.path()).mkpath(QString("gpio%1").arg(number));
+    writeSysfsFile(QString("gpio%1/direction").arg(number), direction.toUtf8() + "\n");
+    writeSysfsFile(QString("gpio%1/value").arg(number), "0\n");
+    writeSysfsFile(QString("gpio%1/edge").arg(number), "none\n");
+    writeSysfsFile(QString("gpio%1/active_low").arg(number), "0\n");
+}
+
+void TestGpio::writeSysfsFile(const QString &fileName, const QByteArray &data)
+{
+    QFile file(m_sysfs.path() + "/" + fileName);
+    QVERIFY(file.open(QFile::WriteOnly | QFile::Truncate));
+    file.write(data);
+}
+
+QByteArray TestGpio::readSysfsFile(const QString &fileName)
+{
+    QFile file(m_sysfs.path() + "/" + fileName);
+    if (!file.open(QFile::ReadOnly))
+        return QByteArray();
+
+    return file.readAll();
+}
+
+void TestGpio::init()
+{
+    QVERIFY(m_sysfs.isValid());
+    writeSysfsFile("export", "");
+    writeSysfsFile("unexport", "");
+    Gpio::setSysfsDirectory(m_sysfs.path());
+    QVERIFY(Gpio::isAvailable());
+}
+
+void TestGpio::cleanup()
+{
+    Gpio::setSysfsDirectory("/sys/class/gpio");
+}
+
+void TestGpio::valueReadWrite()
+{
+    createGpio(18, "out");
+
+    Gpio gpio(18);
+    QVERIFY(gpio.exportGpio());
+    QCOMPARE(gpio.direction(), Gpio::DirectionOutput);
+    QCOMPARE(gpio.value(), Gpio::ValueLow);
+
+    QVERIFY(gpio.setValue(Gpio::ValueHigh));
+    QCOMPARE(readSysfsFile("gpio18/value").left(1), QByteArray("1"));
+    QCOMPARE(gpio.value(), Gpio::ValueHigh);
+
+    // The value file stays open, external changes must still be visible
+    writeSysfsFile("gpio18/value", "0\n");
+    QCOMPARE(gpio.value(), Gpio::ValueLow);
+
+    QVERIFY(!gpio.setValue(Gpio::ValueInvalid));
+}
+
+void TestGpio::batchedValues()
+{
+    QHash<Gpio *, Gpio::Value> values;
+    QList<Gpio *> gpios;
+    for (int i = 0; i < 8; i++) {
+        createGpio(20 + i, "out");
+        Gpio *gpio = new Gpio(20 + i, this);
+        gpios.append(gpio);
+        values.insert(gpio, i % 2 == 0 ? Gpio::ValueHigh : Gpio::ValueLow);
+    }
+
+    QVERIFY(Gpio::setValues(values));
+    for (int i = 0; i < 8; i++) {
+        QCOMPARE(readSysfsFile(QString("gpio%1/value").arg(20 + i)).left(1), QByteArray(i % 2 == 0 ? "1" : "0"));
+        QCOMPARE(gpios.at(i)->value(), values.value(gpios.at(i)));
+    }
+
+    qDeleteAll(gpios);
+}
+
+void TestGpio::invalidBatch()
+{
+    createGpio(30, "out");
+    createGpio(31, "in");
+
+    Gpio output(30);
+    Gpio input(31);
+
+    // Nothing gets written if one of the GPIOs can't be set
+    QHash<Gpio *, Gpio::Value> values;
+    values.insert(&output, Gpio::ValueHigh);
+    values.insert(&input, Gpio::ValueHigh);
+    QVERIFY(!Gpio::setValues(values));
+    QCOMPARE(readSysfsFile("gpio30/value").left(1), QByteArray("0"));
+    QCOMPARE(readSysfsFile("gpio31/value").left(1), QByteArray("0"));
+}
+
+void TestGpio::monitorValueChanges()
+{
+    createGpio(17, "in");
+
+    GpioMonitor monitor(17);
+    QCOMPARE(monitor.backend(), GpioMonitor::BackendSysfs);
+    QVERIFY(monitor.enable(false, Gpio::EdgeBoth));
+    QVERIFY(monitor.isRunning());
+    QCOMPARE(monitor.value(), false);
+    QCOMPARE(readSysfsFile("gpio17/edge"), QByteArray("both"));
+
+    QSignalSpy spy(&monitor, &GpioMonitor::valueChanged);
+    writeSysfsFile("gpio17/value", "1\n");
+    QTRY_COMPARE(spy.count(), 1);
+    QCOMPARE(spy.at(0).at(0).toBool(), true);
+    QCOMPARE(monitor.value(), true);
+
+    writeSysfsFile("gpio17/value", "0\n");
+    QTRY_COMPARE(spy.count(), 2);
+    QCOMPARE(spy.at(1).at(0).toBool(), false);
+
+    // No events after disabling
+    monitor.disable();
+    QVERIFY(!monitor.isRunning());
+    writeSysfsFile("gpio17/value", "1\n");
+    QTest::qWait(200);
+    QCOMPARE(spy.count(), 2);
+}
+
+void TestGpio::manyMonitors()
+{
+    QList<GpioMonitor *> monitors;
+    QList<QSignalSpy *> spies;
+    for (int i = 0; i < 32; i++) {
+        createGpio(100 + i, "in");
+        GpioMonitor *monitor = new GpioMonitor(100 + i, this);
+        QVERIFY(monitor->enable());
+        monitors.append(monitor);
+        spies.append(new QSignalSpy(monitor, &GpioMonitor::valueChanged));
+    }
+
+    // Toggle every second input, only those must report a change
+    for (int i = 0; i < 32; i += 2)
+        writeSysfsFile(QString("gpio%1/value").arg(100 + i), "1\n");
+
+    for (int i = 0; i < 32; i += 2)
+        QTRY_COMPARE(spies.at(i)->count(), 1);
+
+    for (int i = 1; i < 32; i += 2)
+        QCOMPARE(spies.at(i)->count(), 0);
+
+    qDeleteAll(spies);
+    qDeleteAll(monitors);
+}
+
+#include "testgpio.moc"
+QTEST_MAIN(TestGpio)
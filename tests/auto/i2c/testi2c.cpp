@@ -0,0 +1,240 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "hardware/i2c/i2cdevice.h"
+#include "hardware/i2c/i2cbusworker.h"
+
+#include <QtTest>
+#include <QSignalSpy>
+#include <QElapsedTimer>
+
+using namespace nymeaserver;
+
+// Simulates a device with the given bus delay per transfer
+class FakeI2CDevice : public I2CDevice
+{
+    Q_OBJECT
+public:
+    FakeI2CDevice(const QString &portName, int address, int delay, QObject *parent = nullptr) :
+        I2CDevice(portName, address, parent),
+        m_delay(delay)
+    {
+    }
+
+    QByteArray readData(int fileDescriptor) override
+    {
+        Q_UNUSED(fileDescriptor)
+        QThread::msleep(m_delay);
+        log("read");
+        return QByteArray("data");
+    }
+
+    bool writeData(int fileDescriptor, const QByteArray &data) override
+    {
+        Q_UNUSED(fileDescriptor)
+        QThread::msleep(m_delay);
+        log("write " + data);
+        return true;
+    }
+
+    QStringList transfers() const
+    {
+        QMutexLocker locker(&m_mutex);
+        return m_transfers;
+    }
+
+private:
+    int m_delay;
+    mutable QMutex m_mutex;
+    QStringList m_transfers;
+
+    void log(const QString &transfer)
+    {
+        QMutexLocker locker(&m_mutex);
+        m_transfers.append(transfer);
+    }
+};
+
+// Worker without a real I2C adapter
+class FakeI2CBusWorker : public I2CBusWorker
+{
+    Q_OBJECT
+public:
+    FakeI2CBusWorker(const QString &portName) : I2CBusWorker(portName, -1) { }
+    ~FakeI2CBusWorker() override { stop(); }
+
+protected:
+    bool selectAddress(int address) override
+    {
+        Q_UNUSED(address)
+        return true;
+    }
+};
+
+class TestI2C : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void deadlineOrdering();
+    void writesBeforeReads();
+    void independentBuses();
+    void statistics();
+    void removeDeviceWhileReading();
+};
+
+void TestI2C::deadlineOrdering()
+{
+    FakeI2CBusWorker worker("i2c-1");
+    FakeI2CDevice fastDevice("i2c-1", 0x40, 2);
+    FakeI2CDevice slowDevice("i2c-1", 0x41, 2);
+    worker.start();
+
+    QSignalSpy fastSpy(&fastDevice, &I2CDevice::readingAvailable);
+    QSignalSpy slowSpy(&slowDevice, &I2CDevice::readingAvailable);
+    worker.addReader(&fastDevice, 50);
+    worker.addReader(&slowDevice, 250);
+
+    QTest::qWait(1000);
+    worker.removeReader(&fastDevice);
+    worker.removeReader(&slowDevice);
+
+    // Both devices are read immediately and then at their own interval
+    qDebug() << "Fast device:" << fastSpy.count() << "readings, slow device:" << slowSpy.count() << "readings";
+    QVERIFY(fastSpy.count() >= 15 && fastSpy.count() <= 22);
+    QVERIFY(slowSpy.count() >= 3 && slowSpy.count() <= 6);
+    QCOMPARE(fastSpy.first().first().toByteArray(), QByteArray("data"));
+}
+
+void TestI2C::writesBeforeReads()
+{
+    FakeI2CBusWorker worker("i2c-1");
+    FakeI2CDevice device("i2c-1", 0x40, 30);
+    FakeI2CDevice otherDevice("i2c-1", 0x41, 30);
+    worker.start();
+
+    QSignalSpy writeSpy(&device, &I2CDevice::dataWritten);
+    worker.addReader(&device, 1);
+    worker.addReader(&otherDevice, 1);
+    QTest::qWait(10);
+
+    worker.enqueueWrite(&device, "1");
+    worker.enqueueWrite(&device, "2");
+    worker.enqueueWrite(&device, "3");
+    QTRY_COMPARE(writeSpy.count(), 3);
+    worker.removeDevice(&device);
+    worker.removeDevice(&otherDevice);
+
+    // At most the running reading finishes before the queued writes are flushed in order
+    QStringList transfers = device.transfers();
+    int firstWrite = transfers.indexOf("write 1");
+    QVERIFY(firstWrite >= 0);
+    QCOMPARE(transfers.mid(firstWrite, 3), QStringList() << "write 1" << "write 2" << "write 3");
+
+    foreach (const QVariantList &arguments, writeSpy) {
+        QCOMPARE(arguments.first().toBool(), true);
+    }
+}
+
+void TestI2C::independentBuses()
+{
+    // A slow sensor on one bus must not delay a fast one on another bus
+    FakeI2CBusWorker slowBus("i2c-1");
+    FakeI2CBusWorker fastBus("i2c-3");
+    FakeI2CDevice slowDevice("i2c-1", 0x40, 300);
+    FakeI2CDevice fastDevice("i2c-3", 0x40, 1);
+    slowBus.start();
+    fastBus.start();
+
+    QSignalSpy fastSpy(&fastDevice, &I2CDevice::readingAvailable);
+    slowBus.addReader(&slowDevice, 50);
+    fastBus.addReader(&fastDevice, 20);
+
+    QTest::qWait(1000);
+    I2CDeviceStatistics statistics = fastBus.statistics(&fastDevice);
+    slowBus.removeDevice(&slowDevice);
+    fastBus.removeDevice(&fastDevice);
+
+    qDebug() << "Fast device readings:" << statistics.readCount << "max jitter:" << statistics.maxJitter << "us";
+    QVERIFY(statistics.readCount >= 35);
+    QVERIFY(fastSpy.count() >= 35);
+    QVERIFY(statistics.maxJitter < 50000);
+}
+
+void TestI2C::statistics()
+{
+    FakeI2CBusWorker worker("i2c-1");
+    FakeI2CDevice device("i2c-1", 0x40, 20);
+    worker.start();
+
+    worker.addReader(&device, 100);
+    QTest::qWait(450);
+    worker.enqueueWrite(&device, "x");
+    QTRY_VERIFY(worker.statistics(&device).writeCount == 1);
+    worker.removeReader(&device);
+
+    I2CDeviceStatistics statistics = worker.statistics(&device);
+    qDebug() << "Readings:" << statistics.readCount << "average latency:" << statistics.averageReadLatency() << "us"
+             << "average jitter:" << statistics.averageJitter() << "us"
+             << "write latency:" << statistics.averageWriteLatency() << "us";
+
+    QVERIFY(statistics.readCount >= 4);
+    QCOMPARE(statistics.failedCount, 0);
+    QVERIFY(statistics.averageReadLatency() >= 20000);
+    QVERIFY(statistics.maxReadLatency >= statistics.averageReadLatency());
+    QVERIFY(statistics.maxJitter >= 0);
+    QVERIFY(statistics.averageWriteLatency() >= 20000);
+
+    worker.removeDevice(&device);
+    QCOMPARE(worker.statistics(&device).readCount, 0);
+}
+
+void TestI2C::removeDeviceWhileReading()
+{
+    FakeI2CBusWorker worker("i2c-1");
+    FakeI2CDevice *device = new FakeI2CDevice("i2c-1", 0x40, 200);
+    worker.start();
+
+    worker.addReader(device, 1000);
+    QTest::qWait(50);
+
+    // Must block until the running reading is done, afterwards the device can be deleted safely
+    QElapsedTimer timer;
+    timer.start();
+    worker.removeDevice(device);
+    QVERIFY(timer.elapsed() >= 100);
+    QCOMPARE(device->transfers().count(), 1);
+    delete device;
+
+    QTest::qWait(100);
+}
+
+#include "testi2c.moc"
+QTEST_MAIN(TestI2C)
@@ -152,6 +152,7 @@ private slots:
     void removeAutoThing();
 
     void discoverThingsParenting();
+    void discoverThingsShared();
 };
 
 void TestIntegrations::initTestCase()
@@ -1823,6 +1824,45 @@ void TestIntegrations::discoverThingsParenting()
 
 }
 
+void TestIntegrations::discoverThingsShared()
+{
+    ParamList discoveryParams;
+    discoveryParams.append(Param(mockDiscoveryResultCountParamTypeId, 2));
+
+    // Concurrent discoveries with the same params share one plugin discovery
+    ThingDiscoveryInfo *firstInfo = NymeaCore::instance()->thingManager()->discoverThings(mockThingClassId, discoveryParams);
+    ThingDiscoveryInfo *secondInfo = NymeaCore::instance()->thingManager()->discoverThings(mockThingClassId, discoveryParams);
+    QSignalSpy firstSpy(firstInfo, &ThingDiscoveryInfo::finished);
+    QSignalSpy secondSpy(secondInfo, &ThingDiscoveryInfo::finished);
+    QVERIFY(firstSpy.count() > 0 || firstSpy.wait());
+    QVERIFY(secondSpy.count() > 0 || secondSpy.wait());
+
+    QCOMPARE(firstInfo->status(), Thing::ThingErrorNoError);
+    QCOMPARE(secondInfo->status(), Thing::ThingErrorNoError);
+    QCOMPARE(firstInfo->thingDescriptors().count(), 2);
+
+    QList<ThingDescriptorId> descriptorIds;
+    foreach (const ThingDescriptor &descriptor, firstInfo->thingDescriptors())
+        descriptorIds.append(descriptor.id());
+
+    QList<ThingDescriptorId> sharedDescriptorIds;
+    foreach (const ThingDescriptor &descriptor, secondInfo->thingDescriptors())
+        sharedDescriptorIds.append(descriptor.id());
+
+    QCOMPARE(sharedDescriptorIds, descriptorIds);
+
+    // A discovery right after that is served from the cache
+    ThingDiscoveryInfo *cachedInfo = NymeaCore::instance()->thingManager()->discoverThings(mockThingClassId, discoveryParams);
+    QVERIFY(cachedInfo->isFinished());
+    QCOMPARE(cachedInfo->status(), Thing::ThingErrorNoError);
+
+    QList<ThingDescriptorId> cachedDescriptorIds;
+    foreach (const ThingDescriptor &descriptor, cachedInfo->thingDescriptors())
+        cachedDescriptorIds.append(descriptor.id());
+
+    QCOMPARE(cachedDescriptorIds, descriptorIds);
+}
+
 void TestIntegrations::testExecuteBrowserItem_data()
 {
     QTest::addColumn<ThingId>("thingId");
@@ -31,6 +31,7 @@
 #include "nymeatestbase.h"
 #include "../../utils/pushbuttonagent.h"
 #include "nymeacore.h"
+#include "performancemonitor.h"
 #include "version.h"
 #include "servers/mocktcpserver.h"
 #include "usermanager/usermanager.h"
@@ -78,6 +79,8 @@ private slots:
 
     void pluginConfigChangeEmitsNotification();
 
+    void performanceStats();
+
     /*
     Cases for push button auth:
 
@@ -1042,6 +1045,50 @@ void TestJSONRPC::pluginConfigChangeEmitsNotification()
     QCOMPARE(notificationData.first().toMap().value("notification").toString() == "Integrations.PluginConfigurationChanged", true);
 }
 
+void TestJSONRPC::performanceStats()
+{
+    PerformanceMonitor *performanceMonitor = NymeaCore::instance()->performanceMonitor();
+
+    // Disabled by default, nothing gets recorded
+    QVariantMap response = injectAndWait("System.GetPerformanceStats").toMap();
+    QCOMPARE(response.value("params").toMap().value("enabled").toBool(), false);
+    QCOMPARE(response.value("params").toMap().value("entries").toList().count(), 0);
+
+    performanceMonitor->setEnabled(true);
+    injectAndWait("Integrations.GetThings");
+    injectAndWait("Integrations.GetThings");
+
+    QVariantMap params;
+    params.insert("reset", true);
+    response = injectAndWait("System.GetPerformanceStats", params).toMap();
+    QCOMPARE(response.value("params").toMap().value("enabled").toBool(), true);
+    int bucketCount = response.value("params").toMap().value("histogramBounds").toList().count() + 1;
+
+    QVariantMap getThingsEntry;
+    foreach (const QVariant &entry, response.value("params").toMap().value("entries").toList()) {
+        if (entry.toMap().value("category").toString() == "PerformanceCategoryJsonRpc" && entry.toMap().value("name").toString() == "Integrations.GetThings") {
+            getThingsEntry = entry.toMap();
+        }
+    }
+    QCOMPARE(getThingsEntry.value("samples").toInt(), 2);
+    QCOMPARE(getThingsEntry.value("histogram").toList().count(), bucketCount);
+    int histogramSamples = 0;
+    foreach (const QVariant &count, getThingsEntry.value("histogram").toList()) {
+        histogramSamples += count.toInt();
+    }
+    QCOMPARE(histogramSamples, 2);
+    QVERIFY(getThingsEntry.value("maxTime").toDouble() <= getThingsEntry.value("totalTime").toDouble());
+
+    // The previous call has reset the statistics
+    response = injectAndWait("System.GetPerformanceStats").toMap();
+    foreach (const QVariant &entry, response.value("params").toMap().value("entries").toList()) {
+        QVERIFY2(entry.toMap().value("name").toString() != "Integrations.GetThings", "Statistics have not been reset");
+    }
+
+    performanceMonitor->setEnabled(false);
+    performanceMonitor->reset();
+}
+
 void TestJSONRPC::testPushButtonAuth()
 {
     PushButtonAgent pushButtonAgent;
@@ -0,0 +1,255 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "loggingcategories.h"
+
+#include <QtTest>
+#include <QThread>
+#include <QSemaphore>
+#include <QTemporaryDir>
+
+#include <atomic>
+
+Q_LOGGING_CATEGORY(dcLogWriterTest, "LogWriterTest")
+
+// Messages passed to the installed nymea message handler
+static QMutex s_handledMutex;
+static QStringList s_handledMessages;
+
+// Lets the handler block the writer thread while a "block" message is handled
+static std::atomic<bool> s_blocking(false);
+static QSemaphore s_handlerBlocked;
+static QSemaphore s_handlerReleased;
+
+static void testMessageHandler(QtMsgType type, const QMessageLogContext &context, const QString &message)
+{
+    Q_UNUSED(type)
+    if (QByteArray(context.category) != "LogWriterTest")
+        return;
+
+    if (s_blocking && message == "block") {
+        s_handlerBlocked.release();
+        s_handlerReleased.acquire();
+    }
+
+    QMutexLocker locker(&s_handledMutex);
+    s_handledMessages.append(message);
+}
+
+class LogThread : public QThread
+{
+public:
+    LogThread(int id, int count): m_id(id), m_count(count) { }
+
+protected:
+    void run() override
+    {
+        for (int i = 0; i < m_count; i++) {
+            qCDebug(dcLogWriterTest()) << QString("thread %1 message %2").arg(m_id).arg(i);
+        }
+    }
+
+private:
+    int m_id;
+    int m_count;
+};
+
+class TestLogWriter: public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void init();
+
+    void handlersCalledAsynchronously();
+    void handlersCalledSynchronously();
+    void orderWithinThreads();
+    void droppedMessagesCounted();
+    void logFileRotated();
+
+private:
+    QStringList handledMessages();
+    QStringList logLines(const QString &fileName);
+
+    QTemporaryDir m_dir;
+    QtMessageHandler m_previousHandler = nullptr;
+};
+
+void TestLogWriter::initTestCase()
+{
+    QVERIFY(m_dir.isValid());
+    QLoggingCategory::setFilterRules("*.debug=false\nLogWriterTest.debug=true");
+    nymeaInstallMessageHandler(testMessageHandler);
+
+    // initLogging() replaces the message handler of the test framework
+    m_previousHandler = qInstallMessageHandler(nullptr);
+    qInstallMessageHandler(m_previousHandler);
+}
+
+void TestLogWriter::cleanupTestCase()
+{
+    closeLogFile();
+    nymeaUninstallMessageHandler(testMessageHandler);
+    qInstallMessageHandler(m_previousHandler);
+}
+
+void TestLogWriter::init()
+{
+    closeLogFile();
+    setLogFileRotation(0, 5);
+    QMutexLocker locker(&s_handledMutex);
+    s_handledMessages.clear();
+}
+
+void TestLogWriter::handlersCalledAsynchronously()
+{
+    QVERIFY(initLogging(m_dir.filePath("async.log"), false));
+
+    qCDebug(dcLogWriterTest()) << "async";
+    QTRY_COMPARE(handledMessages(), QStringList() << "async");
+}
+
+void TestLogWriter::handlersCalledSynchronously()
+{
+    // Without a running writer, messages are written and handled right away
+    QVERIFY(initLogging(m_dir.filePath("sync.log"), false));
+    closeLogFile();
+
+    qCDebug(dcLogWriterTest()) << "sync";
+    QCOMPARE(handledMessages(), QStringList() << "sync");
+}
+
+void TestLogWriter::orderWithinThreads()
+{
+    QString fileName = m_dir.filePath("order.log");
+    QVERIFY(initLogging(fileName, false));
+
+    // Each thread stays below the ring buffer capacity, nothing may be dropped
+    quint64 droppedBefore = droppedLogMessages();
+    QList<LogThread*> threads;
+    for (int i = 0; i < 4; i++) {
+        threads.append(new LogThread(i, 500));
+    }
+    foreach (LogThread *thread, threads) {
+        thread->start();
+    }
+    foreach (LogThread *thread, threads) {
+        QVERIFY(thread->wait(10000));
+        delete thread;
+    }
+    closeLogFile();
+    QCOMPARE(droppedLogMessages(), droppedBefore);
+
+    QList<int> nextMessage = QList<int>() << 0 << 0 << 0 << 0;
+    foreach (const QString &line, logLines(fileName)) {
+        QRegExp exp("thread (\\d) message (\\d+)");
+        if (exp.indexIn(line) < 0)
+            continue;
+
+        int thread = exp.cap(1).toInt();
+        QCOMPARE(exp.cap(2).toInt(), nextMessage.at(thread));
+        nextMessage[thread]++;
+    }
+    QCOMPARE(nextMessage, QList<int>() << 500 << 500 << 500 << 500);
+}
+
+void TestLogWriter::droppedMessagesCounted()
+{
+    QString fileName = m_dir.filePath("drops.log");
+    QVERIFY(initLogging(fileName, false));
+
+    // Block the writer thread in the handler, the ring buffer of this thread fills up
+    s_blocking = true;
+    qCDebug(dcLogWriterTest()) << "block";
+    QVERIFY(s_handlerBlocked.tryAcquire(1, 5000));
+
+    quint64 droppedBefore = droppedLogMessages();
+    for (int i = 0; i < 3000; i++) {
+        qCDebug(dcLogWriterTest()) << "flood" << i;
+    }
+    quint64 dropped = droppedLogMessages() - droppedBefore;
+    QVERIFY2(dropped >= 3000 - 1024, QString("Only %1 messages dropped").arg(dropped).toUtf8());
+
+    s_blocking = false;
+    s_handlerReleased.release();
+    closeLogFile();
+
+    QCOMPARE(handledMessages().count(), 1 + 3000 - static_cast<int>(dropped));
+    bool reported = false;
+    foreach (const QString &line, logLines(fileName)) {
+        if (line.contains(QString("Dropped %1 log messages").arg(dropped))) {
+            reported = true;
+        }
+    }
+    QVERIFY2(reported, "The dropped messages have not been reported in the log");
+}
+
+void TestLogWriter::logFileRotated()
+{
+    QString fileName = m_dir.filePath("rotation.log");
+    setLogFileRotation(4096, 2);
+    QVERIFY(initLogging(fileName, false));
+
+    QString payload(100, 'x');
+    for (int i = 0; i < 300; i++) {
+        qCDebug(dcLogWriterTest()) << i << payload;
+        // Spread the messages over several batches
+        if (i % 50 == 0) {
+            QTest::qWait(10);
+        }
+    }
+    closeLogFile();
+
+    QVERIFY(QFile::exists(fileName));
+    QVERIFY(QFile::exists(fileName + ".1"));
+    QVERIFY(QFile::exists(fileName + ".2"));
+    QVERIFY2(!QFile::exists(fileName + ".3"), "More log files than configured have been kept");
+    QVERIFY(QFileInfo(fileName + ".1").size() >= 4096);
+}
+
+QStringList TestLogWriter::handledMessages()
+{
+    QMutexLocker locker(&s_handledMutex);
+    return s_handledMessages;
+}
+
+QStringList TestLogWriter::logLines(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QFile::ReadOnly))
+        return QStringList();
+
+    return QString::fromUtf8(file.readAll()).split('\n', QString::SkipEmptyParts);
+}
+
+#include "testlogwriter.moc"
+QTEST_MAIN(TestLogWriter)
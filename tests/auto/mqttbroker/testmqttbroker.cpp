@@ -32,6 +32,7 @@
 #include "nymeacore.h"
 #include "servers/mqttbroker.h"
 #include "servers/mocktcpserver.h"
+#include "hardware/network/mqtt/mqttproviderimplementation.h"
 
 #include "nymea-mqtt/mqttclient.h"
 
@@ -57,6 +58,16 @@ private slots:
 
     void testSubscribePolicy_data();
     void testSubscribePolicy();
+
+    void testRetainedReplay();
+    void testSharedFilterReplay();
+    void testPresence();
+
+    void benchmarkPublish();
+
+private:
+    MqttClient *connectClient(const QString &clientId, const QString &username, const QString &password);
+    MqttClient *connectPublisher();
 };
 
 void TestMqttBroker::initTestCase()
@@ -448,6 +459,219 @@ void TestMqttBroker::testSubscribePolicy()
     QCOMPARE(clientSubscribedSpy.count(), (allowed ? 1 : 0));
 }
 
+void TestMqttBroker::testRetainedReplay()
+{
+    MqttBroker *broker = NymeaCore::instance()->serverManager()->mqttBroker();
+    MqttProviderImplementation provider(broker);
+
+    QSignalSpy publishReceivedSpy(broker, &MqttBroker::publishReceived);
+    MqttClient *publisher = connectPublisher();
+    QVERIFY(publisher);
+    publisher->publish("retaintest/status", "on", Mqtt::QoS0, true);
+    publisher->publish("retaintest/live", "live");
+    QTRY_COMPARE(publishReceivedSpy.count(), 2);
+
+    // Only the retained message is replayed
+    MqttChannel *channel = provider.createChannel("retaintest-device", QHostAddress::LocalHost, {"retaintest"});
+    QVERIFY(channel);
+    QHash<QString, QByteArray> received;
+    int receivedCount = 0;
+    connect(channel, &MqttChannel::publishReceived, this, [&received, &receivedCount](MqttChannel*, const QString &topic, const QByteArray &payload){
+        received.insert(topic, payload);
+        receivedCount++;
+    });
+    QTRY_COMPARE(receivedCount, 1);
+    QCOMPARE(received.value("retaintest/status"), QByteArray("on"));
+
+    // A plain publish reaches the channel, but doesn't replace the retained message
+    publisher->publish("retaintest/status", "off");
+    QTRY_COMPARE(receivedCount, 2);
+    QCOMPARE(received.value("retaintest/status"), QByteArray("off"));
+
+    // A new retained topic
+    publisher->publish("retaintest/new", "1", Mqtt::QoS0, true);
+    QTRY_COMPARE(receivedCount, 3);
+    provider.releaseChannel(channel);
+
+    // A new channel gets what the broker holds
+    channel = provider.createChannel("retaintest-device", QHostAddress::LocalHost, {"retaintest"});
+    QVERIFY(channel);
+    received.clear();
+    receivedCount = 0;
+    connect(channel, &MqttChannel::publishReceived, this, [&received, &receivedCount](MqttChannel*, const QString &topic, const QByteArray &payload){
+        received.insert(topic, payload);
+        receivedCount++;
+    });
+    QTRY_COMPARE(receivedCount, 2);
+    QTest::qWait(200);
+    QCOMPARE(receivedCount, 2);
+    QCOMPARE(received.value("retaintest/status"), QByteArray("on"));
+    QCOMPARE(received.value("retaintest/new"), QByteArray("1"));
+    provider.releaseChannel(channel);
+
+    // Clear the retained messages
+    publisher->publish("retaintest/status", QByteArray(), Mqtt::QoS0, true);
+    publisher->publish("retaintest/new", QByteArray(), Mqtt::QoS0, true);
+    QTRY_COMPARE(publishReceivedSpy.count(), 6);
+    delete publisher;
+}
+
+void TestMqttBroker::testSharedFilterReplay()
+{
+    MqttBroker *broker = NymeaCore::instance()->serverManager()->mqttBroker();
+    MqttProviderImplementation provider(broker);
+
+    QSignalSpy publishReceivedSpy(broker, &MqttBroker::publishReceived);
+    MqttClient *publisher = connectPublisher();
+    QVERIFY(publisher);
+    publisher->publish("shared/state", "1", Mqtt::QoS0, true);
+    QTRY_COMPARE(publishReceivedSpy.count(), 1);
+
+    MqttChannel *firstChannel = provider.createChannel("shared-device-1", QHostAddress::LocalHost, {"shared"});
+    QVERIFY(firstChannel);
+    int firstCount = 0;
+    connect(firstChannel, &MqttChannel::publishReceived, this, [&firstCount](MqttChannel*, const QString &topic, const QByteArray &payload){
+        QCOMPARE(topic, QString("shared/state"));
+        QCOMPARE(payload, QByteArray("1"));
+        firstCount++;
+    });
+    QTRY_COMPARE(firstCount, 1);
+
+    // A second channel with the same prefix gets the retained message, the first one doesn't get it again
+    MqttChannel *secondChannel = provider.createChannel("shared-device-2", QHostAddress::LocalHost, {"shared"});
+    QVERIFY(secondChannel);
+    int secondCount = 0;
+    connect(secondChannel, &MqttChannel::publishReceived, this, [&secondCount](MqttChannel*, const QString &topic, const QByteArray &payload){
+        QCOMPARE(topic, QString("shared/state"));
+        QCOMPARE(payload, QByteArray("1"));
+        secondCount++;
+    });
+    QTRY_COMPARE(secondCount, 1);
+    QTest::qWait(200);
+    QCOMPARE(firstCount, 1);
+    QCOMPARE(secondCount, 1);
+
+    provider.releaseChannel(firstChannel);
+    provider.releaseChannel(secondChannel);
+    publisher->publish("shared/state", QByteArray(), Mqtt::QoS0, true);
+    QTRY_COMPARE(publishReceivedSpy.count(), 2);
+    delete publisher;
+}
+
+void TestMqttBroker::testPresence()
+{
+    MqttBroker *broker = NymeaCore::instance()->serverManager()->mqttBroker();
+    MqttProviderImplementation provider(broker);
+
+    MqttChannel *channel = provider.createChannel("presence-device", QHostAddress::LocalHost, {"presence"});
+    QVERIFY(channel);
+    QVERIFY(!channel->isOnline());
+
+    // Without availability messages, the channel follows the connection of the device
+    MqttClient *device = connectClient(channel->clientId(), channel->username(), channel->password());
+    QVERIFY(device);
+    QTRY_VERIFY(channel->isOnline());
+
+    // Availability messages take over once the device sends them
+    device->publish("presence/LWT", "Offline", Mqtt::QoS0, true);
+    QTRY_VERIFY(!channel->isOnline());
+    device->publish("presence/LWT", "Online", Mqtt::QoS0, true);
+    QTRY_VERIFY(channel->isOnline());
+
+    // Another channel for the same prefix takes the presence from the retained availability message
+    MqttChannel *secondChannel = provider.createChannel("presence-device-2", QHostAddress::LocalHost, {"presence"});
+    QVERIFY(secondChannel);
+    QVERIFY(!secondChannel->isOnline());
+    QTRY_VERIFY(secondChannel->isOnline());
+
+    // Clear the retained message. Releasing the channel removes the policy and disconnects the device.
+    QSignalSpy publishReceivedSpy(broker, &MqttBroker::publishReceived);
+    device->publish("presence/LWT", QByteArray(), Mqtt::QoS0, true);
+    QTRY_COMPARE(publishReceivedSpy.count(), 1);
+    QSignalSpy disconnectedSpy(device, &MqttClient::disconnected);
+    provider.releaseChannel(channel);
+    QTRY_COMPARE(disconnectedSpy.count(), 1);
+    provider.releaseChannel(secondChannel);
+    delete device;
+}
+
+MqttClient *TestMqttBroker::connectClient(const QString &clientId, const QString &username, const QString &password)
+{
+    MqttClient* mqttClient = new MqttClient(clientId, this);
+    mqttClient->setUsername(username);
+    mqttClient->setPassword(password);
+    mqttClient->setAutoReconnect(false);
+    QSignalSpy connectedSpy(mqttClient, &MqttClient::connected);
+    mqttClient->connectToHost("127.0.0.1", 1883);
+    if (connectedSpy.count() == 0 && !connectedSpy.wait()) {
+        delete mqttClient;
+        return nullptr;
+    }
+    return mqttClient;
+}
+
+MqttClient *TestMqttBroker::connectPublisher()
+{
+    MqttPolicy policy;
+    policy.clientId = "testpublisher";
+    policy.username = "testuser";
+    policy.password = "testpassword";
+    policy.allowedPublishTopicFilters << "#";
+    NymeaCore::instance()->configuration()->updateMqttPolicy(policy);
+    return connectClient(policy.clientId, policy.username, policy.password);
+}
+
+void TestMqttBroker::benchmarkPublish()
+{
+    MqttBroker *broker = NymeaCore::instance()->serverManager()->mqttBroker();
+
+    // Many devices, each with its own policy like the MQTT channels of plugins create them
+    const int clientCount = 200;
+    QList<MqttPolicy> policies;
+    for (int i = 0; i < clientCount; i++) {
+        MqttPolicy policy;
+        policy.clientId = QString("benchmark-%1").arg(i);
+        policy.username = "testuser";
+        policy.password = "testpassword";
+        policy.allowedPublishTopicFilters << QString("shellies/%1/#").arg(policy.clientId) << QString("tele/%1/+").arg(policy.clientId);
+        policy.allowedSubscribeTopicFilters << QString("shellies/%1/#").arg(policy.clientId) << QString("cmnd/%1/+").arg(policy.clientId);
+        policies.append(policy);
+    }
+    broker->updatePolicies(policies);
+
+    int connectedCount = 0;
+    QList<MqttClient*> clients;
+    foreach (const MqttPolicy &policy, policies) {
+        MqttClient* mqttClient = new MqttClient(policy.clientId, this);
+        mqttClient->setUsername(policy.username);
+        mqttClient->setPassword(policy.password);
+        mqttClient->setAutoReconnect(false);
+        connect(mqttClient, &MqttClient::connected, this, [&connectedCount](Mqtt::ConnectReturnCode returnCode) {
+            if (returnCode == Mqtt::ConnectReturnCodeAccepted) {
+                connectedCount++;
+            }
+        });
+        mqttClient->connectToHost("127.0.0.1", 1883);
+        clients.append(mqttClient);
+    }
+    QTRY_COMPARE_WITH_TIMEOUT(connectedCount, clientCount, 10000);
+
+    QSignalSpy publishReceivedSpy(broker, &MqttBroker::publishReceived);
+    QBENCHMARK {
+        publishReceivedSpy.clear();
+        for (int i = 0; i < clients.count(); i++) {
+            clients.at(i)->publish(QString("shellies/%1/relay/0").arg(policies.at(i).clientId), "on");
+        }
+        while (publishReceivedSpy.count() < clientCount && publishReceivedSpy.wait(1000)) { }
+        QCOMPARE(publishReceivedSpy.count(), clientCount);
+    }
+
+    qDeleteAll(clients);
+    foreach (const MqttPolicy &policy, policies) {
+        broker->removePolicy(policy.clientId);
+    }
+}
+
 
 #include "testmqttbroker.moc"
 QTEST_MAIN(TestMqttBroker)
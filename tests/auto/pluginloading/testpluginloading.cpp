@@ -0,0 +1,159 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "nymeatestbase.h"
+#include "nymeacore.h"
+#include "nymeasettings.h"
+#include "integrations/thingmanager.h"
+#include "integrations/integrationplugin.h"
+
+using namespace nymeaserver;
+
+// The lazyMock plugin from tests/testplugins
+static const PluginId lazyMockPluginId = PluginId("37a2d7f3-43b6-4ec8-a481-f2b758ec7565");
+static const VendorId lazyMockVendorId = VendorId("7589c59a-e1a1-4d79-be95-60d3243a7338");
+static const ThingClassId lazyMockThingClassId = ThingClassId("01a2f0d8-7b67-4a75-806f-c0a57c59f233");
+
+class TestPluginLoading: public NymeaTestBase
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void pluginDormantUntilUsed();
+    void pluginActivatedOnSetup();
+    void activePluginNotUnloadedWhileInUse();
+    void idlePluginUnloaded();
+
+private:
+    bool lazyMockActive() const;
+    ThingId addLazyMock();
+
+    ThingId m_lazyMockId;
+};
+
+void TestPluginLoading::initTestCase()
+{
+    qputenv("NYMEA_PLUGINS_PATH", QString(QCoreApplication::applicationDirPath() + "/../../testplugins/").toUtf8());
+
+    NymeaTestBase::initTestCase();
+    QLoggingCategory::setFilterRules("*.debug=false\nTests.debug=true\nThingManager.debug=true\nLazyMock.debug=true");
+
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("Plugins");
+    settings.setValue("lazyLoading", true);
+    settings.setValue("idleTimeout", 1);
+    settings.endGroup();
+
+    restartServer();
+}
+
+void TestPluginLoading::pluginDormantUntilUsed()
+{
+    QVERIFY2(NymeaCore::instance()->thingManager()->plugin(lazyMockPluginId), "The lazyMock plugin has not been registered");
+    QVERIFY2(!lazyMockActive(), "The lazyMock plugin has been loaded without being used");
+
+    // The metadata is available without loading the plugin
+    QVariantMap params;
+    params.insert("vendorId", lazyMockVendorId);
+    QVariant response = injectAndWait("Integrations.GetThingClasses", params);
+    QCOMPARE(response.toMap().value("params").toMap().value("thingClasses").toList().count(), 1);
+    QVERIFY(!lazyMockActive());
+
+    // Plugins with auto created things are loaded right away
+    QVERIFY2(QString(NymeaCore::instance()->thingManager()->plugin(mockPluginId)->metaObject()->className()) == "IntegrationPluginMock", "The mock plugin should not be deferred");
+}
+
+void TestPluginLoading::pluginActivatedOnSetup()
+{
+    m_lazyMockId = addLazyMock();
+    QVERIFY(!m_lazyMockId.isNull());
+    QVERIFY2(lazyMockActive(), "The lazyMock plugin has not been loaded for setting up a thing");
+
+    // The activated plugin handles actions
+    QVariantMap param;
+    param.insert("paramTypeId", "c307b6e5-fe12-423a-a6d2-2c0041d911e5");
+    param.insert("value", true);
+    QVariantMap params;
+    params.insert("thingId", m_lazyMockId);
+    params.insert("actionTypeId", "c307b6e5-fe12-423a-a6d2-2c0041d911e5");
+    params.insert("params", QVariantList() << param);
+    QVariant response = injectAndWait("Integrations.ExecuteAction", params);
+    verifyError(response, "thingError", "ThingErrorNoError");
+}
+
+void TestPluginLoading::activePluginNotUnloadedWhileInUse()
+{
+    QVERIFY(lazyMockActive());
+
+    // Wait for more than the idle timeout, the plugin still has a thing
+    QTest::qWait(2500);
+    QVERIFY2(lazyMockActive(), "The lazyMock plugin has been unloaded while it still has things");
+}
+
+void TestPluginLoading::idlePluginUnloaded()
+{
+    QVariantMap params;
+    params.insert("thingId", m_lazyMockId);
+    QVariant response = injectAndWait("Integrations.RemoveThing", params);
+    verifyError(response, "thingError", "ThingErrorNoError");
+
+    QTRY_VERIFY_WITH_TIMEOUT(!lazyMockActive(), 5000);
+
+    // The placeholder still serves the metadata and the plugin is loaded again when needed
+    QVERIFY(NymeaCore::instance()->thingManager()->findThingClass(lazyMockThingClassId).isValid());
+    m_lazyMockId = addLazyMock();
+    QVERIFY(!m_lazyMockId.isNull());
+    QVERIFY2(lazyMockActive(), "The lazyMock plugin has not been loaded again after being unloaded");
+}
+
+bool TestPluginLoading::lazyMockActive() const
+{
+    // Until the plugin is loaded, its metadata is served by a plain IntegrationPlugin
+    IntegrationPlugin *plugin = NymeaCore::instance()->thingManager()->plugin(lazyMockPluginId);
+    return plugin && QString(plugin->metaObject()->className()) == "IntegrationPluginLazyMock";
+}
+
+ThingId TestPluginLoading::addLazyMock()
+{
+    QVariantMap params;
+    params.insert("thingClassId", lazyMockThingClassId);
+    params.insert("name", "Lazy mock");
+    QVariant response = injectAndWait("Integrations.AddThing", params);
+    if (response.toMap().value("params").toMap().value("thingError").toString() != "ThingErrorNoError") {
+        qCWarning(dcTests()) << "Error adding lazyMock thing:" << response;
+        return ThingId();
+    }
+    return ThingId(response.toMap().value("params").toMap().value("thingId").toString());
+}
+
+#include "testpluginloading.moc"
+QTEST_MAIN(TestPluginLoading)
@@ -0,0 +1,5 @@
+include(../../../nymea.pri)
+include(../autotests.pri)
+
+TARGET = testplugintimers
+SOURCES += testplugintimers.cpp
@@ -0,0 +1,201 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "hardware/timerwheel.h"
+#include "hardware/plugintimermanagerimplementation.h"
+
+#include <QtTest>
+#include <QSignalSpy>
+#include <QElapsedTimer>
+
+using namespace nymeaserver;
+
+class TestPluginTimers : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void timerWheelExpiry_data();
+    void timerWheelExpiry();
+
+    void timerWheelRemove();
+
+    void timerTimeout();
+
+    void stoppedTimer();
+
+    void phaseSpread();
+};
+
+void TestPluginTimers::timerWheelExpiry_data()
+{
+    QTest::addColumn<qint64>("startTick");
+
+    QTest::newRow("start 0") << Q_INT64_C(0);
+    QTest::newRow("start 63") << Q_INT64_C(63);
+    QTest::newRow("start 4095") << Q_INT64_C(4095);
+}
+
+void TestPluginTimers::timerWheelExpiry()
+{
+    QFETCH(qint64, startTick);
+
+    TimerWheel wheel;
+    QVERIFY(wheel.advance(startTick).isEmpty());
+    QCOMPARE(wheel.nextTick(), Q_INT64_C(-1));
+
+    // Expiries on every level and at the level boundaries
+    QList<qint64> deltas = { 1, 2, 63, 64, 65, 127, 128, 4095, 4096, 4097, 5000, 262143, 262144, 300000, 17000000, 20000000 };
+    QHash<int, qint64> expiries;
+    for (int i = 0; i < deltas.count(); i++) {
+        expiries.insert(i, startTick + deltas.at(i));
+        wheel.insert(i, startTick + deltas.at(i));
+    }
+
+    // Advance only to the next interesting tick, like the timer manager does
+    QHash<int, qint64> expired;
+    int wakeups = 0;
+    while (!wheel.isEmpty()) {
+        qint64 nextTick = wheel.nextTick();
+        QVERIFY(nextTick > wheel.currentTick());
+        foreach (int id, wheel.advance(nextTick)) {
+            expired.insert(id, wheel.currentTick());
+        }
+        wakeups++;
+    }
+
+    QCOMPARE(expired, expiries);
+    QVERIFY2(wakeups < 500, QString("Too many wakeups: %1").arg(wakeups).toUtf8());
+}
+
+void TestPluginTimers::timerWheelRemove()
+{
+    TimerWheel wheel;
+    wheel.insert(1, 10);
+    wheel.insert(2, 100);
+    wheel.insert(3, 100);
+    QVERIFY(wheel.contains(2));
+
+    wheel.remove(2);
+    QVERIFY(!wheel.contains(2));
+
+    // Re-inserting moves the timer
+    wheel.insert(3, 20);
+
+    QCOMPARE(wheel.advance(10), QList<int>() << 1);
+    QCOMPARE(wheel.advance(20), QList<int>() << 3);
+    QVERIFY(wheel.isEmpty());
+    QCOMPARE(wheel.nextTick(), Q_INT64_C(-1));
+}
+
+void TestPluginTimers::timerTimeout()
+{
+    PluginTimerManagerImplementation manager;
+    manager.enable();
+
+    PluginTimer *timer = manager.registerTimerMSecs(200);
+    QCOMPARE(timer->intervalMSecs(), 200);
+    QCOMPARE(timer->interval(), 0);
+
+    QSignalSpy spy(timer, &PluginTimer::timeout);
+    QElapsedTimer elapsed;
+    elapsed.start();
+    QTRY_VERIFY_WITH_TIMEOUT(spy.count() >= 5, 3000);
+
+    // Never early
+    QVERIFY(elapsed.elapsed() >= 4 * 200);
+
+    manager.unregisterTimer(timer);
+}
+
+void TestPluginTimers::stoppedTimer()
+{
+    PluginTimerManagerImplementation manager;
+    manager.enable();
+
+    PluginTimer *timer = manager.registerTimerMSecs(200);
+    QSignalSpy spy(timer, &PluginTimer::timeout);
+
+    timer->stop();
+    QVERIFY(!timer->running());
+    QTest::qWait(500);
+    QCOMPARE(spy.count(), 0);
+
+    timer->start();
+    QTRY_COMPARE_WITH_TIMEOUT(spy.count(), 1, 1000);
+
+    // A disabled timer manager doesn't fire any timers
+    manager.disable();
+    QTest::qWait(500);
+    QCOMPARE(spy.count(), 1);
+
+    manager.enable();
+    QTRY_VERIFY_WITH_TIMEOUT(spy.count() > 1, 1000);
+
+    manager.unregisterTimer(timer);
+}
+
+void TestPluginTimers::phaseSpread()
+{
+    PluginTimerManagerImplementation manager;
+    manager.enable();
+
+    QElapsedTimer elapsed;
+    elapsed.start();
+
+    // Timers registered in the same moment with the same interval
+    QList<PluginTimer *> timers;
+    QHash<PluginTimer *, qint64> timeouts;
+    for (int i = 0; i < 10; i++) {
+        PluginTimer *timer = manager.registerTimer(2);
+        connect(timer, &PluginTimer::timeout, this, [&timeouts, &elapsed, timer]() {
+            if (!timeouts.contains(timer)) {
+                timeouts.insert(timer, elapsed.elapsed());
+            }
+        });
+        timers.append(timer);
+    }
+
+    QTRY_COMPARE_WITH_TIMEOUT(timeouts.count(), 10, 3000);
+    QList<qint64> firstTimeouts = timeouts.values();
+    std::sort(firstTimeouts.begin(), firstTimeouts.end());
+
+    // All within the first interval, but not all at once
+    QVERIFY(firstTimeouts.first() >= 1000);
+    QVERIFY(firstTimeouts.last() <= 2500);
+    QVERIFY2(firstTimeouts.last() - firstTimeouts.first() >= 500, "Timers with the same interval are not spread");
+
+    foreach (PluginTimer *timer, timers) {
+        manager.unregisterTimer(timer);
+    }
+}
+
+#include "testplugintimers.moc"
+QTEST_MAIN(TestPluginTimers)
@@ -89,6 +89,10 @@ private slots:
 
     void loadStoreConfig();
 
+    void migrateRulesFromSettings();
+
+    void enabledStatePersists();
+
     void evaluateEvent();
 
     void evaluateEventParams();
@@ -130,6 +134,9 @@ private slots:
 
     void testInterfaceBasedStateRule();
 
+    void testInterfaceBasedStateRuleWithNewThing();
+    void testInterfaceBasedStateRuleWithRemovedThing();
+
     void testLoopingRules();
 
     void testScene();
@@ -1594,6 +1601,101 @@ void TestRules::loadStoreConfig()
     QVERIFY2(rules.count() == 0, "There should be no rules.");
 }
 
+void TestRules::migrateRulesFromSettings()
+{
+    QString settingsFileName = NymeaSettings::settingsFileName(NymeaSettings::SettingsRoleRules);
+    RuleId ruleId = RuleId::createRuleId();
+
+    // Write a rule in the pre database format while the server is down
+    NymeaCore::instance()->destroy();
+    {
+        NymeaSettings settings(NymeaSettings::SettingsRoleRules);
+        settings.beginGroup(ruleId.toString());
+        settings.setValue("name", "Migrated rule");
+        settings.setValue("enabled", false);
+        settings.setValue("executable", true);
+        settings.beginGroup("events");
+        settings.beginGroup("EventDescriptor-0");
+        settings.setValue("thingId", m_mockThingId.toString());
+        settings.setValue("eventTypeId", mockEvent1EventTypeId.toString());
+        settings.endGroup();
+        settings.endGroup();
+        settings.beginGroup("ruleActions");
+        settings.beginGroup("0");
+        settings.setValue("thingId", m_mockThingId.toString());
+        settings.setValue("actionTypeId", mockWithoutParamsActionTypeId.toString());
+        settings.endGroup();
+        settings.endGroup();
+        settings.endGroup();
+    }
+    NymeaCore::instance()->init();
+    QSignalSpy coreSpy(NymeaCore::instance(), SIGNAL(initialized()));
+    coreSpy.wait();
+    m_mockTcpServer = MockTcpServer::servers().first();
+    m_mockTcpServer->clientConnected(m_clientId);
+    injectAndWait("JSONRPC.Hello");
+
+    QVERIFY2(!QFile::exists(settingsFileName), "The rules settings should have been moved away after migrating.");
+    QVERIFY(QFile::exists(settingsFileName + ".migrated"));
+
+    // Migrated rules must survive another restart without the settings file
+    restartServer();
+
+    QVariantMap params;
+    params.insert("ruleId", ruleId);
+    QVariant response = injectAndWait("Rules.GetRuleDetails", params);
+    verifyRuleError(response);
+    QVariantMap rule = response.toMap().value("params").toMap().value("rule").toMap();
+    QCOMPARE(rule.value("name").toString(), QString("Migrated rule"));
+    QCOMPARE(rule.value("enabled").toBool(), false);
+    QCOMPARE(rule.value("eventDescriptors").toList().count(), 1);
+    QCOMPARE(rule.value("actions").toList().count(), 1);
+
+    response = injectAndWait("Rules.RemoveRule", params);
+    verifyRuleError(response);
+}
+
+void TestRules::enabledStatePersists()
+{
+    QVariantMap addRuleParams;
+    QVariantMap event1;
+    event1.insert("eventTypeId", mockEvent1EventTypeId);
+    event1.insert("thingId", m_mockThingId);
+    addRuleParams.insert("eventDescriptors", QVariantList() << event1);
+    addRuleParams.insert("name", "TestRule");
+    QVariantMap action;
+    action.insert("actionTypeId", mockWithoutParamsActionTypeId);
+    action.insert("thingId", m_mockThingId);
+    addRuleParams.insert("actions", QVariantList() << action);
+    QVariant response = injectAndWait("Rules.AddRule", addRuleParams);
+    verifyRuleError(response);
+    RuleId ruleId = RuleId(response.toMap().value("params").toMap().value("ruleId").toString());
+
+    QVariantMap params;
+    params.insert("ruleId", ruleId);
+    response = injectAndWait("Rules.DisableRule", params);
+    verifyRuleError(response);
+
+    restartServer();
+
+    response = injectAndWait("Rules.GetRuleDetails", params);
+    verifyRuleError(response);
+    QCOMPARE(response.toMap().value("params").toMap().value("rule").toMap().value("enabled").toBool(), false);
+    QCOMPARE(response.toMap().value("params").toMap().value("rule").toMap().value("actions").toList().count(), 1);
+
+    response = injectAndWait("Rules.EnableRule", params);
+    verifyRuleError(response);
+
+    restartServer();
+
+    response = injectAndWait("Rules.GetRuleDetails", params);
+    verifyRuleError(response);
+    QCOMPARE(response.toMap().value("params").toMap().value("rule").toMap().value("enabled").toBool(), true);
+
+    response = injectAndWait("Rules.RemoveRule", params);
+    verifyRuleError(response);
+}
+
 void TestRules::evaluateEvent()
 {
     // Add a rule
@@ -3013,6 +3115,138 @@ void TestRules::testInterfaceBasedStateRule()
     verifyRuleExecuted(mockPowerActionTypeId);
 }
 
+void TestRules::testInterfaceBasedStateRuleWithNewThing()
+{
+    // Make sure the only existing light is off
+    QNetworkAccessManager nam;
+    QSignalSpy spy(&nam, SIGNAL(finished(QNetworkReply*)));
+    QNetworkRequest request(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(m_mockThing1Port).arg(mockPowerStateTypeId.toString()).arg(false)));
+    QNetworkReply *reply = nam.get(request);
+    spy.wait();
+    QCOMPARE(spy.count(), 1);
+    reply->deleteLater();
+
+    QVariantMap stateDescriptor;
+    stateDescriptor.insert("interface", "light");
+    stateDescriptor.insert("interfaceState", "power");
+    stateDescriptor.insert("value", true);
+    stateDescriptor.insert("operator", "ValueOperatorEquals");
+    QVariantMap stateEvaluator;
+    stateEvaluator.insert("stateDescriptor", stateDescriptor);
+
+    QVariantMap action;
+    action.insert("actionTypeId", mockWithoutParamsActionTypeId);
+    action.insert("thingId", m_mockThingId);
+
+    QVariantMap addRuleParams;
+    addRuleParams.insert("name", "TestInterfaceBasedStateRuleWithNewThing");
+    addRuleParams.insert("stateEvaluator", stateEvaluator);
+    addRuleParams.insert("actions", QVariantList() << action);
+    QVariant response = injectAndWait("Rules.AddRule", addRuleParams);
+    verifyRuleError(response);
+
+    cleanupMockHistory();
+
+    // Add a light after the rule has been created, it needs to be picked up by the rule
+    QVariantMap params;
+    params.insert("thingClassId", virtualIoLightMockThingClassId);
+    params.insert("name", "Virtual light");
+    response = injectAndWait("Integrations.AddThing", params);
+    ThingId lightThingId = ThingId(response.toMap().value("params").toMap().value("thingId").toUuid());
+    QVERIFY2(!lightThingId.isNull(), "Creating virtual light failed");
+
+    QVariantMap powerParam;
+    powerParam.insert("paramTypeId", virtualIoLightMockPowerActionPowerParamTypeId);
+    powerParam.insert("value", true);
+    params.clear();
+    params.insert("thingId", lightThingId);
+    params.insert("actionTypeId", virtualIoLightMockPowerActionTypeId);
+    params.insert("params", QVariantList() << powerParam);
+    response = injectAndWait("Integrations.ExecuteAction", params);
+    verifyError(response, "thingError", "ThingErrorNoError");
+
+    verifyRuleExecuted(mockWithoutParamsActionTypeId);
+
+    params.clear();
+    params.insert("thingId", lightThingId);
+    response = injectAndWait("Integrations.RemoveThing", params);
+    verifyError(response, "thingError", "ThingErrorNoError");
+}
+
+void TestRules::testInterfaceBasedStateRuleWithRemovedThing()
+{
+    // Make sure the only existing light is off
+    QNetworkAccessManager nam;
+    QSignalSpy spy(&nam, SIGNAL(finished(QNetworkReply*)));
+    QNetworkRequest request(QUrl(QString("http://localhost:%1/setstate?%2=%3").arg(m_mockThing1Port).arg(mockPowerStateTypeId.toString()).arg(false)));
+    QNetworkReply *reply = nam.get(request);
+    spy.wait();
+    QCOMPARE(spy.count(), 1);
+    reply->deleteLater();
+
+    QVariantMap stateDescriptor;
+    stateDescriptor.insert("interface", "light");
+    stateDescriptor.insert("interfaceState", "power");
+    stateDescriptor.insert("value", true);
+    stateDescriptor.insert("operator", "ValueOperatorEquals");
+    QVariantMap stateEvaluator;
+    stateEvaluator.insert("stateDescriptor", stateDescriptor);
+
+    QVariantMap action;
+    action.insert("actionTypeId", mockWithoutParamsActionTypeId);
+    action.insert("thingId", m_mockThingId);
+
+    QVariantMap addRuleParams;
+    addRuleParams.insert("name", "TestInterfaceBasedStateRuleWithRemovedThing");
+    addRuleParams.insert("eventDescriptors", QVariantList() << createEventDescriptor(m_mockThingId, mockEvent1EventTypeId));
+    addRuleParams.insert("stateEvaluator", stateEvaluator);
+    addRuleParams.insert("actions", QVariantList() << action);
+    QVariant response = injectAndWait("Rules.AddRule", addRuleParams);
+    verifyRuleError(response);
+    RuleId ruleId = RuleId(response.toMap().value("params").toMap().value("ruleId").toString());
+
+    QVERIFY(!NymeaCore::instance()->ruleEngine()->findRule(ruleId).statesActive());
+
+    // Add a light and turn it on, the states of the rule match now
+    QVariantMap params;
+    params.insert("thingClassId", virtualIoLightMockThingClassId);
+    params.insert("name", "Virtual light");
+    response = injectAndWait("Integrations.AddThing", params);
+    ThingId lightThingId = ThingId(response.toMap().value("params").toMap().value("thingId").toUuid());
+    QVERIFY2(!lightThingId.isNull(), "Creating virtual light failed");
+
+    QVariantMap powerParam;
+    powerParam.insert("paramTypeId", virtualIoLightMockPowerActionPowerParamTypeId);
+    powerParam.insert("value", true);
+    params.clear();
+    params.insert("thingId", lightThingId);
+    params.insert("actionTypeId", virtualIoLightMockPowerActionTypeId);
+    params.insert("params", QVariantList() << powerParam);
+    response = injectAndWait("Integrations.ExecuteAction", params);
+    verifyError(response, "thingError", "ThingErrorNoError");
+
+    QVERIFY(NymeaCore::instance()->ruleEngine()->findRule(ruleId).statesActive());
+
+    // Removing the only light which is on must not leave the states matching
+    params.clear();
+    params.insert("thingId", lightThingId);
+    response = injectAndWait("Integrations.RemoveThing", params);
+    verifyError(response, "thingError", "ThingErrorNoError");
+
+    QVERIFY(!NymeaCore::instance()->ruleEngine()->findRule(ruleId).statesActive());
+
+    // The event alone must not trigger the rule any more
+    cleanupMockHistory();
+    spy.clear();
+    request = QNetworkRequest(QUrl(QString("http://localhost:%1/generateevent?eventtypeid=%2").arg(m_mockThing1Port).arg(mockEvent1EventTypeId.toString())));
+    reply = nam.get(request);
+    spy.wait();
+    QCOMPARE(spy.count(), 1);
+    reply->deleteLater();
+
+    verifyRuleNotExecuted();
+}
+
 void TestRules::testLoopingRules()
 {
     QVariantMap powerOnActionParam;
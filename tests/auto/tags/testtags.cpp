@@ -51,6 +51,8 @@ private slots:
 
     void removeTag();
 
+    void addRemoveTags();
+
 private:
     QVariantMap createThingTag(const QString &thingId, const QString &appId, const QString &tagId, const QString &value);
     bool compareThingTag(const QVariantMap &tag, const QUuid &thingId, const QString &appId, const QString &tagId, const QString &value);
@@ -248,5 +250,67 @@ void TestTags::removeTag()
     QCOMPARE(tagsList.count(), 0);
 }
 
+void TestTags::addRemoveTags()
+{
+    QString thingId = m_mockThingId.toString();
+    QString appId = "testbulktags";
+
+    QVariantList tags;
+    for (int i = 2; i >= 0; i--) {
+        tags.append(createThingTag(thingId, appId, QString("bulkTag%1").arg(i), QString::number(i)));
+    }
+
+    // Adding fails as a whole if one of the tags is invalid
+    QVariantMap params;
+    params.insert("tags", QVariantList(tags) << createThingTag(ThingId::createThingId().toString(), appId, "invalid", "1"));
+    QVariant response = injectAndWait("Tags.AddTags", params);
+    verifyTagError(response, TagsStorage::TagErrorThingNotFound);
+
+    params.clear();
+    params.insert("appId", appId);
+    response = injectAndWait("Tags.GetTags", params);
+    QCOMPARE(response.toMap().value("params").toMap().value("tags").toList().count(), 0);
+
+    // Add all valid tags at once
+    params.clear();
+    params.insert("tags", tags);
+    response = injectAndWait("Tags.AddTags", params);
+    verifyTagError(response, TagsStorage::TagErrorNoError);
+
+    // They must survive a restart
+    restartServer();
+
+    params.clear();
+    params.insert("appId", appId);
+    response = injectAndWait("Tags.GetTags", params);
+    QVariantList tagsList = response.toMap().value("params").toMap().value("tags").toList();
+    QCOMPARE(tagsList.count(), 3);
+    foreach (const QVariant &tag, tagsList) {
+        QString tagId = tag.toMap().value("tagId").toString();
+        QVERIFY2(compareThingTag(tag.toMap(), thingId, appId, tagId, tagId.right(1)), "Fetched tag isn't matching the one we added");
+    }
+
+    // Tags are always listed in the same order, regardless of the order they have been added in
+    for (int i = 0; i < 3; i++) {
+        QCOMPARE(tagsList.at(i).toMap().value("tagId").toString(), QString("bulkTag%1").arg(i));
+    }
+
+    // Removing fails as a whole if one of the tags doesn't exist
+    params.clear();
+    params.insert("tags", QVariantList(tags) << createThingTag(thingId, appId, "notExisting", QString()));
+    response = injectAndWait("Tags.RemoveTags", params);
+    verifyTagError(response, TagsStorage::TagErrorTagNotFound);
+
+    params.clear();
+    params.insert("tags", tags);
+    response = injectAndWait("Tags.RemoveTags", params);
+    verifyTagError(response, TagsStorage::TagErrorNoError);
+
+    params.clear();
+    params.insert("appId", appId);
+    response = injectAndWait("Tags.GetTags", params);
+    QCOMPARE(response.toMap().value("params").toMap().value("tags").toList().count(), 0);
+}
+
 #include "testtags.moc"
 QTEST_MAIN(TestTags)
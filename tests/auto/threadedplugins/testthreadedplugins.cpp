@@ -0,0 +1,168 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "nymeatestbase.h"
+#include "nymeacore.h"
+#include "integrations/thingmanager.h"
+#include "integrations/integrationplugin.h"
+#include "integrations/thing.h"
+
+using namespace nymeaserver;
+
+// The threadedMock plugin from tests/testplugins
+static const PluginId threadedMockPluginId = PluginId("21b8ccbc-1fe6-48ee-849f-aadf9381b41f");
+static const ParamTypeId threadedMockPluginIntervalParamTypeId = ParamTypeId("48d6f10d-5818-41d2-9379-41f6192b2e99");
+static const ThingClassId threadedMockThingClassId = ThingClassId("7cd7c9b5-4161-4c99-b928-0faa870244dc");
+static const StateTypeId threadedMockPowerStateTypeId = StateTypeId("ab153ad0-6f2a-4e76-820e-edd1d721c7a1");
+static const StateTypeId threadedMockTicksStateTypeId = StateTypeId("082f1332-d54b-40ed-8196-c029eecfbc15");
+static const ActionTypeId threadedMockFinishLaterActionTypeId = ActionTypeId("9d64802b-ba53-4d9f-8e33-e719aca19a72");
+
+class TestThreadedPlugins: public NymeaTestBase
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void setupInPluginThread();
+    void actionInPluginThread();
+    void actionFinishedLater();
+    void timerInPluginThread();
+    void pluginConfigInPluginThread();
+    void removeThing();
+
+private:
+    ThingId m_threadedMockId;
+};
+
+void TestThreadedPlugins::initTestCase()
+{
+    qputenv("NYMEA_PLUGINS_PATH", QString(QCoreApplication::applicationDirPath() + "/../../testplugins/").toUtf8());
+
+    NymeaTestBase::initTestCase();
+    QLoggingCategory::setFilterRules("*.debug=false\nTests.debug=true\nThingManager.debug=true\nThreadedMock.debug=true");
+}
+
+void TestThreadedPlugins::setupInPluginThread()
+{
+    QVariantMap params;
+    params.insert("thingClassId", threadedMockThingClassId);
+    params.insert("name", "Threaded mock");
+    QVariant response = injectAndWait("Integrations.AddThing", params);
+    verifyError(response, "thingError", "ThingErrorNoError");
+    m_threadedMockId = ThingId(response.toMap().value("params").toMap().value("thingId").toString());
+
+    Thing *thing = NymeaCore::instance()->thingManager()->findConfiguredThing(m_threadedMockId);
+    QVERIFY(thing);
+    QCOMPARE(thing->setupStatus(), Thing::ThingSetupStatusComplete);
+}
+
+void TestThreadedPlugins::actionInPluginThread()
+{
+    Thing *thing = NymeaCore::instance()->thingManager()->findConfiguredThing(m_threadedMockId);
+    QVERIFY(thing);
+    bool powerNotified = false;
+    QObject context;
+    connect(thing, &Thing::stateValueChanged, &context, [&powerNotified](const StateTypeId &stateTypeId, const QVariant &value){
+        if (stateTypeId == threadedMockPowerStateTypeId && value.toBool()) {
+            powerNotified = true;
+        }
+    });
+
+    // The plugin fails the action if the new state value is not returned right after setting it
+    QVariantMap param;
+    param.insert("paramTypeId", threadedMockPowerStateTypeId);
+    param.insert("value", true);
+    QVariantMap params;
+    params.insert("thingId", m_threadedMockId);
+    params.insert("actionTypeId", threadedMockPowerStateTypeId);
+    params.insert("params", QVariantList() << param);
+    QVariant response = injectAndWait("Integrations.ExecuteAction", params);
+    verifyError(response, "thingError", "ThingErrorNoError");
+
+    QCOMPARE(thing->stateValue(threadedMockPowerStateTypeId).toBool(), true);
+
+    // The notification is handed back to the main thread
+    QTRY_VERIFY_WITH_TIMEOUT(powerNotified, 2000);
+}
+
+void TestThreadedPlugins::actionFinishedLater()
+{
+    // Finished by a timer in the plugin thread
+    QVariantMap params;
+    params.insert("thingId", m_threadedMockId);
+    params.insert("actionTypeId", threadedMockFinishLaterActionTypeId);
+    QVariant response = injectAndWait("Integrations.ExecuteAction", params);
+    verifyError(response, "thingError", "ThingErrorNoError");
+}
+
+void TestThreadedPlugins::timerInPluginThread()
+{
+    // The plugin counts ticks only if its timer expires in the plugin thread
+    Thing *thing = NymeaCore::instance()->thingManager()->findConfiguredThing(m_threadedMockId);
+    QVERIFY(thing);
+    QTRY_VERIFY_WITH_TIMEOUT(thing->stateValue(threadedMockTicksStateTypeId).toInt() > 0, 2000);
+}
+
+void TestThreadedPlugins::pluginConfigInPluginThread()
+{
+    QVariantMap configParam;
+    configParam.insert("paramTypeId", threadedMockPluginIntervalParamTypeId);
+    configParam.insert("value", 200);
+    QVariantMap params;
+    params.insert("pluginId", threadedMockPluginId);
+    params.insert("configuration", QVariantList() << configParam);
+    QVariant response = injectAndWait("Integrations.SetPluginConfiguration", params);
+    verifyError(response, "thingError", "ThingErrorNoError");
+
+    // Applied asynchronously by the plugin thread
+    IntegrationPlugin *plugin = NymeaCore::instance()->thingManager()->plugin(threadedMockPluginId);
+    QVERIFY(plugin);
+    QTRY_COMPARE_WITH_TIMEOUT(plugin->configValue(threadedMockPluginIntervalParamTypeId).toInt(), 200, 2000);
+}
+
+void TestThreadedPlugins::removeThing()
+{
+    // The plugin still uses the thing for a while after being told it got removed
+    QVariantMap params;
+    params.insert("thingId", m_threadedMockId);
+    QVariant response = injectAndWait("Integrations.RemoveThing", params);
+    verifyError(response, "thingError", "ThingErrorNoError");
+
+    QVERIFY(!NymeaCore::instance()->thingManager()->findConfiguredThing(m_threadedMockId));
+
+    // Give the plugin thread time to finish with the thing, the server must still be working
+    QTest::qWait(500);
+    response = injectAndWait("Integrations.GetThings");
+    QVERIFY(response.toMap().value("status").toString() == "success");
+}
+
+#include "testthreadedplugins.moc"
+QTEST_MAIN(TestThreadedPlugins)
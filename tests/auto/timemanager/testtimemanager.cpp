@@ -114,6 +114,8 @@ private slots:
 
     void testEnableDisableTimeRule();
 
+    void testNextTimeEvaluation();
+
 private:
     void initTimeManager();
 
@@ -2024,6 +2026,73 @@ void TestTimeManager::testEnableDisableTimeRule()
     verifyRuleError(response);
 }
 
+void TestTimeManager::testNextTimeEvaluation()
+{
+    initTimeManager();
+    QDateTime dateTime(QDate::currentDate(), QTime(8,0));
+    NymeaCore::instance()->timeManager()->setTime(dateTime.addSecs(-60));
+
+    // Action
+    QVariantMap action;
+    action.insert("actionTypeId", mockWithoutParamsActionTypeId);
+    action.insert("thingId", m_mockThingId);
+    action.insert("ruleActionParams", QVariantList());
+
+    // Event at 08:00:30 and calendar item from 08:00 to 08:10
+    QVariantMap eventRuleMap;
+    eventRuleMap.insert("name", "Time based event rule");
+    eventRuleMap.insert("actions", QVariantList() << action);
+    eventRuleMap.insert("timeDescriptor", createTimeDescriptorTimeEvent(createTimeEventItem(dateTime.addSecs(30).toTime_t())));
+
+    QVariantMap calendarRuleMap;
+    calendarRuleMap.insert("name", "Time based calendar rule");
+    calendarRuleMap.insert("actions", QVariantList() << action);
+    calendarRuleMap.insert("timeDescriptor", createTimeDescriptorCalendar(createCalendarItem("08:00", 10)));
+
+    QVariant response = injectAndWait("Rules.AddRule", eventRuleMap);
+    verifyRuleError(response);
+    RuleId eventRuleId = RuleId(response.toMap().value("params").toMap().value("ruleId").toString());
+
+    response = injectAndWait("Rules.AddRule", calendarRuleMap);
+    verifyRuleError(response);
+    RuleId calendarRuleId = RuleId(response.toMap().value("params").toMap().value("ruleId").toString());
+
+    // New rules are due right away
+    QVERIFY(NymeaCore::instance()->ruleEngine()->nextTimeEvaluation() <= NymeaCore::instance()->timeManager()->currentDateTime());
+
+    NymeaCore::instance()->timeManager()->setTime(dateTime.addSecs(-30));
+    QCOMPARE(NymeaCore::instance()->ruleEngine()->nextTimeEvaluation(), dateTime);
+
+    NymeaCore::instance()->timeManager()->setTime(dateTime);
+    verifyRuleExecuted(mockWithoutParamsActionTypeId);
+    cleanupMockHistory();
+    QCOMPARE(NymeaCore::instance()->ruleEngine()->nextTimeEvaluation(), dateTime.addSecs(30));
+
+    // Sub minute precision
+    NymeaCore::instance()->timeManager()->setTime(dateTime.addSecs(29));
+    verifyRuleNotExecuted();
+    NymeaCore::instance()->timeManager()->setTime(dateTime.addSecs(30));
+    verifyRuleExecuted(mockWithoutParamsActionTypeId);
+    cleanupMockHistory();
+    QCOMPARE(NymeaCore::instance()->ruleEngine()->nextTimeEvaluation(), dateTime.addSecs(10 * 60));
+
+    // Disabled rules are not scheduled, the time event has passed
+    QVariantMap enableDisableParams;
+    enableDisableParams.insert("ruleId", calendarRuleId.toString());
+    response = injectAndWait("Rules.DisableRule", enableDisableParams);
+    verifyRuleError(response);
+    QVERIFY(!NymeaCore::instance()->ruleEngine()->nextTimeEvaluation().isValid());
+
+    // REMOVE rules
+    QVariantMap removeParams;
+    removeParams.insert("ruleId", eventRuleId);
+    response = injectAndWait("Rules.RemoveRule", removeParams);
+    verifyRuleError(response);
+    removeParams.insert("ruleId", calendarRuleId);
+    response = injectAndWait("Rules.RemoveRule", removeParams);
+    verifyRuleError(response);
+}
+
 void TestTimeManager::initTimeManager()
 {
     cleanupMockHistory();
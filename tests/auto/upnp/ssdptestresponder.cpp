@@ -0,0 +1,207 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+#include "ssdptestresponder.h"
+
+SsdpTestResponder::SsdpTestResponder(QObject *parent) :
+    QObject(parent)
+{
+    m_ssdpSocket = new QUdpSocket(this);
+    if (!m_ssdpSocket->bind(QHostAddress::LocalHost, 0))
+        qWarning() << "Could not bind SSDP test responder" << m_ssdpSocket->errorString();
+
+    connect(m_ssdpSocket, &QUdpSocket::readyRead, this, &SsdpTestResponder::onSsdpReadyRead);
+
+    m_httpServer = new QTcpServer(this);
+    if (!m_httpServer->listen(QHostAddress::LocalHost, 0))
+        qWarning() << "Could not start SSDP test HTTP server" << m_httpServer->errorString();
+
+    connect(m_httpServer, &QTcpServer::newConnection, this, &SsdpTestResponder::onNewConnection);
+}
+
+quint16 SsdpTestResponder::ssdpPort() const
+{
+    return m_ssdpSocket->localPort();
+}
+
+quint16 SsdpTestResponder::httpPort() const
+{
+    return m_httpServer->serverPort();
+}
+
+void SsdpTestResponder::addDevice(const QString &uuid, const QString &friendlyName, int maxAge, const QString &deviceType)
+{
+    Device device;
+    device.uuid = uuid;
+    device.friendlyName = friendlyName;
+    device.deviceType = deviceType;
+    device.maxAge = maxAge;
+    m_devices.append(device);
+}
+
+void SsdpTestResponder::setResponseRepeat(int repeat)
+{
+    m_responseRepeat = repeat;
+}
+
+void SsdpTestResponder::sendByeBye(const QString &uuid, const QString &notificationType)
+{
+    // Announced to the last searching client instead of the multicast group
+    QByteArray message = QByteArray("NOTIFY * HTTP/1.1\r\n"
+                                    "HOST:239.255.255.250:1900\r\n"
+                                    "NT: " + notificationType.toUtf8() + "\r\n"
+                                    "NTS: ssdp:byebye\r\n"
+                                    "USN: uuid:" + uuid.toUtf8() + "::" + notificationType.toUtf8() + "\r\n"
+                                    "\r\n");
+    m_ssdpSocket->writeDatagram(message, m_searchAddress, m_searchPort);
+}
+
+int SsdpTestResponder::searchRequestCount() const
+{
+    return m_searchRequestCount;
+}
+
+int SsdpTestResponder::descriptionRequestCount(const QString &uuid) const
+{
+    if (!uuid.isEmpty())
+        return m_descriptionRequests.value(uuid);
+
+    int count = 0;
+    foreach (int requests, m_descriptionRequests.values())
+        count += requests;
+
+    return count;
+}
+
+QByteArray SsdpTestResponder::searchResponse(const Device &device, const QString &searchTarget) const
+{
+    // Searching for everything is answered with the root device
+    QString st = searchTarget == "ssdp:all" ? "upnp:rootdevice" : searchTarget;
+    QByteArray location = "http://127.0.0.1:" + QByteArray::number(httpPort()) + "/" + device.uuid.toUtf8() + ".xml";
+    return QByteArray("HTTP/1.1 200 OK\r\n"
+                      "CACHE-CONTROL: max-age=" + QByteArray::number(device.maxAge) + "\r\n"
+                      "EXT:\r\n"
+                      "LOCATION: " + location + "\r\n"
+                      "SERVER: Linux/1.0 UPnP/1.1 nymea-test/1.0\r\n"
+                      "ST: " + st.toUtf8() + "\r\n"
+                      "USN: uuid:" + device.uuid.toUtf8() + "::" + st.toUtf8() + "\r\n"
+                      "\r\n");
+}
+
+QByteArray SsdpTestResponder::deviceDescription(const Device &device) const
+{
+    return QByteArray("<?xml version=\"1.0\"?>\n"
+                      "<root xmlns=\"urn:schemas-upnp-org:device-1-0\">\n"
+                      "<specVersion><major>1</major><minor>1</minor></specVersion>\n"
+                      "<device>\n"
+                      "<deviceType>" + device.deviceType.toUtf8() + "</deviceType>\n"
+                      "<friendlyName>" + device.friendlyName.toUtf8() + "</friendlyName>\n"
+                      "<manufacturer>nymea</manufacturer>\n"
+                      "<modelName>SSDP test device</modelName>\n"
+                      "<UDN>uuid:" + device.uuid.toUtf8() + "</UDN>\n"
+                      "</device>\n"
+                      "</root>\n");
+}
+
+void SsdpTestResponder::onSsdpReadyRead()
+{
+    while (m_ssdpSocket->hasPendingDatagrams()) {
+        QByteArray data;
+        QHostAddress address;
+        quint16 port;
+        data.resize(static_cast<int>(m_ssdpSocket->pendingDatagramSize()));
+        m_ssdpSocket->readDatagram(data.data(), data.size(), &address, &port);
+
+        if (!data.startsWith("M-SEARCH"))
+            continue;
+
+        m_searchRequestCount++;
+        m_searchAddress = address;
+        m_searchPort = port;
+
+        QString searchTarget;
+        foreach (const QByteArray &line, data.split('\n')) {
+            if (line.toUpper().startsWith("ST:")) {
+                searchTarget = QString::fromUtf8(line.mid(3)).trimmed();
+            }
+        }
+
+        // Real devices answer once per advertised service, all of them in one burst
+        foreach (const Device &device, m_devices) {
+            if (searchTarget != "ssdp:all" && searchTarget != "upnp:rootdevice" && searchTarget != device.deviceType)
+                continue;
+
+            for (int i = 0; i < m_responseRepeat; i++) {
+                m_ssdpSocket->writeDatagram(searchResponse(device, searchTarget), address, port);
+            }
+        }
+    }
+}
+
+void SsdpTestResponder::onNewConnection()
+{
+    while (m_httpServer->hasPendingConnections()) {
+        QTcpSocket *socket = m_httpServer->nextPendingConnection();
+        connect(socket, &QTcpSocket::readyRead, this, &SsdpTestResponder::onHttpReadyRead);
+        connect(socket, &QTcpSocket::disconnected, this, [this, socket]() {
+            m_buffers.remove(socket);
+            socket->deleteLater();
+        });
+    }
+}
+
+void SsdpTestResponder::onHttpReadyRead()
+{
+    QTcpSocket *socket = static_cast<QTcpSocket *>(sender());
+    QByteArray &buffer = m_buffers[socket];
+    buffer.append(socket->readAll());
+    if (!buffer.contains("\r\n\r\n"))
+        return;
+
+    QByteArray path = buffer.split(' ').value(1);
+    buffer.clear();
+
+    QByteArray status = "404 Not Found";
+    QByteArray body;
+    foreach (const Device &device, m_devices) {
+        if (path == "/" + device.uuid.toUtf8() + ".xml") {
+            m_descriptionRequests[device.uuid]++;
+            status = "200 OK";
+            body = deviceDescription(device);
+            break;
+        }
+    }
+
+    socket->write("HTTP/1.1 " + status + "\r\n"
+                  "Content-Type: text/xml\r\n"
+                  "Content-Length: " + QByteArray::number(body.length()) + "\r\n"
+                  "Connection: close\r\n"
+                  "\r\n" + body);
+    socket->disconnectFromHost();
+}
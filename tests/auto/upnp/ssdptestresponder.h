@@ -0,0 +1,87 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+#ifndef SSDPTESTRESPONDER_H
+#define SSDPTESTRESPONDER_H
+
+#include <QHash>
+#include <QObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QUdpSocket>
+
+// Minimal SSDP responder on the loopback interface answering every M-SEARCH message and serving the device descriptions
+class SsdpTestResponder : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SsdpTestResponder(QObject *parent = nullptr);
+
+    quint16 ssdpPort() const;
+    quint16 httpPort() const;
+
+    void addDevice(const QString &uuid, const QString &friendlyName, int maxAge = 1800, const QString &deviceType = "urn:schemas-upnp-org:device:Basic:1");
+    void setResponseRepeat(int repeat);
+
+    void sendByeBye(const QString &uuid, const QString &notificationType = "upnp:rootdevice");
+
+    int searchRequestCount() const;
+    int descriptionRequestCount(const QString &uuid = QString()) const;
+
+private:
+    class Device {
+    public:
+        QString uuid;
+        QString friendlyName;
+        QString deviceType;
+        int maxAge = 1800;
+    };
+
+    QUdpSocket *m_ssdpSocket;
+    QTcpServer *m_httpServer;
+    QList<Device> m_devices;
+    QHash<QTcpSocket *, QByteArray> m_buffers;
+    QHash<QString, int> m_descriptionRequests;
+    int m_responseRepeat = 1;
+    int m_searchRequestCount = 0;
+    QHostAddress m_searchAddress;
+    quint16 m_searchPort = 0;
+
+    QByteArray searchResponse(const Device &device, const QString &searchTarget) const;
+    QByteArray deviceDescription(const Device &device) const;
+
+private slots:
+    void onSsdpReadyRead();
+    void onNewConnection();
+    void onHttpReadyRead();
+
+};
+
+#endif // SSDPTESTRESPONDER_H
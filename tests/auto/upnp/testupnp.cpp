@@ -0,0 +1,232 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+#include "hardware/network/upnp/upnpdiscoveryimplementation.h"
+#include "ssdptestresponder.h"
+
+#include <QtTest>
+#include <QNetworkAccessManager>
+
+using namespace nymeaserver;
+
+class TestUpnp : public QObject
+{
+    Q_OBJECT
+
+private:
+    SsdpTestResponder *m_responder = nullptr;
+    QNetworkAccessManager *m_networkAccessManager = nullptr;
+    UpnpDiscoveryImplementation *m_upnpDiscovery = nullptr;
+
+    QStringList friendlyNames(UpnpDiscoveryReply *reply) const;
+
+private slots:
+    void init();
+    void cleanup();
+
+    void processAllDatagrams();
+    void deduplicateResponses();
+    void concurrentDiscoveries();
+    void sharedSearchMessages();
+    void cacheMaxAge();
+    void byeByeInvalidatesCache();
+    void resultsMatchSearchTarget();
+
+};
+
+QStringList TestUpnp::friendlyNames(UpnpDiscoveryReply *reply) const
+{
+    QStringList names;
+    foreach (const UpnpDeviceDescriptor &descriptor, reply->deviceDescriptors())
+        names.append(descriptor.friendlyName());
+
+    names.sort();
+    return names;
+}
+
+void TestUpnp::init()
+{
+    m_responder = new SsdpTestResponder(this);
+    m_networkAccessManager = new QNetworkAccessManager(this);
+    m_upnpDiscovery = new UpnpDiscoveryImplementation(m_networkAccessManager, this);
+    m_upnpDiscovery->setMulticastAddress(QHostAddress::LocalHost, m_responder->ssdpPort());
+    QVERIFY(m_upnpDiscovery->enable());
+}
+
+void TestUpnp::cleanup()
+{
+    delete m_upnpDiscovery;
+    m_upnpDiscovery = nullptr;
+    delete m_networkAccessManager;
+    m_networkAccessManager = nullptr;
+    delete m_responder;
+    m_responder = nullptr;
+}
+
+void TestUpnp::processAllDatagrams()
+{
+    m_responder->addDevice("3f1a9a52-0001-4d4e-8c4a-6e796d656101", "Kitchen");
+    m_responder->addDevice("3f1a9a52-0002-4d4e-8c4a-6e796d656101", "Living room");
+    m_responder->addDevice("3f1a9a52-0003-4d4e-8c4a-6e796d656101", "Office");
+
+    UpnpDiscoveryReply *reply = m_upnpDiscovery->discoverDevices("ssdp:all", QString(), 1000);
+    QTRY_VERIFY_WITH_TIMEOUT(reply->isFinished(), 5000);
+
+    QCOMPARE(reply->error(), UpnpDiscoveryReply::UpnpDiscoveryReplyErrorNoError);
+    QCOMPARE(friendlyNames(reply), QStringList() << "Kitchen" << "Living room" << "Office");
+    reply->deleteLater();
+}
+
+void TestUpnp::deduplicateResponses()
+{
+    m_responder->addDevice("3f1a9a52-0001-4d4e-8c4a-6e796d656101", "Kitchen");
+    m_responder->addDevice("3f1a9a52-0002-4d4e-8c4a-6e796d656101", "Living room");
+    m_responder->setResponseRepeat(5);
+
+    UpnpDiscoveryReply *reply = m_upnpDiscovery->discoverDevices("ssdp:all", QString(), 1000);
+    QTRY_VERIFY_WITH_TIMEOUT(reply->isFinished(), 5000);
+
+    QCOMPARE(friendlyNames(reply), QStringList() << "Kitchen" << "Living room");
+    QVERIFY2(m_responder->searchRequestCount() > 1, "Expected the search message to be repeated");
+
+    // Every response has been received several times, but each description only fetched once
+    QCOMPARE(m_responder->descriptionRequestCount(), 2);
+    reply->deleteLater();
+}
+
+void TestUpnp::concurrentDiscoveries()
+{
+    m_responder->addDevice("3f1a9a52-0001-4d4e-8c4a-6e796d656101", "Kitchen");
+    m_responder->addDevice("3f1a9a52-0002-4d4e-8c4a-6e796d656101", "Living room");
+    m_responder->setResponseRepeat(3);
+
+    UpnpDiscoveryReply *firstReply = m_upnpDiscovery->discoverDevices("ssdp:all", QString(), 1000);
+    UpnpDiscoveryReply *secondReply = m_upnpDiscovery->discoverDevices("upnp:rootdevice", QString(), 1000);
+    QTRY_VERIFY_WITH_TIMEOUT(firstReply->isFinished() && secondReply->isFinished(), 5000);
+
+    QCOMPARE(friendlyNames(firstReply), QStringList() << "Kitchen" << "Living room");
+    QCOMPARE(friendlyNames(secondReply), QStringList() << "Kitchen" << "Living room");
+    QCOMPARE(m_responder->descriptionRequestCount(), 2);
+
+    firstReply->deleteLater();
+    secondReply->deleteLater();
+}
+
+void TestUpnp::sharedSearchMessages()
+{
+    m_responder->addDevice("3f1a9a52-0001-4d4e-8c4a-6e796d656101", "Kitchen");
+
+    UpnpDiscoveryReply *firstReply = m_upnpDiscovery->discoverDevices("ssdp:all", QString(), 1000);
+    UpnpDiscoveryReply *secondReply = m_upnpDiscovery->discoverDevices("ssdp:all", QString(), 1000);
+    QTRY_VERIFY_WITH_TIMEOUT(firstReply->isFinished() && secondReply->isFinished(), 5000);
+
+    QCOMPARE(friendlyNames(firstReply), QStringList() << "Kitchen");
+    QCOMPARE(friendlyNames(secondReply), QStringList() << "Kitchen");
+
+    // One initial search message and one for each 500 ms interval, sent once for both discoveries
+    QVERIFY2(m_responder->searchRequestCount() <= 4, QString("Sent %1 search messages").arg(m_responder->searchRequestCount()).toUtf8());
+
+    firstReply->deleteLater();
+    secondReply->deleteLater();
+}
+
+void TestUpnp::cacheMaxAge()
+{
+    QString cachedUuid = "3f1a9a52-0001-4d4e-8c4a-6e796d656101";
+    QString shortLivedUuid = "3f1a9a52-0002-4d4e-8c4a-6e796d656101";
+    m_responder->addDevice(cachedUuid, "Kitchen", 1800);
+    m_responder->addDevice(shortLivedUuid, "Living room", 1);
+
+    UpnpDiscoveryReply *reply = m_upnpDiscovery->discoverDevices("ssdp:all", QString(), 500);
+    QTRY_VERIFY_WITH_TIMEOUT(reply->isFinished(), 5000);
+    QCOMPARE(friendlyNames(reply), QStringList() << "Kitchen" << "Living room");
+    QCOMPARE(m_responder->descriptionRequestCount(cachedUuid), 1);
+    QCOMPARE(m_responder->descriptionRequestCount(shortLivedUuid), 1);
+    reply->deleteLater();
+
+    // Let the short lived description expire
+    QTest::qWait(1500);
+
+    reply = m_upnpDiscovery->discoverDevices("ssdp:all", QString(), 500);
+    QTRY_VERIFY_WITH_TIMEOUT(reply->isFinished(), 5000);
+    QCOMPARE(friendlyNames(reply), QStringList() << "Kitchen" << "Living room");
+    QCOMPARE(m_responder->descriptionRequestCount(cachedUuid), 1);
+    QCOMPARE(m_responder->descriptionRequestCount(shortLivedUuid), 2);
+    reply->deleteLater();
+}
+
+void TestUpnp::byeByeInvalidatesCache()
+{
+    QString uuid = "3f1a9a52-0001-4d4e-8c4a-6e796d656101";
+    m_responder->addDevice(uuid, "Kitchen");
+
+    UpnpDiscoveryReply *reply = m_upnpDiscovery->discoverDevices("ssdp:all", QString(), 500);
+    QTRY_VERIFY_WITH_TIMEOUT(reply->isFinished(), 5000);
+    QCOMPARE(m_responder->descriptionRequestCount(uuid), 1);
+    reply->deleteLater();
+
+    // Any of the announced services leaving invalidates the whole device
+    m_responder->sendByeBye(uuid, "urn:schemas-upnp-org:device:Basic:1");
+    QTest::qWait(200);
+
+    reply = m_upnpDiscovery->discoverDevices("ssdp:all", QString(), 500);
+    QTRY_VERIFY_WITH_TIMEOUT(reply->isFinished(), 5000);
+    QCOMPARE(friendlyNames(reply), QStringList() << "Kitchen");
+    QCOMPARE(m_responder->descriptionRequestCount(uuid), 2);
+    reply->deleteLater();
+}
+
+void TestUpnp::resultsMatchSearchTarget()
+{
+    QString lightType = "urn:schemas-upnp-org:device:DimmableLight:1";
+    m_responder->addDevice("3f1a9a52-0001-4d4e-8c4a-6e796d656101", "Kitchen");
+    m_responder->addDevice("3f1a9a52-0002-4d4e-8c4a-6e796d656101", "Lamp", 1800, lightType);
+
+    // Fetched descriptions only reach the discoveries which received a response for them
+    UpnpDiscoveryReply *allReply = m_upnpDiscovery->discoverDevices("ssdp:all", QString(), 1000);
+    UpnpDiscoveryReply *lightReply = m_upnpDiscovery->discoverDevices(lightType, QString(), 1000);
+    QTRY_VERIFY_WITH_TIMEOUT(allReply->isFinished() && lightReply->isFinished(), 5000);
+    QCOMPARE(friendlyNames(allReply), QStringList() << "Kitchen" << "Lamp");
+    QCOMPARE(friendlyNames(lightReply), QStringList() << "Lamp");
+    allReply->deleteLater();
+    lightReply->deleteLater();
+
+    // Cached descriptions the same way
+    allReply = m_upnpDiscovery->discoverDevices("ssdp:all", QString(), 1000);
+    lightReply = m_upnpDiscovery->discoverDevices(lightType, QString(), 1000);
+    QTRY_VERIFY_WITH_TIMEOUT(allReply->isFinished() && lightReply->isFinished(), 5000);
+    QCOMPARE(friendlyNames(allReply), QStringList() << "Kitchen" << "Lamp");
+    QCOMPARE(friendlyNames(lightReply), QStringList() << "Lamp");
+    QCOMPARE(m_responder->descriptionRequestCount(), 2);
+    allReply->deleteLater();
+    lightReply->deleteLater();
+}
+
+#include "testupnp.moc"
+QTEST_MAIN(TestUpnp)
@@ -0,0 +1,11 @@
+include(../../../nymea.pri)
+include(../autotests.pri)
+
+TARGET = testupnp
+
+SOURCES += \
+    testupnp.cpp \
+    ssdptestresponder.cpp
+
+HEADERS += \
+    ssdptestresponder.h
@@ -30,11 +30,32 @@
 
 #include "nymeatestbase.h"
 #include "nymeacore.h"
+#include "nymeasettings.h"
+#include "servers/httprequest.h"
+#include "loggingcategories.h"
 
 #include <QXmlReader>
+#include <QWebSocket>
 
 using namespace nymeaserver;
 
+// Routes the log through the nymea log writer, which feeds the debug server, while in scope
+class LogWriterScope
+{
+public:
+    LogWriterScope() {
+        m_previousHandler = qInstallMessageHandler(nullptr);
+        initLogging(QString(), false);
+    }
+    ~LogWriterScope() {
+        closeLogFile();
+        qInstallMessageHandler(m_previousHandler);
+    }
+
+private:
+    QtMessageHandler m_previousHandler = nullptr;
+};
+
 class TestWebserver: public NymeaTestBase
 {
     Q_OBJECT
@@ -48,15 +69,27 @@ private slots:
 
     void multiPackageMessage();
 
+    void parseRequestSegments_data();
+    void parseRequestSegments();
+    void parseRequestFuzz();
+    void parseRequestBodyLimit();
+    void parseRequestBenchmark();
+
     void checkAllowedMethodCall_data();
     void checkAllowedMethodCall();
 
     void badRequests_data();
     void badRequests();
 
+    void keepAliveAndPipelining();
+    void pipeliningBackpressure();
+
     void getFiles_data();
     void getFiles();
 
+    void getCachedFiles();
+    void getLargeFiles();
+
     void getServerDescription();
 
     void getIcons_data();
@@ -65,6 +98,16 @@ private slots:
     void getDebugServer_data();
     void getDebugServer();
 
+    void getMetrics();
+
+    void debugLogHistory();
+    void debugLogBatching();
+    void debugLogDroppedLines();
+
+private:
+    void enableDebugServer(bool enabled);
+    QWebSocket *connectDebugLogClient(QStringList *messages);
+
 public slots:
     void onSslErrors(const QList<QSslError> &) {
         qWarning() << "SSL error";
@@ -78,6 +121,16 @@ void TestWebserver::initTestCase()
     NymeaTestBase::initTestCase();
     qDebug() << "TestWebserver starting";
 
+    // Files are only sent with sendfile on unencrypted connections
+    qDebug() << "Creating new unencrypted webserver instance on 127.0.0.1:3334";
+    WebServerConfiguration plainConfig;
+    plainConfig.id = "plain";
+    plainConfig.address = QHostAddress("127.0.0.1");
+    plainConfig.port = 3334;
+    plainConfig.sslEnabled = false;
+    plainConfig.authenticationEnabled = false;
+    NymeaCore::instance()->configuration()->setWebServerConfiguration(plainConfig);
+
     foreach (const WebServerConfiguration &config, NymeaCore::instance()->configuration()->webServerConfigurations()) {
         if (config.port == 3333 && (config.address == QHostAddress("127.0.0.1") || config.address == QHostAddress("0.0.0.0"))) {
             qDebug() << "Already have a webserver listening on 127.0.0.1:3333";
@@ -194,6 +247,190 @@ void TestWebserver::multiPackageMessage()
     socket->deleteLater();
 }
 
+void TestWebserver::parseRequestSegments_data()
+{
+    QTest::addColumn<QByteArray>("data");
+    QTest::addColumn<QByteArray>("expectedPayload");
+
+    QByteArray payload = "{\"id\": 1, \"method\": \"JSONRPC.Hello\"}";
+
+    QByteArray contentLength;
+    contentLength.append("POST /api/v1/things?filter=all HTTP/1.1\r\n");
+    contentLength.append("Host: localhost:3333\r\n");
+    contentLength.append("User-Agent: webserver test\r\n");
+    contentLength.append("content-length: " + QByteArray::number(payload.size()) + "\r\n");
+    contentLength.append("\r\n");
+    contentLength.append(payload);
+
+    QByteArray chunked;
+    chunked.append("POST /api/v1/things?filter=all HTTP/1.1\r\n");
+    chunked.append("Host: localhost:3333\r\n");
+    chunked.append("User-Agent: webserver test\r\n");
+    chunked.append("Transfer-Encoding: chunked\r\n");
+    chunked.append("\r\n");
+    chunked.append(QByteArray::number(10, 16) + ";name=value\r\n" + payload.left(10) + "\r\n");
+    chunked.append(QByteArray::number(payload.size() - 10, 16) + "\r\n" + payload.mid(10) + "\r\n");
+    chunked.append("0\r\n");
+    chunked.append("X-Trailer: done\r\n");
+    chunked.append("\r\n");
+
+    QTest::newRow("content length") << contentLength << payload;
+    QTest::newRow("chunked") << chunked << payload;
+}
+
+void TestWebserver::parseRequestSegments()
+{
+    QFETCH(QByteArray, data);
+    QFETCH(QByteArray, expectedPayload);
+
+    // Split the request into two segments at every possible position
+    for (int i = 0; i <= data.size(); i++) {
+        HttpRequest request(data.left(i));
+        if (i < data.size()) {
+            QVERIFY2(!request.isComplete(), qPrintable(QString("Request complete after %1 of %2 bytes").arg(i).arg(data.size())));
+            request.appendData(data.mid(i));
+        }
+        QVERIFY(request.isComplete());
+        QVERIFY(request.isValid());
+        QCOMPARE(request.method(), HttpRequest::Post);
+        QCOMPARE(request.url().path(), QString("/api/v1/things"));
+        QCOMPARE(request.urlQuery().queryItemValue("filter"), QString("all"));
+        QCOMPARE(request.rawHeaderList().value("User-Agent"), QByteArray("webserver test"));
+        QCOMPARE(request.payload(), expectedPayload);
+        QVERIFY(request.excessData().isEmpty());
+    }
+
+    // Byte by byte, followed by the next request on the same connection
+    HttpRequest request;
+    for (int i = 0; i < data.size(); i++) {
+        request.appendData(data.mid(i, 1));
+    }
+    request.appendData("GET / HTTP/1.1\r\n");
+    QVERIFY(request.isValid());
+    QCOMPARE(request.payload(), expectedPayload);
+    QCOMPARE(request.excessData(), QByteArray("GET / HTTP/1.1\r\n"));
+}
+
+void TestWebserver::parseRequestFuzz()
+{
+    QByteArray data;
+    data.append("PUT /debug?a=b HTTP/1.1\r\n");
+    data.append("User-Agent: webserver test\r\n");
+    data.append("Transfer-Encoding: chunked\r\n");
+    data.append("Content-Length: 5\r\n");
+    data.append("\r\n");
+    data.append("5\r\nhello\r\n0\r\n\r\n");
+
+    // Mutate random bytes and feed the result in random segments. The parser must neither
+    // crash nor hang, and never produce more payload than it got data.
+    qsrand(42);
+    const char alphabet[] = "\r\n :;0123456789abcdefABCDEF-GETPOST/ HTTP/1.1\x00\xff";
+    for (int round = 0; round < 2000; round++) {
+        QByteArray mutated = data;
+        int mutations = qrand() % 4 + 1;
+        for (int i = 0; i < mutations; i++) {
+            int position = qrand() % mutated.size();
+            switch (qrand() % 3) {
+            case 0:
+                mutated[position] = alphabet[qrand() % (sizeof(alphabet) - 1)];
+                break;
+            case 1:
+                mutated.remove(position, 1);
+                break;
+            case 2:
+                mutated.insert(position, alphabet[qrand() % (sizeof(alphabet) - 1)]);
+                break;
+            }
+        }
+
+        HttpRequest request;
+        int position = 0;
+        while (position < mutated.size() && !request.isComplete()) {
+            int length = qrand() % 16 + 1;
+            request.appendData(mutated.mid(position, length));
+            position += length;
+        }
+        QVERIFY(request.payload().size() <= mutated.size());
+        if (!request.isComplete()) {
+            QVERIFY(!request.isValid());
+        }
+    }
+}
+
+void TestWebserver::parseRequestBodyLimit()
+{
+    const qint64 maxBodySize = 16 * 1024 * 1024;
+
+    // A Content-Length above the limit is refused right after the header
+    HttpRequest contentLength("PUT / HTTP/1.1\r\nUser-Agent: webserver test\r\nContent-Length: " + QByteArray::number(maxBodySize + 1) + "\r\n\r\n");
+    QVERIFY(contentLength.isComplete());
+    QVERIFY(!contentLength.isValid());
+
+    // Up to the limit is fine
+    HttpRequest contentLengthLimit("PUT / HTTP/1.1\r\nUser-Agent: webserver test\r\nContent-Length: " + QByteArray::number(maxBodySize) + "\r\n\r\n");
+    QVERIFY(!contentLengthLimit.isComplete());
+
+    // A single chunk above the limit
+    HttpRequest chunk("PUT / HTTP/1.1\r\nUser-Agent: webserver test\r\nTransfer-Encoding: chunked\r\n\r\n" + QByteArray::number(maxBodySize + 1, 16) + "\r\n");
+    QVERIFY(chunk.isComplete());
+    QVERIFY(!chunk.isValid());
+
+    // Huge chunk sizes must not overflow the check
+    HttpRequest hugeChunk("PUT / HTTP/1.1\r\nUser-Agent: webserver test\r\nTransfer-Encoding: chunked\r\n\r\n7fffffffffffffff\r\n");
+    QVERIFY(hugeChunk.isComplete());
+    QVERIFY(!hugeChunk.isValid());
+
+    // Chunks adding up to more than the limit
+    QByteArray chunkData(4 * 1024 * 1024, 'x');
+    HttpRequest chunks("PUT / HTTP/1.1\r\nUser-Agent: webserver test\r\nTransfer-Encoding: chunked\r\n\r\n");
+    for (int i = 0; i < 4; i++) {
+        chunks.appendData(QByteArray::number(chunkData.size(), 16) + "\r\n" + chunkData + "\r\n");
+        QVERIFY(!chunks.isComplete());
+    }
+    chunks.appendData("1\r\n");
+    QVERIFY(chunks.isComplete());
+    QVERIFY(!chunks.isValid());
+
+    // Chunks adding up to exactly the limit are accepted
+    HttpRequest chunksLimit("PUT / HTTP/1.1\r\nUser-Agent: webserver test\r\nTransfer-Encoding: chunked\r\n\r\n");
+    for (int i = 0; i < 4; i++) {
+        chunksLimit.appendData(QByteArray::number(chunkData.size(), 16) + "\r\n" + chunkData + "\r\n");
+    }
+    chunksLimit.appendData("0\r\n\r\n");
+    QVERIFY(chunksLimit.isValid());
+    QCOMPARE(chunksLimit.payload().size(), static_cast<int>(maxBodySize));
+}
+
+void TestWebserver::parseRequestBenchmark()
+{
+    // A typical REST call, as it arrives from the TLS socket in small records
+    QByteArray payload(2048, 'x');
+    QByteArray data;
+    data.append("POST /api/v1/things/execute HTTP/1.1\r\n");
+    data.append("Host: nymea.local:3333\r\n");
+    data.append("User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko)\r\n");
+    data.append("Accept: application/json, text/plain, */*\r\n");
+    data.append("Accept-Encoding: gzip, deflate, br\r\n");
+    data.append("Content-Type: application/json\r\n");
+    data.append("Content-Length: " + QByteArray::number(payload.size()) + "\r\n");
+    data.append("Connection: keep-alive\r\n");
+    data.append("\r\n");
+    data.append(payload);
+
+    QList<QByteArray> segments;
+    for (int i = 0; i < data.size(); i += 64) {
+        segments.append(data.mid(i, 64));
+    }
+
+    QBENCHMARK {
+        HttpRequest request;
+        foreach (const QByteArray &segment, segments) {
+            request.appendData(segment);
+        }
+        QVERIFY(request.isValid());
+    }
+}
+
 void TestWebserver::checkAllowedMethodCall_data()
 {
     QTest::addColumn<QString>("method");
@@ -268,9 +505,9 @@ void TestWebserver::badRequests_data()
     QByteArray wrongContentLength;
     wrongContentLength.append("PUT / HTTP/1.1\r\n");
     wrongContentLength.append("User-Agent: webserver test\r\n");
-    wrongContentLength.append("Content-Length: 1\r\n");
+    wrongContentLength.append("Content-Length: one\r\n");
     wrongContentLength.append("\r\n");
-    wrongContentLength.append("longer content than told in the header");
+    wrongContentLength.append("content with an invalid length in the header");
 
     QByteArray wrongHeaderFormatting;
     wrongHeaderFormatting.append("PUT / HTTP/1.1\r\n");
@@ -326,6 +563,116 @@ void TestWebserver::badRequests()
     socket->deleteLater();
 }
 
+void TestWebserver::keepAliveAndPipelining()
+{
+    QSslSocket *socket = new QSslSocket(this);
+    typedef void (QSslSocket:: *sslErrorsSignal)(const QList<QSslError> &);
+    connect(socket, static_cast<sslErrorsSignal>(&QSslSocket::sslErrors), this, &TestWebserver::onSslErrors);
+    socket->connectToHostEncrypted("127.0.0.1", 3333);
+    QSignalSpy encryptedSpy(socket, SIGNAL(encrypted()));
+    bool encrypted = encryptedSpy.wait();
+    QVERIFY2(encrypted, "could not created encrypte webserver connection.");
+
+    QSignalSpy disconnectedSpy(socket, SIGNAL(disconnected()));
+
+    // Two pipelined requests in one package, the replies have to arrive in the same order
+    QByteArray requestData;
+    requestData.append("GET /server.xml HTTP/1.1\r\n");
+    requestData.append("User-Agent: webserver test\r\n");
+    requestData.append("\r\n");
+    requestData.append("GET /this/file/does/not/exist.html HTTP/1.1\r\n");
+    requestData.append("User-Agent: webserver test\r\n");
+    requestData.append("\r\n");
+    socket->write(requestData);
+
+    QByteArray data;
+    while (data.count("HTTP/1.1 ") < 2 && socket->waitForReadyRead(1000))
+        data.append(socket->readAll());
+
+    int firstReply = data.indexOf("HTTP/1.1 200");
+    int secondReply = data.indexOf("HTTP/1.1 404");
+    QVERIFY2(firstReply >= 0, "missing reply for the first request");
+    QVERIFY2(secondReply > firstReply, "replies not sent in request order");
+    QVERIFY(data.contains("Keep-Alive: timeout="));
+    QCOMPARE(socket->state(), QAbstractSocket::ConnectedState);
+
+    // The connection is closed after the reply to a request asking for it
+    requestData.clear();
+    requestData.append("GET /server.xml HTTP/1.1\r\n");
+    requestData.append("User-Agent: webserver test\r\n");
+    requestData.append("Connection: close\r\n");
+    requestData.append("\r\n");
+    socket->write(requestData);
+
+    if (disconnectedSpy.isEmpty())
+        disconnectedSpy.wait();
+    QCOMPARE(disconnectedSpy.count(), 1);
+
+    data = socket->readAll();
+    QVERIFY2(data.startsWith("HTTP/1.1 200"), "got no response before the connection was closed");
+    QVERIFY(data.contains("Connection: close"));
+
+    socket->deleteLater();
+}
+
+void TestWebserver::pipeliningBackpressure()
+{
+    // Big files keep their replies pending as long as the client doesn't read
+    QByteArray content;
+    for (int i = 0; i < 1024 * 1024; i++) {
+        content.append(static_cast<char>(i % 251));
+    }
+    QFile file(QCoreApplication::applicationDirPath() + "/pipelining.bin");
+    QVERIFY(file.open(QFile::WriteOnly | QFile::Truncate));
+    file.write(content);
+    file.close();
+
+    QTcpSocket socket;
+    socket.connectToHost(QHostAddress::LocalHost, 3334);
+    QVERIFY(socket.waitForConnected());
+    socket.setReadBufferSize(64 * 1024);
+
+    // More pipelined requests than the server keeps pending. It stops reading them until
+    // the client catches up and has to resume afterwards.
+    const int requestCount = 40;
+    QByteArray requestData;
+    for (int i = 0; i < requestCount; i++) {
+        requestData.append("GET /pipelining.bin HTTP/1.1\r\nUser-Agent: webserver test\r\n\r\n");
+    }
+    socket.write(requestData);
+    QVERIFY(socket.waitForBytesWritten());
+    QTest::qWait(500);
+    socket.setReadBufferSize(0);
+
+    int replies = 0;
+    QByteArray data;
+    QRegExp contentLength("Content-Length: (\\d+)");
+    while (replies < requestCount && socket.waitForReadyRead(5000)) {
+        data.append(socket.readAll());
+        forever {
+            int headerEnd = data.indexOf("\r\n\r\n");
+            if (headerEnd < 0)
+                break;
+
+            QString header = QString::fromUtf8(data.left(headerEnd));
+            QVERIFY2(header.startsWith("HTTP/1.1 200"), qUtf8Printable(header));
+            QVERIFY(contentLength.indexIn(header) >= 0);
+            int bodySize = contentLength.cap(1).toInt();
+            QCOMPARE(bodySize, content.size());
+            if (data.size() < headerEnd + 4 + bodySize)
+                break;
+
+            QVERIFY2(data.mid(headerEnd + 4, bodySize) == content, "reply content does not match the file");
+            data.remove(0, headerEnd + 4 + bodySize);
+            replies++;
+        }
+    }
+    QCOMPARE(replies, requestCount);
+    QCOMPARE(socket.state(), QAbstractSocket::ConnectedState);
+
+    QFile::remove(file.fileName());
+}
+
 void TestWebserver::getFiles_data()
 {
     QTest::addColumn<QString>("query");
@@ -367,6 +714,167 @@ void TestWebserver::getFiles()
     reply->deleteLater();
 }
 
+void TestWebserver::getCachedFiles()
+{
+    QFile file(QCoreApplication::applicationDirPath() + "/cachetest.html");
+    QVERIFY(file.open(QFile::WriteOnly | QFile::Truncate));
+    file.write("<html>first version</html>");
+    file.close();
+    QFile::remove(file.fileName() + ".gz");
+
+    QSslSocket *socket = new QSslSocket(this);
+    typedef void (QSslSocket:: *sslErrorsSignal)(const QList<QSslError> &);
+    connect(socket, static_cast<sslErrorsSignal>(&QSslSocket::sslErrors), this, &TestWebserver::onSslErrors);
+    socket->connectToHostEncrypted("127.0.0.1", 3333);
+    QSignalSpy encryptedSpy(socket, SIGNAL(encrypted()));
+    bool encrypted = encryptedSpy.wait();
+    QVERIFY2(encrypted, "could not created encrypte webserver connection.");
+
+    auto get = [socket](const QByteArray &extraHeaders) -> QByteArray {
+        socket->write("GET /cachetest.html HTTP/1.1\r\nUser-Agent: webserver test\r\n" + extraHeaders + "\r\n");
+        QByteArray data;
+        while (socket->waitForReadyRead(1000)) {
+            data.append(socket->readAll());
+            int headerEnd = data.indexOf("\r\n\r\n");
+            QRegExp contentLength("Content-Length: (\\d+)");
+            if (headerEnd >= 0 && (contentLength.indexIn(data) < 0 || data.size() >= headerEnd + 4 + contentLength.cap(1).toInt()))
+                break;
+        }
+        return data;
+    };
+
+    QByteArray data = get(QByteArray());
+    QVERIFY2(data.startsWith("HTTP/1.1 200"), data.constData());
+    QVERIFY(data.endsWith("<html>first version</html>"));
+    QRegExp etagExpression("ETag: (\"[^\"]+\")");
+    QVERIFY(etagExpression.indexIn(data) >= 0);
+    QByteArray etag = etagExpression.cap(1).toUtf8();
+    QVERIFY(data.contains("Last-Modified: "));
+
+    // A matching ETag results in 304 without a body
+    data = get("If-None-Match: " + etag + "\r\n");
+    QVERIFY2(data.startsWith("HTTP/1.1 304"), data.constData());
+    QVERIFY(data.endsWith("\r\n\r\n"));
+
+    // Changing the file invalidates the cached content and the ETag
+    QVERIFY(file.open(QFile::WriteOnly | QFile::Truncate));
+    file.write("<html>second, longer version</html>");
+    file.close();
+    data = get("If-None-Match: " + etag + "\r\n");
+    QVERIFY2(data.startsWith("HTTP/1.1 200"), data.constData());
+    QVERIFY(data.endsWith("<html>second, longer version</html>"));
+
+    // The precompressed file is only sent to clients accepting gzip
+    QFile gzipFile(file.fileName() + ".gz");
+    QVERIFY(gzipFile.open(QFile::WriteOnly | QFile::Truncate));
+    gzipFile.write("gzip data");
+    gzipFile.close();
+    data = get("Accept-Encoding: gzip, deflate\r\n");
+    QVERIFY2(data.startsWith("HTTP/1.1 200"), data.constData());
+    QVERIFY(data.contains("Content-Encoding: gzip"));
+    QVERIFY(data.endsWith("gzip data"));
+
+    data = get("Accept-Encoding: gzip;q=0\r\n");
+    QVERIFY2(data.startsWith("HTTP/1.1 200"), data.constData());
+    QVERIFY(!data.contains("Content-Encoding: gzip"));
+    QVERIFY(data.endsWith("<html>second, longer version</html>"));
+
+    socket->close();
+    socket->deleteLater();
+    QFile::remove(file.fileName());
+    QFile::remove(gzipFile.fileName());
+}
+
+void TestWebserver::getLargeFiles()
+{
+    // Files above 512 KiB are not cached and sent with sendfile on unencrypted connections
+    QByteArray content;
+    for (int i = 0; i < 32 * 1024 * 1024; i++) {
+        content.append(static_cast<char>(i % 251));
+    }
+    QFile file(QCoreApplication::applicationDirPath() + "/largetest.bin");
+    QVERIFY(file.open(QFile::WriteOnly | QFile::Truncate));
+    file.write(content.left(2 * 1024 * 1024));
+    file.close();
+
+    QTcpSocket socket;
+    socket.connectToHost(QHostAddress::LocalHost, 3334);
+    QVERIFY(socket.waitForConnected());
+
+    // Reads one reply, or everything until the server closes the connection
+    auto get = [&socket](const QByteArray &extraHeaders) -> QByteArray {
+        socket.write("GET /largetest.bin HTTP/1.1\r\nUser-Agent: webserver test\r\n" + extraHeaders + "\r\n");
+        QByteArray data = socket.readAll();
+        QRegExp contentLength("Content-Length: (\\d+)");
+        forever {
+            int headerEnd = data.indexOf("\r\n\r\n");
+            if (headerEnd >= 0 && (contentLength.indexIn(data.left(headerEnd)) < 0 || data.size() >= headerEnd + 4 + contentLength.cap(1).toInt()))
+                break;
+            if (!socket.waitForReadyRead(5000))
+                break;
+            data.append(socket.readAll());
+        }
+        return data;
+    };
+
+    QByteArray data = get(QByteArray());
+    QVERIFY2(data.startsWith("HTTP/1.1 200"), data.left(200).constData());
+    QVERIFY(data.contains("Content-Length: 2097152\r\n"));
+    QVERIFY(data.endsWith(content.left(2 * 1024 * 1024)));
+    QRegExp etagExpression("ETag: (\"[^\"]+\")");
+    QVERIFY(etagExpression.indexIn(data) >= 0);
+    QByteArray etag = etagExpression.cap(1).toUtf8();
+
+    // The connection is kept alive after a file sent with sendfile
+    data = get("If-None-Match: " + etag + "\r\n");
+    QVERIFY2(data.startsWith("HTTP/1.1 304"), data.constData());
+
+    // A file bigger than the kernel buffers, while the client doesn't read. Once the kernel
+    // buffer is full, the rest is queued through the socket.
+    QVERIFY(file.open(QFile::WriteOnly | QFile::Truncate));
+    file.write(content);
+    file.close();
+    socket.setReadBufferSize(64 * 1024);
+    socket.write("GET /largetest.bin HTTP/1.1\r\nUser-Agent: webserver test\r\n\r\n");
+    QTest::qWait(500);
+    socket.setReadBufferSize(0);
+    data = socket.readAll();
+    int headerEnd = -1;
+    while ((headerEnd = data.indexOf("\r\n\r\n")) < 0 || data.size() < headerEnd + 4 + content.size()) {
+        if (!socket.waitForReadyRead(5000))
+            break;
+        data.append(socket.readAll());
+    }
+    QVERIFY(data.startsWith("HTTP/1.1 200"));
+    QVERIFY(data.left(headerEnd).contains("Content-Length: 33554432"));
+    QCOMPARE(data.size(), headerEnd + 4 + content.size());
+    QVERIFY2(data.mid(headerEnd + 4) == content, "file content does not match");
+
+    // The following request on the same connection still works
+    data = get("If-None-Match: \"other\"\r\n");
+    QVERIFY2(data.startsWith("HTTP/1.1 200"), data.left(200).constData());
+    QVERIFY(data.endsWith(content));
+
+    // If the file gets truncated during the transfer, the announced Content-Length can't be
+    // kept. The server has to close the connection.
+    QSignalSpy disconnectedSpy(&socket, &QTcpSocket::disconnected);
+    socket.setReadBufferSize(64 * 1024);
+    socket.write("GET /largetest.bin HTTP/1.1\r\nUser-Agent: webserver test\r\n\r\n");
+    QTest::qWait(500);
+    QVERIFY(file.resize(1024));
+    socket.setReadBufferSize(0);
+    data = socket.readAll();
+    while (socket.state() == QAbstractSocket::ConnectedState && socket.waitForReadyRead(5000)) {
+        data.append(socket.readAll());
+    }
+    data.append(socket.readAll());
+    QTRY_COMPARE(disconnectedSpy.count(), 1);
+    QVERIFY(data.startsWith("HTTP/1.1 200"));
+    QVERIFY(data.size() < content.size());
+
+    QFile::remove(file.fileName());
+}
+
 void TestWebserver::getServerDescription()
 {
     QNetworkAccessManager nam;
@@ -634,5 +1142,204 @@ void TestWebserver::getDebugServer()
     QCOMPARE(statusCode, expectedStatusCode);
 }
 
+void TestWebserver::getMetrics()
+{
+    QNetworkAccessManager nam;
+    connect(&nam, &QNetworkAccessManager::sslErrors, [this, &nam](QNetworkReply* reply, const QList<QSslError> &) {
+        reply->ignoreSslErrors();
+    });
+    QSignalSpy clientSpy(&nam, SIGNAL(finished(QNetworkReply*)));
+
+    QNetworkRequest request;
+    request.setUrl(QUrl("https://localhost:3333/metrics"));
+
+    // Disabled by default
+    QNetworkReply *reply = nam.get(request);
+    clientSpy.wait();
+    QVERIFY2(clientSpy.count() == 1, "expected exactly 1 response from webserver");
+    QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 404);
+    reply->deleteLater();
+
+    NymeaSettings settings(NymeaSettings::SettingsRoleGlobal);
+    settings.beginGroup("nymead");
+    settings.setValue("metricsEnabled", true);
+    settings.sync();
+
+    // Make sure there is at least one observed call
+    injectAndWait("JSONRPC.Hello");
+
+    clientSpy.clear();
+    reply = nam.get(request);
+    clientSpy.wait();
+    QVERIFY2(clientSpy.count() == 1, "expected exactly 1 response from webserver");
+    QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 200);
+    QVERIFY(reply->header(QNetworkRequest::ContentTypeHeader).toString().startsWith("text/plain"));
+
+    QByteArray data = reply->readAll();
+    reply->deleteLater();
+    QVERIFY2(data.contains("# TYPE nymea_jsonrpc_call_duration_seconds histogram"), data);
+    QVERIFY2(data.contains("nymea_jsonrpc_call_duration_seconds_count{method=\"JSONRPC.Hello\"}"), data);
+    QVERIFY2(data.contains("# TYPE nymea_rule_evaluations_total counter"), data);
+    QVERIFY2(data.contains("process_resident_memory_bytes"), data);
+
+    // Only GET is allowed
+    clientSpy.clear();
+    reply = nam.post(request, "");
+    clientSpy.wait();
+    QVERIFY2(clientSpy.count() == 1, "expected exactly 1 response from webserver");
+    QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 405);
+    reply->deleteLater();
+
+    settings.setValue("metricsEnabled", false);
+    settings.endGroup();
+}
+
+void TestWebserver::debugLogHistory()
+{
+    LogWriterScope logWriter;
+    enableDebugServer(true);
+
+    qCWarning(dcTests()) << "Debug log history marker";
+    // Give the log writer thread some time to pass it on
+    QTest::qWait(300);
+
+    QStringList firstMessages;
+    QWebSocket *firstClient = connectDebugLogClient(&firstMessages);
+    QTRY_VERIFY(firstMessages.join(QString()).contains("Debug log history marker"));
+
+    qCWarning(dcTests()) << "Debug log live marker";
+    QTRY_VERIFY(firstMessages.join(QString()).contains("Debug log live marker"));
+
+    // A client connecting while lines are waiting for the next batch gets them once
+    qCWarning(dcTests()) << "Debug log pending marker";
+    QTest::qWait(20);
+    QStringList secondMessages;
+    QWebSocket *secondClient = connectDebugLogClient(&secondMessages);
+    QTRY_VERIFY(secondMessages.join(QString()).contains("Debug log pending marker"));
+    QTRY_VERIFY(firstMessages.join(QString()).contains("Debug log pending marker"));
+
+    QTest::qWait(500);
+    QCOMPARE(firstMessages.join(QString()).count("Debug log history marker"), 1);
+    QCOMPARE(firstMessages.join(QString()).count("Debug log live marker"), 1);
+    QCOMPARE(firstMessages.join(QString()).count("Debug log pending marker"), 1);
+    QCOMPARE(secondMessages.join(QString()).count("Debug log pending marker"), 1);
+
+    // Disabling the debug server closes the connections
+    enableDebugServer(false);
+    QTRY_COMPARE(firstClient->state(), QAbstractSocket::UnconnectedState);
+    QTRY_COMPARE(secondClient->state(), QAbstractSocket::UnconnectedState);
+    delete firstClient;
+    delete secondClient;
+}
+
+void TestWebserver::debugLogBatching()
+{
+    LogWriterScope logWriter;
+    enableDebugServer(true);
+
+    QStringList messages;
+    QWebSocket *client = connectDebugLogClient(&messages);
+    QTRY_VERIFY(!messages.isEmpty());
+    QTest::qWait(500);
+    messages.clear();
+
+    for (int i = 0; i < 50; i++) {
+        qCWarning(dcTests()) << "Debug log batch line" << i;
+    }
+    QTRY_VERIFY(messages.join(QString()).contains("Debug log batch line 49"));
+
+    // Lines are sent every 200 ms, not one by one
+    int batches = 0;
+    foreach (const QString &message, messages) {
+        if (message.contains("Debug log batch line")) {
+            batches++;
+        }
+    }
+    QVERIFY2(batches <= 2, QString("The lines have been sent in %1 messages").arg(batches).toUtf8());
+
+    QString allMessages = messages.join(QString());
+    int position = 0;
+    for (int i = 0; i < 50; i++) {
+        position = allMessages.indexOf(QString("Debug log batch line %1\n").arg(i), position);
+        QVERIFY2(position >= 0, QString("Line %1 missing or out of order").arg(i).toUtf8());
+    }
+
+    enableDebugServer(false);
+    delete client;
+}
+
+void TestWebserver::debugLogDroppedLines()
+{
+    LogWriterScope logWriter;
+    enableDebugServer(true);
+
+    // A client reading everything
+    QStringList messages;
+    QWebSocket *client = connectDebugLogClient(&messages);
+
+    // A client which stops reading right after the handshake
+    QTcpSocket slowClient;
+    slowClient.connectToHost(QHostAddress::LocalHost, 2626);
+    QVERIFY(slowClient.waitForConnected());
+    slowClient.setSocketOption(QAbstractSocket::ReceiveBufferSizeSocketOption, 4096);
+    slowClient.write("GET / HTTP/1.1\r\n"
+                     "Host: 127.0.0.1:2626\r\n"
+                     "Upgrade: websocket\r\n"
+                     "Connection: Upgrade\r\n"
+                     "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                     "Sec-WebSocket-Version: 13\r\n\r\n");
+    QByteArray slowData;
+    QTRY_VERIFY([&slowClient, &slowData](){ slowData.append(slowClient.readAll()); return slowData.contains("\r\n\r\n"); }());
+    QVERIFY2(slowData.startsWith("HTTP/1.1 101"), slowData);
+    slowClient.setReadBufferSize(4096);
+
+    // Log more than the kernel buffers and the allowed pending bytes
+    QString payload(4000, 'x');
+    for (int i = 0; i < 1250; i++) {
+        qCWarning(dcTests()) << "Debug log flood" << i << payload;
+        if (i % 100 == 0) {
+            QTest::qWait(50);
+        }
+    }
+
+    // Once the slow client reads again, it is told how many lines it missed
+    slowClient.setReadBufferSize(0);
+    QTRY_VERIFY_WITH_TIMEOUT([&slowClient, &slowData](){
+        qCWarning(dcTests()) << "Debug log trigger";
+        slowData.append(slowClient.readAll());
+        return slowData.contains("log lines dropped because the connection is too slow");
+    }(), 30000);
+    QRegExp dropExp("(\\d+) log lines dropped");
+    QVERIFY(dropExp.indexIn(QString::fromUtf8(slowData)) >= 0);
+    QVERIFY(dropExp.cap(1).toInt() > 0);
+
+    // The other client got everything
+    QTRY_VERIFY_WITH_TIMEOUT(messages.join(QString()).contains("Debug log flood 1249"), 10000);
+    QVERIFY2(!messages.join(QString()).contains("log lines dropped"), "Lines have been dropped for the client reading everything");
+
+    enableDebugServer(false);
+    delete client;
+}
+
+void TestWebserver::enableDebugServer(bool enabled)
+{
+    QVariantMap params;
+    params.insert("enabled", enabled);
+    QVariant response = injectAndWait("Configuration.SetDebugServerEnabled", params);
+    verifyError(response, "configurationError", "ConfigurationErrorNoError");
+}
+
+QWebSocket *TestWebserver::connectDebugLogClient(QStringList *messages)
+{
+    QWebSocket *client = new QWebSocket();
+    connect(client, &QWebSocket::textMessageReceived, this, [messages](const QString &message){
+        messages->append(message);
+    });
+    QSignalSpy connectedSpy(client, &QWebSocket::connected);
+    client->open(QUrl("ws://127.0.0.1:2626"));
+    connectedSpy.wait();
+    return client;
+}
+
 #include "testwebserver.moc"
 QTEST_MAIN(TestWebserver)
@@ -1,7 +1,7 @@
 include(../../../nymea.pri)
 include(../autotests.pri)
 
-QT += xml
+QT += xml websockets
 
 TARGET = webserver
 SOURCES += testwebserver.cpp
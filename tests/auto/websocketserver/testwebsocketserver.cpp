@@ -31,8 +31,11 @@
 #include "nymeatestbase.h"
 #include "nymeacore.h"
 #include "version.h"
+#include "servers/tlssessioncache.h"
 
 #include <QWebSocket>
+#include <QSslSocket>
+#include <QElapsedTimer>
 
 using namespace nymeaserver;
 
@@ -52,6 +55,8 @@ private slots:
 
     void introspect();
 
+    void benchmarkReconnectHandshake();
+
 public slots:
     void sslErrors(const QList<QSslError> &) {
         QWebSocket *socket = static_cast<QWebSocket*>(sender());
@@ -63,6 +68,7 @@ private:
 
     QVariant injectSocketAndWait(const QString &method, const QVariantMap &params = QVariantMap());
     QVariant injectSocketData(const QByteArray &data);
+    qint64 measureHandshake(QSslConfiguration &configuration);
 };
 
 
@@ -172,6 +178,66 @@ void TestWebSocketServer::introspect()
 
 }
 
+void TestWebSocketServer::benchmarkReconnectHandshake()
+{
+    const int rounds = 20;
+
+    QSslConfiguration configuration = QSslConfiguration::defaultConfiguration();
+    configuration.setPeerVerifyMode(QSslSocket::VerifyNone);
+    // TLS 1.3 tickets only arrive after the handshake, 1.2 hands out the session right away
+    configuration.setProtocol(QSsl::TlsV1_2);
+    configuration.setSslOption(QSsl::SslOptionDisableSessionPersistence, false);
+
+    // Clients not presenting a session get a full handshake, like every reconnect did before
+    qint64 fullHandshakes = 0;
+    for (int i = 0; i < rounds; i++) {
+        QSslConfiguration freshConfiguration = configuration;
+        qint64 duration = measureHandshake(freshConfiguration);
+        QVERIFY2(duration >= 0, "TLS handshake failed");
+        fullHandshakes += duration;
+    }
+
+    // Reconnect with the session of the previous connection
+    quint64 resumedBefore = TlsSessionCache::instance()->resumedSessions();
+    QVERIFY2(measureHandshake(configuration) >= 0, "TLS handshake failed");
+    QVERIFY2(!configuration.sessionTicket().isEmpty(), "Server did not hand out a TLS session");
+    qint64 resumedHandshakes = 0;
+    for (int i = 0; i < rounds; i++) {
+        qint64 duration = measureHandshake(configuration);
+        QVERIFY2(duration >= 0, "TLS handshake failed");
+        resumedHandshakes += duration;
+    }
+    quint64 resumed = TlsSessionCache::instance()->resumedSessions() - resumedBefore;
+
+    qDebug() << "Full TLS handshake:" << fullHandshakes / rounds / 1000 << "us";
+    qDebug() << "Resumed TLS handshake:" << resumedHandshakes / rounds / 1000 << "us";
+    QVERIFY2(resumed >= static_cast<quint64>(rounds), QString("Only %1 of %2 reconnects resumed their TLS session").arg(resumed).arg(rounds).toUtf8().constData());
+}
+
+qint64 TestWebSocketServer::measureHandshake(QSslConfiguration &configuration)
+{
+    QSslSocket socket;
+    socket.setSslConfiguration(configuration);
+    QSignalSpy encryptedSpy(&socket, &QSslSocket::encrypted);
+
+    QElapsedTimer timer;
+    timer.start();
+    socket.connectToHostEncrypted("127.0.0.1", 4444);
+    if (!encryptedSpy.wait()) {
+        return -1;
+    }
+    qint64 duration = timer.nsecsElapsed();
+
+    // Keep the session for the next connection
+    configuration.setSessionTicket(socket.sslConfiguration().sessionTicket());
+
+    socket.disconnectFromHost();
+    if (socket.state() != QAbstractSocket::UnconnectedState) {
+        socket.waitForDisconnected(1000);
+    }
+    return duration;
+}
+
 QVariant TestWebSocketServer::injectSocketAndWait(const QString &method, const QVariantMap &params)
 {
     QVariantMap call;
@@ -60,6 +60,7 @@ void NymeaTestBase::initTestCase()
     // If testcase asserts cleanup won't do. Lets clear any previous test run settings leftovers
     NymeaSettings rulesSettings(NymeaSettings::SettingsRoleRules);
     rulesSettings.clear();
+    QFile::remove(NymeaSettings::settingsPath() + "/rules.sqlite");
     NymeaSettings thingSettings(NymeaSettings::SettingsRoleThings);
     thingSettings.clear();
     NymeaSettings pluginSettings(NymeaSettings::SettingsRolePlugins);
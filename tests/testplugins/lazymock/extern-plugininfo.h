@@ -0,0 +1,22 @@
+/* This file is generated by the nymea build system. Any changes to this file will *
+ * be lost. If you want to change this file, edit the plugin's json file.          */
+
+#ifndef EXTERNPLUGININFO_H
+#define EXTERNPLUGININFO_H
+
+#include "typeutils.h"
+
+#include <QLoggingCategory>
+
+Q_DECLARE_LOGGING_CATEGORY(dcLazyMock)
+
+extern PluginId pluginId;
+extern VendorId nymeaTestsVendorId;
+extern ThingClassId lazyMockThingClassId;
+extern StateTypeId lazyMockPowerStateTypeId;
+extern EventTypeId lazyMockPowerEventTypeId;
+extern ParamTypeId lazyMockPowerEventPowerParamTypeId;
+extern ActionTypeId lazyMockPowerActionTypeId;
+extern ParamTypeId lazyMockPowerActionPowerParamTypeId;
+
+#endif // EXTERNPLUGININFO_H
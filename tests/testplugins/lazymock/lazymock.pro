@@ -0,0 +1,21 @@
+include(../../../nymea.pri)
+
+TEMPLATE = lib
+CONFIG += plugin
+
+QT += network
+
+INCLUDEPATH += $$top_srcdir/libnymea
+LIBS += -L$$top_builddir/libnymea -lnymea
+
+TARGET = $$qtLibraryTarget(nymea_integrationpluginlazymock)
+
+OTHER_FILES += integrationpluginlazymock.json
+
+HEADERS += \
+    integrationpluginlazymock.h \
+    plugininfo.h \
+    extern-plugininfo.h
+
+SOURCES += \
+    integrationpluginlazymock.cpp
@@ -0,0 +1,52 @@
+/* This file is generated by the nymea build system. Any changes to this file will *
+ * be lost. If you want to change this file, edit the plugin's json file.          */
+
+#ifndef PLUGININFO_H
+#define PLUGININFO_H
+
+#include "typeutils.h"
+
+#include <QLoggingCategory>
+#include <QObject>
+
+extern "C" const QString libnymea_api_version() { return QString("7.0.0");}
+
+Q_DECLARE_LOGGING_CATEGORY(dcLazyMock)
+Q_LOGGING_CATEGORY(dcLazyMock, "LazyMock")
+
+PluginId pluginId = PluginId("{37a2d7f3-43b6-4ec8-a481-f2b758ec7565}");
+VendorId nymeaTestsVendorId = VendorId("{7589c59a-e1a1-4d79-be95-60d3243a7338}");
+ThingClassId lazyMockThingClassId = ThingClassId("{01a2f0d8-7b67-4a75-806f-c0a57c59f233}");
+StateTypeId lazyMockPowerStateTypeId = StateTypeId("{c307b6e5-fe12-423a-a6d2-2c0041d911e5}");
+EventTypeId lazyMockPowerEventTypeId = EventTypeId("{c307b6e5-fe12-423a-a6d2-2c0041d911e5}");
+ParamTypeId lazyMockPowerEventPowerParamTypeId = ParamTypeId("{c307b6e5-fe12-423a-a6d2-2c0041d911e5}");
+ActionTypeId lazyMockPowerActionTypeId = ActionTypeId("{c307b6e5-fe12-423a-a6d2-2c0041d911e5}");
+ParamTypeId lazyMockPowerActionPowerParamTypeId = ParamTypeId("{c307b6e5-fe12-423a-a6d2-2c0041d911e5}");
+
+const QString translations[] {
+    //: The name of the plugin lazyMock ({37a2d7f3-43b6-4ec8-a481-f2b758ec7565})
+    QT_TRANSLATE_NOOP("lazyMock", "Lazily loaded mock"),
+
+    //: The name of the ThingClass ({01a2f0d8-7b67-4a75-806f-c0a57c59f233})
+    QT_TRANSLATE_NOOP("lazyMock", "Lazy mock"),
+
+    //: The name of the vendor ({7589c59a-e1a1-4d79-be95-60d3243a7338})
+    QT_TRANSLATE_NOOP("lazyMock", "nymea tests"),
+
+    //: The name of the ParamType (ThingClass: lazyMock, ActionType: power, ID: {c307b6e5-fe12-423a-a6d2-2c0041d911e5})
+    QT_TRANSLATE_NOOP("lazyMock", "powered"),
+
+    //: The name of the ParamType (ThingClass: lazyMock, EventType: power, ID: {c307b6e5-fe12-423a-a6d2-2c0041d911e5})
+    QT_TRANSLATE_NOOP("lazyMock", "powered"),
+
+    //: The name of the StateType ({c307b6e5-fe12-423a-a6d2-2c0041d911e5}) of ThingClass lazyMock
+    QT_TRANSLATE_NOOP("lazyMock", "powered"),
+
+    //: The name of the EventType ({c307b6e5-fe12-423a-a6d2-2c0041d911e5}) of ThingClass lazyMock
+    QT_TRANSLATE_NOOP("lazyMock", "powered changed"),
+
+    //: The name of the ActionType ({c307b6e5-fe12-423a-a6d2-2c0041d911e5}) of ThingClass lazyMock
+    QT_TRANSLATE_NOOP("lazyMock", "set power")
+};
+
+#endif // PLUGININFO_H
@@ -0,0 +1,4 @@
+TEMPLATE = subdirs
+
+# Plugins only loaded by tests which add this directory to NYMEA_PLUGINS_PATH
+SUBDIRS = lazymock threadedmock
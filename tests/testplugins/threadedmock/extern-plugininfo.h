@@ -0,0 +1,27 @@
+/* This file is generated by the nymea build system. Any changes to this file will *
+ * be lost. If you want to change this file, edit the plugin's json file.          */
+
+#ifndef EXTERNPLUGININFO_H
+#define EXTERNPLUGININFO_H
+
+#include "typeutils.h"
+
+#include <QLoggingCategory>
+
+Q_DECLARE_LOGGING_CATEGORY(dcThreadedMock)
+
+extern PluginId pluginId;
+extern ParamTypeId threadedMockPluginIntervalParamTypeId;
+extern VendorId nymeaTestsVendorId;
+extern ThingClassId threadedMockThingClassId;
+extern StateTypeId threadedMockPowerStateTypeId;
+extern StateTypeId threadedMockTicksStateTypeId;
+extern EventTypeId threadedMockPowerEventTypeId;
+extern ParamTypeId threadedMockPowerEventPowerParamTypeId;
+extern EventTypeId threadedMockTicksEventTypeId;
+extern ParamTypeId threadedMockTicksEventTicksParamTypeId;
+extern ActionTypeId threadedMockPowerActionTypeId;
+extern ParamTypeId threadedMockPowerActionPowerParamTypeId;
+extern ActionTypeId threadedMockFinishLaterActionTypeId;
+
+#endif // EXTERNPLUGININFO_H
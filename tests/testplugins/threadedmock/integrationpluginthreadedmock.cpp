@@ -0,0 +1,111 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "integrationpluginthreadedmock.h"
+#include "integrations/thing.h"
+#include "integrations/thingsetupinfo.h"
+#include "integrations/thingactioninfo.h"
+#include "hardwaremanager.h"
+#include "plugininfo.h"
+
+#include <QCoreApplication>
+#include <QThread>
+#include <QTimer>
+
+IntegrationPluginThreadedMock::IntegrationPluginThreadedMock()
+{
+
+}
+
+void IntegrationPluginThreadedMock::setupThing(ThingSetupInfo *info)
+{
+    if (!inPluginThread()) {
+        info->finish(Thing::ThingErrorHardwareFailure, "Not called in the plugin thread.");
+        return;
+    }
+
+    qCDebug(dcThreadedMock()) << "Setting up" << info->thing()->name();
+
+    // Registered from the plugin thread, so the timer expires in there
+    Thing *thing = info->thing();
+    PluginTimer *timer = hardwareManager()->pluginTimerManager()->registerTimerMSecs(configValue(threadedMockPluginIntervalParamTypeId).toInt());
+    connect(timer, &PluginTimer::timeout, this, [this, thing](){
+        if (!inPluginThread()) {
+            qCWarning(dcThreadedMock()) << "Timer expired outside the plugin thread";
+            return;
+        }
+        thing->setStateValue(threadedMockTicksStateTypeId, thing->stateValue(threadedMockTicksStateTypeId).toInt() + 1);
+    });
+    m_timers.insert(thing, timer);
+
+    info->finish(Thing::ThingErrorNoError);
+}
+
+void IntegrationPluginThreadedMock::thingRemoved(Thing *thing)
+{
+    // The thing must still be valid while the plugin thread is busy with it
+    QThread::msleep(200);
+    qCDebug(dcThreadedMock()) << "Removed" << thing->name();
+
+    hardwareManager()->pluginTimerManager()->unregisterTimer(m_timers.take(thing));
+}
+
+void IntegrationPluginThreadedMock::executeAction(ThingActionInfo *info)
+{
+    if (!inPluginThread()) {
+        info->finish(Thing::ThingErrorHardwareFailure, "Not called in the plugin thread.");
+        return;
+    }
+
+    if (info->action().actionTypeId() == threadedMockPowerActionTypeId) {
+        QVariant power = info->action().param(threadedMockPowerActionPowerParamTypeId).value();
+        info->thing()->setStateValue(threadedMockPowerStateTypeId, power);
+        if (info->thing()->stateValue(threadedMockPowerStateTypeId) != power) {
+            info->finish(Thing::ThingErrorHardwareFailure, "The state value has not been updated.");
+            return;
+        }
+        info->finish(Thing::ThingErrorNoError);
+        return;
+    }
+
+    if (info->action().actionTypeId() == threadedMockFinishLaterActionTypeId) {
+        QTimer::singleShot(100, this, [info](){
+            info->finish(Thing::ThingErrorNoError);
+        });
+        return;
+    }
+
+    info->finish(Thing::ThingErrorActionTypeNotFound);
+}
+
+bool IntegrationPluginThreadedMock::inPluginThread() const
+{
+    return QThread::currentThread() == thread() && thread() != QCoreApplication::instance()->thread();
+}
@@ -0,0 +1,72 @@
+/* This file is generated by the nymea build system. Any changes to this file will *
+ * be lost. If you want to change this file, edit the plugin's json file.          */
+
+#ifndef PLUGININFO_H
+#define PLUGININFO_H
+
+#include "typeutils.h"
+
+#include <QLoggingCategory>
+#include <QObject>
+
+extern "C" const QString libnymea_api_version() { return QString("7.0.0");}
+
+Q_DECLARE_LOGGING_CATEGORY(dcThreadedMock)
+Q_LOGGING_CATEGORY(dcThreadedMock, "ThreadedMock")
+
+PluginId pluginId = PluginId("{21b8ccbc-1fe6-48ee-849f-aadf9381b41f}");
+ParamTypeId threadedMockPluginIntervalParamTypeId = ParamTypeId("{48d6f10d-5818-41d2-9379-41f6192b2e99}");
+VendorId nymeaTestsVendorId = VendorId("{7589c59a-e1a1-4d79-be95-60d3243a7338}");
+ThingClassId threadedMockThingClassId = ThingClassId("{7cd7c9b5-4161-4c99-b928-0faa870244dc}");
+StateTypeId threadedMockPowerStateTypeId = StateTypeId("{ab153ad0-6f2a-4e76-820e-edd1d721c7a1}");
+StateTypeId threadedMockTicksStateTypeId = StateTypeId("{082f1332-d54b-40ed-8196-c029eecfbc15}");
+EventTypeId threadedMockPowerEventTypeId = EventTypeId("{ab153ad0-6f2a-4e76-820e-edd1d721c7a1}");
+ParamTypeId threadedMockPowerEventPowerParamTypeId = ParamTypeId("{ab153ad0-6f2a-4e76-820e-edd1d721c7a1}");
+EventTypeId threadedMockTicksEventTypeId = EventTypeId("{082f1332-d54b-40ed-8196-c029eecfbc15}");
+ParamTypeId threadedMockTicksEventTicksParamTypeId = ParamTypeId("{082f1332-d54b-40ed-8196-c029eecfbc15}");
+ActionTypeId threadedMockPowerActionTypeId = ActionTypeId("{ab153ad0-6f2a-4e76-820e-edd1d721c7a1}");
+ParamTypeId threadedMockPowerActionPowerParamTypeId = ParamTypeId("{ab153ad0-6f2a-4e76-820e-edd1d721c7a1}");
+ActionTypeId threadedMockFinishLaterActionTypeId = ActionTypeId("{9d64802b-ba53-4d9f-8e33-e719aca19a72}");
+
+const QString translations[] {
+    //: The name of the plugin threadedMock ({21b8ccbc-1fe6-48ee-849f-aadf9381b41f})
+    QT_TRANSLATE_NOOP("threadedMock", "Mock running in its own thread"),
+
+    //: The name of the ThingClass ({7cd7c9b5-4161-4c99-b928-0faa870244dc})
+    QT_TRANSLATE_NOOP("threadedMock", "Threaded mock"),
+
+    //: The name of the ParamType (ThingClass: threadedMock, Type: plugin, ID: {48d6f10d-5818-41d2-9379-41f6192b2e99})
+    QT_TRANSLATE_NOOP("threadedMock", "Tick interval"),
+
+    //: The name of the ActionType ({9d64802b-ba53-4d9f-8e33-e719aca19a72}) of ThingClass threadedMock
+    QT_TRANSLATE_NOOP("threadedMock", "finish later"),
+
+    //: The name of the vendor ({7589c59a-e1a1-4d79-be95-60d3243a7338})
+    QT_TRANSLATE_NOOP("threadedMock", "nymea tests"),
+
+    //: The name of the ParamType (ThingClass: threadedMock, ActionType: power, ID: {ab153ad0-6f2a-4e76-820e-edd1d721c7a1})
+    QT_TRANSLATE_NOOP("threadedMock", "powered"),
+
+    //: The name of the ParamType (ThingClass: threadedMock, EventType: power, ID: {ab153ad0-6f2a-4e76-820e-edd1d721c7a1})
+    QT_TRANSLATE_NOOP("threadedMock", "powered"),
+
+    //: The name of the StateType ({ab153ad0-6f2a-4e76-820e-edd1d721c7a1}) of ThingClass threadedMock
+    QT_TRANSLATE_NOOP("threadedMock", "powered"),
+
+    //: The name of the EventType ({ab153ad0-6f2a-4e76-820e-edd1d721c7a1}) of ThingClass threadedMock
+    QT_TRANSLATE_NOOP("threadedMock", "powered changed"),
+
+    //: The name of the ActionType ({ab153ad0-6f2a-4e76-820e-edd1d721c7a1}) of ThingClass threadedMock
+    QT_TRANSLATE_NOOP("threadedMock", "set power"),
+
+    //: The name of the ParamType (ThingClass: threadedMock, EventType: ticks, ID: {082f1332-d54b-40ed-8196-c029eecfbc15})
+    QT_TRANSLATE_NOOP("threadedMock", "ticks"),
+
+    //: The name of the StateType ({082f1332-d54b-40ed-8196-c029eecfbc15}) of ThingClass threadedMock
+    QT_TRANSLATE_NOOP("threadedMock", "ticks"),
+
+    //: The name of the EventType ({082f1332-d54b-40ed-8196-c029eecfbc15}) of ThingClass threadedMock
+    QT_TRANSLATE_NOOP("threadedMock", "ticks changed")
+};
+
+#endif // PLUGININFO_H
@@ -0,0 +1,21 @@
+include(../../../nymea.pri)
+
+TEMPLATE = lib
+CONFIG += plugin
+
+QT += network
+
+INCLUDEPATH += $$top_srcdir/libnymea
+LIBS += -L$$top_builddir/libnymea -lnymea
+
+TARGET = $$qtLibraryTarget(nymea_integrationpluginthreadedmock)
+
+OTHER_FILES += integrationpluginthreadedmock.json
+
+HEADERS += \
+    integrationpluginthreadedmock.h \
+    plugininfo.h \
+    extern-plugininfo.h
+
+SOURCES += \
+    integrationpluginthreadedmock.cpp
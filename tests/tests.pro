@@ -1,5 +1,5 @@
 TEMPLATE = subdirs
 
-SUBDIRS = testlib auto tools/simplepushbuttonhandler
+SUBDIRS = testlib testplugins auto tools/simplepushbuttonhandler
 
-auto.depends += testlib
+auto.depends += testlib testplugins